@@ -0,0 +1,23 @@
+#!/bin/sh
+# Scenari di comportamento (QUICKPLAY, WATCH, RESUME, tornei, code a
+# server pieno) su ogni backend di I/O del server.
+# Uso: ./check.sh [backend...]
+# Richiede ../server/server e ./checks già compilati.
+
+PORT=${PORT:-23457}
+GRACE=2
+SERVER=../server/server
+BACKENDS=${*:-threaded epoll uring}
+status=0
+
+for io in $BACKENDS; do
+    $SERVER -l 0 -i 0 -g $GRACE -I $io -r /tmp/checks.ratings.$$ "$PORT" >/dev/null 2>&1 &
+    pid=$!
+    sleep 0.5
+    echo "$io:"
+    ./checks -p "$PORT" -g $GRACE || status=1
+    kill $pid
+    wait $pid 2>/dev/null
+    rm -f /tmp/checks.ratings.$$
+done
+exit $status
@@ -0,0 +1,24 @@
+#!/bin/sh
+# Confronta i backend di I/O del server con lo stesso carico.
+# Uso: ./run.sh [connessioni] [secondi] [worker]
+# Richiede ../server/server e ./iobench già compilati.
+
+CONNS=${1:-64}
+SECS=${2:-5}
+WORKERS=${3:-0}
+PORT=${PORT:-23456}
+SERVER=../server/server
+HZ=$(getconf CLK_TCK)
+
+for io in threaded epoll uring; do
+    $SERVER -l 0 -i 0 -I $io -w "$WORKERS" -r /tmp/iobench.ratings.$$ "$PORT" >/dev/null 2>&1 &
+    pid=$!
+    sleep 0.5
+    cpu0=$(awk '{ print $14 + $15 }' /proc/$pid/stat)
+    ./iobench -p "$PORT" -c "$CONNS" -d "$SECS" -b "$io"
+    cpu1=$(awk '{ print $14 + $15 }' /proc/$pid/stat)
+    echo "           CPU server: $(echo "$cpu0 $cpu1 $HZ" | awk '{ printf "%.2f s", ($2 - $1) / $3 }')"
+    kill $pid
+    wait $pid 2>/dev/null
+done
+rm -f /tmp/iobench.ratings.$$
@@ -0,0 +1,558 @@
+#include <errno.h>
+#include <poll.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include "state.h"
+#include "match.h"
+
+/* ================================================================== */
+/*  CHECKS  –  Scenari di comportamento contro un server in ascolto    */
+/* ================================================================== */
+
+/*
+ * Ogni scenario apre le sue connessioni, manda i comandi e aspetta le
+ * righe previste (le altre, come i broadcast della lobby, si saltano).
+ * Alla fine esce con QUIT e aspetta la chiusura, così il server ha già
+ * liberato slot e partite quando parte lo scenario successivo.  Il
+ * server va avviato con -l 0 -i 0 e una grazia corta (-g 2): vedi
+ * check.sh.  Esce con 1 se uno scenario fallisce.
+ */
+
+#define WAIT_MS  2000
+#define QUIET_MS 400
+#define RXBUF    16384
+#define NPOOL    (MAX_CLIENTS + 2)
+
+typedef struct {
+    int    fd;
+    char   name[16];
+    char   board[9];     /* partita di torneo in corso, ' ' = vuota */
+    char   mark;
+    char   rx[RXBUF];
+    size_t rxlen;
+} cl_t;
+
+static cl_t        g_pool[NPOOL];
+static int         g_port  = 12345;
+static int         g_grace = 2;
+static const char *g_scene;
+static int         g_failed;
+
+static long now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000L + ts.tv_nsec / 1000000L;
+}
+
+static void sleep_ms(long ms) {
+    struct timespec ts = { ms / 1000, (ms % 1000) * 1000000L };
+    while (nanosleep(&ts, &ts) < 0 && errno == EINTR) {}
+}
+
+static int fail(const char *fmt, ...) {
+    va_list ap;
+    va_start(ap, fmt);
+    printf("  %-14s FALLITO: ", g_scene);
+    vprintf(fmt, ap);
+    printf("\n");
+    va_end(ap);
+    g_failed = 1;
+    return -1;
+}
+
+static int cl_connect(cl_t *c) {
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family      = AF_INET;
+    addr.sin_port        = htons((uint16_t)g_port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    c->rxlen = 0;
+    c->fd    = socket(AF_INET, SOCK_STREAM, 0);
+    if (c->fd < 0) return -1;
+    if (connect(c->fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        close(c->fd);
+        c->fd = -1;
+        return -1;
+    }
+    return 0;
+}
+
+static void cl_send(cl_t *c, const char *fmt, ...) {
+    char    line[256];
+    va_list ap;
+    va_start(ap, fmt);
+    int len = vsnprintf(line, sizeof(line) - 1, fmt, ap);
+    va_end(ap);
+    line[len++] = '\n';
+    for (int off = 0; off < len; ) {
+        ssize_t n = send(c->fd, line + off, (size_t)(len - off), MSG_NOSIGNAL);
+        if (n <= 0) return;
+        off += (int)n;
+    }
+}
+
+/* Una riga senza "\n": 1, 0 se non arriva entro ms, -1 a connessione chiusa */
+static int cl_line(cl_t *c, char *out, size_t cap, int ms) {
+    long end = now_ms() + ms;
+    for (;;) {
+        char *nl = memchr(c->rx, '\n', c->rxlen);
+        if (nl) {
+            size_t l = (size_t)(nl - c->rx);
+            size_t k = l < cap - 1 ? l : cap - 1;
+            memcpy(out, c->rx, k);
+            out[k] = '\0';
+            c->rxlen -= l + 1;
+            memmove(c->rx, nl + 1, c->rxlen);
+            return 1;
+        }
+        if (c->rxlen == sizeof(c->rx)) c->rxlen = 0;   /* riga enorme: si scarta */
+
+        long left = end - now_ms();
+        if (left < 0) left = 0;
+        struct pollfd pfd = { c->fd, POLLIN, 0 };
+        int r = poll(&pfd, 1, (int)left);
+        if (r < 0 && errno == EINTR) continue;
+        if (r <= 0) return 0;
+        ssize_t n = recv(c->fd, c->rx + c->rxlen, sizeof(c->rx) - c->rxlen, 0);
+        if (n <= 0) return -1;
+        c->rxlen += (size_t)n;
+    }
+}
+
+/* Salta le righe finché una comincia con prefix: 0 oppure -1 (scaduto) */
+static int cl_expect(cl_t *c, const char *prefix, char *out, size_t cap) {
+    char line[512];
+    long end = now_ms() + WAIT_MS;
+    for (;;) {
+        long left = end - now_ms();
+        if (left <= 0 || cl_line(c, line, sizeof(line), (int)left) <= 0)
+            return fail("%s: atteso \"%s\"", c->name, prefix);
+        if (strncmp(line, prefix, strlen(prefix)) == 0) {
+            if (out) snprintf(out, cap, "%s", line);
+            return 0;
+        }
+    }
+}
+
+/* 0 se per QUIET_MS non arriva nessuna riga che comincia con prefix */
+static int cl_quiet(cl_t *c, const char *prefix) {
+    char line[512];
+    long end = now_ms() + QUIET_MS;
+    for (;;) {
+        long left = end - now_ms();
+        if (left <= 0 || cl_line(c, line, sizeof(line), (int)left) <= 0) return 0;
+        if (strncmp(line, prefix, strlen(prefix)) == 0)
+            return fail("%s: inatteso \"%s\"", c->name, line);
+    }
+}
+
+static int cl_login(cl_t *c, const char *name, char *token, size_t cap) {
+    char line[512];
+    snprintf(c->name, sizeof(c->name), "%s", name);
+    if (cl_connect(c) < 0) return fail("%s: connect: %s", name, strerror(errno));
+    if (cl_expect(c, "WELCOME", NULL, 0) < 0) return -1;
+    cl_send(c, "LOGIN %s", name);
+    if (cl_expect(c, "OK LOGIN", NULL, 0) < 0) return -1;
+    if (!token) return 0;
+    if (cl_expect(c, "OK TOKEN ", line, sizeof(line)) < 0) return -1;
+    size_t n = strlen(line + 9);
+    if (n >= cap) n = cap - 1;
+    memcpy(token, line + 9, n);
+    token[n] = '\0';
+    return 0;
+}
+
+/* Connessione chiusa senza QUIT: la sessione resta nel periodo di grazia */
+static void cl_drop(cl_t *c) {
+    if (c->fd >= 0) close(c->fd);
+    c->fd = -1;
+}
+
+/* QUIT e attesa della chiusura dal server (pulizia già fatta) */
+static void cl_quit(cl_t *c) {
+    char line[512];
+    if (c->fd < 0) return;
+    cl_send(c, "QUIT");
+    long end = now_ms() + WAIT_MS;
+    while (now_ms() < end && cl_line(c, line, sizeof(line), WAIT_MS) >= 0) {}
+    cl_drop(c);
+}
+
+static int id_after(const char *line, const char *prefix) {
+    return atoi(line + strlen(prefix));
+}
+
+/* Partita avviata fra x e o: cinque mosse, vince x (l'ultima senza OK MOVED) */
+static int play_x_wins(cl_t *x, cl_t *o) {
+    static const int mv[5][2] = { {0, 0}, {1, 0}, {0, 1}, {1, 1}, {0, 2} };
+    for (int i = 0; i < 5; i++) {
+        cl_t *c = i % 2 ? o : x;
+        cl_send(c, "MOVE %d %d", mv[i][0], mv[i][1]);
+        if (i < 4 && cl_expect(c, "OK MOVED", NULL, 0) < 0) return -1;
+    }
+    if (cl_expect(x, "EVENT YOU_WIN", NULL, 0) < 0) return -1;
+    return cl_expect(o, "EVENT YOU_LOSE", NULL, 0);
+}
+
+/* CREATE, JOIN, ACCEPT e partita vinta dall'owner; ritorna l'id o -1 */
+static int play_created(cl_t *x, cl_t *o) {
+    char line[512];
+    cl_send(x, "CREATE");
+    if (cl_expect(x, "OK MATCH_", line, sizeof(line)) < 0) return -1;
+    if (strncmp(line, "OK MATCH_CREATED ", 17) != 0) return fail("CREATE: %s", line);
+    int id = id_after(line, "OK MATCH_CREATED ");
+    cl_send(o, "JOIN %d", id);
+    if (cl_expect(o, "OK JOIN_REQUESTED", NULL, 0) < 0) return -1;
+    cl_send(x, "ACCEPT %d", id);
+    if (cl_expect(x, "OK MATCH_STARTED", NULL, 0) < 0) return -1;
+    if (cl_expect(o, "OK MATCH_STARTED", NULL, 0) < 0) return -1;
+    return play_x_wins(x, o) < 0 ? -1 : id;
+}
+
+static void report(int ok) {
+    if (ok) printf("  %-14s ok\n", g_scene);
+}
+
+/* ------------------------------------------------------------------ */
+/*  QUICKPLAY: abbinamento, CANCEL, partita aperta, coda dopo un QUIT   */
+/* ------------------------------------------------------------------ */
+
+static void scene_quickplay(void) {
+    cl_t *a = &g_pool[0], *b = &g_pool[1], *c = &g_pool[2], *d = &g_pool[3], *e = &g_pool[4];
+    char  line[512];
+    int   ok = 0;
+    g_scene = "quickplay";
+
+    if (cl_login(a, "qa", NULL, 0) < 0 || cl_login(b, "qb", NULL, 0) < 0 ||
+        cl_login(c, "qc", NULL, 0) < 0 || cl_login(d, "qd", NULL, 0) < 0) goto out;
+
+    cl_send(a, "QUICKPLAY");
+    if (cl_expect(a, "OK QUEUED", NULL, 0) < 0) goto out;
+    cl_send(a, "QUICKPLAY CANCEL");
+    if (cl_expect(a, "OK UNQUEUED", NULL, 0) < 0) goto out;
+    cl_send(b, "QUICKPLAY");
+    if (cl_expect(b, "OK QUEUED", NULL, 0) < 0) goto out;
+    if (cl_quiet(a, "OK MATCH_STARTED") < 0) goto out;
+
+    cl_send(a, "QUICKPLAY");
+    if (cl_expect(a, "OK MATCH_STARTED", line, sizeof(line)) < 0) goto out;
+    if (!strstr(line, "vs qb")) { fail("qa: %s", line); goto out; }
+    if (cl_expect(b, "OK MATCH_STARTED", NULL, 0) < 0) goto out;
+
+    /* Con una partita propria in attesa niente coda */
+    cl_send(c, "CREATE");
+    if (cl_expect(c, "OK MATCH_CREATED", NULL, 0) < 0) goto out;
+    cl_send(c, "QUICKPLAY");
+    if (cl_expect(c, "ERR ALREADY_PLAYING", NULL, 0) < 0) goto out;
+
+    /* Chi esce dalla coda non viene abbinato */
+    cl_send(d, "QUICKPLAY");
+    if (cl_expect(d, "OK QUEUED", NULL, 0) < 0) goto out;
+    cl_quit(d);
+    if (cl_login(e, "qe", NULL, 0) < 0) goto out;
+    cl_send(e, "QUICKPLAY");
+    if (cl_expect(e, "OK QUEUED", NULL, 0) < 0) goto out;
+    ok = 1;
+out:
+    for (int i = 0; i < 5; i++) cl_quit(&g_pool[i]);
+    report(ok);
+}
+
+/* ------------------------------------------------------------------ */
+/*  WATCH: due spettatori ricevono le mosse, UNWATCH le ferma           */
+/* ------------------------------------------------------------------ */
+
+static void scene_watch(void) {
+    cl_t *x = &g_pool[0], *o = &g_pool[1], *s1 = &g_pool[2], *s2 = &g_pool[3];
+    char  line[512], want[64];
+    int   ok = 0;
+    g_scene = "watch";
+
+    if (cl_login(x, "wx", NULL, 0) < 0 || cl_login(o, "wo", NULL, 0) < 0 ||
+        cl_login(s1, "ws1", NULL, 0) < 0 || cl_login(s2, "ws2", NULL, 0) < 0) goto out;
+
+    cl_send(x, "QUICKPLAY");
+    if (cl_expect(x, "OK QUEUED", NULL, 0) < 0) goto out;
+    cl_send(o, "QUICKPLAY");
+    if (cl_expect(o, "OK MATCH_STARTED ", line, sizeof(line)) < 0) goto out;
+    int id = id_after(line, "OK MATCH_STARTED ");
+
+    cl_send(s1, "WATCH %d", id);
+    cl_send(s2, "WATCH %d", id);
+    snprintf(want, sizeof(want), "OK WATCHING %d", id);
+    if (cl_expect(s1, want, NULL, 0) < 0 || cl_expect(s2, want, NULL, 0) < 0) goto out;
+
+    cl_send(x, "MOVE 0 0");
+    snprintf(want, sizeof(want), "EVENT WATCH %d MOVE 0 0", id);
+    if (cl_expect(s1, want, NULL, 0) < 0 || cl_expect(s2, want, NULL, 0) < 0) goto out;
+
+    cl_send(s2, "UNWATCH");
+    if (cl_expect(s2, "OK UNWATCHED", NULL, 0) < 0) goto out;
+    cl_send(o, "MOVE 1 1");
+    snprintf(want, sizeof(want), "EVENT WATCH %d MOVE 1 1", id);
+    if (cl_expect(s1, want, NULL, 0) < 0) goto out;
+    if (cl_quiet(s2, "EVENT WATCH") < 0) goto out;
+
+    cl_send(o, "RESIGN");
+    snprintf(want, sizeof(want), "EVENT WATCH %d RESIGN", id);
+    if (cl_expect(s1, want, NULL, 0) < 0) goto out;
+    cl_send(s1, "UNWATCH");
+    if (cl_expect(s1, "ERR NOT_WATCHING", NULL, 0) < 0) goto out;
+    ok = 1;
+out:
+    for (int i = 0; i < 4; i++) cl_quit(&g_pool[i]);
+    report(ok);
+}
+
+/* ------------------------------------------------------------------ */
+/*  RESUME: entro la grazia con replay, dopo la grazia rifiutato        */
+/* ------------------------------------------------------------------ */
+
+static void scene_resume(void) {
+    cl_t *x = &g_pool[0], *o = &g_pool[1];
+    char  token[128], line[512], want[64];
+    int   ok = 0;
+    g_scene = "resume";
+
+    if (cl_login(x, "rx", NULL, 0) < 0 || cl_login(o, "ro", token, sizeof(token)) < 0) goto out;
+    cl_send(x, "QUICKPLAY");
+    if (cl_expect(x, "OK QUEUED", NULL, 0) < 0) goto out;
+    cl_send(o, "QUICKPLAY");
+    if (cl_expect(o, "OK MATCH_STARTED ", line, sizeof(line)) < 0) goto out;
+    int id = id_after(line, "OK MATCH_STARTED ");
+
+    cl_drop(o);
+    cl_send(x, "MOVE 0 0");
+    if (cl_expect(x, "OK MOVED", NULL, 0) < 0) goto out;
+
+    /* Entro la grazia: stessa partita, la mossa persa arriva come replay */
+    if (cl_connect(o) < 0 || cl_expect(o, "WELCOME", NULL, 0) < 0) goto out;
+    cl_send(o, "RESUME %s 0", token);
+    snprintf(want, sizeof(want), "OK RESUMED ro match=%d", id);
+    if (cl_expect(o, want, NULL, 0) < 0) goto out;
+    if (cl_expect(o, "EVENT REPLAY 1 MOVE X 0 0", NULL, 0) < 0) goto out;
+    cl_send(o, "MOVE 1 1");
+    if (cl_expect(x, "EVENT OPPONENT_MOVED 1 1", NULL, 0) < 0) goto out;
+
+    /* Dopo la grazia: sessione chiusa, l'avversario vince a tavolino */
+    cl_drop(o);
+    sleep_ms(g_grace * 1000L + 1500);
+    if (cl_expect(x, "EVENT YOU_WIN", NULL, 0) < 0) goto out;
+    if (cl_connect(o) < 0 || cl_expect(o, "WELCOME", NULL, 0) < 0) goto out;
+    cl_send(o, "RESUME %s 2", token);
+    if (cl_expect(o, "ERR RESUME_FAILED", NULL, 0) < 0) goto out;
+    ok = 1;
+out:
+    cl_quit(x);
+    cl_quit(o);
+    report(ok);
+}
+
+/* ------------------------------------------------------------------ */
+/*  Tornei: ogni giocatore muove nella prima casella libera (vince X)  */
+/* ------------------------------------------------------------------ */
+
+static void tour_move(cl_t *c) {
+    for (int i = 0; i < 9; i++) {
+        if (c->board[i] != ' ') continue;
+        c->board[i] = c->mark;
+        cl_send(c, "MOVE %d %d", i / 3, i % 3);
+        return;
+    }
+}
+
+/*
+ * Fa giocare ps[0..n-1] finché arriva EVENT TOURNAMENT_END tid.  Conta
+ * le partite (una per ogni X) e legge il numero di turni dagli eventi
+ * EVENT TOURNAMENT_ROUND.  0 oppure -1.
+ */
+static int tour_play(cl_t *ps, int n, int tid, int *matches, int *rounds) {
+    char line[512], pfx_round[48], pfx_end[48];
+    int  ended = 0;
+    long end   = now_ms() + 20000;
+    snprintf(pfx_round, sizeof(pfx_round), "EVENT TOURNAMENT_ROUND %d ", tid);
+    snprintf(pfx_end,   sizeof(pfx_end),   "EVENT TOURNAMENT_END %d ", tid);
+    *matches = *rounds = 0;
+
+    while (!ended) {
+        if (now_ms() > end) return fail("torneo %d non finito", tid);
+        for (int i = 0; i < n; i++) {
+            cl_t *c = &ps[i];
+            while (cl_line(c, line, sizeof(line), i == 0 ? 5 : 0) > 0) {
+                if (strncmp(line, "ERR", 3) == 0) return fail("%s: %s", c->name, line);
+                if (strncmp(line, "OK MATCH_STARTED ", 17) == 0) {
+                    memset(c->board, ' ', sizeof(c->board));
+                    c->mark = strstr(line, "(YOU=X)") ? 'X' : 'O';
+                    if (c->mark == 'X') { (*matches)++; tour_move(c); }
+                } else if (strncmp(line, "EVENT OPPONENT_MOVED ", 21) == 0) {
+                    int r = line[21] - '0', col = line[23] - '0';
+                    c->board[r * 3 + col] = c->mark == 'X' ? 'O' : 'X';
+                    tour_move(c);
+                } else if (strncmp(line, pfx_round, strlen(pfx_round)) == 0) {
+                    int tot = atoi(strchr(line + strlen(pfx_round), '/') + 1);
+                    if (tot > *rounds) *rounds = tot;
+                } else if (strncmp(line, pfx_end, strlen(pfx_end)) == 0) {
+                    ended = 1;
+                }
+            }
+        }
+    }
+    return 0;
+}
+
+/* Torneo da n fra ps[]: creato da ps[0], gli altri si iscrivono.  tid o -1 */
+static int tour_open(cl_t *ps, int n, const char *format) {
+    char line[512];
+    cl_send(&ps[0], "TOURNAMENT CREATE %d %s", n, format);
+    if (cl_expect(&ps[0], "OK TOURNAMENT_CREATED ", line, sizeof(line)) < 0) return -1;
+    int tid = id_after(line, "OK TOURNAMENT_CREATED ");
+    for (int i = 1; i < n; i++) {
+        cl_send(&ps[i], "TOURNAMENT JOIN %d", tid);
+        if (cl_expect(&ps[i], "OK TOURNAMENT_JOINED", NULL, 0) < 0) return -1;
+    }
+    return tid;
+}
+
+static void scene_tournament(const char *format, int want_matches, int want_rounds) {
+    static char scene[32];
+    cl_t *ps = &g_pool[0];
+    char  name[16];
+    int   ok = 0, matches, rounds;
+    snprintf(scene, sizeof(scene), "torneo %s", format);
+    g_scene = scene;
+
+    for (int i = 0; i < 4; i++) {
+        snprintf(name, sizeof(name), "t%.3s%d", format, i);
+        if (cl_login(&ps[i], name, NULL, 0) < 0) goto out;
+    }
+    int tid = tour_open(ps, 4, format);
+    if (tid < 0 || tour_play(ps, 4, tid, &matches, &rounds) < 0) goto out;
+    if (matches != want_matches || rounds != want_rounds) {
+        fail("%d partite in %d turni, attese %d in %d", matches, rounds, want_matches, want_rounds);
+        goto out;
+    }
+    ok = 1;
+out:
+    for (int i = 0; i < 4; i++) cl_quit(&ps[i]);
+    report(ok);
+}
+
+/* ------------------------------------------------------------------ */
+/*  Partite esaurite: coda di CREATE, turno di torneo che aspetta gli   */
+/*  slot prenotati, REMATCH nel frattempo                               */
+/* ------------------------------------------------------------------ */
+
+static void scene_full(void) {
+    cl_t *a = &g_pool[0], *b = &g_pool[1], *c = &g_pool[2], *ps = &g_pool[3];
+    char  line[512], name[16];
+    int   ok = 0, matches, rounds;
+    g_scene = "slot esauriti";
+
+    if (cl_login(a, "fa", NULL, 0) < 0 || cl_login(b, "fb", NULL, 0) < 0 ||
+        cl_login(c, "fc", NULL, 0) < 0) goto out;
+    for (int i = 0; i < 4; i++) {
+        snprintf(name, sizeof(name), "ft%d", i);
+        if (cl_login(&ps[i], name, NULL, 0) < 0) goto out;
+    }
+
+    /* Le partite finite tengono lo slot (per il REMATCH): ne resta uno */
+    for (int i = 0; i < MAX_MATCHES - 1; i++)
+        if (play_created(a, b) < 0) goto out;
+
+    /* Il primo turno vuole due slot: prenota l'unico libero e aspetta */
+    int tid = tour_open(ps, 4, "single");
+    if (tid < 0 || cl_quiet(&ps[0], "OK MATCH_STARTED") < 0) goto out;
+
+    /* Lo slot prenotato non va a CREATE, che si mette in coda */
+    cl_send(c, "CREATE");
+    if (cl_expect(c, "OK MATCH_", line, sizeof(line)) < 0) goto out;
+    if (strncmp(line, "OK MATCH_QUEUED 1 ", 18) != 0) { fail("fc: %s", line); goto out; }
+
+    /* REMATCH riusa il proprio slot anche con prenotazioni in corso */
+    cl_send(a, "REMATCH");
+    if (cl_expect(a, "OK REMATCH_CREATED", NULL, 0) < 0) goto out;
+    if (cl_quiet(c, "OK MATCH_CREATED") < 0) goto out;
+
+    /* fb esce: le sue partite finite liberano gli slot per tutti */
+    cl_quit(b);
+    if (cl_expect(c, "OK MATCH_CREATED", NULL, 0) < 0) goto out;
+    if (tour_play(ps, 4, tid, &matches, &rounds) < 0) goto out;
+    if (matches != 3) { fail("%d partite di torneo, attese 3", matches); goto out; }
+    ok = 1;
+out:
+    for (int i = 0; i < 7; i++) cl_quit(&g_pool[i]);
+    report(ok);
+}
+
+/* ------------------------------------------------------------------ */
+/*  Ammissione: oltre MAX_CLIENTS connessioni si aspetta in ordine      */
+/* ------------------------------------------------------------------ */
+
+static void scene_admission(void) {
+    char line[512];
+    int  ok = 0, n = 0;
+    g_scene = "ammissione";
+
+    /* Si riempie fino alla prima connessione messa in coda */
+    for (;;) {
+        cl_t *c = &g_pool[n];
+        snprintf(c->name, sizeof(c->name), "conn%d", n);
+        if (n == NPOOL - 1) { fail("%d connessioni senza coda", n); goto out; }
+        if (cl_connect(c) < 0) { fail("connect: %s", strerror(errno)); goto out; }
+        n++;
+        if (cl_line(c, line, sizeof(line), WAIT_MS) <= 0) { fail("%s: nessuna risposta", c->name); goto out; }
+        if (strncmp(line, "EVENT ADMISSION_QUEUE 1 ", 24) == 0) break;
+        if (strncmp(line, "WELCOME", 7) != 0) { fail("%s: %s", c->name, line); goto out; }
+    }
+    cl_t *q1 = &g_pool[n - 1], *q2 = &g_pool[n];
+    snprintf(q2->name, sizeof(q2->name), "conn%d", n);
+    if (cl_connect(q2) < 0) { fail("connect: %s", strerror(errno)); goto out; }
+    n++;
+    if (cl_expect(q2, "EVENT ADMISSION_QUEUE 2 ", NULL, 0) < 0) goto out;
+
+    /* Si libera uno slot: entra il primo, il secondo avanza */
+    cl_quit(&g_pool[0]);
+    if (cl_expect(q1, "WELCOME", NULL, 0) < 0) goto out;
+    if (cl_expect(q2, "EVENT ADMISSION_QUEUE 1 ", NULL, 0) < 0) goto out;
+    if (cl_quiet(q2, "WELCOME") < 0) goto out;
+    cl_quit(&g_pool[1]);
+    if (cl_expect(q2, "WELCOME", NULL, 0) < 0) goto out;
+    ok = 1;
+out:
+    for (int i = 0; i < n; i++) cl_quit(&g_pool[i]);
+    report(ok);
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr, "Uso: %s [-p porta] [-g grazia_sec del server]\n", prog);
+}
+
+int main(int argc, char *argv[]) {
+    int opt;
+    while ((opt = getopt(argc, argv, "p:g:")) != -1) {
+        switch (opt) {
+            case 'p': g_port  = atoi(optarg); break;
+            case 'g': g_grace = atoi(optarg); break;
+            default:  usage(argv[0]); return 2;
+        }
+    }
+    for (int i = 0; i < NPOOL; i++) g_pool[i].fd = -1;
+    setvbuf(stdout, NULL, _IOLBF, 0);
+
+    scene_quickplay();
+    scene_watch();
+    scene_resume();
+    scene_tournament("single", 3, 2);
+    scene_tournament("swiss",  4, 2);
+    scene_tournament("rr",     6, 3);
+    scene_full();
+    scene_admission();
+    return g_failed;
+}
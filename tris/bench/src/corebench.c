@@ -0,0 +1,143 @@
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "core.h"
+#include "log.h"
+#include "ratelimit.h"
+
+/* ================================================================== */
+/*  COREBENCH  –  Partite complete sul motore in-process, senza rete   */
+/* ================================================================== */
+
+/*
+ * T thread, ognuno con P coppie di giocatori collegati con core_connect:
+ * ogni coppia gioca partite intere (CREATE, poi REMATCH del vincitore
+ * che riusa lo slot; JOIN, ACCEPT, cinque mosse fino alla vittoria di
+ * X) una dopo l'altra.  I sink contano le righe e tengono l'ultimo id di
+ * partita creato.  Riporta comandi e partite al secondo; gli ERR
+ * ricevuti indicano uno scenario che non va come previsto e vengono
+ * contati a parte.
+ */
+
+#define DEFAULT_T    4
+#define DEFAULT_SECS 3
+#define MAX_THREADS  16
+
+typedef struct {
+    int      last_id;     /* da OK MATCH_CREATED / OK REMATCH_CREATED */
+    uint64_t lines;
+    uint64_t errors;
+    uint64_t wins;
+} peer_t;
+
+typedef struct {
+    int      pairs;
+    int      secs;
+    uint64_t cmds;
+    uint64_t games;
+    uint64_t lines;
+    uint64_t errors;
+} worker_t;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static void sink(void *ctx, const char *msg, size_t len) {
+    peer_t *pe = ctx;
+    for (const char *p = msg, *end = msg + len; p < end; ) {
+        const char *nl = memchr(p, '\n', (size_t)(end - p));
+        if (!nl) nl = end;
+        pe->lines++;
+        if (strncmp(p, "OK MATCH_CREATED ", 17) == 0)        pe->last_id = atoi(p + 17);
+        else if (strncmp(p, "OK REMATCH_CREATED ", 19) == 0) pe->last_id = atoi(p + 19);
+        else if (strncmp(p, "ERR", 3) == 0)                  pe->errors++;
+        else if (strncmp(p, "EVENT YOU_WIN", 13) == 0)       pe->wins++;
+        p = nl + 1;
+    }
+}
+
+static void *worker(void *arg) {
+    worker_t *w = arg;
+    core_player_t *x[MAX_THREADS * 4], *o[MAX_THREADS * 4];
+    peer_t         px[MAX_THREADS * 4], po[MAX_THREADS * 4];
+    static int     seq;
+
+    memset(px, 0, sizeof(px));
+    memset(po, 0, sizeof(po));
+    for (int i = 0; i < w->pairs; i++) {
+        char line[64];
+        x[i] = core_connect(sink, &px[i]);
+        o[i] = core_connect(sink, &po[i]);
+        if (!x[i] || !o[i]) { fprintf(stderr, "core_connect: slot finiti\n"); exit(1); }
+        int n = __atomic_add_fetch(&seq, 1, __ATOMIC_RELAXED);
+        snprintf(line, sizeof(line), "LOGIN x%d", n);
+        core_command(x[i], line);
+        snprintf(line, sizeof(line), "LOGIN o%d", n);
+        core_command(o[i], line);
+    }
+
+    static const char *const moves[] = { "MOVE 0 0", "MOVE 1 0", "MOVE 0 1", "MOVE 1 1", "MOVE 0 2" };
+    uint64_t end = now_ns() + (uint64_t)w->secs * 1000000000ull;
+    while (now_ns() < end) {
+        for (int i = 0; i < w->pairs; i++) {
+            char line[32];
+            core_command(x[i], px[i].wins ? "REMATCH" : "CREATE");
+            snprintf(line, sizeof(line), "JOIN %d", px[i].last_id);
+            core_command(o[i], line);
+            snprintf(line, sizeof(line), "ACCEPT %d", px[i].last_id);
+            core_command(x[i], line);
+            for (int m = 0; m < 5; m++) core_command(m % 2 ? o[i] : x[i], moves[m]);
+            w->cmds += 8;
+        }
+    }
+
+    for (int i = 0; i < w->pairs; i++) {
+        w->games  += px[i].wins;
+        w->lines  += px[i].lines + po[i].lines;
+        w->errors += px[i].errors + po[i].errors;
+        core_disconnect(x[i]);
+        core_disconnect(o[i]);
+    }
+    return NULL;
+}
+
+int main(int argc, char *argv[]) {
+    int nthreads = argc > 1 ? atoi(argv[1]) : DEFAULT_T;
+    int secs     = argc > 2 ? atoi(argv[2]) : DEFAULT_SECS;
+    if (nthreads <= 0 || nthreads > MAX_THREADS) nthreads = DEFAULT_T;
+    if (secs <= 0) secs = DEFAULT_SECS;
+    int pairs = CORE_MAX_PLAYERS / 2 / nthreads;
+    if (pairs > 4) pairs = 4;
+
+    /* Come server -l 0 con il log spento: si misura il motore */
+    g_log_mask = 0;
+    rl_configure(RL_ANY, 0, 0);
+    rl_configure(RL_QUERY, 0, 0);
+    rl_configure(RL_LOBBY, 0, 0);
+    if (core_init(NULL, 0) < 0 || core_start() < 0) { perror("core"); return 1; }
+
+    pthread_t tid[MAX_THREADS];
+    worker_t  w[MAX_THREADS];
+    uint64_t  t0 = now_ns();
+    for (int i = 0; i < nthreads; i++) {
+        w[i] = (worker_t){ pairs, secs, 0, 0, 0, 0 };
+        pthread_create(&tid[i], NULL, worker, &w[i]);
+    }
+    uint64_t cmds = 0, games = 0, lines = 0, errors = 0;
+    for (int i = 0; i < nthreads; i++) {
+        pthread_join(tid[i], NULL);
+        cmds += w[i].cmds; games += w[i].games; lines += w[i].lines; errors += w[i].errors;
+    }
+    double s = (double)(now_ns() - t0) / 1e9;
+    printf("%d thread x %d coppie: %.0f comandi/s, %.0f partite/s, %.1f righe per comando",
+           nthreads, pairs, cmds / s, games / s, cmds ? (double)lines / cmds : 0.0);
+    if (errors) printf(", %llu ERR", (unsigned long long)errors);
+    printf("\n");
+    return 0;
+}
@@ -0,0 +1,197 @@
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+
+/* ================================================================== */
+/*  IOBENCH  –  Carico a ciclo chiuso sul server, per confrontare i    */
+/*              backend di I/O (-I threaded | epoll | uring)            */
+/* ================================================================== */
+
+/*
+ * Apre C connessioni, fa LOGIN su ognuna e poi tiene una richiesta in
+ * volo per connessione: appena arriva la risposta ne parte un'altra.
+ * Misura richieste al secondo e latenza (p50 / p99 / max) dopo un
+ * periodo di riscaldamento.  Il server va avviato con -l 0, altrimenti
+ * il limite di righe al secondo domina la misura.
+ */
+
+#define MAX_CONNS   1024
+#define RXBUF       4096
+#define MAX_SAMPLES (1 << 22)
+
+typedef struct {
+    int      fd;
+    int      ready;      /* login completato */
+    uint64_t sent_ns;
+    char     rx[RXBUF];
+    size_t   rxlen;
+} conn_t;
+
+static conn_t    g_conns[MAX_CONNS];
+static uint32_t *g_lat_us;
+static size_t    g_nlat;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+        "Uso: %s [-h host] [-p porta] [-c connessioni] [-d secondi] "
+        "[-w riscaldamento_sec] [-q comando] [-b etichetta]\n"
+        "  comando: WHOAMI (default) oppure PING\n", prog);
+}
+
+static int send_line(int fd, const char *s) {
+    size_t len = strlen(s), off = 0;
+    while (off < len) {
+        ssize_t n = send(fd, s + off, len - off, MSG_NOSIGNAL);
+        if (n <= 0) return -1;
+        off += (size_t)n;
+    }
+    return 0;
+}
+
+static int cmp_u32(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+int main(int argc, char *argv[]) {
+    const char *host   = "127.0.0.1";
+    const char *label  = "server";
+    const char *cmd    = "WHOAMI";
+    int         port   = 12345;
+    int         nconns = 64;
+    int         dur    = 5;
+    int         warm   = 1;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "h:p:c:d:w:q:b:")) != -1) {
+        switch (opt) {
+            case 'h': host   = optarg; break;
+            case 'p': port   = atoi(optarg); break;
+            case 'c': nconns = atoi(optarg); break;
+            case 'd': dur    = atoi(optarg); break;
+            case 'w': warm   = atoi(optarg); break;
+            case 'q': cmd    = optarg; break;
+            case 'b': label  = optarg; break;
+            default:  usage(argv[0]); return 1;
+        }
+    }
+    if (nconns <= 0 || nconns > MAX_CONNS || dur <= 0 ||
+        (strcmp(cmd, "WHOAMI") != 0 && strcmp(cmd, "PING") != 0)) {
+        usage(argv[0]);
+        return 1;
+    }
+    /* Prefisso della riga di risposta */
+    const char *reply = strcmp(cmd, "PING") == 0 ? "PONG" : "OK YOU ";
+    char        req[32];
+    snprintf(req, sizeof(req), "%s\n", cmd);
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port   = htons((uint16_t)port);
+    if (inet_pton(AF_INET, host, &addr.sin_addr) != 1) {
+        fprintf(stderr, "Host non valido: %s\n", host);
+        return 1;
+    }
+
+    g_lat_us = malloc(MAX_SAMPLES * sizeof(*g_lat_us));
+    int ep   = epoll_create1(0);
+    if (!g_lat_us || ep < 0) { perror("init"); return 1; }
+
+    for (int i = 0; i < nconns; i++) {
+        conn_t *c = &g_conns[i];
+        c->fd = socket(AF_INET, SOCK_STREAM, 0);
+        if (c->fd < 0 || connect(c->fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+            perror("connect");
+            return 1;
+        }
+        int one = 1;
+        setsockopt(c->fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        char login[64];
+        snprintf(login, sizeof(login), "LOGIN bench%d\n", i);
+        send_line(c->fd, login);
+
+        struct epoll_event ev = { .events = EPOLLIN, .data.u32 = (uint32_t)i };
+        epoll_ctl(ep, EPOLL_CTL_ADD, c->fd, &ev);
+    }
+
+    uint64_t t0       = now_ns();
+    uint64_t start_ns = t0 + (uint64_t)warm * 1000000000ULL;
+    uint64_t end_ns   = start_ns + (uint64_t)dur * 1000000000ULL;
+    uint64_t done     = 0;
+    int      ready    = 0;
+
+    struct epoll_event evs[256];
+    while (now_ns() < end_ns) {
+        int n = epoll_wait(ep, evs, 256, 100);
+        if (n < 0 && errno != EINTR) { perror("epoll_wait"); return 1; }
+        for (int e = 0; e < n; e++) {
+            conn_t *c = &g_conns[evs[e].data.u32];
+            ssize_t r = recv(c->fd, c->rx + c->rxlen, RXBUF - 1 - c->rxlen, 0);
+            if (r <= 0) {
+                fprintf(stderr, "Connessione chiusa dal server (%s)\n",
+                        r == 0 ? "EOF" : strerror(errno));
+                return 1;
+            }
+            c->rxlen += (size_t)r;
+            c->rx[c->rxlen] = '\0';
+
+            char *line = c->rx, *nl;
+            while ((nl = strchr(line, '\n')) != NULL) {
+                *nl = '\0';
+                if (!c->ready && strncmp(line, "OK TOKEN", 8) == 0) {
+                    c->ready = 1;
+                    ready++;
+                    c->sent_ns = now_ns();
+                    send_line(c->fd, req);
+                } else if (!c->ready && strncmp(line, "ERR", 3) == 0) {
+                    fprintf(stderr, "Login rifiutato: %s\n", line);
+                    return 1;
+                } else if (c->ready && strncmp(line, reply, strlen(reply)) == 0) {
+                    uint64_t t = now_ns();
+                    if (c->sent_ns >= start_ns) {
+                        done++;
+                        if (g_nlat < MAX_SAMPLES)
+                            g_lat_us[g_nlat++] = (uint32_t)((t - c->sent_ns) / 1000);
+                    }
+                    c->sent_ns = t;
+                    send_line(c->fd, req);
+                }
+                line = nl + 1;
+            }
+            c->rxlen -= (size_t)(line - c->rx);
+            memmove(c->rx, line, c->rxlen);
+        }
+    }
+
+    if (ready < nconns)
+        fprintf(stderr, "Attenzione: solo %d/%d connessioni hanno completato il login\n",
+                ready, nconns);
+
+    qsort(g_lat_us, g_nlat, sizeof(*g_lat_us), cmp_u32);
+    uint32_t p50 = g_nlat ? g_lat_us[g_nlat / 2] : 0;
+    uint32_t p99 = g_nlat ? g_lat_us[g_nlat * 99 / 100] : 0;
+    uint32_t max = g_nlat ? g_lat_us[g_nlat - 1] : 0;
+
+    printf("%-10s conn=%-5d req/s=%-10.0f p50=%uus p99=%uus max=%uus\n",
+           label, nconns, (double)done / dur, p50, p99, max);
+
+    for (int i = 0; i < nconns; i++) close(g_conns[i].fd);
+    free(g_lat_us);
+    return 0;
+}
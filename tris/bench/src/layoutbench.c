@@ -0,0 +1,206 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include "match.h"
+
+/* ================================================================== */
+/*  LAYOUTBENCH  –  Scansioni delle partite: layout vecchio (un solo   */
+/*                  array di match_t) contro parte calda e fredda      */
+/* ================================================================== */
+
+/*
+ * Ripete le scansioni che il server fa su tutti gli slot partita
+ * (ricerca per id, disconnect di un fd, slot libero) sui due layout,
+ * con la cache svuotata prima di ogni scansione: è il caso reale, fra
+ * due comandi il resto del server sporca la cache.  Riporta tempo medio
+ * per scansione e cache miss contati da perf_event_open solo durante le
+ * scansioni ("n/d" se il kernel non li concede, es. perf_event_paranoid).
+ */
+
+#define EVICT_BYTES (32u << 20)
+#define DEFAULT_ROUNDS 2000
+
+/* Layout di prima: campi caldi in testa a ogni match_t */
+typedef struct {
+    int            id;
+    match_status_t status;
+    int            owner_fd;
+    int            joiner_fd;
+    int            pending_fd;
+    match_t        cold;
+} old_match_t;
+
+static old_match_t  g_old[MAX_MATCHES];
+static match_hot_t  g_hot[MAX_MATCHES] __attribute__((aligned(64)));
+static match_t      g_cold[MAX_MATCHES];
+static volatile int g_sink;
+
+static unsigned char *g_evict;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static void evict(void) {
+    for (size_t i = 0; i < EVICT_BYTES; i += 64) g_evict[i]++;
+}
+
+/* ------------------------------------------------------------------ */
+/*  Contatore di cache miss                                             */
+/* ------------------------------------------------------------------ */
+static int perf_open(void) {
+    struct perf_event_attr a;
+    memset(&a, 0, sizeof(a));
+    a.type           = PERF_TYPE_HARDWARE;
+    a.size           = sizeof(a);
+    a.config         = PERF_COUNT_HW_CACHE_MISSES;
+    a.disabled       = 1;
+    a.exclude_kernel = 1;
+    a.exclude_hv     = 1;
+    return (int)syscall(__NR_perf_event_open, &a, 0, -1, -1, 0);
+}
+
+static void perf_on(int fd)  { if (fd >= 0) ioctl(fd, PERF_EVENT_IOC_ENABLE, 0); }
+static void perf_off(int fd) { if (fd >= 0) ioctl(fd, PERF_EVENT_IOC_DISABLE, 0); }
+
+static long long perf_take(int fd) {
+    long long v = -1;
+    if (fd < 0) return -1;
+    if (read(fd, &v, sizeof(v)) != (ssize_t)sizeof(v)) return -1;
+    ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+    return v;
+}
+
+/* ------------------------------------------------------------------ */
+/*  Scansioni, una per layout                                           */
+/* ------------------------------------------------------------------ */
+static int old_find(int id) {
+    for (int i = 0; i < MAX_MATCHES; i++)
+        if (g_old[i].id == id) return g_old[i].cold.seq;
+    return -1;
+}
+
+static int hot_find(int id) {
+    for (int i = 0; i < MAX_MATCHES; i++)
+        if (g_hot[i].id == id) return g_cold[i].seq;
+    return -1;
+}
+
+static int old_disconnect(int fd) {
+    int n = 0;
+    for (int i = 0; i < MAX_MATCHES; i++) {
+        const old_match_t *m = &g_old[i];
+        if (m->id == 0) continue;
+        n += m->owner_fd == fd || m->joiner_fd == fd || m->pending_fd == fd;
+    }
+    return n;
+}
+
+static int hot_disconnect(int fd) {
+    int n = 0;
+    for (int i = 0; i < MAX_MATCHES; i++) {
+        const match_hot_t *h = &g_hot[i];
+        if (h->id == 0) continue;
+        n += h->owner_fd == fd || h->joiner_fd == fd || h->pending_fd == fd;
+    }
+    return n;
+}
+
+static int old_free(void) {
+    for (int i = 0; i < MAX_MATCHES; i++)
+        if (g_old[i].id == 0) return i;
+    return -1;
+}
+
+static int hot_free(void) {
+    for (int i = 0; i < MAX_MATCHES; i++)
+        if (g_hot[i].id == 0) return i;
+    return -1;
+}
+
+typedef struct {
+    const char *name;
+    int (*old_fn)(int);
+    int (*hot_fn)(int);
+} scan_t;
+
+static int old_free_arg(int x) { (void)x; return old_free(); }
+static int hot_free_arg(int x) { (void)x; return hot_free(); }
+
+static void run(const scan_t *s, int rounds, int pfd) {
+    uint64_t  t[2]  = { 0, 0 };
+    long long mi[2] = { 0, 0 };
+
+    for (int r = 0; r < rounds; r++) {
+        int arg = 4 + (r * 37) % (MAX_MATCHES + 4);   /* id / fd, anche assenti */
+        for (int k = 0; k < 2; k++) {
+            evict();
+            perf_on(pfd);
+            uint64_t t0 = now_ns();
+            g_sink += k ? s->hot_fn(arg) : s->old_fn(arg);
+            t[k] += now_ns() - t0;
+            perf_off(pfd);
+            long long v = perf_take(pfd);
+            if (v < 0 || mi[k] < 0) mi[k] = -1;
+            else                    mi[k] += v;
+        }
+    }
+
+    for (int k = 0; k < 2; k++) {
+        printf("%-12s %-9s %8.0f ns", s->name, k ? "hot/cold" : "vecchio",
+               (double)t[k] / rounds);
+        if (mi[k] < 0) printf("   miss n/d\n");
+        else           printf("   miss %7.1f\n", (double)mi[k] / rounds);
+    }
+}
+
+int main(int argc, char *argv[]) {
+    int rounds = argc > 1 ? atoi(argv[1]) : DEFAULT_ROUNDS;
+    if (rounds <= 0) rounds = DEFAULT_ROUNDS;
+
+    g_evict = malloc(EVICT_BYTES);
+    if (!g_evict) { perror("malloc"); return 1; }
+    memset(g_evict, 1, EVICT_BYTES);
+
+    /* Tre quarti degli slot occupati, come un server carico */
+    for (int i = 0; i < MAX_MATCHES; i++) {
+        int id = (i % 4 == 3) ? 0 : i + 1;
+        match_hot_t h = { id, id ? MATCH_PLAYING : MATCH_WAITING,
+                          id ? 4 + 2 * i : -1, id ? 5 + 2 * i : -1, -1 };
+        g_hot[i] = h;
+        g_cold[i].seq = i;
+        g_old[i].id         = h.id;
+        g_old[i].status     = h.status;
+        g_old[i].owner_fd   = h.owner_fd;
+        g_old[i].joiner_fd  = h.joiner_fd;
+        g_old[i].pending_fd = h.pending_fd;
+        g_old[i].cold.seq   = i;
+    }
+
+    int pfd = perf_open();
+    if (pfd < 0) perror("perf_event_open (miss non disponibili)");
+
+    printf("slot %d: vecchio %zu byte/slot, hot/cold %zu + %zu byte/slot\n",
+           MAX_MATCHES, sizeof(old_match_t), sizeof(match_hot_t), sizeof(match_t));
+    printf("%d scansioni per riga, cache svuotata prima di ognuna\n\n", rounds);
+
+    const scan_t scans[] = {
+        { "find_match", old_find,       hot_find       },
+        { "disconnect", old_disconnect, hot_disconnect },
+        { "slot_libero", old_free_arg,  hot_free_arg   },
+    };
+    for (size_t i = 0; i < sizeof(scans) / sizeof(scans[0]); i++)
+        run(&scans[i], rounds, pfd);
+
+    if (pfd >= 0) close(pfd);
+    free(g_evict);
+    return 0;
+}
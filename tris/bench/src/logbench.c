@@ -0,0 +1,79 @@
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include "log.h"
+
+/* ================================================================== */
+/*  LOGBENCH  –  Costo per record del log asincrono del server          */
+/* ================================================================== */
+
+/*
+ * T thread scrivono record a raffiche di mezzo ring, poi aspettano che
+ * il thread di scrittura li svuoti: si misura solo il tempo delle
+ * raffiche, cioè quanto costa un LOG a chi lo chiama.  Riporta anche il
+ * costo di un LOG con il sottosistema disattivato (solo il controllo).
+ */
+
+#define BURST     (LOG_RING / 2)
+#define DEFAULT_T 4
+#define DEFAULT_N 200
+
+static int g_bursts = DEFAULT_N;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static void *writer(void *arg) {
+    uint64_t *out = arg;
+    uint64_t  t   = 0;
+    struct timespec pause = { 0, 3 * LOG_FLUSH_MS * 1000000L };
+
+    for (int b = 0; b < g_bursts; b++) {
+        uint64_t t0 = now_ns();
+        for (int i = 0; i < BURST; i++)
+            LOGS(LOG_INFO, LOG_SYS_CMD, "MOVE 1 1", "%s (fd=%ld) seq %ld", 7, b * BURST + i);
+        t += now_ns() - t0;
+        nanosleep(&pause, NULL);
+    }
+    *out = t;
+    return NULL;
+}
+
+int main(int argc, char *argv[]) {
+    int         nthreads = argc > 1 ? atoi(argv[1]) : DEFAULT_T;
+    const char *path     = argc > 2 ? argv[2] : "/tmp/logbench.log";
+    if (nthreads <= 0 || nthreads > 64) nthreads = DEFAULT_T;
+
+    g_log_mask = (1u << LOG_SYS_COUNT) - 1;
+    if (log_start(path) < 0) { perror("log_start"); return 1; }
+
+    pthread_t tid[64];
+    uint64_t  ns[64];
+    for (int i = 0; i < nthreads; i++)
+        pthread_create(&tid[i], NULL, writer, &ns[i]);
+    uint64_t total = 0;
+    for (int i = 0; i < nthreads; i++) {
+        pthread_join(tid[i], NULL);
+        total += ns[i];
+    }
+    long records = (long)nthreads * g_bursts * BURST;
+    printf("%d thread, %ld record: %.1f ns per record (file %s)\n",
+           nthreads, records, (double)total / records, path);
+
+    /* Sottosistema spento: resta solo log_on */
+    g_log_mask = 0;
+    uint64_t t0 = now_ns();
+    for (long i = 0; i < records; i++)
+        LOG(LOG_INFO, LOG_SYS_CMD, "spento %ld", i);
+    printf("sottosistema spento: %.1f ns per chiamata\n",
+           (double)(now_ns() - t0) / records);
+
+    log_flush();
+    return 0;
+}
@@ -0,0 +1,441 @@
+#include <errno.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "capture.h"
+#include "protocol.h"
+
+/* ================================================================== */
+/*  REPLAY  –  Rigioca una cattura del server (-C) con i tempi veri    */
+/* ================================================================== */
+
+/*
+ * Legge un file scritto da server -C e lo rimanda a un server locale:
+ * ogni connessione della cattura diventa una connessione vera, aperta
+ * alla sua prima riga e chiusa dove nella cattura c'è la chiusura.  Le
+ * righe partono agli istanti registrati (-s 1), N volte più in fretta
+ * (-s N) oppure senza attese (-s max): in quel caso una riga parte
+ * appena la precedente della stessa connessione ha avuto risposta e la
+ * connessione tace da QUIET_US (il server scrive certe risposte in più
+ * pezzi, e la coda non deve chiudere la riga successiva).  Le
+ * righe di una connessione restano sempre nel loro ordine, e prima di
+ * una chiusura si aspettano le risposte ancora in volo.
+ *
+ * Latenza di una riga: dall'invio al primo byte ricevuto dopo di essa
+ * sulla stessa connessione (risposta o evento).  L'apertura e il
+ * benvenuto non si misurano.  Con due server la cattura viene rigiocata
+ * su entrambi, uno dopo l'altro, e si stampano le differenze: così si
+ * confrontano due build con lo stesso carico.
+ *
+ * Lo stato del server conta (nomi, partite, rating): ogni server va
+ * avviato da zero, con un file di rating usa e getta.  I token di RESUME
+ * catturati non valgono su un altro processo.
+ */
+
+#define RXBUF      4096
+#define GREET_MS   1000     /* attesa massima del benvenuto */
+#define DRAIN_MS   2000     /* attesa delle ultime risposte */
+#define SETTLE_MS  200      /* attesa di una risposta prima di proseguire */
+#define QUIET_US   300      /* -s max: silenzio che chiude una risposta */
+#define MAX_EVENTS 256
+
+typedef struct {
+    uint64_t    t_ns;
+    uint32_t    conn;
+    uint16_t    kind;
+    uint16_t    len;
+    const char *line;
+} rec_t;
+
+enum { C_NEW = 0, C_OPEN, C_CLOSED };
+
+typedef struct {
+    int       fd;
+    int       state;
+    uint64_t *pend;      /* istanti di invio ancora senza risposta */
+    int       npend, cap;
+    uint64_t  last_rx;
+} conn_t;
+
+typedef struct {
+    uint64_t  sent, answered, lost, skipped, ungreeted;
+    uint64_t *lat_ns;
+    size_t    nlat, cap;
+    double    secs;
+} stats_t;
+
+static rec_t   *g_recs;
+static size_t   g_nrecs;
+static conn_t  *g_conns;
+static uint32_t g_nconns;       /* id massimo + 1 */
+static uint32_t g_nused;        /* connessioni con almeno un record */
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+        "Uso: %s [-s 1|<N>|max] <cattura> <server> [<server_b>]\n"
+        "  server: host:porta, porta oppure percorso del socket UNIX (-U)\n", prog);
+}
+
+static int cmp_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+/* ------------------------------------------------------------------ */
+/*  Cattura                                                             */
+/* ------------------------------------------------------------------ */
+
+static char *load(const char *path, size_t *size) {
+    FILE *f = fopen(path, "rb");
+    if (!f) return NULL;
+    fseek(f, 0, SEEK_END);
+    long n = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    char *buf = n > 0 ? malloc((size_t)n) : NULL;
+    if (!buf || fread(buf, 1, (size_t)n, f) != (size_t)n) {
+        free(buf);
+        fclose(f);
+        return NULL;
+    }
+    fclose(f);
+    *size = (size_t)n;
+    return buf;
+}
+
+/* Indice dei record; l'ultimo record troncato (server ucciso) si scarta */
+static int parse(const char *buf, size_t size) {
+    cap_header_t h;
+    if (size < sizeof(h)) return -1;
+    memcpy(&h, buf, sizeof(h));
+    if (memcmp(h.magic, CAP_MAGIC, sizeof(h.magic)) != 0) return -1;
+
+    size_t cap = 1024;
+    g_recs = malloc(cap * sizeof(*g_recs));
+    if (!g_recs) return -1;
+    for (size_t off = sizeof(h); off + sizeof(cap_rec_t) <= size; ) {
+        cap_rec_t r;
+        memcpy(&r, buf + off, sizeof(r));
+        if (off + sizeof(r) + r.len > size) break;
+        if (g_nrecs == cap) {
+            cap *= 2;
+            rec_t *n = realloc(g_recs, cap * sizeof(*g_recs));
+            if (!n) return -1;
+            g_recs = n;
+        }
+        g_recs[g_nrecs++] = (rec_t){ r.t_ns, r.conn, r.kind, r.len, buf + off + sizeof(r) };
+        if (r.conn >= g_nconns) g_nconns = r.conn + 1;
+        off += sizeof(r) + r.len;
+    }
+    g_conns = calloc(g_nconns ? g_nconns : 1, sizeof(*g_conns));
+    if (!g_conns) return -1;
+    for (size_t i = 0; i < g_nrecs; i++) {
+        conn_t *c = &g_conns[g_recs[i].conn];
+        if (c->state == C_NEW) { c->state = C_OPEN; g_nused++; }
+    }
+    return 0;
+}
+
+/* ------------------------------------------------------------------ */
+/*  Connessioni                                                         */
+/* ------------------------------------------------------------------ */
+
+static int dial(const char *target) {
+    if (strchr(target, '/')) {
+        struct sockaddr_un addr;
+        if (strlen(target) >= sizeof(addr.sun_path)) return -1;
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        strcpy(addr.sun_path, target);
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0) return -1;
+        if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) { close(fd); return -1; }
+        return fd;
+    }
+
+    char        host[64] = "127.0.0.1";
+    const char *colon    = strrchr(target, ':');
+    const char *port     = target;
+    if (colon) {
+        snprintf(host, sizeof(host), "%.*s", (int)(colon - target), target);
+        port = colon + 1;
+    }
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port   = htons((uint16_t)atoi(port));
+    if (inet_pton(AF_INET, host, &addr.sin_addr) != 1) return -1;
+
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) { close(fd); return -1; }
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    return fd;
+}
+
+/* Legge il benvenuto prima di misurare qualsiasi riga: 0 ok, -1 scaduto */
+static int greet(int fd) {
+    char     rx[RXBUF];
+    size_t   len = 0;
+    uint64_t end = now_ns() + GREET_MS * 1000000ULL;
+    struct timeval tv = { 0, 100 * 1000 };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    while (now_ns() < end && len < sizeof(rx) - 1) {
+        ssize_t n = recv(fd, rx + len, sizeof(rx) - 1 - len, 0);
+        if (n == 0) break;
+        if (n < 0) continue;
+        len += (size_t)n;
+        rx[len] = '\0';
+        if (strstr(rx, PROTO_HINT_CMDS)) return 0;
+    }
+    return -1;
+}
+
+static void push_lat(stats_t *st, uint64_t ns) {
+    if (st->nlat == st->cap) {
+        size_t    cap = st->cap ? 2 * st->cap : 4096;
+        uint64_t *n   = realloc(st->lat_ns, cap * sizeof(*n));
+        if (!n) return;
+        st->lat_ns = n;
+        st->cap    = cap;
+    }
+    st->lat_ns[st->nlat++] = ns;
+}
+
+static void conn_close(int ep, conn_t *c, stats_t *st) {
+    epoll_ctl(ep, EPOLL_CTL_DEL, c->fd, NULL);
+    close(c->fd);
+    c->state = C_CLOSED;
+    st->lost += (uint64_t)c->npend;
+    c->npend = 0;
+}
+
+/* Risposte arrivate entro timeout_ms: chiudono le righe in attesa */
+static void pump(int ep, int timeout_ms, stats_t *st) {
+    struct epoll_event evs[MAX_EVENTS];
+    int n = epoll_wait(ep, evs, MAX_EVENTS, timeout_ms);
+    uint64_t t = now_ns();
+    for (int e = 0; e < n; e++) {
+        conn_t *c = &g_conns[evs[e].data.u32];
+        char    rx[RXBUF];
+        ssize_t r = recv(c->fd, rx, sizeof(rx), MSG_DONTWAIT);
+        if (r < 0 && (errno == EAGAIN || errno == EINTR)) continue;
+        if (r <= 0) {
+            conn_close(ep, c, st);
+            continue;
+        }
+        c->last_rx = t;
+        for (int i = 0; i < c->npend; i++) push_lat(st, t - c->pend[i]);
+        st->answered += (uint64_t)c->npend;
+        c->npend = 0;
+    }
+}
+
+/*
+ * Risposte in volo su c, al massimo SETTLE_MS; quelle mancanti si
+ * perdono.  Con quiet si legge anche il resto della risposta.
+ */
+static void settle(int ep, conn_t *c, stats_t *st, int quiet) {
+    uint64_t end = now_ns() + SETTLE_MS * 1000000ULL;
+    while (c->state == C_OPEN && c->npend && now_ns() < end) pump(ep, 1, st);
+    if (c->state == C_OPEN && c->npend) {
+        st->lost += (uint64_t)c->npend;
+        c->npend = 0;
+    }
+    uint64_t t;
+    while (quiet && c->state == C_OPEN && (t = now_ns()) < end &&
+           t < c->last_rx + QUIET_US * 1000ULL)
+        pump(ep, 0, st);
+}
+
+static int send_rec(int ep, uint32_t id, const rec_t *r, const char *target, stats_t *st) {
+    conn_t *c = &g_conns[id];
+    if (c->state == C_CLOSED) { st->skipped++; return 0; }
+    if (c->state == C_NEW) {
+        c->fd = dial(target);
+        if (c->fd < 0) return -1;
+        if (greet(c->fd) < 0) st->ungreeted++;
+        struct epoll_event ev = { .events = EPOLLIN, .data.u32 = id };
+        epoll_ctl(ep, EPOLL_CTL_ADD, c->fd, &ev);
+        c->state = C_OPEN;
+    }
+
+    char   buf[RXBUF];
+    size_t len = r->len < sizeof(buf) - 1 ? r->len : sizeof(buf) - 1;
+    memcpy(buf, r->line, len);
+    buf[len++] = '\n';
+    uint64_t t0 = now_ns();     /* prima di send: su loopback la risposta può precederne il ritorno */
+    for (size_t off = 0; off < len; ) {
+        ssize_t n = send(c->fd, buf + off, len - off, MSG_NOSIGNAL);
+        if (n <= 0) {
+            st->skipped++;
+            conn_close(ep, c, st);
+            return 0;
+        }
+        off += (size_t)n;
+    }
+    if (c->npend == c->cap) {
+        int       cap = c->cap ? 2 * c->cap : 8;
+        uint64_t *p   = realloc(c->pend, (size_t)cap * sizeof(*p));
+        if (!p) return -1;
+        c->pend = p;
+        c->cap  = cap;
+    }
+    c->pend[c->npend++] = t0;
+    st->sent++;
+    return 0;
+}
+
+/* ------------------------------------------------------------------ */
+/*  Una passata della cattura su un server                              */
+/* ------------------------------------------------------------------ */
+
+static int replay(const char *target, double speed, stats_t *st) {
+    int ep = epoll_create1(0);
+    if (ep < 0) { perror("epoll_create1"); return -1; }
+    for (uint32_t i = 0; i < g_nconns; i++) {
+        g_conns[i].state = C_NEW;
+        g_conns[i].npend   = 0;
+        g_conns[i].last_rx = 0;
+    }
+
+    uint64_t t_first = g_nrecs ? g_recs[0].t_ns : 0;
+    uint64_t start   = now_ns();
+    for (size_t i = 0; i < g_nrecs; i++) {
+        const rec_t *r = &g_recs[i];
+        if (speed > 0) {
+            uint64_t due = start + (uint64_t)((double)(r->t_ns - t_first) / speed);
+            uint64_t t;
+            while ((t = now_ns()) < due)
+                pump(ep, (int)((due - t) / 1000000), st);   /* l'ultimo ms a giro corto */
+        } else {
+            pump(ep, 0, st);
+        }
+
+        conn_t *c = &g_conns[r->conn];
+        if (r->kind == CAP_CLOSE) {
+            if (c->state == C_OPEN) {
+                settle(ep, c, st, 0);
+                if (c->state == C_OPEN) conn_close(ep, c, st);
+            }
+            c->state = C_CLOSED;
+            continue;
+        }
+        if (speed == 0) settle(ep, c, st, 1);
+        if (send_rec(ep, r->conn, r, target, st) < 0) {
+            fprintf(stderr, "%s: connessione %u: %s\n", target, r->conn, strerror(errno));
+            close(ep);
+            return -1;
+        }
+    }
+
+    uint64_t end = now_ns() + DRAIN_MS * 1000000ULL;
+    for (;;) {
+        int waiting = 0;
+        for (uint32_t i = 0; i < g_nconns; i++) waiting += g_conns[i].npend;
+        if (!waiting || now_ns() >= end) break;
+        pump(ep, 10, st);
+    }
+    st->secs = (double)(now_ns() - start) / 1e9;
+
+    for (uint32_t i = 0; i < g_nconns; i++)
+        if (g_conns[i].state == C_OPEN) conn_close(ep, &g_conns[i], st);
+    close(ep);
+    qsort(st->lat_ns, st->nlat, sizeof(*st->lat_ns), cmp_u64);
+    return 0;
+}
+
+/* Percentile in microsecondi */
+static double pct(const stats_t *st, int p) {
+    if (!st->nlat) return 0;
+    size_t i = st->nlat * (size_t)p / 100;
+    return (double)st->lat_ns[i < st->nlat ? i : st->nlat - 1] / 1000.0;
+}
+
+static void report(const char *target, const stats_t *st) {
+    printf("%-20s righe=%-8llu risposte=%-8llu perse=%-5llu saltate=%-5llu %.2f s\n"
+           "%-20s p50=%.1fus p90=%.1fus p99=%.1fus max=%.1fus\n",
+           target, (unsigned long long)st->sent, (unsigned long long)st->answered,
+           (unsigned long long)st->lost, (unsigned long long)st->skipped, st->secs,
+           "", pct(st, 50), pct(st, 90), pct(st, 99), pct(st, 100));
+    if (st->ungreeted)
+        fprintf(stderr, "Attenzione: %llu connessioni senza benvenuto (server pieno?)\n",
+                (unsigned long long)st->ungreeted);
+}
+
+static void report_diff(const stats_t *a, const stats_t *b) {
+    static const int ps[] = { 50, 90, 99, 100 };
+    static const char *names[] = { "p50", "p90", "p99", "max" };
+    printf("%-20s", "differenza b - a");
+    for (int i = 0; i < 4; i++) {
+        double d   = pct(b, ps[i]) - pct(a, ps[i]);
+        double rel = pct(a, ps[i]) > 0 ? 100.0 * d / pct(a, ps[i]) : 0.0;
+        printf(" %s=%+.1fus(%+.1f%%)", names[i], d, rel);
+    }
+    printf("\n");
+}
+
+int main(int argc, char *argv[]) {
+    double speed = 1.0;
+    int    opt;
+    while ((opt = getopt(argc, argv, "s:")) != -1) {
+        switch (opt) {
+            case 's':
+                speed = strcmp(optarg, "max") == 0 ? 0.0 : atof(optarg);
+                if (speed < 0 || (speed == 0 && strcmp(optarg, "max") != 0)) {
+                    usage(argv[0]);
+                    return 1;
+                }
+                break;
+            default: usage(argv[0]); return 1;
+        }
+    }
+    int ntargets = argc - optind - 1;
+    if (ntargets < 1 || ntargets > 2) {
+        usage(argv[0]);
+        return 1;
+    }
+    signal(SIGPIPE, SIG_IGN);
+
+    size_t size;
+    char  *buf = load(argv[optind], &size);
+    if (!buf || parse(buf, size) < 0) {
+        fprintf(stderr, "Cattura non valida: %s\n", argv[optind]);
+        return 1;
+    }
+    printf("cattura: %zu record, %u connessioni, %.2f s\n", g_nrecs, g_nused,
+           g_nrecs ? (double)(g_recs[g_nrecs - 1].t_ns - g_recs[0].t_ns) / 1e9 : 0.0);
+
+    stats_t st[2];
+    memset(st, 0, sizeof(st));
+    for (int i = 0; i < ntargets; i++) {
+        const char *target = argv[optind + 1 + i];
+        if (replay(target, speed, &st[i]) < 0) return 1;
+        report(target, &st[i]);
+    }
+    if (ntargets == 2) report_diff(&st[0], &st[1]);
+
+    for (uint32_t i = 0; i < g_nconns; i++) free(g_conns[i].pend);
+    free(st[0].lat_ns);
+    free(st[1].lat_ns);
+    free(g_conns);
+    free(g_recs);
+    free(buf);
+    return 0;
+}
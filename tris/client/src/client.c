@@ -4,6 +4,7 @@
 #include <unistd.h>
 #include <arpa/inet.h>
 #include <sys/socket.h>
+#include <sys/un.h>
 #include <pthread.h>
 
 #define MAX_LINE 1024
@@ -34,17 +35,30 @@ static void *receiver_thread(void *arg) {
     return NULL;
 }
 
-int main(int argc, char *argv[]) {
-    if (argc != 3) {
-        fprintf(stderr, "Uso: %s <ip_server> <porta>\n", argv[0]);
-        return 1;
+/* Socket UNIX del server (-U): stessa sessione, senza lo stack TCP */
+static int connect_local(const char *path) {
+    struct sockaddr_un srv;
+    if (strlen(path) >= sizeof(srv.sun_path)) {
+        fprintf(stderr, "Percorso non valido: %s\n", path);
+        return -1;
     }
+    memset(&srv, 0, sizeof(srv));
+    srv.sun_family = AF_UNIX;
+    strcpy(srv.sun_path, path);
 
-    const char *ip   = argv[1];
-    int         port = atoi(argv[2]);
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) { perror("socket"); return -1; }
+    if (connect(fd, (struct sockaddr *)&srv, sizeof(srv)) < 0) {
+        perror("connect");
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
 
+static int connect_tcp(const char *ip, int port) {
     int fd = socket(AF_INET, SOCK_STREAM, 0);
-    if (fd < 0) { perror("socket"); return 1; }
+    if (fd < 0) { perror("socket"); return -1; }
 
     struct sockaddr_in srv;
     memset(&srv, 0, sizeof(srv));
@@ -53,15 +67,28 @@ int main(int argc, char *argv[]) {
     if (inet_pton(AF_INET, ip, &srv.sin_addr) != 1) {
         fprintf(stderr, "IP non valido: %s\n", ip);
         close(fd);
-        return 1;
+        return -1;
     }
 
     if (connect(fd, (struct sockaddr *)&srv, sizeof(srv)) < 0) {
         perror("connect");
         close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc != 2 && argc != 3) {
+        fprintf(stderr, "Uso: %s <ip_server> <porta>\n"
+                        "     %s <socket_unix>\n", argv[0], argv[0]);
         return 1;
     }
 
+    int fd = argc == 2 ? connect_local(argv[1])
+                       : connect_tcp(argv[1], atoi(argv[2]));
+    if (fd < 0) return 1;
+
     
     pthread_t tid;
     int fd_copy = fd;   
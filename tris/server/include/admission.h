@@ -0,0 +1,82 @@
+#ifndef ADMISSION_H
+#define ADMISSION_H
+
+#include <pthread.h>
+#include <stdint.h>
+
+/* ================================================================== */
+/*  ADMISSION.H  –  Code FIFO limitate di attesa a capienza esaurita   */
+/* ================================================================== */
+
+/*
+ * Quando il server è pieno (slot client o slot partita) la richiesta
+ * non viene rifiutata ma messa in coda: chi aspetta riceve posizione e
+ * attesa stimata, e viene servito in ordine appena si libera un posto.
+ * La coda è limitata: oltre cap il rifiuto torna quello di prima.
+ *
+ * La stima dell'attesa è posizione * intervallo medio fra due uscite
+ * dalla coda servite (media mobile esponenziale, misurata solo mentre
+ * c'era qualcuno in attesa); finché non c'è una misura si usa
+ * default_gap_ms.
+ */
+
+#define ADM_MAX   128
+#define ADM_SLOTS (ADM_MAX + 1)   /* + 1 per adm_push_front */
+
+/* Cosa aspetta l'elemento: lo interpreta chi usa la coda */
+typedef struct {
+    int fd;
+    int fd2;       /* secondo giocatore (QUICKPLAY), -1 se nessuno */
+    int kind;
+    int a, b, c;   /* parametri della richiesta */
+} adm_entry_t;
+
+typedef struct {
+    pthread_mutex_t mtx;
+    adm_entry_t     q[ADM_SLOTS];
+    int             head;
+    int             len;
+    int             cap;
+    uint32_t        gap_ms;      /* intervallo medio fra due uscite */
+    uint64_t        busy_ms;     /* ultima uscita o inizio dell'attesa */
+} adm_queue_t;
+
+void adm_init(adm_queue_t *q, int cap, uint32_t default_gap_ms);
+
+/* Posizione (da 1) dell'elemento accodato, -1 se la coda è piena */
+int  adm_push(adm_queue_t *q, const adm_entry_t *e);
+
+/*
+ * Rimette in testa un elemento appena estratto (posto preso da altri).
+ * Da usare da un solo thread, quello che svuota la coda.
+ */
+void adm_push_front(adm_queue_t *q, const adm_entry_t *e);
+
+/* Estrae il primo elemento: 0 ok, -1 coda vuota */
+int  adm_pop(adm_queue_t *q, adm_entry_t *out);
+
+/* L'elemento estratto è stato servito: aggiorna la stima dell'attesa */
+void adm_served(adm_queue_t *q);
+
+/* Toglie gli elementi che riguardano fd (fd o fd2); ne copia al più max */
+int  adm_remove_fd(adm_queue_t *q, int fd, adm_entry_t *out, int max);
+
+/* Posizione (da 1) del primo elemento di fd, 0 se non è in coda */
+int  adm_position(adm_queue_t *q, int fd);
+
+int  adm_len(adm_queue_t *q);
+
+/* Attesa stimata in secondi per la posizione pos */
+int  adm_eta(adm_queue_t *q, int pos);
+
+/* Copia gli elementi in ordine */
+int  adm_snapshot(adm_queue_t *q, adm_entry_t *out, int max);
+
+/*
+ * Manda a ogni elemento (fd e fd2) la sua posizione e l'attesa stimata:
+ * fmt riceve due %d.  Invio senza attesa, un client lento perde il
+ * messaggio.
+ */
+void adm_announce(adm_queue_t *q, const char *fmt);
+
+#endif /* ADMISSION_H */
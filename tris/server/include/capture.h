@@ -0,0 +1,61 @@
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#include <stdint.h>
+
+/* ================================================================== */
+/*  CAPTURE.H  –  Registrazione dei comandi ricevuti (-C)              */
+/* ================================================================== */
+
+/*
+ * Con -C <file> ogni riga ricevuta da un client viene scritta, prima di
+ * limiti e parsing, in un file binario compatto: l'istante, la
+ * connessione e la riga.  Anche la chiusura di una connessione è un
+ * record, così chi rigioca il file (tris/bench/replay) può ripetere le
+ * disconnessioni.  L'istante si prende sotto il lock di scrittura: i
+ * record nel file sono in ordine di tempo, e quelli di una connessione
+ * nell'ordine di arrivo.  Il file si aggiorna una volta al secondo.
+ *
+ * Le connessioni sono numerate da 1 in ordine di apertura (un fd può
+ * essere riusato, un id no).  Le sessioni su fd virtuali (lobby, MUX)
+ * non hanno un id proprio: le loro righe sono già nel record della
+ * connessione reale che le porta.
+ *
+ * Il file contiene nomi e token di RESUME così come arrivano.
+ */
+
+#define CAP_MAGIC    "TRISCAP1"
+#define CAP_BUF      65536     /* byte accumulati prima di una write */
+
+typedef struct {
+    char     magic[8];
+    uint64_t start_ns;     /* CLOCK_REALTIME all'avvio della cattura */
+} cap_header_t;
+
+typedef enum {
+    CAP_LINE  = 0,         /* seguono len byte: la riga senza "\r\n" */
+    CAP_CLOSE = 1          /* la connessione si è chiusa, len = 0 */
+} cap_kind_t;
+
+typedef struct {
+    uint64_t t_ns;         /* dall'avvio della cattura, CLOCK_MONOTONIC */
+    uint32_t conn;
+    uint16_t len;
+    uint16_t kind;
+} cap_rec_t;
+
+_Static_assert(sizeof(cap_rec_t) == 16, "cap_rec_t: 16 byte");
+
+/* Apre il file (troncato) e scrive l'intestazione.  0 oppure -1 */
+int      capture_start(const char *path);
+
+/* Id della nuova connessione, 0 se la cattura è spenta */
+uint32_t capture_conn(void);
+
+void     capture_line(uint32_t conn, const char *line);
+void     capture_close(uint32_t conn);
+
+/* Scrive i record accumulati (housekeeping, handover) */
+void     capture_flush(void);
+
+#endif /* CAPTURE_H */
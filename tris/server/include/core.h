@@ -0,0 +1,73 @@
+#ifndef CORE_H
+#define CORE_H
+
+#include <stddef.h>
+#include "state.h"
+#include "net.h"
+
+/* ================================================================== */
+/*  CORE.H  –  Motore di gioco senza rete (libtriscore.a)              */
+/* ================================================================== */
+
+/*
+ * Lobby, partite, code, rating e protocollo a righe stanno nella
+ * libreria libtriscore.a; il server di rete (main.c con io*.c e
+ * handover.c) è un adattatore come un altro.  Chi incorpora il motore:
+ *
+ *   core_init(...)            una volta, poi core_start()
+ *   p = core_connect(sink)    un giocatore: riceve il benvenuto
+ *   core_command(p, "LOGIN alice")
+ *   ...
+ *   core_disconnect(p)
+ *
+ * Ogni riga che il motore manderebbe al client (risposte, eventi,
+ * board) arriva al sink del giocatore, testo compreso "\n".  Il sink
+ * può essere chiamato da thread diversi (la mossa dell'avversario, i
+ * timer di housekeeping), ma mai in parallelo per lo stesso giocatore.
+ * Gira con un lock del giocatore preso: deve solo copiare o accodare,
+ * mai chiamare core_*.
+ *
+ * core_command per un giocatore va chiamata da un thread alla volta
+ * (come le righe di una connessione); giocatori diversi possono andare
+ * in parallelo.  Dentro il motore i giocatori restano chiavi intere:
+ * ogni handle è un fd virtuale (net.h) il cui invio chiama il sink.
+ *
+ * Un giocatore del motore non ha periodo di grazia: core_disconnect è
+ * una disconnessione definitiva.  Ogni giocatore occupa uno slot client
+ * (MAX_CLIENTS) come una connessione di rete.  Con il limite di
+ * inattività (g_idle_sec) il motore chiude da sé il giocatore fermo: il
+ * sink non riceve più nulla, la core_command successiva ritorna 1 e
+ * l'handle va comunque chiuso così (o con core_disconnect).
+ */
+
+#define CORE_MAX_PLAYERS MAX_CLIENTS
+#define CORE_VFD_BASE    (NET_VFD_BASE + (2 << 20))
+
+typedef struct core_player core_player_t;
+
+/* Riga (o più righe) per il giocatore; ctx è quello di core_connect */
+typedef void (*core_sink_t)(void *ctx, const char *msg, size_t len);
+
+/*
+ * Stato globale, rating da ratings_path (NULL = nessun file), fascia
+ * QUICKPLAY band, thread degli spettatori.  Le opzioni g_*_sec di
+ * server.h vanno impostate prima.  0 oppure -1 con errno.
+ */
+int  core_init(const char *ratings_path, int band);
+
+/* Timer di turno, caricamento e salvataggio dei rating, housekeeping */
+int  core_start(void);
+
+/* Nuovo giocatore, NULL se gli slot sono finiti */
+core_player_t *core_connect(core_sink_t sink, void *ctx);
+
+/*
+ * Una riga di comando (senza "\n").  0 = il giocatore resta, 1 = ha
+ * chiuso (QUIT, flood o inattività): l'handle non è più valido.
+ */
+int  core_command(core_player_t *p, const char *line);
+
+/* Disconnessione: come la chiusura di una connessione, senza grazia */
+void core_disconnect(core_player_t *p);
+
+#endif /* CORE_H */
@@ -0,0 +1,39 @@
+#ifndef EPOCH_H
+#define EPOCH_H
+
+#include <stdint.h>
+
+/* ================================================================== */
+/*  EPOCH.H  –  Letture senza lock con recupero per epoche             */
+/* ================================================================== */
+
+/*
+ * Un dato letto spesso e scritto di rado viene pubblicato come puntatore
+ * a una versione immutabile.  Il lettore apre una sezione con
+ * epoch_enter, legge il puntatore corrente e lo usa fino a epoch_exit,
+ * senza lock.  Lo scrittore pubblica la versione nuova, poi chiama
+ * epoch_retire sulla vecchia: il numero ritornato dice quando potrà
+ * riusarla (epoch_safe), cioè quando nessun lettore entrato prima del
+ * cambio è ancora dentro.
+ *
+ * Ogni thread lettore occupa un record (una riga di cache) alla prima
+ * epoch_enter e lo lascia quando termina, per il prossimo thread.  Oltre
+ * EPOCH_MAX_READERS thread vivi i lettori in più usano un contatore
+ * condiviso: restano corretti, ma finché uno di loro è dentro nessuna
+ * versione viene riusata.
+ *
+ * Le sezioni possono essere annidate nello stesso thread.
+ */
+
+#define EPOCH_MAX_READERS 512
+
+void     epoch_enter(void);
+void     epoch_exit(void);
+
+/* Versione appena sostituita: epoca da passare a epoch_safe */
+uint64_t epoch_retire(void);
+
+/* 1 se nessun lettore può ancora vedere la versione ritirata a epoch e */
+int      epoch_safe(uint64_t e);
+
+#endif /* EPOCH_H */
@@ -0,0 +1,59 @@
+#ifndef HANDOVER_H
+#define HANDOVER_H
+
+#include "state.h"
+#include "match.h"
+#include "matchmaker.h"
+#include "rating.h"
+#include "spectate.h"
+
+/* ================================================================== */
+/*  HANDOVER.H  –  Aggiornamento del binario senza disconnessioni      */
+/* ================================================================== */
+
+/*
+ * Il vecchio processo ascolta su un socket UNIX (<path>).  Il nuovo
+ * processo, avviato con lo stesso <path>, vi si collega e riceve via
+ * SCM_RIGHTS i socket di ascolto e tutti gli fd dei client, insieme
+ * a uno snapshot di g_state / g_matches / coda QUICKPLAY / spettatori
+ * (solo chi osserva cosa: gli eventi non ancora consegnati si perdono).
+ * Il vecchio processo termina subito dopo l'invio; le connessioni TCP
+ * restano aperte.
+ *
+ * Gli fd nello snapshot vengono rimappati sui nuovi numeri ricevuti.
+ * I byte già letti dai thread del vecchio processo ma non ancora
+ * eseguiti non viaggiano: vanno perse la riga parziale in lettura e
+ * anche le righe intere arrivate fra lo snapshot e la _exit (accodate
+ * nel buffer di ricezione o eseguite su uno stato che il successore
+ * non vedrà).  Il client non riceve risposta e deve ripetere il comando.
+ * I rating non viaggiano nello snapshot: il vecchio processo li salva
+ * su file prima di cedere.
+ */
+
+typedef struct {
+    server_state_t *st;
+    match_store_t  *ms;
+    matchmaker_t   *mm;
+    rating_store_t *rs;
+    spectators_t   *sp;
+    int             listen_fd;
+    int             local_fd;    /* socket UNIX di ascolto (-U), -1 se assente */
+} handover_ctx_t;
+
+/*
+ * Prova a rilevare un processo precedente in ascolto su <path>.
+ * Ritorna:
+ *   0  : handover completato, stato ripristinato, ctx->listen_fd valido
+ *        (e ctx->local_fd, se il predecessore ascoltava anche su -U)
+ *   1  : nessun processo precedente (avvio normale)
+ *  -1  : errore (snapshot incompatibile o trasferimento interrotto)
+ */
+int handover_takeover(const char *path, handover_ctx_t *ctx);
+
+/*
+ * Avvia il thread che attende il processo successore su <path>.
+ * Ritorna 0 oppure -1 in caso di errore.
+ */
+int handover_listen(const char *path, const handover_ctx_t *ctx);
+
+#endif /* HANDOVER_H */
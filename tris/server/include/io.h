@@ -0,0 +1,68 @@
+#ifndef IO_H
+#define IO_H
+
+#include <stddef.h>
+
+/* ================================================================== */
+/*  IO.H  –  Backend di I/O delle connessioni client                    */
+/* ================================================================== */
+
+/*
+ *  threaded : un thread per connessione con recv bloccante, preso da
+ *             un pool di thread pre-avviati e riusati a fine connessione.
+ *  epoll    : pochi thread di I/O leggono le righe e le accodano a un
+ *             pool fisso di worker (io_pool.h).  Le righe sono smistate
+ *             per id di partita: tutte le azioni su una partita girano
+ *             in ordine sullo stesso worker.
+ *  uring    : come epoll, ma accept, recv e send passano da un solo
+ *             anello io_uring (accept multishot, buffer forniti dal
+ *             kernel, invii raccolti in un'unica submit).
+ *
+ * Se start fallisce (kernel senza supporto) main ripiega su fallback.
+ */
+
+#define IO_DEFAULT_STACK_KB 64   /* frame più profondo del server: ~8 KB */
+
+typedef struct {
+    int    workers;      /* worker del pool (threaded: thread pre-avviati); <= 0 default */
+    size_t stack_size;   /* stack dei thread del backend, 0 = default di sistema */
+} io_opts_t;
+
+typedef struct io_backend io_backend_t;
+
+struct io_backend {
+    const char         *name;
+    const io_backend_t *fallback;
+    /* 0 oppure -1 */
+    int  (*start)(const io_opts_t *o);
+    /* Connessione già in g_state (nuova o ereditata).  0 oppure -1 */
+    int  (*adopt)(int fd, int resumed);
+    /* Ciclo di accept proprio (NULL = accept bloccante + adopt) */
+    void (*serve)(int listen_fd);
+};
+
+extern const io_backend_t io_threaded;
+extern const io_backend_t io_epoll;
+extern const io_backend_t io_uring;
+
+/* Thread staccato con lo stack richiesto (0 = default).  0 oppure -1 */
+int  io_spawn(void *(*fn)(void *), void *arg, size_t stack_size);
+
+/* Backend per nome, NULL se sconosciuto */
+const io_backend_t *io_find(const char *name);
+
+/*
+ * Nuovo client: registrato in g_state e passato a be, oppure, se il
+ * server è pieno, messo nella coda di ammissione (admission.h) fino a
+ * uno slot libero.  Con la coda piena riceve ERR SERVER_FULL.
+ */
+void io_accepted(const io_backend_t *be, int fd);
+
+/*
+ * Accetta i client per sempre (con la coda di ammissione).  local_fd,
+ * se >= 0, è il socket UNIX di -U: lo serve un thread di accept
+ * bloccante, e i suoi client passano per io_accepted come quelli TCP.
+ */
+void io_serve(const io_backend_t *be, int listen_fd, int local_fd);
+
+#endif /* IO_H */
@@ -0,0 +1,92 @@
+#ifndef IO_POOL_H
+#define IO_POOL_H
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "io.h"
+#include "net.h"
+#include "session.h"
+
+/* ================================================================== */
+/*  IO_POOL.H  –  Connessioni e worker comuni ai backend asincroni      */
+/* ================================================================== */
+
+/*
+ * I backend epoll e io_uring leggono i byte nel buffer della
+ * connessione e chiamano io_conn_kick: appena c'è una riga completa la
+ * connessione viene affidata a un worker, al massimo una volta, quindi
+ * le righe di una sessione sono eseguite una alla volta e in ordine.
+ * Dopo ogni riga il worker rismista la connessione, perché la partita
+ * della riga successiva può essere un'altra (JOIN, fine partita, ...).
+ *
+ * Le connessioni stanno in un pool statico.  Il tag (indice e
+ * generazione) identifica una connessione nei dati degli eventi del
+ * kernel: un evento arrivato dopo la chiusura si riconosce e si scarta.
+ * I 4 bit alti del tag sono sempre a zero, liberi per il backend.
+ */
+
+#define IO_MAX_CONNS  MAX_CLIENTS
+#define IO_RXBUF      (4 * MAX_LINE)
+#define IO_GEN_MASK   0x0FFFFFFFu
+
+typedef struct io_conn io_conn_t;
+
+/*
+ * Ogni connessione parte su una riga di cache propria: connessioni
+ * vicine sono scritte da worker e thread di I/O diversi e non devono
+ * invalidarsi a vicenda.
+ */
+struct io_conn {
+    _Alignas(64) session_t s;
+    pthread_mutex_t mtx;
+    uint32_t        gen;
+    int             used;
+    char            rx[IO_RXBUF];
+    size_t          rxlen;
+    int             queued;    /* affidata a un worker (in coda o in esecuzione) */
+    int             paused;    /* buffer pieno: il backend non legge finché il worker non consuma */
+    int             eof;       /* fine flusso vista dal backend, nessun altro evento in arrivo */
+    int             closing;   /* QUIT o flood: righe residue ignorate */
+};
+
+typedef struct {
+    /* Il worker ha consumato una riga di una connessione in pausa (c->mtx tenuto) */
+    void (*resume)(io_conn_t *c);
+    /* Prima di shutdown / chiusura: attende i dati ancora da inviare (NULL = nulla) */
+    void (*drain)(io_conn_t *c);
+    /* La connessione torna nel pool (c->mtx tenuto, NULL = nulla) */
+    void (*release)(io_conn_t *c);
+} io_pool_ops_t;
+
+/* Avvia i worker (o->workers <= 0: uno per CPU).  Ritorna il numero di worker o -1 */
+int        io_pool_start(const io_opts_t *o, const io_pool_ops_t *ops);
+
+/* Connessione libera con c->mtx tenuto, NULL se il pool è pieno */
+io_conn_t *io_conn_alloc(void);
+
+/* Rimette nel pool una connessione mai passata a un worker (c->mtx tenuto, poi rilasciato) */
+void       io_conn_abort(io_conn_t *c);
+
+int        io_conn_index(const io_conn_t *c);
+uint64_t   io_conn_tag(const io_conn_t *c);
+
+/* Connessione del tag con c->mtx tenuto; NULL se nel frattempo è stata chiusa */
+io_conn_t *io_conn_lock_tag(uint64_t tag);
+
+/*
+ * Spazio libero nel buffer di ricezione (c->mtx tenuto).  Un buffer
+ * pieno senza "\n" è una riga troppo lunga: viene scartato.  0 vuol
+ * dire che il worker è indietro e il backend deve mettersi in pausa.
+ */
+size_t     io_conn_room(io_conn_t *c);
+
+/*
+ * Dopo nuovi byte in rx o eof (c->mtx tenuto): affida la connessione a
+ * un worker se ha una riga completa o è finita e nessuno la sta già
+ * servendo.
+ */
+void       io_conn_kick(io_conn_t *c);
+
+#endif /* IO_POOL_H */
@@ -0,0 +1,81 @@
+#ifndef LOBBY_H
+#define LOBBY_H
+
+#include "state.h"
+#include "match.h"
+
+/* ================================================================== */
+/*  LOBBY.H  –  Lobby condivisa fra processi sullo stesso host          */
+/* ================================================================== */
+
+/*
+ * Con -M <nome> più processi server (stessa porta con SO_REUSEPORT,
+ * oppure porte diverse) si comportano come una lobby sola:
+ *
+ *  - un segmento di memoria condivisa (/dev/shm/tris-lobby-<nome>)
+ *    tiene i processi vivi, i nomi loggati e la directory delle
+ *    partite; gli id partita vengono da un contatore unico sull'host.
+ *    Lo protegge un mutex robusto condiviso fra processi: se un processo
+ *    muore col lock preso il prossimo lo recupera, e le voci si scrivono
+ *    in un ordine per cui una scrittura a metà resta una voce libera;
+ *  - ogni processo ha un socket datagram UNIX astratto (il canale) per
+ *    i broadcast della lobby e per le sessioni inoltrate.
+ *
+ * LOGIN prenota il nome su tutto l'host, USERS e LIST leggono la
+ * directory.  JOIN di una partita di un altro processo B trasforma la
+ * connessione in un inoltro: il processo A, che tiene il socket, passa
+ * le righe a B; B esegue la sessione su un fd virtuale (net.h) e
+ * rimanda l'output ad A.  Il giocatore da quel momento vive su B.
+ *
+ * Ogni secondo il thread del canale toglie dalla directory i processi
+ * morti (kill(pid, 0)) con i loro nomi e partite, chiude le sessioni
+ * virtuali che venivano da loro e le connessioni inoltrate verso di loro.
+ *
+ * Restano per processo: QUICKPLAY, WATCH, REMATCH e il file dei rating.
+ * Le sessioni inoltrate non si riprendono con RESUME e non passano
+ * attraverso un handover.
+ */
+
+#define LOBBY_MAX_PROCS   16
+#define LOBBY_MAX_PLAYERS (LOBBY_MAX_PROCS * MAX_CLIENTS)
+#define LOBBY_MAX_MATCHES (LOBBY_MAX_PROCS * MAX_MATCHES)
+#define LOBBY_RELAYS      MAX_CLIENTS   /* connessioni inoltrate per processo */
+
+/*
+ * Apre (o crea) il segmento, registra il processo, apre il canale e
+ * installa la directory delle partite e l'invio sugli fd virtuali.
+ * Dopo un handover ripubblica i nomi e le partite ereditati.
+ * 0 ok, -1 con errno.
+ */
+int  lobby_attach(const char *name);
+
+int  lobby_active(void);
+
+/* Prenota il nome su tutto l'host: 0 ok, -1 già preso da qualcuno */
+int  lobby_claim_name(const char *name);
+
+/* Libera il nome se è di questo processo */
+void lobby_release_name(const char *name);
+
+/* USERS e LIST di tutto l'host, stesso formato delle versioni locali */
+void lobby_users(char *out, int outsz);
+void lobby_list(char *out, int outsz);
+
+/* Processo che ha la partita id, -1 se è locale o sconosciuta */
+int  lobby_match_proc(int id);
+
+/*
+ * Inoltro di una connessione locale (fd) verso il processo proc: il nome
+ * passa a proc, che riceve la prima riga (il JOIN).  Ritorna l'id
+ * dell'inoltro, -1 se non ci sono inoltri liberi o proc non c'è più.
+ */
+int  lobby_relay_open(int proc, int fd, const char *name, const char *line);
+void lobby_relay_line(int relay, const char *line);
+
+/* La connessione inoltrata si è chiusa */
+void lobby_relay_close(int relay);
+
+/* Broadcast della lobby verso gli altri processi */
+void lobby_broadcast(const char *msg);
+
+#endif /* LOBBY_H */
@@ -0,0 +1,104 @@
+#ifndef LOG_H
+#define LOG_H
+
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+
+/* ================================================================== */
+/*  LOG.H  –  Log asincrono: ring per thread e thread di scrittura      */
+/* ================================================================== */
+
+/*
+ * Chi logga non formatta e non scrive: copia un record binario di
+ * dimensione fissa (istante, formato, fino a LOG_ARGS interi e una
+ * stringa corta) nel ring del proprio thread, senza lock né syscall
+ * oltre a clock_gettime (vDSO).  Un thread dedicato svuota i ring ogni
+ * LOG_FLUSH_MS, formatta e scrive a blocchi sul file, che ruota oltre
+ * LOG_ROTATE_BYTES (file, file.1 ... file.<LOG_KEEP>).  Senza file il
+ * log va su stderr.
+ *
+ * Il formato deve essere un letterale: si formatta più tardi, dal thread
+ * di scrittura.  Gli interi vanno scritti con %ld; con LOGS la stringa
+ * è la prima conversione (%s) e viene copiata, troncata a LOG_STR - 1.
+ *
+ * Ring pieno (thread di scrittura indietro): il record si perde e viene
+ * contato, chi logga non si ferma mai.  Il ring di un thread che termina
+ * viene svuotato e liberato dal thread di scrittura.  L'ordine è garantito solo fra
+ * record dello stesso thread.
+ */
+
+#define LOG_ARGS          4
+#define LOG_STR           77          /* record di 128 byte: due righe di cache */
+#define LOG_RING          256         /* record per thread, potenza di 2 */
+#define LOG_MAX_THREADS   512         /* thread vivi con un ring */
+#define LOG_FLUSH_MS      20
+#define LOG_ROTATE_BYTES  (16u << 20)
+#define LOG_KEEP          4
+
+typedef enum {
+    LOG_DEBUG = 0,
+    LOG_INFO  = 1,
+    LOG_WARN  = 2,
+    LOG_ERROR = 3
+} log_level_t;
+
+/* Sottosistemi, attivabili uno per uno (-D) */
+typedef enum {
+    LOG_SYS_MAIN     = 0,
+    LOG_SYS_IO       = 1,
+    LOG_SYS_SESSION  = 2,
+    LOG_SYS_CMD      = 3,   /* ogni comando ricevuto */
+    LOG_SYS_MATCH    = 4,
+    LOG_SYS_HANDOVER = 5,
+    LOG_SYS_RATING   = 6,
+    LOG_SYS_LOBBY    = 7,
+    LOG_SYS_COUNT
+} log_sys_t;
+
+/* Di default tutti tranne cmd */
+#define LOG_MASK_DEFAULT (((1u << LOG_SYS_COUNT) - 1) & ~(1u << LOG_SYS_CMD))
+
+extern int      g_log_level;
+extern unsigned g_log_mask;
+
+static inline int log_on(log_level_t lvl, log_sys_t sys) {
+    return (int)lvl >= __atomic_load_n(&g_log_level, __ATOMIC_RELAXED) &&
+           (__atomic_load_n(&g_log_mask, __ATOMIC_RELAXED) & (1u << sys));
+}
+
+/* Non chiamare direttamente: usare LOG / LOGS */
+void log_record(log_level_t lvl, log_sys_t sys, const char *str,
+                const char *fmt, const long *args, int nargs);
+
+#define LOG_REC_(lvl, sys, str, fmt, ...) do {                              \
+        if (log_on(lvl, sys)) {                                             \
+            const long log_a_[] = { 0, __VA_ARGS__ };                       \
+            log_record(lvl, sys, str, fmt, log_a_ + 1,                      \
+                       (int)(sizeof(log_a_) / sizeof(log_a_[0])) - 1);      \
+        }                                                                   \
+    } while (0)
+
+#define LOG(lvl, sys, fmt, ...)        LOG_REC_(lvl, sys, NULL, fmt, __VA_ARGS__)
+#define LOGS(lvl, sys, str, fmt, ...)  LOG_REC_(lvl, sys, str, fmt, __VA_ARGS__)
+
+/* Al posto di perror: what è un letterale */
+#define LOG_ERRNO(sys, what)           LOGS(LOG_ERROR, sys, strerror(errno), what ": %s")
+
+/* "debug" | "info" | "warn" | "error": livello, -1 se sconosciuto */
+int  log_parse_level(const char *s);
+
+/*
+ * Lista separata da virgole di sottosistemi ("all", "io", "cmd", ...);
+ * un nome preceduto da '-' viene tolto.  Parte da LOG_MASK_DEFAULT.
+ * 0 ok, -1 nome sconosciuto.
+ */
+int  log_parse_mask(const char *s, unsigned *mask_out);
+
+/* Apre il file (NULL = stderr) e avvia il thread di scrittura.  0 oppure -1 */
+int  log_start(const char *path);
+
+/* Svuota subito i ring (prima di uscire) */
+void log_flush(void);
+
+#endif /* LOG_H */
@@ -3,8 +3,21 @@
 
 #include <pthread.h>
 #include "state.h"
+#include "rating.h"
+#include "rules.h"
+#include "timewheel.h"
 
 #define MAX_MATCHES 128
+/*
+ * Ultimi eventi per il replay di RESUME: una partita intera di tris (9
+ * mosse + fine), non una variante m,n,k lunga.  A chi li ha già persi
+ * (seq più vecchio di MATCH_EVENT_RING eventi) il replay manda
+ * EVENT REPLAY_GAP e poi la board, che basta a riprendere la partita:
+ * durante la disconnessione l'avversario fa al più una mossa.
+ */
+#define MATCH_EVENT_RING 16
+#define MATCH_MAX_CELLS   (RULES_MAX_DIM * RULES_MAX_DIM)
+#define MATCH_BOARD_BUFSZ 1024   /* board renderizzata, basta anche per 15x15 */
 
 typedef enum {
     MATCH_WAITING  = 0,
@@ -14,16 +27,55 @@ typedef enum {
     MATCH_REMATCH  = 4    /* fine partita, slot ancora vivo per tracciare risultato */
 } match_status_t;
 
+/*
+ * Avversario gestito dal server (PLAYAI): gioca sempre O, joiner_fd = -1.
+ * Le partite contro l'AI non aggiornano i rating.
+ */
+typedef enum {
+    MATCH_AI_NONE    = 0,
+    MATCH_AI_EASY    = 1,   /* mosse casuali */
+    MATCH_AI_PERFECT = 2    /* tabella minimax: non perde mai */
+} match_ai_t;
+
+/*
+ * Evento di partita numerato, usato per il replay dopo RESUME.
+ * kind: 'M' mossa, 'W' vittoria, 'D' pareggio, 'R' resa (mark = chi si arrende),
+ *       'T' tempo scaduto (mark = chi non ha mosso)
+ */
 typedef struct {
-    int            id;
+    int         seq;
+    char        kind;
+    char        mark;
+    signed char r, c;
+} match_event_t;
+
+/*
+ * Layout hot/cold: le scansioni su tutti gli slot (ricerca per id, LIST,
+ * disconnect, REMATCH, slot libero) leggono solo match_hot_t, 20 byte
+ * per slot in un array a parte (128 slot = 40 righe di cache invece di
+ * una riga per slot).  Board, eventi e risultato stanno in match_t, allo
+ * stesso indice, e si toccano solo per la partita trovata.  Gli slot si
+ * scrivono tutti sotto ms->mtx: nessun false sharing fra thread.
+ */
+typedef struct {
+    int            id;          /* 0 = slot libero */
     match_status_t status;
 
     int owner_fd;
     int joiner_fd;
     int pending_fd;
+} match_hot_t;
+
+typedef struct {
+    /* Variante m,n,k (3,3,3 = tris classico); board piatta rows*cols */
+    unsigned char rows, cols, k;
+    int           stones;        /* pietre posate: pareggio a rows*cols */
+    char          board[MATCH_MAX_CELLS];
+    int           turn;          /* 0=X(owner), 1=O(joiner) */
 
-    char board[3][3];
-    int  turn;         /* 0=X(owner), 1=O(joiner) */
+    match_ai_t ai;
+    unsigned   ai_seed;
+    int        tour;         /* torneo proprietario (tournament.h), 0 = nessuno */
 
     /*
      * Risultato — valorizzati quando si entra in MATCH_REMATCH.
@@ -34,21 +86,164 @@ typedef struct {
     int winner_fd;
     int loser_fd;
     int draw;
+
+    /* Ultimi eventi della partita; seq = numero di eventi finora (0 = nessuno) */
+    int           seq;
+    match_event_t events[MATCH_EVENT_RING];
 } match_t;
 
+/*
+ * Indice inverso giocatore -> partite.  Ogni fd che compare in una
+ * partita ha una voce con la testa di tre liste (ruoli owner, joiner,
+ * pending); gli slot partita sono concatenati per ruolo in link[].  Le
+ * partite in corso e quelle in MATCH_REMATCH stanno nelle liste owner e
+ * joiner.  Disconnect e REMATCH visitano solo le partite del giocatore,
+ * non tutti gli slot.
+ *
+ * Le voci sono in una tabella a indirizzamento aperto per fd, come gli
+ * indici di state.c; ogni fd è in al più 3 ruoli per partita, quindi
+ * 4 * MAX_MATCHES voci bastano sempre.  Tutto sotto ms->mtx.
+ */
+#define MATCH_ROLES        3     /* owner, joiner, pending */
+#define MATCH_PLAYERS_SIZE 512   /* potenza di 2, >= 3 * MAX_MATCHES */
+
+typedef struct {
+    int fd;                      /* -1 = voce libera */
+    int head[MATCH_ROLES];       /* primo slot per ruolo, -1 = nessuno */
+} match_player_t;
+
+typedef struct {
+    short next[MATCH_ROLES];
+    short prev[MATCH_ROLES];
+} match_link_t;
+
+/*
+ * Directory esterna delle partite (lobby fra processi, lobby.h).  Se
+ * impostata gli id nuovi vengono da next_id, unici su tutto l'host, e
+ * ogni cambio di stato di uno slot viene pubblicato (h = NULL: partita
+ * chiusa).  Chiamate con ms->mtx preso: non prendono lock del server.
+ */
+typedef struct {
+    int  (*next_id)(void);
+    void (*publish)(int id, const match_hot_t *h, const match_t *m);
+} match_dir_t;
+
+/*
+ * Risultato di una partita di torneo, dai campi di MATCH_REMATCH.
+ * winner_fd / loser_fd sono -1 in caso di pareggio.
+ */
+typedef struct {
+    int tour;
+    int match_id;
+    int winner_fd;
+    int loser_fd;
+    int draw;
+} match_result_t;
+
 typedef struct {
     pthread_mutex_t mtx;
     int             next_id;
-    match_t         matches[MAX_MATCHES];
+    int             reserved;  /* slot liberi prenotati dai tornei */
+    const match_dir_t *dir;    /* NULL = solo partite locali */
+    _Alignas(64) match_hot_t hot[MAX_MATCHES];
+    match_t         matches[MAX_MATCHES];   /* parte fredda, stesso indice */
+    rating_store_t *ratings;   /* aggiornato a ogni vittoria/pareggio, può essere NULL */
+
+    /* Timer di turno (per slot partita, fuori da match_t: non viaggiano nell'handover) */
+    timewheel_t    *wheel;
+    int             turn_sec;  /* 0 = nessun limite */
+    tw_node_t       turn_timer[MAX_MATCHES];
+
+    /* Indice inverso (fuori da match_t: si ricostruisce dopo l'handover) */
+    match_player_t  players[MATCH_PLAYERS_SIZE];
+    match_link_t    link[MAX_MATCHES];
 } match_store_t;
 
 /* Init */
-void matches_init(match_store_t *ms);
+void matches_init(match_store_t *ms, rating_store_t *rs);
+
+/* Imposta la directory e vi pubblica le partite già presenti (handover) */
+void matches_set_dir(match_store_t *ms, const match_dir_t *dir);
+
+/*
+ * Limite di tempo per mossa: a ogni cambio di turno si arma il timer
+ * della partita, che alla scadenza fa perdere a tavolino chi doveva
+ * muovere.  Riarma anche le partite già in corso (dopo un handover).
+ */
+void matches_set_turn_timer(match_store_t *ms, timewheel_t *tw, int turn_sec);
+
+/*
+ * Timer TW_TURN estratto dalla ruota.  Ritorna 0 se la partita è stata
+ * chiusa a tavolino (loser = chi non ha mosso, winner = l'altro, -1 se
+ * è l'AI), -1 se il timer era superato da una mossa nel frattempo.
+ */
+int  matches_turn_expired(match_store_t *ms, server_state_t *st,
+                          const tw_fired_t *f, int *loser_fd_out,
+                          int *winner_fd_out,
+                          char *board_out, int board_outsz,
+                          char *winner_name_out, int winner_name_sz);
 
-/* Lobby */
-int  matches_create(match_store_t *ms, int owner_fd);
+/* Lobby: -1 nessuno slot libero, -2 variante m,n,k non valida */
+int  matches_create(match_store_t *ms, int owner_fd, int rows, int cols, int k);
 void matches_list(match_store_t *ms, server_state_t *st, char *out, int outsz);
 
+/*
+ * QUICKPLAY: partita creata direttamente in MATCH_PLAYING.  claim viene
+ * chiamata con ms->mtx preso, appena prima di occupare lo slot: se
+ * ritorna -1 la coppia non c'è più (un giocatore si è disconnesso dopo
+ * l'abbinamento) e la partita non nasce.  Chi si disconnette dopo il
+ * claim trova la partita in matches_on_disconnect e la perde.
+ * -1 nessuno slot libero, -2 coppia sparita o giocatore già in un'altra
+ * partita aperta.
+ */
+int  matches_create_playing(match_store_t *ms, int owner_fd, int joiner_fd,
+                            int (*claim)(int owner_fd, int joiner_fd));
+
+/* 1 se fd è owner, avversario o richiedente di una partita non finita */
+int  matches_player_busy(match_store_t *ms, int fd);
+
+/*
+ * Prenotazione degli slot per i tornei (tournament.h).  Gli slot
+ * prenotati restano liberi ma CREATE, QUICKPLAY, PLAYAI e REMATCH non li
+ * vedono: un turno di torneo parte solo con tutti i suoi slot in mano e
+ * non trova mai la lobby piena a metà.
+ *
+ * matches_reserve      : prenota fino a n slot liberi non ancora prenotati,
+ *                        ritorna quanti ne ha presi (anche 0).
+ * matches_unreserve    : restituisce n prenotazioni.
+ * matches_create_tour  : partita del torneo tour in MATCH_PLAYING su uno
+ *                        slot prenotato (-1 = nessuna prenotazione).
+ * matches_collect_tour : partite di torneo finite: ne scrive al massimo
+ *                        max in out, libera gli slot e li lascia prenotati
+ *                        (li riusa il turno successivo o una ripetizione).
+ *
+ * Una partita di torneo finita resta in MATCH_REMATCH finché non viene
+ * raccolta: REMATCH non la vede, e chi si disconnette mentre è in corso
+ * vi lascia la sconfitta a tavolino invece di liberare lo slot.
+ */
+int  matches_reserve(match_store_t *ms, int n);
+void matches_unreserve(match_store_t *ms, int n);
+int  matches_create_tour(match_store_t *ms, int owner_fd, int joiner_fd, int tour);
+int  matches_collect_tour(match_store_t *ms, match_result_t *out, int max);
+
+/* PLAYAI: partita contro il server, già in MATCH_PLAYING (-1 = piena) */
+int  matches_create_ai(match_store_t *ms, int owner_fd, match_ai_t level);
+
+/*
+ * Mossa dell'AI dopo quella del giocatore.  Ritorna come matches_move:
+ * 0 partita in corso, 1 vince l'AI, 2 pareggio; -1 se non tocca all'AI.
+ */
+int  matches_ai_move(match_store_t *ms, int match_id, int *r_out, int *c_out,
+                     char *board_out, int board_outsz);
+
+/*
+ * HINT: mossa migliore per player_fd (solo contro l'AI).
+ * 0 ok, -1 match non trovato, -2 non in corso, -3 non disponibile,
+ * -4 non è il tuo turno.
+ */
+int  matches_hint(match_store_t *ms, int match_id, int player_fd,
+                  int *r_out, int *c_out);
+
 /* JOIN flow */
 int matches_request_join(match_store_t *ms, int match_id, int joiner_fd,
                          int *owner_fd_out);
@@ -78,7 +273,8 @@ int matches_resign(match_store_t *ms, server_state_t *st,
  *  Il vincitore (o chiunque in caso di pareggio) fa REMATCH:
  *  → viene creata una NUOVA partita in WAITING con lui come owner (X)
  *  → broadcast a tutti: chiunque può fare JOIN
- *  → il vecchio slot MATCH_REMATCH viene liberato
+ *  → il vecchio slot MATCH_REMATCH viene liberato (e riusato se non ce
+ *    ne sono altri: REMATCH non trova mai la lobby piena)
  *
  *  Il perdente non può fare REMATCH.
  *
@@ -87,7 +283,7 @@ int matches_resign(match_store_t *ms, server_state_t *st,
  *   -1           : match non trovato / non in MATCH_REMATCH
  *   -2           : non sei un giocatore di questa partita
  *   -3           : sei il perdente, non puoi fare rematch
- *   -4           : nessuno slot libero
+ *   -4           : nessuno slot libero fuori dalle prenotazioni dei tornei
  */
 int matches_rematch(match_store_t *ms, int match_id, int player_fd);
 
@@ -97,7 +293,25 @@ int matches_rematch(match_store_t *ms, int match_id, int player_fd);
  */
 int matches_find_rematch(match_store_t *ms, int player_fd);
 
-/* Disconnect */
-void matches_on_disconnect(match_store_t *ms, server_state_t *st, int fd);
+/*
+ * Replay dopo RESUME: scrive in out gli eventi con seq > last_seq
+ * (oppure EVENT REPLAY_GAP se sono già usciti dal ring) seguiti dalla
+ * board.  Ritorna il seq corrente oppure -1 se il match non esiste.
+ */
+int matches_replay(match_store_t *ms, int match_id, int last_seq,
+                   char *out, int outsz);
+
+/*
+ * Ricostruisce l'indice inverso dopo aver sovrascritto hot[] (handover).
+ * I tornei non viaggiano nell'handover: le loro partite proseguono come
+ * partite normali.
+ */
+void matches_rebuild_index(match_store_t *ms);
+
+/*
+ * Disconnect: ritorna l'id della partita in corso persa a tavolino
+ * (per avvisare gli spettatori), -1 se fd non stava giocando.
+ */
+int  matches_on_disconnect(match_store_t *ms, server_state_t *st, int fd);
 
 #endif /* MATCH_H */
\ No newline at end of file
@@ -0,0 +1,78 @@
+#ifndef MATCHMAKER_H
+#define MATCHMAKER_H
+
+#include <pthread.h>
+#include <time.h>
+#include "state.h"
+
+/* ================================================================== */
+/*  MATCHMAKER.H  –  Coda QUICKPLAY con abbinamento automatico         */
+/* ================================================================== */
+
+/*
+ * Lista FIFO doppiamente collegata, con le celle indicizzate per slot
+ * client (state_slot_of): inserimento, abbinamento e rimozione alla
+ * disconnessione sono O(1).  Il primo arrivato gioca come X.
+ *
+ * Con band > 0 si abbinano solo giocatori con rating distante al più
+ * band; la fascia si allarga di band ogni MM_WIDEN_SEC secondi di attesa
+ * e matchmaker_tick riprova periodicamente gli abbinamenti in coda.
+ *
+ * Una coppia abbinata esce dalla coda ma resta segnata (paired) finché
+ * la partita non nasce: la disconnessione passa da matchmaker_remove,
+ * che toglie il segno, e la creazione della partita lo consuma con
+ * matchmaker_claim sotto il lock delle partite (ordine ms -> mm -> st).
+ * Così una partita non nasce mai contro un fd già chiuso o riassegnato.
+ */
+#define MM_WIDEN_SEC 10
+
+typedef struct {
+    int    fd;
+    int    queued;
+    int    paired;       /* abbinato, partita non ancora creata */
+    int    prev, next;   /* slot adiacenti nella coda, -1 = nessuno */
+    int    rating;
+    time_t since;
+} mm_entry_t;
+
+typedef struct {
+    pthread_mutex_t mtx;
+    int        band;     /* 0 = nessun vincolo di rating */
+    int        head, tail;
+    int        count;
+    mm_entry_t entries[MAX_CLIENTS];
+} matchmaker_t;
+
+void matchmaker_init(matchmaker_t *mm, int band);
+
+/*
+ * Ritorna:
+ *   1  : abbinato, *opponent_fd_out = giocatore in attesa (sarà X)
+ *   0  : nessun avversario libero, fd messo in coda
+ *  -1  : fd già in coda
+ *  -2  : client sconosciuto
+ */
+int  matchmaker_enqueue(matchmaker_t *mm, server_state_t *st, int fd,
+                        int rating, int *opponent_fd_out);
+
+/* Toglie fd dalla coda o da una coppia.  0 se c'era, -1 altrimenti. */
+int  matchmaker_remove(matchmaker_t *mm, server_state_t *st, int fd);
+
+/* Coppia (x, o) ancora abbinata: la consuma e ritorna 0, altrimenti -1 */
+int  matchmaker_claim(matchmaker_t *mm, server_state_t *st, int x_fd, int o_fd);
+
+/*
+ * La partita di una coppia non è nata: fd, se è ancora abbinato, torna
+ * in coda.  Ritorna come matchmaker_enqueue, -2 se non era abbinato.
+ */
+int  matchmaker_requeue(matchmaker_t *mm, server_state_t *st, int fd,
+                        int rating, int *opponent_fd_out);
+
+/*
+ * Abbina i giocatori in coda la cui fascia si è allargata.  Scrive in
+ * pairs_out coppie (X, O) di fd e ritorna il numero di coppie.
+ */
+int  matchmaker_tick(matchmaker_t *mm, server_state_t *st,
+                     int *pairs_out, int max_pairs);
+
+#endif /* MATCHMAKER_H */
@@ -0,0 +1,65 @@
+#ifndef MUX_H
+#define MUX_H
+
+#include "session.h"
+#include "net.h"
+
+/* ================================================================== */
+/*  MUX.H  –  Più giocatori su una sola connessione                    */
+/* ================================================================== */
+
+/*
+ * Per i client automatici: dopo MUX una connessione porta i comandi di
+ * molti giocatori, "@<sid> <comando>".  Ogni sid è una sessione
+ * completa (session_t) su un fd virtuale (net.h): stato, partite, code
+ * e broadcast lo vedono come un client qualsiasi, e ogni riga inviata a
+ * quel fd torna sulla connessione con il prefisso "@<sid> ".
+ *
+ * Le righe dei sid le esegue chi serve la connessione, una alla volta
+ * come quelle della connessione stessa: le sessioni dei sid non hanno
+ * lock.  Gli invii da altri thread (avversari, broadcast) prendono il
+ * lock della connessione, così le righe di due sid non si mescolano;
+ * quelli con dontwait (spettatori, heartbeat) non lo aspettano e sono
+ * tutto o niente come su un socket, -1/EAGAIN se la connessione è piena.
+ *
+ * Un sid nasce alla sua prima riga e vive fino a "@<sid> QUIT", alla
+ * chiusura della connessione o al limite di inattività (-i, contato per
+ * sid), senza periodo di grazia.  Ogni sid occupa
+ * uno slot client (MAX_CLIENTS) e ha i suoi limiti di righe al secondo,
+ * in aggiunta al limite generale della connessione (-l), che vale per
+ * tutte le righe, con prefisso o senza.
+ */
+
+#define MUX_MAX_CONN  MAX_CLIENTS   /* connessioni multiplexate contemporanee */
+#define MUX_MAX_SIDS  256           /* giocatori per connessione */
+#define MUX_VFD_BASE  (NET_VFD_BASE + (1 << 20))
+
+/* Registra l'invio sugli fd virtuali dei sid (prima di avviare l'I/O) */
+void mux_init(void);
+
+/* MUX: la connessione passa in modalità multiplexata.  0 ok, -1 piena */
+int  mux_open(session_t *s);
+
+/*
+ * Riga "@<sid> ..." di una connessione multiplexata, già contata nei
+ * limiti della connessione.  0, oppure -1 se rifiutata senza arrivare a
+ * un sid (ERR BAD_SID, ERR SERVER_FULL): conta come una riga oltre il
+ * limite (rl_reject).
+ */
+int  mux_line(session_t *s, char *line);
+
+/* Partita su cui agirà la riga "@<sid> ...", come session_match_of */
+int  mux_match_of(const session_t *s, const char *line);
+
+/* Chiusura della connessione: chiude tutti i sid */
+void mux_close(session_t *s);
+
+/*
+ * Handover: i sid non passano al successore (vivono nello stato di
+ * questo processo), quindi ogni connessione multiplexata riceve BYE e
+ * viene chiusa in entrambe le direzioni.  Il successore la trova già
+ * chiusa e la libera come una disconnessione; i sid li chiude lui.
+ */
+void mux_handover(void);
+
+#endif /* MUX_H */
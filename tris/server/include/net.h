@@ -2,8 +2,62 @@
 #define NET_H
 
 #include <stddef.h>
+#include <sys/types.h>
 
-#define MAX_LINE 512
+#define MAX_LINE     512
+#define NET_NOT_MINE (-2)
+
+/*
+ * Invio delegato a un backend asincrono (io_uring): accoda fino a len
+ * byte per fd e ritorna quanti ne ha accettati, -1 con errno (EAGAIN
+ * se dontwait e la coda è piena, EPIPE se la connessione è morta),
+ * oppure NET_NOT_MINE se il fd non è suo.
+ */
+typedef ssize_t (*net_sender_t)(int fd, const void *buf, size_t len, int dontwait);
+
+void    net_set_sender(net_sender_t fn);
+
+/*
+ * fd virtuali (>= NET_VFD_BASE, oltre ogni fd reale): sessioni senza un
+ * socket proprio, il cui output va altrove (lobby.h, mux.h).  Ogni
+ * modulo registra il suo intervallo [first, first + count) con la
+ * funzione di invio e quella di chiusura, prima di avviare l'I/O.
+ * 0 oppure -1 se pieni.
+ *
+ * La chiusura fa per il fd virtuale quello che shutdown(2) fa per un
+ * socket: chiede a chi esegue la sessione di chiuderla (inattività),
+ * da un thread qualsiasi.  NULL se la sessione la chiude già qualcun
+ * altro (il processo che tiene il socket, per gli inoltri della lobby).
+ */
+#define NET_VFD_BASE    (1 << 24)
+#define NET_MAX_VIRTUAL 4
+
+typedef void (*net_closer_t)(int fd);
+
+int     net_add_virtual(int first, int count, net_sender_t fn, net_closer_t close_fn);
+
+/* shutdown(fd, SHUT_RDWR) anche per i fd virtuali: 0, -1 se non c'è chiusura */
+int     net_shutdown(int fd);
+
+/*
+ * Un invio: tramite il backend se il fd è suo, altrimenti send(2) con
+ * il lock di scrittura del fd, così le righe di thread diversi (risposte,
+ * spettatori, avversari) non si mescolano.  Sul socket l'invio è tutto
+ * o niente: senza dontwait ritorna len oppure -1; con dontwait -1/EAGAIN
+ * se il socket è pieno o un altro thread sta scrivendo, e un invio
+ * partito a metà viene completato prima di lasciare il lock.  Se il
+ * client non legge il resto entro NET_STALL_MS la connessione viene
+ * chiusa (shutdown) invece di restare con una riga troncata.
+ *
+ * Ogni fd sotto NET_WLOCKS ha il suo lock, quindi un client che non
+ * legge ferma solo chi scrive a lui.  Oltre quel numero i lock sono
+ * condivisi per modulo e l'invio è sempre quello non bloccante, così
+ * l'attesa su un fd vicino resta limitata a NET_STALL_MS.
+ */
+#define NET_WLOCKS   4096  /* lock di scrittura, uno per fd (come UR_MAX_FD) */
+#define NET_STALL_MS 2000
+
+ssize_t net_send(int fd, const void *buf, size_t len, int dontwait);
 
 int  net_send_str(int sock, const char *s);
 int  net_recv_into_buffer(int sock, char *buf, size_t *len, size_t cap);
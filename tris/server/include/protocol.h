@@ -10,9 +10,14 @@
 /* ------------------------------------------------------------------ */
 #define PROTO_WELCOME           "WELCOME\n"
 #define PROTO_HINT_LOGIN        "Please LOGIN <n>\n"
-#define PROTO_HINT_CMDS         "Commands: LOGIN <n>, WHOAMI, USERS, CREATE, LIST, " \
+#define PROTO_HINT_CMDS         "Commands: LOGIN <n>, WHOAMI, USERS, "               \
+                                "CREATE [<m> <n> <k>], LIST, "                       \
                                 "JOIN <id>, ACCEPT <id>, REJECT <id>, "                \
-                                "MOVE <r> <c>, BOARD, RESIGN, REMATCH, QUIT\n"
+                                "MOVE <r> <c>, BOARD, RESIGN, REMATCH, "             \
+                                "QUICKPLAY [CANCEL], TOP <n>, RANK [<n>], "          \
+                                "WATCH <id>, UNWATCH, PLAYAI [easy|perfect], HINT, "  \
+                                "TOURNAMENT CREATE|JOIN|LEAVE|LIST|STANDINGS, "      \
+                                "RESUME <token> <seq>, PING, QUIT\n"
 
 /* ------------------------------------------------------------------ */
 /*  Login                                                               */
@@ -22,6 +27,26 @@
 #define PROTO_ERR_BAD_NAME      "ERR BAD_NAME\n"
 #define PROTO_ERR_PLEASE_LOGIN  "ERR PLEASE_LOGIN\n"
 
+/* ------------------------------------------------------------------ */
+/*  Sessione / RESUME                                                   */
+/*                                                                      */
+/*  Dopo il login il server invia un token.  Se la connessione cade, la */
+/*  sessione resta riservata per un periodo di grazia: da una nuova     */
+/*  connessione RESUME <token> <seq> la riaggancia e rimanda gli eventi */
+/*  di partita con numero > seq.  seq conta gli eventi della partita    */
+/*  corrente: ogni mossa (OK MOVED / OPPONENT_MOVED) e la fine partita. */
+/* ------------------------------------------------------------------ */
+#define PROTO_OK_TOKEN             "OK TOKEN %s\n"
+#define PROTO_OK_RESUMED           "OK RESUMED %s\n"
+#define PROTO_OK_RESUMED_MATCH     "OK RESUMED %s match=%d seq=%d\n"
+#define PROTO_ERR_RESUME_FAILED    "ERR RESUME_FAILED\n"
+#define PROTO_EVENT_REPLAY_MOVE    "EVENT REPLAY %d MOVE %c %d %d\n"
+#define PROTO_EVENT_REPLAY_WIN     "EVENT REPLAY %d WIN %c\n"
+#define PROTO_EVENT_REPLAY_DRAW    "EVENT REPLAY %d DRAW\n"
+#define PROTO_EVENT_REPLAY_RESIGN  "EVENT REPLAY %d RESIGN %c\n"
+#define PROTO_EVENT_REPLAY_TIMEOUT "EVENT REPLAY %d TIMEOUT %c\n"
+#define PROTO_EVENT_REPLAY_GAP     "EVENT REPLAY_GAP %d\n"
+
 /* ------------------------------------------------------------------ */
 /*  Comandi generici                                                    */
 /* ------------------------------------------------------------------ */
@@ -30,14 +55,66 @@
 #define PROTO_BYE              "BYE\n"
 #define PROTO_ERR_UNKNOWN_CMD  "ERR UNKNOWN_CMD\n"
 #define PROTO_ERR_BAD_USAGE    "ERR BAD_USAGE\n"
+#define PROTO_ERR_RATE_LIMITED "ERR RATE_LIMITED\n"
+
+/* ------------------------------------------------------------------ */
+/*  Multiplexing (mux.h)                                                */
+/*                                                                      */
+/*  MUX, prima del login, apre la modalità: "@<sid> <comando>" è un     */
+/*  comando del giocatore sid (0 .. max-1), che nasce alla prima riga,  */
+/*  e ogni riga di risposta o di evento per lui arriva con lo stesso    */
+/*  prefisso.  Le righe senza prefisso restano della connessione.      */
+/* ------------------------------------------------------------------ */
+#define PROTO_OK_MUX           "OK MUX %d\n"
+#define PROTO_ERR_BAD_SID      "ERR BAD_SID\n"
+
+/* ------------------------------------------------------------------ */
+/*  Heartbeat                                                           */
+/*                                                                      */
+/*  Il client può mandare PING in ogni momento (risposta PONG).  Con   */
+/*  -p il server manda PING a una connessione silenziosa: basta una    */
+/*  riga qualsiasi, tipicamente PONG, prima del timeout di inattività. */
+/* ------------------------------------------------------------------ */
+#define PROTO_PING             "PING\n"
+#define PROTO_PONG             "PONG\n"
 
 /* ------------------------------------------------------------------ */
 /*  CREATE / LIST                                                       */
 /* ------------------------------------------------------------------ */
 #define PROTO_OK_MATCH_CREATED  "OK MATCH_CREATED %d\n"
+#define PROTO_OK_MATCH_CREATED_MNK "OK MATCH_CREATED %d board=%dx%d k=%d\n"
+#define PROTO_ERR_BAD_VARIANT   "ERR BAD_VARIANT Righe e colonne da 3 a 15, 3 <= k <= max(righe, colonne)\n"
 #define PROTO_ERR_MATCHES_FULL  "ERR MATCHES_FULL\n"
 #define PROTO_NO_MATCHES        "NO_MATCHES\n"
 
+/* ------------------------------------------------------------------ */
+/*  Code di attesa a capienza esaurita                                  */
+/*                                                                      */
+/*  Server pieno: la connessione resta aperta e riceve                  */
+/*  EVENT ADMISSION_QUEUE <posizione> <attesa_sec> (anche a ogni        */
+/*  avanzamento) finché non si libera uno slot; allora parte WELCOME.   */
+/*  Partite finite: CREATE, PLAYAI, REMATCH e gli abbinamenti QUICKPLAY */
+/*  vanno in coda (OK MATCH_QUEUED) e ricevono la risposta normale      */
+/*  appena si libera una partita.  Con la coda piena: ERR SERVER_FULL / */
+/*  ERR MATCHES_FULL come prima.                                        */
+/* ------------------------------------------------------------------ */
+#define PROTO_EVENT_ADMISSION     "EVENT ADMISSION_QUEUE %d %d\n"
+#define PROTO_ERR_SERVER_FULL     "ERR SERVER_FULL\n"
+#define PROTO_OK_MATCH_QUEUED     "OK MATCH_QUEUED %d %d\n"
+#define PROTO_EVENT_MATCH_QUEUE   "EVENT MATCH_QUEUE %d %d\n"
+
+/* ------------------------------------------------------------------ */
+/*  QUICKPLAY                                                           */
+/*                                                                      */
+/*  Il giocatore entra nella coda di matchmaking; appena c'è un        */
+/*  avversario libero la partita parte subito in MATCH_PLAYING e       */
+/*  entrambi ricevono OK MATCH_STARTED (chi aspettava da più tempo è X).*/
+/* ------------------------------------------------------------------ */
+#define PROTO_OK_QUEUED           "OK QUEUED\n"
+#define PROTO_OK_UNQUEUED         "OK UNQUEUED\n"
+#define PROTO_ERR_ALREADY_QUEUED  "ERR ALREADY_QUEUED\n"
+#define PROTO_ERR_NOT_QUEUED      "ERR NOT_QUEUED\n"
+
 /* ------------------------------------------------------------------ */
 /*  JOIN                                                                */
 /* ------------------------------------------------------------------ */
@@ -115,6 +192,70 @@
 #define PROTO_ERR_REMATCH_FAILED   "ERR REMATCH_FAILED\n"
 #define PROTO_ERR_REMATCH_NOT_AVAIL "ERR REMATCH_NOT_AVAILABLE Non sei in una partita terminata\n"
 
+/* ------------------------------------------------------------------ */
+/*  PLAYAI / HINT (avversario del server, gioca O)                      */
+/* ------------------------------------------------------------------ */
+#define PROTO_AI_NAME                "AI"
+#define PROTO_OK_AI_MATCH_STARTED    "OK AI_MATCH_STARTED %d %s\n"
+#define PROTO_OK_HINT                "OK HINT %d %d\n"
+#define PROTO_ERR_HINT_UNAVAILABLE   "ERR HINT_UNAVAILABLE\n"
+
+/* ------------------------------------------------------------------ */
+/*  WATCH / UNWATCH (spettatori)                                        */
+/*                                                                      */
+/*  Ogni evento arriva come riga EVENT WATCH <id> ... seguita, per le  */
+/*  mosse, dalla board.  Dopo l'evento finale lo spettatore viene      */
+/*  sganciato automaticamente.                                         */
+/* ------------------------------------------------------------------ */
+#define PROTO_OK_WATCHING            "OK WATCHING %d\n"
+#define PROTO_OK_UNWATCHED           "OK UNWATCHED\n"
+#define PROTO_ERR_NOT_WATCHING       "ERR NOT_WATCHING\n"
+#define PROTO_ERR_WATCH_FULL         "ERR WATCH_FULL\n"
+#define PROTO_EVENT_WATCH_MOVE       "EVENT WATCH %d MOVE %d %d\n"
+#define PROTO_EVENT_WATCH_WINNER     "EVENT WATCH %d WINNER %s\n"
+#define PROTO_EVENT_WATCH_DRAW       "EVENT WATCH %d DRAW\n"
+#define PROTO_EVENT_WATCH_RESIGN     "EVENT WATCH %d RESIGN %s\n"
+#define PROTO_EVENT_WATCH_TIMEOUT    "EVENT WATCH %d TIMEOUT %s\n"
+#define PROTO_EVENT_TURN_TIMEOUT     "EVENT TURN_TIMEOUT %d %s\n"
+#define PROTO_EVENT_WATCH_ABANDONED  "EVENT WATCH %d ABANDONED\n"
+
+/* ------------------------------------------------------------------ */
+/*  Tornei (tournament.h)                                               */
+/*                                                                      */
+/*  TOURNAMENT CREATE <size> single|swiss|rr, JOIN <id>, LEAVE, LIST,   */
+/*  STANDINGS <id>.  A iscrizioni complete il torneo parte da solo: a   */
+/*  ogni turno EVENT TOURNAMENT_ROUND, poi per chi gioca                */
+/*  EVENT TOURNAMENT_MATCH seguito dal normale OK MATCH_STARTED.  Le    */
+/*  partite del torneo non ammettono REMATCH.                           */
+/* ------------------------------------------------------------------ */
+#define PROTO_OK_TOURNAMENT_CREATED   "OK TOURNAMENT_CREATED %d\n"
+#define PROTO_OK_TOURNAMENT_JOINED    "OK TOURNAMENT_JOINED %d %d/%d\n"
+#define PROTO_OK_TOURNAMENT_LEFT      "OK TOURNAMENT_LEFT %d\n"
+#define PROTO_OK_STANDINGS            "OK STANDINGS %d\n"
+#define PROTO_TOURNAMENT_LINE         "TOURNAMENT %d %s players=%d/%d status=%s round=%d/%d\n"
+#define PROTO_STANDING_LINE           "STANDING %d %s %d.%d W=%d D=%d L=%d%s\n"
+#define PROTO_NO_TOURNAMENTS          "NO_TOURNAMENTS\n"
+#define PROTO_ERR_BAD_TOURNAMENT      "ERR BAD_TOURNAMENT Iscritti da 2 a %d, formato single, swiss o rr\n"
+#define PROTO_ERR_TOURNAMENTS_FULL    "ERR TOURNAMENTS_FULL\n"
+#define PROTO_ERR_TOURNAMENT_NOT_FOUND "ERR TOURNAMENT_NOT_FOUND\n"
+#define PROTO_ERR_TOURNAMENT_CLOSED   "ERR TOURNAMENT_CLOSED\n"
+#define PROTO_ERR_IN_TOURNAMENT       "ERR ALREADY_IN_TOURNAMENT\n"
+#define PROTO_ERR_NOT_IN_TOURNAMENT   "ERR NOT_IN_TOURNAMENT\n"
+#define PROTO_EVENT_TOURNAMENT_OPEN   "EVENT TOURNAMENT_OPEN %d owner=%s size=%d format=%s\n"
+#define PROTO_EVENT_TOURNAMENT_ROUND  "EVENT TOURNAMENT_ROUND %d %d/%d\n"
+#define PROTO_EVENT_TOURNAMENT_MATCH  "EVENT TOURNAMENT_MATCH %d %d %d\n"
+#define PROTO_EVENT_TOURNAMENT_BYE    "EVENT TOURNAMENT_BYE %d %d\n"
+#define PROTO_EVENT_TOURNAMENT_OUT    "EVENT TOURNAMENT_OUT %d %d\n"
+#define PROTO_EVENT_TOURNAMENT_END    "EVENT TOURNAMENT_END %d winner=%s\n"
+
+/* ------------------------------------------------------------------ */
+/*  Classifica (rating Elo)                                             */
+/* ------------------------------------------------------------------ */
+#define PROTO_RANK_LINE        "RANK %d %s %d W=%d L=%d D=%d\n"
+#define PROTO_OK_RANK          "OK RANK %d %s %d\n"
+#define PROTO_NO_RATINGS       "NO_RATINGS\n"
+#define PROTO_ERR_UNRANKED     "ERR UNRANKED\n"
+
 /* ------------------------------------------------------------------ */
 /*  Disconnect / eventi asincroni                                       */
 /* ------------------------------------------------------------------ */
@@ -125,6 +266,7 @@
 /*  Broadcast cambio stato partita (a tutti i client connessi)         */
 /* ------------------------------------------------------------------ */
 #define PROTO_EVENT_MATCH_AVAILABLE   "EVENT MATCH_AVAILABLE %d owner=%s\n"
+#define PROTO_EVENT_MATCH_AVAILABLE_MNK "EVENT MATCH_AVAILABLE %d owner=%s board=%dx%d k=%d\n"
 #define PROTO_EVENT_MATCH_STARTED_ALL "EVENT MATCH_STARTED %d\n"
 #define PROTO_EVENT_MATCH_FINISHED    "EVENT MATCH_FINISHED %d\n"
 
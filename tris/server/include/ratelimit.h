@@ -0,0 +1,68 @@
+#ifndef RATELIMIT_H
+#define RATELIMIT_H
+
+#include <stdint.h>
+
+/* ================================================================== */
+/*  RATELIMIT.H  –  Token bucket per connessione e classe di comando   */
+/* ================================================================== */
+
+/*
+ * Ogni connessione ha un bucket per classe; ogni riga accettata consuma
+ * un token di RL_ANY e uno della sua classe (una riga rifiutata dalla
+ * classe non tocca RL_ANY, così chi insiste con LIST può ancora muovere).  I bucket si ricaricano di rate
+ * token al secondo fino a burst.  Lo stato vive nella sessione
+ * (session.h), usata da un thread alla volta: nessun lock, solo un
+ * clock monotono grossolano per riga.
+ *
+ * Le righe oltre il limite ricevono ERR RATE_LIMITED; dopo
+ * RL_MAX_STRIKES righe rifiutate senza una riga accettata in mezzo la
+ * connessione viene chiusa.
+ */
+
+typedef enum {
+    RL_ANY   = 0,   /* ogni riga */
+    RL_QUERY = 1,   /* LIST, USERS, TOP, RANK, ...: lock globale + risposta lunga */
+    RL_LOBBY = 2,   /* CREATE, JOIN, QUICKPLAY, ...: modificano la lobby, broadcast */
+    RL_GAME  = 3,   /* tutto il resto (MOVE, BOARD, ...): solo RL_ANY */
+    RL_CLASSES
+} rl_class_t;
+
+#define RL_ANY_RATE     20
+#define RL_ANY_BURST    40
+#define RL_QUERY_RATE   2
+#define RL_QUERY_BURST  5
+#define RL_LOBBY_RATE   1
+#define RL_LOBBY_BURST  5
+#define RL_MAX_STRIKES  50
+
+typedef struct {
+    uint32_t milli;     /* token * 1000 */
+    uint64_t last_ms;
+} rl_bucket_t;
+
+typedef struct {
+    rl_bucket_t b[RL_CLASSES];
+    int         strikes;
+    int         prev;       /* strikes prima dell'ultima riga accettata */
+} rl_conn_t;
+
+/* Limite per classe (rate <= 0: classe senza limite).  Da chiamare all'avvio. */
+void rl_configure(rl_class_t cls, int rate, int burst);
+
+void rl_conn_init(rl_conn_t *c);
+
+/* Classe del comando all'inizio di line */
+rl_class_t rl_class_of(const char *line);
+
+/* 0 riga accettata, 1 oltre il limite, -1 da disconnettere */
+int rl_check(rl_conn_t *c, const char *line);
+
+/*
+ * La riga appena accettata da rl_check è stata rifiutata per altri
+ * motivi (MUX: sid non valido, server pieno): conta come una riga oltre
+ * il limite.  0, oppure -1 da disconnettere.
+ */
+int rl_reject(rl_conn_t *c);
+
+#endif /* RATELIMIT_H */
@@ -0,0 +1,86 @@
+#ifndef RATING_H
+#define RATING_H
+
+#include <pthread.h>
+#include "state.h"
+
+/* ================================================================== */
+/*  RATING.H  –  Punteggi Elo e classifica                             */
+/* ================================================================== */
+
+#define RATING_INITIAL   1500
+#define RATING_K         32
+#define RATING_MAX_LEVEL 24
+#define RATING_MAX_TOP   50     /* righe massime per TOP <n> */
+
+/*
+ * Un giocatore (per nome, persiste tra le sessioni).  I nodi stanno in
+ * una hash per nome e, contemporaneamente, in una skiplist indicizzata
+ * (ogni puntatore porta lo "span", cioè quante posizioni salta) ordinata
+ * per rating decrescente e nome crescente: aggiornamento, RANK e TOP
+ * costano O(log n) senza mai riordinare.
+ */
+typedef struct rating_node {
+    char                name[MAX_NAME];
+    int                 rating;
+    int                 wins, losses, draws;
+    struct rating_node *hnext;
+    int                 level;
+    struct {
+        struct rating_node *next;
+        int                 span;
+    } lv[];
+} rating_node_t;
+
+typedef struct {
+    pthread_mutex_t  mtx;
+    rating_node_t  **buckets;
+    int              nbuckets;
+    int              count;
+    rating_node_t   *head;      /* sentinella della skiplist */
+    int              level;
+    unsigned         seed;
+    int              dirty;
+    char             path[256]; /* file di persistenza */
+    pthread_mutex_t  save_mtx;  /* un salvataggio su file alla volta */
+    int              paused;    /* autosave sospeso (handover) */
+} rating_store_t;
+
+void rating_init(rating_store_t *rs, const char *path);
+
+/*
+ * File compatto: header (magic, versione, numero record) e record
+ * {len nome, nome, rating, vittorie, sconfitte, pareggi} in ordine di
+ * classifica.  Ritorna il numero di giocatori caricati, -1 se il file
+ * è illeggibile (0 se non esiste).
+ */
+int  rating_load(rating_store_t *rs);
+
+/*
+ * Salvataggi serializzati: snapshot e rename avvengono nello stesso
+ * ordine, su un file temporaneo unico (mkstemp) accanto a path.
+ */
+int  rating_save(rating_store_t *rs);
+
+/* Thread che salva su file ogni interval_sec secondi se ci sono modifiche */
+int  rating_start_autosave(rating_store_t *rs, int interval_sec);
+
+/*
+ * paused = 1: aspetta il salvataggio automatico in corso e non ne fa
+ * altri (prima del salvataggio finale dell'handover); 0 li riprende.
+ */
+void rating_pause_autosave(rating_store_t *rs, int paused);
+
+/* Registra un risultato (draw = 1: a e b pareggiano, altrimenti vince a) */
+void rating_record(rating_store_t *rs, const char *a, const char *b, int draw);
+
+/* Rating del giocatore (RATING_INITIAL se mai visto) */
+int  rating_get(rating_store_t *rs, const char *name);
+
+/* Posizione (1 = primo) e rating; ritorna -1 se il giocatore non ha partite */
+int  rating_rank(rating_store_t *rs, const char *name, int *rating_out);
+
+/* Prime n posizioni formattate in out (NO_RATINGS se vuota) */
+void rating_top(rating_store_t *rs, int n, char *out, int outsz);
+
+#endif /* RATING_H */
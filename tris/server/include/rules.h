@@ -0,0 +1,46 @@
+#ifndef RULES_H
+#define RULES_H
+
+/* ================================================================== */
+/*  RULES.H  –  Regole del tris, condivise da server, solver e sim     */
+/* ================================================================== */
+
+/*
+ * Varianti m,n,k: board di m righe e n colonne, vince chi allinea k
+ * simboli (orizzontale, verticale o diagonale).  Il tris classico è
+ * 3,3,3; 4,4,4 e 15,15,5 (Gomoku) sono le altre varianti previste.
+ * La board è un array piatto di rows*cols celle (' ', 'X', 'O').
+ */
+
+#define RULES_MIN_DIM 3
+#define RULES_MAX_DIM 15
+
+/* 1 se m,n,k descrivono una variante giocabile */
+int  rules_mnk_valid(int rows, int cols, int k);
+
+void rules_board_clear(char *b, int cells);
+
+/*
+ * 1 se la pietra appena posata in (r, c) chiude una linea di k:
+ * guarda solo le 4 direzioni che passano per (r, c), O(k) per mossa.
+ * Il pareggio si ricava dal numero di pietre, senza scandire la board.
+ */
+int  rules_mnk_wins(const char *b, int rows, int cols, int k, int r, int c);
+
+/*
+ * Tris classico in bitboard: un bit per cella (bit r*3+c), una maschera
+ * per giocatore.  rules_lines sono le linee vincenti della variante
+ * 3,3,3, usate dalla tabella del solver e dal simulatore vettoriale
+ * (tris/sim); rules_mnk_wins dà le stesse risposte su quella variante.
+ */
+
+#define RULES_CELLS 9
+#define RULES_LINES 8
+#define RULES_FULL  0x1FFu
+
+extern const unsigned short rules_lines[RULES_LINES];
+
+/* 1 se la maschera contiene una linea completa */
+int rules_bits_win(unsigned mask);
+
+#endif /* RULES_H */
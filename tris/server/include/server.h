@@ -0,0 +1,32 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+#include "state.h"
+#include "match.h"
+#include "matchmaker.h"
+#include "rating.h"
+#include "spectate.h"
+#include "timewheel.h"
+#include "tournament.h"
+
+/* ================================================================== */
+/*  SERVER.H  –  Stato globale del processo e opzioni da riga di comando */
+/* ================================================================== */
+
+#define DEFAULT_GRACE_SEC 30
+#define DEFAULT_IDLE_SEC  600
+
+extern server_state_t g_state;
+extern match_store_t  g_matches;
+extern matchmaker_t   g_queue;
+extern rating_store_t g_ratings;
+extern spectators_t   g_spect;
+extern timewheel_t    g_wheel;
+extern tour_registry_t g_tours;
+
+extern int g_grace_sec;
+extern int g_idle_sec;   /* 0 = nessun limite */
+extern int g_ping_sec;   /* 0 = nessun heartbeat */
+extern int g_turn_sec;   /* 0 = nessun limite di turno */
+
+#endif /* SERVER_H */
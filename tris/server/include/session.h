@@ -0,0 +1,69 @@
+#ifndef SESSION_H
+#define SESSION_H
+
+#include "state.h"
+#include "ratelimit.h"
+
+/* ================================================================== */
+/*  SESSION.H  –  Comandi di una connessione, indipendenti dall'I/O     */
+/* ================================================================== */
+
+/*
+ * Una sessione è lo stato per connessione che prima viveva sullo stack
+ * del thread del client.  Il backend di I/O (io.h) legge le righe e le
+ * passa a session_line una alla volta, sempre dallo stesso thread
+ * oppure in modo serializzato: la sessione non ha lock propri.
+ */
+
+#define SESSION_CONTINUE 0
+#define SESSION_CLOSE    1   /* QUIT o flood: chiudere senza grazia */
+
+typedef struct session session_t;
+
+struct session {
+    int       fd;
+    int       slot;
+    int       dropped;   /* connessione caduta (non QUIT): sessione riprendibile */
+    char      me[MAX_NAME];
+    rl_conn_t rl;
+
+    /*
+     * Dopo RESUME la sessione passa sul vecchio fd: il backend aggiorna
+     * s->fd e la propria registrazione (NULL = basta assegnare s->fd).
+     * Chiamata prima che il fd della nuova connessione venga chiuso.
+     */
+    void    (*rebind)(session_t *s, int new_fd);
+    void     *io;        /* dati privati del backend */
+    int       relay;     /* >= 0: righe inoltrate a un altro processo (lobby.h) */
+    struct mux *mux;     /* != NULL: connessione multiplexata (mux.h) */
+    uint32_t  cap;       /* id nella cattura (capture.h), 0 = non registrata */
+};
+
+/* Benvenuto (se non ereditata da un handover), limiti e timer */
+void session_open(session_t *s, int fd, int resumed);
+
+/* Esegue una riga (senza "\n"); SESSION_CONTINUE o SESSION_CLOSE */
+int  session_line(session_t *s, char *line);
+
+/*
+ * Fine connessione: se s->dropped e la grazia lo consente la sessione
+ * resta staccata in attesa di RESUME, altrimenti cleanup completo.
+ */
+void session_close(session_t *s);
+
+/*
+ * Partita su cui agirà la riga: l'id esplicito di JOIN / ACCEPT /
+ * REJECT / WATCH, altrimenti la partita in corso; -1 se nessuna.
+ */
+int  session_match_of(const session_t *s, const char *line);
+
+/* Cleanup completo di una connessione chiusa o di una sessione scaduta */
+void session_drop(int fd);
+
+/* Ruota dei timer e nodi per slot client (prima di avviare l'I/O) */
+void session_timers_init(void);
+
+/* Thread dei lavori periodici: timer, coda partite, tornei, QUICKPLAY, sessioni scadute */
+void *session_housekeeping(void *arg);
+
+#endif /* SESSION_H */
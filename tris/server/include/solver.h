@@ -0,0 +1,46 @@
+#ifndef SOLVER_H
+#define SOLVER_H
+
+/* ================================================================== */
+/*  SOLVER.H  –  Tabella di gioco perfetto per il tris 3x3             */
+/* ================================================================== */
+
+/*
+ * Ogni board è codificata in base 3 (cella r*3+c, peso 3^cella;
+ * 0 = vuota, 1 = X, 2 = O): 3^9 = 19683 codici.  All'avvio
+ * solver_init() visita tutte le posizioni raggiungibili dalla board
+ * vuota (X muove per primo) e ne memorizza esito, valore minimax e
+ * mossa migliore: durante la partita ogni domanda costa una lettura.
+ */
+
+#define SOLVER_POSITIONS 19683
+
+typedef enum {
+    SOLVER_INVALID = 0,   /* codice non raggiungibile in una partita */
+    SOLVER_ONGOING = 1,
+    SOLVER_X_WINS  = 2,
+    SOLVER_O_WINS  = 3,
+    SOLVER_DRAW    = 4
+} solver_status_t;
+
+/* Costruisce la tabella (una sola volta, chiamabile da più thread) */
+void solver_init(void);
+
+/* Codice di una board 3x3 piatta (9 celle ' ', 'X', 'O') */
+int solver_encode(const char *cells);
+
+solver_status_t solver_status(int code);
+
+/* Valore per chi deve muovere: +1 vince, 0 patta, -1 perde */
+int solver_value(int code);
+
+/*
+ * Mossa migliore (cella 0..8) per chi deve muovere: vittoria più
+ * rapida, oppure sconfitta più lenta.  -1 se la partita è finita.
+ */
+int solver_best_move(int code);
+
+/* Mossa casuale tra le celle libere (livello "easy"), -1 se piena */
+int solver_random_move(int code, unsigned *seed);
+
+#endif /* SOLVER_H */
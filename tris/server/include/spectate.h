@@ -0,0 +1,85 @@
+#ifndef SPECTATE_H
+#define SPECTATE_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include "state.h"
+#include "match.h"
+
+/* ================================================================== */
+/*  SPECTATE.H  –  WATCH / UNWATCH con buffer condivisi                */
+/* ================================================================== */
+
+#define SPEC_OUT_QUEUE  64     /* buffer in attesa per spettatore */
+#define SPEC_PUB_QUEUE  256    /* eventi pubblicati non ancora smistati */
+
+/*
+ * Evento formattato una sola volta e condiviso (immutabile) fra tutti
+ * gli spettatori: ogni coda tiene un riferimento, l'ultimo lo libera.
+ */
+typedef struct {
+    atomic_int refs;
+    int        len;
+    char       data[];
+} evbuf_t;
+
+evbuf_t *evbuf_printf(const char *fmt, ...);
+void     evbuf_unref(evbuf_t *b);
+
+/*
+ * Il thread che gioca (MOVE/RESIGN) si limita a mettere l'evento nella
+ * coda di pubblicazione; lo smistamento alle code degli spettatori e
+ * gli invii (non bloccanti) li fa un thread dedicato, così anche
+ * molti spettatori non rallentano le mosse.  Uno spettatore
+ * troppo lento perde gli eventi più vecchi invece di frenare gli altri.
+ * Ogni buffer parte intero o resta in coda (net_send con dontwait è
+ * tutto o niente): le righe non si spezzano fra le risposte che il
+ * thread della connessione scrive sullo stesso socket.
+ */
+typedef struct {
+    evbuf_t *q[SPEC_OUT_QUEUE];
+    int      head, count;
+    int      busy;      /* invio in corso senza lock */
+} spec_out_t;
+
+typedef struct {
+    int      match_id;
+    int      close;     /* ultimo evento: poi gli spettatori vengono sganciati */
+    evbuf_t *buf;
+} spec_pub_t;
+
+typedef struct {
+    pthread_mutex_t mtx;
+    pthread_cond_t  cv;        /* nuove pubblicazioni */
+    pthread_cond_t  idle;      /* fine di un invio senza lock */
+
+    /*
+     * Indicizzate per slot client: gli spettatori sono client loggati,
+     * quindi al più MAX_CLIENTS in tutto (giocatori compresi).
+     */
+    int        watching[MAX_CLIENTS];   /* match id per slot client, 0 = nessuno */
+    int        fd[MAX_CLIENTS];
+    int        next[MAX_CLIENTS];       /* lista degli spettatori dello stesso match */
+    spec_out_t out[MAX_CLIENTS];
+
+    struct { int match_id; int head; } groups[MAX_MATCHES];
+
+    spec_pub_t pub[SPEC_PUB_QUEUE];
+    int        pub_head, pub_count;
+} spectators_t;
+
+void spectate_init(spectators_t *sp);
+int  spectate_start(spectators_t *sp);
+
+/* Ritorna 0, -1 client sconosciuto, -2 troppi match osservati */
+int  spectate_watch(spectators_t *sp, server_state_t *st, int fd, int match_id);
+/* Ritorna il match osservato prima, -1 se non osservava niente */
+int  spectate_unwatch(spectators_t *sp, server_state_t *st, int fd);
+
+/*
+ * Pubblica un evento per gli spettatori di match_id, cedendo il
+ * riferimento a buf.  Con close = 1 è l'ultimo evento della partita.
+ */
+void spectate_publish(spectators_t *sp, int match_id, evbuf_t *buf, int close);
+
+#endif /* SPECTATE_H */
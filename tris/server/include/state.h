@@ -2,28 +2,92 @@
 #define STATE_H
 
 #include <pthread.h>
+#include <stdint.h>
+#include <time.h>
 
 #define MAX_NAME    32
 #define MAX_CLIENTS 128
+#define TOKEN_LEN   32    /* token di sessione: 16 byte casuali in esadecimale */
 
+/*
+ * Prima i campi letti dalle scansioni sotto mtx (slot libero, RESUME,
+ * sessioni scadute): stanno nei primi 24 byte dello slot.
+ */
 typedef struct {
-    int  fd;
-    int  logged_in;
-    char name[MAX_NAME];
-    int  playing_match_id;
+    int    fd;
+    int    logged_in;
+    int    playing_match_id;
+    /*
+     * != 0: connessione caduta, slot tenuto in vita fino a questo istante
+     * in attesa di RESUME.  L'fd resta aperto (socket morto) in modo che il
+     * suo numero non venga riassegnato ad altre connessioni.
+     */
+    time_t detached_until;
+    char   name[MAX_NAME];
+    char   token[TOKEN_LEN + 1];
 } client_t;
 
+/*
+ * Indice hash a indirizzamento aperto (linear probing) sugli slot di
+ * clients[].  Le chiavi non sono copiate: si confrontano direttamente con
+ * clients[slot].name / .fd, l'hash memorizzato evita strcmp inutili.
+ */
+#define CLIENT_INDEX_SIZE 256   /* potenza di 2, almeno 2 * MAX_CLIENTS */
+
+typedef struct {
+    short    slot[CLIENT_INDEX_SIZE];   /* -1 = cella vuota */
+    unsigned hash[CLIENT_INDEX_SIZE];
+} client_index_t;
+
+/*
+ * Copia in sola lettura dei campi letti dalla lobby (nome, partita in
+ * corso) con i suoi indici.  Gli scrittori, sotto mtx, ne preparano una
+ * nuova a ogni login / logout / cambio di partita e la pubblicano; i
+ * lettori (USERS, nomi durante MOVE / RESIGN / LIST, broadcast) la
+ * leggono senza lock dentro una sezione epoch.h.  Le versioni sono
+ * STATE_ROSTER_VERSIONS, riusate quando nessun lettore le vede più.
+ *
+ * Struttura di array: il broadcast scorre solo fd[] e logged_in[]
+ * (10 righe di cache per 128 slot), i nomi si toccano solo per lo slot
+ * trovato.  Ogni versione inizia su una riga propria: lo scrittore che
+ * prepara la prossima non invalida quella che i lettori stanno usando.
+ */
+#define STATE_ROSTER_VERSIONS 4
+
+typedef struct {
+    _Alignas(64) int fd[MAX_CLIENTS];    /* 0 = slot libero */
+    unsigned char  logged_in[MAX_CLIENTS];
+    int            playing_match_id[MAX_CLIENTS];
+    char           name[MAX_CLIENTS][MAX_NAME];
+    client_index_t by_name;
+    client_index_t by_fd;
+} roster_t;
+
 typedef struct {
     pthread_mutex_t mtx;
     client_t clients[MAX_CLIENTS];
+    client_index_t by_name;   /* solo client loggati */
+    client_index_t by_fd;     /* tutti gli slot occupati */
+
+    roster_t       *roster;                            /* versione corrente */
+    roster_t        versions[STATE_ROSTER_VERSIONS];
+    uint64_t        retired[STATE_ROSTER_VERSIONS];    /* 0 = mai pubblicata */
 } server_state_t;
 
 void        state_init(server_state_t *st);
-void        state_add_client(server_state_t *st, int fd);
+/* Slot assegnato a fd, -1 se sono tutti occupati */
+int         state_add_client(server_state_t *st, int fd);
 void        state_remove_client(server_state_t *st, int fd);
 
 int         state_login(server_state_t *st, int fd, const char *name);
 const char *state_get_name(server_state_t *st, int fd);
+
+/* Torna non loggato senza chiudere (sessione inoltrata, lobby.h): 0 o -1 */
+int         state_logout(server_state_t *st, int fd);
+
+/* Letture senza lock sulla versione pubblicata (roster_t) */
+int         state_find_by_name(server_state_t *st, const char *name);
+int         state_slot_of(server_state_t *st, int fd);
 int         state_get_name_copy(server_state_t *st, int fd, char *buf, int bufsz);
 
 void        state_users(server_state_t *st, char *out, int outsz);
@@ -34,4 +98,27 @@ int         state_clear_playing_match(server_state_t *st, int fd);
 
 void        state_broadcast(server_state_t *st, const char *msg, int exclude_fd);
 
+/*
+ * Sessioni e riconnessione rapida.
+ *
+ * state_get_token_copy : copia il token generato da state_login.
+ * state_detach         : la connessione di fd è caduta; se loggato, lo
+ *                        slot resta riservato per grace_sec secondi.
+ *                        Ritorna 0 se staccato, -1 se va chiuso subito.
+ * state_resume         : riaggancia new_fd alla sessione staccata con quel
+ *                        token (dup2 sul vecchio numero di fd, lo slot di
+ *                        new_fd viene liberato).  Ritorna 0 e il vecchio fd
+ *                        in *fd_out, -1 se il token non è valido.
+ * state_reap_expired   : raccoglie (al massimo max) fd con grazia scaduta;
+ *                        il chiamante esegue il normale cleanup.
+ */
+int         state_get_token_copy(server_state_t *st, int fd, char *buf, int bufsz);
+int         state_detach(server_state_t *st, int fd, int grace_sec);
+int         state_resume(server_state_t *st, const char *token, int new_fd,
+                         int *fd_out, char *name_out, int name_sz);
+int         state_reap_expired(server_state_t *st, time_t now, int *fds_out, int max);
+
+/* Ricostruisce gli indici dopo aver sovrascritto clients[] (handover) */
+void        state_rebuild_index(server_state_t *st);
+
 #endif 
\ No newline at end of file
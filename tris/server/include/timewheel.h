@@ -0,0 +1,72 @@
+#ifndef TIMEWHEEL_H
+#define TIMEWHEEL_H
+
+#include <pthread.h>
+#include <stdint.h>
+
+/* ================================================================== */
+/*  TIMEWHEEL.H  –  Timer del server su una ruota a hash                */
+/* ================================================================== */
+
+/*
+ * Timing wheel a hash (Varghese & Lauck, schema 6): TW_SLOTS liste
+ * circolari, il timer che scade al tick t sta nella lista t % TW_SLOTS.
+ * Armare, riarmare e cancellare costano O(1); a ogni tick si visita una
+ * sola lista, che contiene in media armati / TW_SLOTS timer.
+ *
+ * I nodi sono intrusivi e preallocati da chi li usa (per slot client o
+ * per slot partita).  Ogni (ri)armo o cancellazione incrementa gen: un
+ * timer già estratto da tw_advance ma riarmato nel frattempo si
+ * riconosce con tw_is_current e va ignorato.
+ */
+
+#define TW_SLOTS         512
+#define TW_TICK_MS       100   /* un giro della ruota = 51,2 s */
+#define TW_TICKS_PER_SEC (1000 / TW_TICK_MS)
+
+typedef enum {
+    TW_IDLE = 0,    /* connessione inattiva: si chiude   (arg = fd)       */
+    TW_PING = 1,    /* heartbeat: il server manda PING   (arg = fd)       */
+    TW_TURN = 2     /* turno scaduto: si perde a tavolino (arg = match id) */
+} tw_kind_t;
+
+typedef struct tw_node {
+    struct tw_node *prev, *next;
+    uint64_t        expires;   /* tick assoluto */
+    unsigned        gen;
+    int             armed;
+    tw_kind_t       kind;
+    int             arg;
+} tw_node_t;
+
+typedef struct {
+    tw_node_t *node;
+    tw_kind_t  kind;
+    int        arg;
+    unsigned   gen;
+} tw_fired_t;
+
+typedef struct {
+    pthread_mutex_t mtx;
+    uint64_t        now;            /* ultimo tick elaborato */
+    int             armed;
+    tw_node_t       slot[TW_SLOTS]; /* sentinelle delle liste */
+} timewheel_t;
+
+void tw_init(timewheel_t *tw, uint64_t now);
+void tw_node_init(tw_node_t *n, tw_kind_t kind);
+
+/* Arma (o riarma) n dopo delay tick (minimo 1) con argomento arg */
+void tw_arm(timewheel_t *tw, tw_node_t *n, unsigned delay, int arg);
+void tw_cancel(timewheel_t *tw, tw_node_t *n);
+
+/*
+ * Elabora i tick fino a now e copia in out i timer scaduti (al più max),
+ * disarmandoli.  Se ritorna max ne restano altri: va richiamata.
+ */
+int  tw_advance(timewheel_t *tw, uint64_t now, tw_fired_t *out, int max);
+
+/* 1 se il timer estratto non è stato riarmato o cancellato dopo */
+int  tw_is_current(timewheel_t *tw, const tw_fired_t *f);
+
+#endif /* TIMEWHEEL_H */
@@ -0,0 +1,188 @@
+#ifndef TOURNAMENT_H
+#define TOURNAMENT_H
+
+#include <pthread.h>
+#include "state.h"
+#include "match.h"
+#include "rating.h"
+
+/* ================================================================== */
+/*  TOURNAMENT.H  –  Tornei: eliminazione diretta, svizzero, girone    */
+/* ================================================================== */
+
+/*
+ * TOURNAMENT CREATE <size> <formato> apre un torneo a iscrizione; chi
+ * lo crea è il primo iscritto.  Con size iscritti il torneo parte al
+ * tick successivo: tutte le partite di un turno partono insieme, in
+ * MATCH_PLAYING come QUICKPLAY, e il turno dopo parte quando sono
+ * finite tutte.
+ *
+ * Ogni turno prima prenota in match.h uno slot per partita e parte solo
+ * con tutti gli slot in mano, così non trova mai ERR MATCHES_FULL a
+ * metà.  Gli slot delle partite finite restano prenotati per il turno
+ * dopo.  I tornei prenotano in ordine di creazione: finché il primo non
+ * ha tutto il turno, gli altri aspettano (niente stallo fra due tornei
+ * con metà degli slot ciascuno).
+ *
+ * I risultati si leggono dai campi di MATCH_REMATCH delle partite del
+ * torneo (matches_collect_tour), a ogni tick dei lavori periodici.
+ *
+ * Formati:
+ *   single  eliminazione diretta, tabellone per rating all'avvio (il
+ *           primo incontra il secondo solo in finale), bye alle teste
+ *           di serie se gli iscritti non sono una potenza di 2.  Un
+ *           pareggio si rigioca a colori invertiti fino a TOUR_REPLAYS
+ *           volte, poi passa la testa di serie migliore.
+ *   swiss   ceil(log2 n) turni; si abbinano giocatori con lo stesso
+ *           punteggio che non si sono ancora incontrati, il bye (vale
+ *           una vittoria) va all'ultimo che non l'ha ancora avuto.
+ *   rr      girone all'italiana, metodo del cerchio: n-1 turni (n se
+ *           dispari, con un bye a testa che non vale punti).
+ *
+ * Punti: vittoria 2, pareggio 1 (in classifica 1 e 0.5).  Un iscritto
+ * che esce (TOURNAMENT LEAVE fuori partita, o disconnessione) perde a
+ * tavolino le partite non ancora giocate; chi si disconnette durante una
+ * partita del torneo la perde come per un abbandono.  Un eliminato
+ * (single) è libero di iscriversi a un altro torneo.
+ *
+ * Gli iscritti sono client di questo processo (niente lobby condivisa,
+ * niente handover): al più TOUR_MAX_SIZE, e un turno occupa al più
+ * TOUR_MAX_SIZE / 2 slot partita.
+ */
+
+#define TOUR_MAX        8              /* tornei contemporanei */
+#define TOUR_MAX_SIZE   MAX_CLIENTS    /* ogni iscritto è un client */
+#define TOUR_MAX_ROUNDS 16             /* turni svizzeri registrati per giocatore */
+#define TOUR_REPLAYS    2              /* ripetizioni di un pareggio a eliminazione */
+#define TOUR_EVENTS_MAX (4 * TOUR_MAX_SIZE)
+
+_Static_assert(TOUR_MAX_SIZE / 2 <= MAX_MATCHES, "un turno deve stare negli slot partita");
+
+typedef enum {
+    TOUR_SINGLE = 0,
+    TOUR_SWISS  = 1,
+    TOUR_RR     = 2
+} tour_format_t;
+
+typedef enum {
+    TOUR_FREE    = 0,
+    TOUR_OPEN    = 1,     /* iscrizioni aperte */
+    TOUR_RUNNING = 2,
+    TOUR_DONE    = 3      /* classifica ancora consultabile */
+} tour_status_t;
+
+typedef struct {
+    int  fd;               /* -1 = uscito o eliminato */
+    char name[MAX_NAME];
+    int  seed;             /* 0 = rating più alto all'avvio */
+    int  score;            /* mezzi punti: vittoria 2, pareggio 1 */
+    int  wins, draws, losses;
+    int  xs;               /* partite giocate come X */
+    int  byes;
+    int  nopp;
+    int  opp[TOUR_MAX_ROUNDS];   /* avversari già incontrati (swiss) */
+} tour_player_t;
+
+typedef enum {
+    PAIR_WAITING = 0,      /* in attesa di slot o di giocatori liberi */
+    PAIR_PLAYING = 1,
+    PAIR_DONE    = 2
+} tour_pair_state_t;
+
+/* Una partita del turno: x gioca X; o = -1 è un bye */
+typedef struct {
+    int               x, o;        /* indici in players[] */
+    int               x_fd, o_fd;  /* fd all'avvio della partita */
+    tour_pair_state_t state;
+    int               match_id;
+    int               replays;
+    int               winner;      /* indice, -1 = nessuno / pareggio */
+} tour_pair_t;
+
+typedef struct {
+    int           id;
+    tour_status_t status;
+    tour_format_t format;
+    int           size;
+    int           round, rounds;   /* round da 1 */
+    int           started;         /* partite del turno avviate (slot tutti in mano) */
+    int           reserved;        /* slot prenotati in match.h */
+    int           nplayers;
+    tour_player_t players[TOUR_MAX_SIZE];
+    int           npairs;
+    tour_pair_t   pairs[TOUR_MAX_SIZE / 2];
+    int           bracket[TOUR_MAX_SIZE];   /* single: posizioni del turno, -1 = vuota */
+    int           blen;
+} tour_t;
+
+typedef struct {
+    pthread_mutex_t mtx;
+    int             next_id;
+    int             running;       /* tornei OPEN o RUNNING */
+    tour_t          tours[TOUR_MAX];
+} tour_registry_t;
+
+/*
+ * Cosa annunciare dopo tour_tick, fuori dai lock (session.c):
+ *   TOUR_EV_ROUND : a fd, il turno round di arg è iniziato
+ *   TOUR_EV_MATCH : partita match_id avviata, fd = X, fd2 = O
+ *   TOUR_EV_BYE   : a fd, passa il turno senza giocare
+ *   TOUR_EV_OUT   : a fd, eliminato (single)
+ *   TOUR_EV_END   : a tutti, torneo finito, name = vincitore ("-" se nessuno)
+ */
+typedef enum {
+    TOUR_EV_ROUND,
+    TOUR_EV_MATCH,
+    TOUR_EV_BYE,
+    TOUR_EV_OUT,
+    TOUR_EV_END
+} tour_ev_kind_t;
+
+typedef struct {
+    tour_ev_kind_t kind;
+    int            tour;
+    int            round;
+    int            arg;
+    int            fd, fd2;
+    int            match_id;
+    char           name[MAX_NAME];
+} tour_event_t;
+
+void tour_init(tour_registry_t *tr);
+
+/* Formato da "single" / "swiss" / "rr", -1 se sconosciuto */
+int  tour_format_parse(const char *s);
+const char *tour_format_name(tour_format_t f);
+
+/*
+ * Ritorna l'id del torneo (fd è il primo iscritto), -1 registro pieno,
+ * -2 dimensione non valida, -3 fd già iscritto a un torneo.
+ */
+int  tour_create(tour_registry_t *tr, int fd, const char *name,
+                 int size, tour_format_t format);
+
+/*
+ * 0 iscritto (*count_out iscritti finora su *size_out), -1 torneo non
+ * trovato, -2 iscrizioni chiuse, -3 fd già iscritto a un torneo.
+ */
+int  tour_join(tour_registry_t *tr, int id, int fd, const char *name,
+               int *count_out, int *size_out);
+
+/* fd lascia il suo torneo: id del torneo, -1 se non era iscritto */
+int  tour_leave(tour_registry_t *tr, int fd);
+
+/* Elenco dei tornei, NO_TOURNAMENTS se vuoto */
+void tour_list(tour_registry_t *tr, char *out, int outsz);
+
+/* Classifica del torneo id; -1 se non esiste */
+int  tour_standings(tour_registry_t *tr, int id, char *out, int outsz);
+
+/*
+ * Dal thread dei lavori periodici: raccoglie i risultati, prenota gli
+ * slot, avvia turni e partite.  Scrive in out al massimo max eventi
+ * (almeno TOUR_EVENTS_MAX) e ne ritorna il numero.
+ */
+int  tour_tick(tour_registry_t *tr, match_store_t *ms, server_state_t *st,
+               rating_store_t *rs, tour_event_t *out, int max);
+
+#endif /* TOURNAMENT_H */
@@ -0,0 +1,132 @@
+#include "admission.h"
+#include "net.h"
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#define ADM_EWMA_SHIFT 2   /* peso 1/4 alla misura nuova */
+
+static uint64_t now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
+
+static adm_entry_t *at(adm_queue_t *q, int i) {
+    return &q->q[(q->head + i) % ADM_SLOTS];
+}
+
+void adm_init(adm_queue_t *q, int cap, uint32_t default_gap_ms) {
+    pthread_mutex_init(&q->mtx, NULL);
+    q->head    = 0;
+    q->len     = 0;
+    q->cap     = (cap > 0 && cap <= ADM_MAX) ? cap : ADM_MAX;
+    q->gap_ms  = default_gap_ms;
+    q->busy_ms = 0;
+}
+
+int adm_push(adm_queue_t *q, const adm_entry_t *e) {
+    pthread_mutex_lock(&q->mtx);
+    if (q->len == q->cap) {
+        pthread_mutex_unlock(&q->mtx);
+        return -1;
+    }
+    if (q->len == 0) q->busy_ms = now_ms();
+    *at(q, q->len) = *e;
+    int pos = ++q->len;
+    pthread_mutex_unlock(&q->mtx);
+    return pos;
+}
+
+void adm_push_front(adm_queue_t *q, const adm_entry_t *e) {
+    pthread_mutex_lock(&q->mtx);
+    /* Può superare cap di uno: c'è sempre lo slot di riserva */
+    q->head = (q->head + ADM_SLOTS - 1) % ADM_SLOTS;
+    q->q[q->head] = *e;
+    q->len++;
+    pthread_mutex_unlock(&q->mtx);
+}
+
+int adm_pop(adm_queue_t *q, adm_entry_t *out) {
+    pthread_mutex_lock(&q->mtx);
+    if (q->len == 0) {
+        pthread_mutex_unlock(&q->mtx);
+        return -1;
+    }
+    *out    = q->q[q->head];
+    q->head = (q->head + 1) % ADM_SLOTS;
+    q->len--;
+    pthread_mutex_unlock(&q->mtx);
+    return 0;
+}
+
+void adm_served(adm_queue_t *q) {
+    pthread_mutex_lock(&q->mtx);
+    uint64_t now = now_ms();
+    uint64_t gap = now - q->busy_ms;
+    if (gap > UINT32_MAX) gap = UINT32_MAX;
+    q->gap_ms  = q->gap_ms - (q->gap_ms >> ADM_EWMA_SHIFT) + ((uint32_t)gap >> ADM_EWMA_SHIFT);
+    q->busy_ms = now;
+    pthread_mutex_unlock(&q->mtx);
+}
+
+int adm_remove_fd(adm_queue_t *q, int fd, adm_entry_t *out, int max) {
+    int n = 0, kept = 0;
+    pthread_mutex_lock(&q->mtx);
+    for (int i = 0; i < q->len; i++) {
+        adm_entry_t *e = at(q, i);
+        if (e->fd == fd || e->fd2 == fd) {
+            if (n < max) out[n++] = *e;
+            continue;
+        }
+        *at(q, kept++) = *e;
+    }
+    q->len = kept;
+    pthread_mutex_unlock(&q->mtx);
+    return n;
+}
+
+int adm_position(adm_queue_t *q, int fd) {
+    int pos = 0;
+    pthread_mutex_lock(&q->mtx);
+    for (int i = 0; i < q->len; i++) {
+        const adm_entry_t *e = at(q, i);
+        if (e->fd == fd || e->fd2 == fd) { pos = i + 1; break; }
+    }
+    pthread_mutex_unlock(&q->mtx);
+    return pos;
+}
+
+int adm_len(adm_queue_t *q) {
+    pthread_mutex_lock(&q->mtx);
+    int n = q->len;
+    pthread_mutex_unlock(&q->mtx);
+    return n;
+}
+
+int adm_eta(adm_queue_t *q, int pos) {
+    pthread_mutex_lock(&q->mtx);
+    uint64_t ms = (uint64_t)q->gap_ms * (uint64_t)pos;
+    pthread_mutex_unlock(&q->mtx);
+    return (int)((ms + 999) / 1000);
+}
+
+int adm_snapshot(adm_queue_t *q, adm_entry_t *out, int max) {
+    pthread_mutex_lock(&q->mtx);
+    int n = q->len < max ? q->len : max;
+    for (int i = 0; i < n; i++) out[i] = *at(q, i);
+    pthread_mutex_unlock(&q->mtx);
+    return n;
+}
+
+void adm_announce(adm_queue_t *q, const char *fmt) {
+    adm_entry_t w[ADM_SLOTS];
+    int n = adm_snapshot(q, w, ADM_SLOTS);
+    for (int i = 0; i < n; i++) {
+        char msg[64];
+        int  len = snprintf(msg, sizeof(msg), fmt, i + 1, adm_eta(q, i + 1));
+        /* Senza attendere: chi aspetta in coda può non leggere */
+        net_send(w[i].fd, msg, (size_t)len, 1);
+        if (w[i].fd2 >= 0) net_send(w[i].fd2, msg, (size_t)len, 1);
+    }
+}
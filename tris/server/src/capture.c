@@ -0,0 +1,94 @@
+#include "capture.h"
+#include "log.h"
+#include <fcntl.h>
+#include <pthread.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+static pthread_mutex_t g_mtx = PTHREAD_MUTEX_INITIALIZER;
+static int             g_fd  = -1;
+static uint32_t        g_next_conn;
+static uint64_t        g_t0;
+static char            g_buf[CAP_BUF];
+static size_t          g_len;
+
+static uint64_t mono_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+/* Con g_mtx preso */
+static void out_write(void) {
+    size_t off = 0;
+    while (off < g_len) {
+        ssize_t n = write(g_fd, g_buf + off, g_len - off);
+        if (n <= 0) {
+            LOG_ERRNO(LOG_SYS_MAIN, "capture write");
+            break;
+        }
+        off += (size_t)n;
+    }
+    g_len = 0;
+}
+
+/* Con g_mtx preso */
+static void put(uint32_t conn, cap_kind_t kind, const char *data, size_t len) {
+    cap_rec_t r = { mono_ns() - g_t0, conn, (uint16_t)len, (uint16_t)kind };
+    if (CAP_BUF - g_len < sizeof(r) + len) out_write();
+    memcpy(g_buf + g_len, &r, sizeof(r));
+    if (len) memcpy(g_buf + g_len + sizeof(r), data, len);
+    g_len += sizeof(r) + len;
+}
+
+/* ------------------------------------------------------------------ */
+/*  API                                                                 */
+/* ------------------------------------------------------------------ */
+
+int capture_start(const char *path) {
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (fd < 0) return -1;
+
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    cap_header_t h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, CAP_MAGIC, sizeof(h.magic));
+    h.start_ns = (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+    if (write(fd, &h, sizeof(h)) != (ssize_t)sizeof(h)) {
+        close(fd);
+        return -1;
+    }
+
+    pthread_mutex_lock(&g_mtx);
+    g_fd = fd;
+    g_t0 = mono_ns();
+    pthread_mutex_unlock(&g_mtx);
+    return 0;
+}
+
+uint32_t capture_conn(void) {
+    if (__atomic_load_n(&g_fd, __ATOMIC_RELAXED) < 0) return 0;
+    return __atomic_add_fetch(&g_next_conn, 1, __ATOMIC_RELAXED);
+}
+
+void capture_line(uint32_t conn, const char *line) {
+    size_t len = strlen(line);
+    if (len > CAP_BUF - sizeof(cap_rec_t)) len = CAP_BUF - sizeof(cap_rec_t);
+    pthread_mutex_lock(&g_mtx);
+    put(conn, CAP_LINE, line, len);
+    pthread_mutex_unlock(&g_mtx);
+}
+
+void capture_close(uint32_t conn) {
+    pthread_mutex_lock(&g_mtx);
+    put(conn, CAP_CLOSE, NULL, 0);
+    pthread_mutex_unlock(&g_mtx);
+}
+
+void capture_flush(void) {
+    pthread_mutex_lock(&g_mtx);
+    if (g_fd >= 0 && g_len) out_write();
+    pthread_mutex_unlock(&g_mtx);
+}
@@ -0,0 +1,157 @@
+#include "core.h"
+#include "server.h"
+#include "session.h"
+#include "solver.h"
+#include "mux.h"
+#include "log.h"
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+
+#define RATINGS_SAVE_SEC  5
+
+server_state_t g_state;
+match_store_t  g_matches;
+matchmaker_t   g_queue;
+rating_store_t g_ratings;
+spectators_t   g_spect;
+timewheel_t    g_wheel;
+tour_registry_t g_tours;
+
+int g_grace_sec = DEFAULT_GRACE_SEC;
+int g_idle_sec  = DEFAULT_IDLE_SEC;   /* 0 = nessun limite */
+int g_ping_sec  = 0;                  /* 0 = nessun heartbeat */
+int g_turn_sec  = 0;                  /* 0 = nessun limite di turno */
+
+struct core_player {
+    pthread_mutex_t mtx;      /* invii al sink */
+    pthread_mutex_t run;      /* core_command contro la chiusura per inattività */
+    int             used;
+    int             closed;   /* chiuso dal motore: sessione finita, handle ancora da rilasciare */
+    core_sink_t     sink;
+    void           *ctx;
+    session_t       s;
+};
+
+static pthread_mutex_t g_mtx = PTHREAD_MUTEX_INITIALIZER;   /* allocazione */
+static core_player_t   g_players[CORE_MAX_PLAYERS];
+
+static ssize_t core_send(int fd, const void *buf, size_t len, int dontwait) {
+    (void)dontwait;
+    core_player_t *p = &g_players[fd - CORE_VFD_BASE];
+    pthread_mutex_lock(&p->mtx);
+    int used = p->used && !p->closed;
+    if (used) p->sink(p->ctx, buf, len);
+    pthread_mutex_unlock(&p->mtx);
+    if (!used) { errno = EPIPE; return -1; }
+    return (ssize_t)len;
+}
+
+static void release(core_player_t *p) {
+    pthread_mutex_lock(&p->mtx);
+    p->used = 0;
+    pthread_mutex_unlock(&p->mtx);
+}
+
+/*
+ * Timer di inattività (net_shutdown), dal thread di housekeeping: la
+ * sessione si chiude subito, l'handle resta all'ospite finché
+ * core_command non ritorna 1 o non chiama core_disconnect.
+ */
+static void core_shut(int fd) {
+    core_player_t *p = &g_players[fd - CORE_VFD_BASE];
+    pthread_mutex_lock(&p->run);
+    if (p->used && !p->closed) {
+        p->s.dropped = 0;
+        session_close(&p->s);
+        pthread_mutex_lock(&p->mtx);
+        p->closed = 1;
+        pthread_mutex_unlock(&p->mtx);
+    }
+    pthread_mutex_unlock(&p->run);
+}
+
+/* ------------------------------------------------------------------ */
+/*  Avvio                                                               */
+/* ------------------------------------------------------------------ */
+
+int core_init(const char *ratings_path, int band) {
+    state_init(&g_state);
+    rating_init(&g_ratings, ratings_path);
+    matches_init(&g_matches, &g_ratings);
+    matchmaker_init(&g_queue, band);
+    tour_init(&g_tours);
+    solver_init();
+    session_timers_init();
+    mux_init();
+    for (int i = 0; i < CORE_MAX_PLAYERS; i++) {
+        pthread_mutex_init(&g_players[i].mtx, NULL);
+        pthread_mutex_init(&g_players[i].run, NULL);
+    }
+    net_add_virtual(CORE_VFD_BASE, CORE_MAX_PLAYERS, core_send, core_shut);
+    spectate_init(&g_spect);
+    return spectate_start(&g_spect);
+}
+
+int core_start(void) {
+    matches_set_turn_timer(&g_matches, &g_wheel, g_turn_sec);
+
+    /* Dopo un handover il file contiene i rating salvati dal predecessore */
+    int nrat = rating_load(&g_ratings);
+    if (nrat < 0)
+        fprintf(stderr, "File rating %s illeggibile, si riparte da zero.\n", g_ratings.path);
+    else if (nrat > 0)
+        LOG(LOG_INFO, LOG_SYS_RATING, "Rating caricati: %ld giocatori.", nrat);
+    if (rating_start_autosave(&g_ratings, RATINGS_SAVE_SEC) < 0)
+        return -1;
+
+    pthread_t hk;
+    if (pthread_create(&hk, NULL, session_housekeeping, NULL) != 0) return -1;
+    pthread_detach(hk);
+    return 0;
+}
+
+/* ------------------------------------------------------------------ */
+/*  Giocatori                                                           */
+/* ------------------------------------------------------------------ */
+
+core_player_t *core_connect(core_sink_t sink, void *ctx) {
+    core_player_t *p = NULL;
+    pthread_mutex_lock(&g_mtx);
+    for (int i = 0; i < CORE_MAX_PLAYERS && !p; i++) {
+        if (g_players[i].used) continue;
+        if (state_add_client(&g_state, CORE_VFD_BASE + i) < 0) break;
+        p = &g_players[i];
+        pthread_mutex_lock(&p->mtx);
+        p->sink   = sink;
+        p->ctx    = ctx;
+        p->used   = 1;
+        p->closed = 0;
+        pthread_mutex_unlock(&p->mtx);
+    }
+    pthread_mutex_unlock(&g_mtx);
+    if (p) session_open(&p->s, CORE_VFD_BASE + (int)(p - g_players), 0);
+    return p;
+}
+
+int core_command(core_player_t *p, const char *line) {
+    char buf[MAX_LINE];
+    snprintf(buf, sizeof(buf), "%s", line);
+    pthread_mutex_lock(&p->run);
+    int done = p->closed || session_line(&p->s, buf) == SESSION_CLOSE;
+    if (done && !p->closed) session_close(&p->s);
+    pthread_mutex_unlock(&p->run);
+    if (done) release(p);
+    return done;
+}
+
+void core_disconnect(core_player_t *p) {
+    pthread_mutex_lock(&p->run);
+    if (!p->closed) {
+        p->s.dropped = 0;
+        session_close(&p->s);
+    }
+    pthread_mutex_unlock(&p->run);
+    release(p);
+}
@@ -0,0 +1,89 @@
+#include "epoch.h"
+#include <pthread.h>
+#include <stdatomic.h>
+
+/*
+ * Tutti gli accessi sono seq_cst: il lettore pubblica la sua epoca prima
+ * di caricare il puntatore, lo scrittore sostituisce il puntatore prima
+ * di avanzare l'epoca e di guardare i lettori.  Quindi o lo scrittore
+ * vede il lettore dentro, o il lettore vede già la versione nuova.
+ */
+
+typedef struct {
+    _Alignas(64) atomic_uint_fast64_t active;   /* 0 = fuori */
+    atomic_int                        used;     /* di un thread vivo */
+} epoch_rec_t;
+
+/*
+ * I record si prendono con un CAS su used fino a g_nrecs, che cresce
+ * solo quando sono tutti presi; all'uscita del thread la chiave li
+ * rende a chi arriva dopo.
+ */
+static epoch_rec_t          g_recs[EPOCH_MAX_READERS];
+static atomic_int           g_nrecs;
+static pthread_key_t        g_key;
+static pthread_once_t       g_key_once = PTHREAD_ONCE_INIT;
+static atomic_uint_fast64_t g_epoch    = 1;
+static atomic_int           g_overflow;          /* lettori senza record */
+
+static _Thread_local epoch_rec_t *t_rec;
+static _Thread_local int          t_depth;
+static _Thread_local int          t_no_rec;
+
+static void rec_release(void *p) {
+    epoch_rec_t *r = p;
+    atomic_store(&r->active, 0);
+    atomic_store(&r->used, 0);
+}
+
+static void key_init(void) {
+    pthread_key_create(&g_key, rec_release);
+}
+
+static epoch_rec_t *rec_claim(void) {
+    pthread_once(&g_key_once, key_init);
+    int n = atomic_load(&g_nrecs);
+    while (1) {
+        for (int i = 0; i < n; i++) {
+            int free_ = 0;
+            if (atomic_compare_exchange_strong(&g_recs[i].used, &free_, 1)) {
+                pthread_setspecific(g_key, &g_recs[i]);
+                return &g_recs[i];
+            }
+        }
+        if (n == EPOCH_MAX_READERS) return NULL;
+        atomic_compare_exchange_strong(&g_nrecs, &n, n + 1);
+        n = atomic_load(&g_nrecs);
+    }
+}
+
+void epoch_enter(void) {
+    if (t_depth++ > 0) return;
+
+    if (!t_rec && !t_no_rec) {
+        t_rec    = rec_claim();
+        t_no_rec = !t_rec;
+    }
+    if (t_rec) atomic_store(&t_rec->active, atomic_load(&g_epoch));
+    else       atomic_fetch_add(&g_overflow, 1);
+}
+
+void epoch_exit(void) {
+    if (--t_depth > 0) return;
+    if (t_rec) atomic_store(&t_rec->active, 0);
+    else       atomic_fetch_sub(&g_overflow, 1);
+}
+
+uint64_t epoch_retire(void) {
+    return atomic_fetch_add(&g_epoch, 1);
+}
+
+int epoch_safe(uint64_t e) {
+    if (atomic_load(&g_overflow) > 0) return 0;
+    int n = atomic_load(&g_nrecs);
+    for (int i = 0; i < n; i++) {
+        uint64_t a = atomic_load(&g_recs[i].active);
+        if (a != 0 && a <= e) return 0;
+    }
+    return 1;
+}
@@ -0,0 +1,419 @@
+#define _GNU_SOURCE
+#include "handover.h"
+#include "net.h"
+#include "log.h"
+#include "capture.h"
+#include "session.h"
+#include "mux.h"
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#define HO_MAGIC        0x5452484fu   /* "TRHO" */
+#define HO_VERSION      3   /* 3: socket di ascolto UNIX (-U) */
+#define HO_FDS_PER_MSG  64            /* ben sotto SCM_MAX_FD (253) */
+#define HO_CHUNK        4096
+
+/*
+ * Si usa SOCK_SEQPACKET: i confini dei messaggi sono preservati, quindi
+ * ogni blocco di fd viaggia insieme ai numeri originali nel payload e
+ * il ricevente legge i messaggi esattamente come sono stati inviati.
+ */
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t client_sz;
+    uint32_t match_sz;
+    uint32_t match_hot_sz;
+    uint32_t max_clients;
+    uint32_t max_matches;
+    uint32_t mm_sz;
+} ho_hello_t;
+
+typedef struct {
+    ho_hello_t hello;
+    int32_t    next_id;
+    int32_t    mm_head, mm_tail, mm_count;
+    int32_t    nfds;      /* listen_fd [+ local_fd] + fd dei client; -1 = rifiutato */
+    int32_t    has_local; /* il secondo fd è local_fd */
+} ho_header_t;
+
+typedef struct {
+    int            lfd;
+    handover_ctx_t ctx;
+} ho_listener_t;
+
+static ho_listener_t g_ho;
+
+/* ------------------------------------------------------------------ */
+/*  Helpers interni                                                     */
+/* ------------------------------------------------------------------ */
+
+static void hello_fill(ho_hello_t *h) {
+    memset(h, 0, sizeof(*h));
+    h->magic       = HO_MAGIC;
+    h->version     = HO_VERSION;
+    h->client_sz   = sizeof(client_t);
+    h->match_sz    = sizeof(match_t);
+    h->match_hot_sz = sizeof(match_hot_t);
+    h->max_clients = MAX_CLIENTS;
+    h->max_matches = MAX_MATCHES;
+    h->mm_sz       = sizeof(mm_entry_t);
+}
+
+static int hello_compatible(const ho_hello_t *h) {
+    ho_hello_t mine;
+    hello_fill(&mine);
+    return memcmp(h, &mine, sizeof(mine)) == 0;
+}
+
+static int make_addr(const char *path, struct sockaddr_un *addr) {
+    if (strlen(path) >= sizeof(addr->sun_path)) return -1;
+    memset(addr, 0, sizeof(*addr));
+    addr->sun_family = AF_UNIX;
+    strcpy(addr->sun_path, path);
+    return 0;
+}
+
+static int send_blob(int sock, const void *data, size_t len) {
+    const char *p = data;
+    while (len > 0) {
+        size_t n = len < HO_CHUNK ? len : HO_CHUNK;
+        if (send(sock, p, n, MSG_NOSIGNAL) != (ssize_t)n) return -1;
+        p   += n;
+        len -= n;
+    }
+    return 0;
+}
+
+static int recv_blob(int sock, void *data, size_t len) {
+    char *p = data;
+    while (len > 0) {
+        size_t n = len < HO_CHUNK ? len : HO_CHUNK;
+        if (recv(sock, p, n, 0) != (ssize_t)n) return -1;
+        p   += n;
+        len -= n;
+    }
+    return 0;
+}
+
+static int send_fds(int sock, const int *fds, int n) {
+    char cbuf[CMSG_SPACE(sizeof(int) * HO_FDS_PER_MSG)];
+    struct iovec  iov = { (void *)fds, sizeof(int) * (size_t)n };
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    memset(cbuf, 0, sizeof(cbuf));
+    msg.msg_iov        = &iov;
+    msg.msg_iovlen     = 1;
+    msg.msg_control    = cbuf;
+    msg.msg_controllen = CMSG_SPACE(sizeof(int) * (size_t)n);
+
+    struct cmsghdr *cm = CMSG_FIRSTHDR(&msg);
+    cm->cmsg_level = SOL_SOCKET;
+    cm->cmsg_type  = SCM_RIGHTS;
+    cm->cmsg_len   = CMSG_LEN(sizeof(int) * (size_t)n);
+    memcpy(CMSG_DATA(cm), fds, sizeof(int) * (size_t)n);
+
+    return sendmsg(sock, &msg, MSG_NOSIGNAL) == (ssize_t)iov.iov_len ? 0 : -1;
+}
+
+/* Riceve n fd: old_out = numeri nel vecchio processo, new_out = nuovi fd */
+static int recv_fds(int sock, int *old_out, int *new_out, int n) {
+    char cbuf[CMSG_SPACE(sizeof(int) * HO_FDS_PER_MSG)];
+    struct iovec  iov = { old_out, sizeof(int) * (size_t)n };
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov        = &iov;
+    msg.msg_iovlen     = 1;
+    msg.msg_control    = cbuf;
+    msg.msg_controllen = sizeof(cbuf);
+
+    if (recvmsg(sock, &msg, MSG_CMSG_CLOEXEC) != (ssize_t)iov.iov_len) return -1;
+    if (msg.msg_flags & (MSG_CTRUNC | MSG_TRUNC)) return -1;
+
+    struct cmsghdr *cm = CMSG_FIRSTHDR(&msg);
+    if (!cm || cm->cmsg_level != SOL_SOCKET || cm->cmsg_type != SCM_RIGHTS ||
+        cm->cmsg_len != CMSG_LEN(sizeof(int) * (size_t)n))
+        return -1;
+    memcpy(new_out, CMSG_DATA(cm), sizeof(int) * (size_t)n);
+    return 0;
+}
+
+static int remap_fd(int fd, const int *old_fds, const int *new_fds, int n) {
+    if (fd <= 0) return fd;
+    for (int i = 1; i < n; i++)
+        if (old_fds[i] == fd) return new_fds[i];
+    return -1;
+}
+
+/* Come remap_fd, ma gli fd virtuali restano: il successore li chiude */
+static int remap_keep_virtual(int fd, const int *old_fds, const int *new_fds, int n) {
+    return fd >= NET_VFD_BASE ? fd : remap_fd(fd, old_fds, new_fds, n);
+}
+
+/* ------------------------------------------------------------------ */
+/*  Lato vecchio processo                                               */
+/* ------------------------------------------------------------------ */
+
+/*
+ * Invia tutto al successore.  Chiamata con tutti i lock presi (ordine
+ * ms -> mm -> st, compatibile con il resto del server), così nessun
+ * comando può modificare lo stato tra lo snapshot e l'uscita del processo.
+ */
+static int handover_send(int c, server_state_t *st, match_store_t *ms,
+                         matchmaker_t *mm, spectators_t *sp, int listen_fd, int local_fd) {
+    int fds[MAX_CLIENTS + 2];
+    int nfds = 0;
+    fds[nfds++] = listen_fd;
+    if (local_fd >= 0) fds[nfds++] = local_fd;
+    /* Le sessioni virtuali della lobby non hanno un socket da passare */
+    for (int i = 0; i < MAX_CLIENTS; i++)
+        if (st->clients[i].fd != 0 && st->clients[i].fd < NET_VFD_BASE)
+            fds[nfds++] = st->clients[i].fd;
+
+    ho_header_t hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    hello_fill(&hdr.hello);
+    hdr.next_id   = ms->next_id;
+    hdr.mm_head   = mm->head;
+    hdr.mm_tail   = mm->tail;
+    hdr.mm_count  = mm->count;
+    hdr.nfds      = nfds;
+    hdr.has_local = local_fd >= 0;
+    if (send(c, &hdr, sizeof(hdr), MSG_NOSIGNAL) != (ssize_t)sizeof(hdr)) return -1;
+
+    for (int off = 0; off < nfds; off += HO_FDS_PER_MSG) {
+        int n = nfds - off < HO_FDS_PER_MSG ? nfds - off : HO_FDS_PER_MSG;
+        if (send_fds(c, fds + off, n) < 0) return -1;
+    }
+
+    if (send_blob(c, st->clients, sizeof(st->clients)) < 0) return -1;
+    if (send_blob(c, ms->hot, sizeof(ms->hot)) < 0) return -1;
+    if (send_blob(c, ms->matches, sizeof(ms->matches)) < 0) return -1;
+    if (send_blob(c, mm->entries, sizeof(mm->entries)) < 0) return -1;
+    if (send_blob(c, sp->watching, sizeof(sp->watching)) < 0) return -1;
+    return 0;
+}
+
+static void *handover_thread(void *arg) {
+    ho_listener_t  *hl  = arg;
+    handover_ctx_t *ctx = &hl->ctx;
+
+    while (1) {
+        int c = accept(hl->lfd, NULL, NULL);
+        if (c < 0) {
+            if (errno == EINTR) continue;
+            LOG_ERRNO(LOG_SYS_HANDOVER, "handover accept");
+            return NULL;
+        }
+
+        /* Solo processi dello stesso utente possono prendere gli fd */
+        struct ucred cred;
+        socklen_t    clen = sizeof(cred);
+        if (getsockopt(c, SOL_SOCKET, SO_PEERCRED, &cred, &clen) < 0 ||
+            cred.uid != getuid()) {
+            close(c);
+            continue;
+        }
+
+        ho_hello_t hello;
+        if (recv(c, &hello, sizeof(hello), 0) != (ssize_t)sizeof(hello)) {
+            close(c);
+            continue;
+        }
+        if (!hello_compatible(&hello)) {
+            ho_header_t nak;
+            memset(&nak, 0, sizeof(nak));
+            hello_fill(&nak.hello);
+            nak.nfds = -1;
+            send(c, &nak, sizeof(nak), MSG_NOSIGNAL);
+            close(c);
+            LOG(LOG_WARN, LOG_SYS_HANDOVER, "Handover rifiutato: snapshot incompatibile");
+            continue;
+        }
+
+        /* Le connessioni MUX non sopravvivono: si chiudono prima dello snapshot */
+        mux_handover();
+
+        pthread_mutex_lock(&ctx->ms->mtx);
+        pthread_mutex_lock(&ctx->mm->mtx);
+        /* Ultimo salvataggio: il successore carica il file appena esce */
+        if (ctx->rs) {
+            rating_pause_autosave(ctx->rs, 1);
+            rating_save(ctx->rs);
+        }
+        pthread_mutex_lock(&ctx->sp->mtx);
+        pthread_mutex_lock(&ctx->st->mtx);
+
+        if (handover_send(c, ctx->st, ctx->ms, ctx->mm, ctx->sp, ctx->listen_fd,
+                           ctx->local_fd) == 0) {
+            LOG(LOG_INFO, LOG_SYS_HANDOVER, "Handover completato, uscita.");
+            log_flush();
+            capture_flush();
+            fflush(stdout);
+            /* Niente close(): gli fd restano vivi nel successore */
+            _exit(0);
+        }
+
+        pthread_mutex_unlock(&ctx->st->mtx);
+        pthread_mutex_unlock(&ctx->sp->mtx);
+        pthread_mutex_unlock(&ctx->mm->mtx);
+        pthread_mutex_unlock(&ctx->ms->mtx);
+        if (ctx->rs) rating_pause_autosave(ctx->rs, 0);
+        LOG_ERRNO(LOG_SYS_HANDOVER, "handover send");
+        close(c);
+    }
+}
+
+int handover_listen(const char *path, const handover_ctx_t *ctx) {
+    struct sockaddr_un addr;
+    if (make_addr(path, &addr) < 0) return -1;
+
+    int lfd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if (lfd < 0) return -1;
+
+    unlink(path);
+    mode_t old_mask = umask(077);
+    int rc = bind(lfd, (struct sockaddr *)&addr, sizeof(addr));
+    umask(old_mask);
+    if (rc < 0 || listen(lfd, 1) < 0) { close(lfd); return -1; }
+
+    g_ho.lfd = lfd;
+    g_ho.ctx = *ctx;
+
+    pthread_t tid;
+    if (pthread_create(&tid, NULL, handover_thread, &g_ho) != 0) {
+        close(lfd);
+        unlink(path);
+        return -1;
+    }
+    pthread_detach(tid);
+    return 0;
+}
+
+/* ------------------------------------------------------------------ */
+/*  Lato nuovo processo                                                 */
+/* ------------------------------------------------------------------ */
+
+int handover_takeover(const char *path, handover_ctx_t *ctx) {
+    server_state_t *st = ctx->st;
+    match_store_t  *ms = ctx->ms;
+    matchmaker_t   *mm = ctx->mm;
+
+    struct sockaddr_un addr;
+    if (make_addr(path, &addr) < 0) return -1;
+
+    int s = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if (s < 0) return -1;
+    if (connect(s, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        int e = errno;
+        close(s);
+        return (e == ENOENT || e == ECONNREFUSED) ? 1 : -1;
+    }
+
+    ho_hello_t hello;
+    hello_fill(&hello);
+    ho_header_t hdr;
+    if (send(s, &hello, sizeof(hello), MSG_NOSIGNAL) != (ssize_t)sizeof(hello) ||
+        recv(s, &hdr, sizeof(hdr), 0) != (ssize_t)sizeof(hdr) ||
+        !hello_compatible(&hdr.hello) ||
+        hdr.nfds < 1 + hdr.has_local || hdr.nfds > MAX_CLIENTS + 2) {
+        LOG(LOG_ERROR, LOG_SYS_HANDOVER, "Handover: processo precedente incompatibile");
+        close(s);
+        return -1;
+    }
+
+    int old_fds[MAX_CLIENTS + 2];
+    int new_fds[MAX_CLIENTS + 2];
+    for (int off = 0; off < hdr.nfds; off += HO_FDS_PER_MSG) {
+        int n = hdr.nfds - off < HO_FDS_PER_MSG ? hdr.nfds - off : HO_FDS_PER_MSG;
+        if (recv_fds(s, old_fds + off, new_fds + off, n) < 0) {
+            for (int i = 0; i < off; i++) close(new_fds[i]);
+            close(s);
+            return -1;
+        }
+    }
+
+    static client_t clients[MAX_CLIENTS];
+    static match_hot_t hot[MAX_MATCHES];
+    static match_t  matches[MAX_MATCHES];
+    static mm_entry_t entries[MAX_CLIENTS];
+    static int        watching[MAX_CLIENTS];
+    char eof;
+    if (recv_blob(s, clients, sizeof(clients)) < 0 ||
+        recv_blob(s, hot, sizeof(hot)) < 0 ||
+        recv_blob(s, matches, sizeof(matches)) < 0 ||
+        recv_blob(s, entries, sizeof(entries)) < 0 ||
+        recv_blob(s, watching, sizeof(watching)) < 0 ||
+        recv(s, &eof, 1, 0) != 0) {   /* il vecchio processo è uscito */
+        for (int i = 0; i < hdr.nfds; i++) close(new_fds[i]);
+        close(s);
+        return -1;
+    }
+    close(s);
+
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        client_t *c = &clients[i];
+        c->fd = remap_keep_virtual(c->fd, old_fds, new_fds, hdr.nfds);
+        if (c->fd < 0) {
+            memset(c, 0, sizeof(*c));
+            c->playing_match_id = -1;
+        }
+    }
+    for (int i = 0; i < MAX_MATCHES; i++) {
+        match_hot_t *h = &hot[i];
+        match_t     *m = &matches[i];
+        h->owner_fd   = remap_keep_virtual(h->owner_fd,   old_fds, new_fds, hdr.nfds);
+        h->joiner_fd  = remap_keep_virtual(h->joiner_fd,  old_fds, new_fds, hdr.nfds);
+        h->pending_fd = remap_keep_virtual(h->pending_fd, old_fds, new_fds, hdr.nfds);
+        m->winner_fd  = remap_keep_virtual(m->winner_fd,  old_fds, new_fds, hdr.nfds);
+        m->loser_fd   = remap_keep_virtual(m->loser_fd,   old_fds, new_fds, hdr.nfds);
+    }
+    /* La coda è indicizzata per slot client: gli slot non cambiano */
+    for (int i = 0; i < MAX_CLIENTS; i++)
+        if (entries[i].queued)
+            entries[i].fd = remap_keep_virtual(entries[i].fd, old_fds, new_fds, hdr.nfds);
+
+    pthread_mutex_lock(&ms->mtx);
+    pthread_mutex_lock(&mm->mtx);
+    pthread_mutex_lock(&st->mtx);
+    memcpy(st->clients, clients, sizeof(clients));
+    memcpy(ms->hot, hot, sizeof(hot));
+    memcpy(ms->matches, matches, sizeof(matches));
+    memcpy(mm->entries, entries, sizeof(entries));
+    ms->next_id = hdr.next_id;
+    mm->head    = hdr.mm_head;
+    mm->tail    = hdr.mm_tail;
+    mm->count   = hdr.mm_count;
+    pthread_mutex_unlock(&st->mtx);
+    pthread_mutex_unlock(&mm->mtx);
+    pthread_mutex_unlock(&ms->mtx);
+    state_rebuild_index(st);
+    matches_rebuild_index(ms);
+
+    /*
+     * Le sessioni virtuali (inoltri della lobby, sid MUX) non hanno un
+     * socket da passare: arrivano nello snapshot con il loro fd e si
+     * chiudono qui come disconnessioni, così le loro partite non restano
+     * con un giocatore fantasma (l'avversario vince a tavolino, una JOIN
+     * in sospeso riceve MATCH_CLOSED, lo slot si libera).
+     */
+    for (int i = 0; i < MAX_CLIENTS; i++)
+        if (st->clients[i].fd >= NET_VFD_BASE) session_drop(st->clients[i].fd);
+
+    /* Spettatori: si ricostruiscono i gruppi con le normali WATCH */
+    for (int i = 0; i < MAX_CLIENTS; i++)
+        if (watching[i] && st->clients[i].fd > 0)
+            spectate_watch(ctx->sp, st, st->clients[i].fd, watching[i]);
+
+    ctx->listen_fd = new_fds[0];
+    ctx->local_fd  = hdr.has_local ? new_fds[1] : -1;
+    return 0;
+}
@@ -0,0 +1,168 @@
+#include "io.h"
+#include "server.h"
+#include "admission.h"
+#include "net.h"
+#include "protocol.h"
+#include "log.h"
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <limits.h>
+#include <pthread.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+#define IO_ADMIT_QUEUE   64       /* connessioni in attesa di uno slot */
+#define IO_ADMIT_GAP_MS  10000    /* stima iniziale fra due ammissioni */
+#define IO_ADMIT_POLL_MS 100
+
+static const io_backend_t *const g_backends[] = { &io_threaded, &io_epoll, &io_uring };
+
+static adm_queue_t         g_admit;
+static const io_backend_t *g_admit_be;
+
+int io_spawn(void *(*fn)(void *), void *arg, size_t stack_size) {
+    pthread_attr_t attr;
+    pthread_t      tid;
+
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    if (stack_size > 0) {
+        if (stack_size < PTHREAD_STACK_MIN) stack_size = PTHREAD_STACK_MIN;
+        pthread_attr_setstacksize(&attr, stack_size);
+    }
+    int rc = pthread_create(&tid, &attr, fn, arg);
+    pthread_attr_destroy(&attr);
+    return rc == 0 ? 0 : -1;
+}
+
+const io_backend_t *io_find(const char *name) {
+    for (size_t i = 0; i < sizeof(g_backends) / sizeof(g_backends[0]); i++)
+        if (strcmp(g_backends[i]->name, name) == 0) return g_backends[i];
+    return NULL;
+}
+
+/* ------------------------------------------------------------------ */
+/*  Coda di ammissione: connessioni accettate con il server pieno       */
+/* ------------------------------------------------------------------ */
+
+/* Il client se n'è andato mentre aspettava? */
+static int peer_gone(int fd) {
+    char c;
+    ssize_t n = recv(fd, &c, 1, MSG_PEEK | MSG_DONTWAIT);
+    return n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR);
+}
+
+static void admit(const io_backend_t *be, int fd) {
+    if (be->adopt(fd, 0) < 0) {
+        close(fd);
+        state_remove_client(&g_state, fd);
+    }
+}
+
+void io_accepted(const io_backend_t *be, int fd) {
+    if (state_add_client(&g_state, fd) >= 0) {
+        admit(be, fd);
+        return;
+    }
+    adm_entry_t e = { fd, -1, 0, 0, 0, 0 };
+    int pos = adm_push(&g_admit, &e);
+    if (pos < 0) {
+        net_send(fd, PROTO_ERR_SERVER_FULL, strlen(PROTO_ERR_SERVER_FULL), 1);
+        close(fd);
+        return;
+    }
+    LOG(LOG_WARN, LOG_SYS_IO, "Server pieno: fd=%ld in coda (posizione %ld)", fd, pos);
+    char msg[64];
+    int  len = snprintf(msg, sizeof(msg), PROTO_EVENT_ADMISSION, pos, adm_eta(&g_admit, pos));
+    net_send(fd, msg, (size_t)len, 1);
+}
+
+static void *admit_main(void *arg) {
+    (void)arg;
+    for (unsigned tick = 1; ; tick++) {
+        usleep(IO_ADMIT_POLL_MS * 1000);
+        if (adm_len(&g_admit) == 0) continue;
+
+        int         moved = 0;
+        adm_entry_t e;
+        while (adm_pop(&g_admit, &e) == 0) {
+            if (peer_gone(e.fd)) {
+                close(e.fd);
+                moved = 1;
+                continue;
+            }
+            if (state_add_client(&g_state, e.fd) < 0) {
+                adm_push_front(&g_admit, &e);
+                break;
+            }
+            adm_served(&g_admit);
+            LOG(LOG_INFO, LOG_SYS_IO, "Client ammesso dalla coda (fd=%ld)", e.fd);
+            admit(g_admit_be, e.fd);
+            moved = 1;
+        }
+
+        /* Una volta al secondo si tolgono quelli che hanno rinunciato */
+        if (tick % (1000 / IO_ADMIT_POLL_MS) == 0) {
+            adm_entry_t w[ADM_SLOTS];
+            int n = adm_snapshot(&g_admit, w, ADM_SLOTS);
+            for (int i = 0; i < n; i++) {
+                if (!peer_gone(w[i].fd)) continue;
+                adm_remove_fd(&g_admit, w[i].fd, &e, 1);
+                close(w[i].fd);
+                moved = 1;
+            }
+        }
+        if (moved) adm_announce(&g_admit, PROTO_EVENT_ADMISSION);
+    }
+    return NULL;
+}
+
+/* ------------------------------------------------------------------ */
+/*  Accept                                                              */
+/* ------------------------------------------------------------------ */
+
+static int g_local_fd = -1;
+
+static void *local_main(void *arg) {
+    const io_backend_t *be = arg;
+    while (1) {
+        int client_fd = accept(g_local_fd, NULL, NULL);
+        if (client_fd < 0) { LOG_ERRNO(LOG_SYS_IO, "accept locale"); continue; }
+
+        LOG(LOG_INFO, LOG_SYS_IO, "Client connesso sul socket locale (fd=%ld)", client_fd);
+        io_accepted(be, client_fd);
+    }
+    return NULL;
+}
+
+void io_serve(const io_backend_t *be, int listen_fd, int local_fd) {
+    adm_init(&g_admit, IO_ADMIT_QUEUE, IO_ADMIT_GAP_MS);
+    g_admit_be = be;
+    if (io_spawn(admit_main, NULL, 0) < 0)
+        LOG_ERRNO(LOG_SYS_IO, "admit_main");
+
+    g_local_fd = local_fd;
+    if (local_fd >= 0 && io_spawn(local_main, (void *)be, 0) < 0)
+        LOG_ERRNO(LOG_SYS_IO, "local_main");
+
+    if (be->serve) {
+        be->serve(listen_fd);
+        return;
+    }
+    while (1) {
+        struct sockaddr_in client_addr;
+        socklen_t clen = sizeof(client_addr);
+        int client_fd = accept(listen_fd, (struct sockaddr *)&client_addr, &clen);
+        if (client_fd < 0) { LOG_ERRNO(LOG_SYS_IO, "accept"); continue; }
+
+        char ip[INET_ADDRSTRLEN];
+        inet_ntop(AF_INET, &client_addr.sin_addr, ip, sizeof(ip));
+        LOGS(LOG_INFO, LOG_SYS_IO, ip, "Client connesso: %s:%ld (fd=%ld)",
+             ntohs(client_addr.sin_port), client_fd);
+
+        io_accepted(be, client_fd);
+    }
+}
@@ -0,0 +1,145 @@
+#include "io.h"
+#include "io_pool.h"
+#include "log.h"
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+
+/*
+ * Thread di I/O: ognuno ha un epoll (level-triggered) e una parte delle
+ * connessioni; legge con MSG_DONTWAIT nel buffer della connessione e
+ * la passa ai worker di io_pool.
+ *
+ * I socket restano bloccanti: le risposte partono con send_all come nel
+ * backend a thread.  Un client che non legge blocca il worker che lo
+ * serve, non un thread di I/O.
+ */
+
+#define EP_MAX_IO     4
+#define EP_EVENTS     64
+
+static int      g_epfd[EP_MAX_IO];
+static int      g_nio;
+static unsigned g_next_io;
+static int      g_conn_epfd[IO_MAX_CONNS];   /* epoll che serve ogni connessione */
+
+static int conn_watch(io_conn_t *c, int op, int fd, uint32_t events) {
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events   = events;
+    ev.data.u64 = io_conn_tag(c);
+    return epoll_ctl(g_conn_epfd[io_conn_index(c)], op, fd, &ev);
+}
+
+/* c->mtx tenuto */
+static void conn_read(io_conn_t *c) {
+    while (1) {
+        size_t room = io_conn_room(c);
+        if (room == 0) {
+            /* Worker in ritardo: si smette di leggere finché non consuma */
+            if (conn_watch(c, EPOLL_CTL_MOD, c->s.fd, 0) == 0) c->paused = 1;
+            return;
+        }
+        ssize_t n = recv(c->s.fd, c->rx + c->rxlen, room, MSG_DONTWAIT);
+        if (n > 0) {
+            c->rxlen += (size_t)n;
+            c->rx[c->rxlen] = '\0';
+            continue;
+        }
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return;
+        if (n < 0) LOG_ERRNO(LOG_SYS_IO, "recv");
+        epoll_ctl(g_conn_epfd[io_conn_index(c)], EPOLL_CTL_DEL, c->s.fd, NULL);
+        c->eof = 1;
+        return;
+    }
+}
+
+static void *io_main(void *arg) {
+    int epfd = *(int *)arg;
+    struct epoll_event ev[EP_EVENTS];
+
+    while (1) {
+        int n = epoll_wait(epfd, ev, EP_EVENTS, -1);
+        if (n < 0) {
+            if (errno != EINTR) LOG_ERRNO(LOG_SYS_IO, "epoll_wait");
+            continue;
+        }
+        for (int i = 0; i < n; i++) {
+            io_conn_t *c = io_conn_lock_tag(ev[i].data.u64);
+            if (!c) continue;
+            if (!c->eof) {
+                conn_read(c);
+                io_conn_kick(c);
+            }
+            pthread_mutex_unlock(&c->mtx);
+        }
+    }
+    return NULL;
+}
+
+/* ------------------------------------------------------------------ */
+/*  Backend                                                             */
+/* ------------------------------------------------------------------ */
+
+static void epoll_resume(io_conn_t *c) {
+    if (conn_watch(c, EPOLL_CTL_MOD, c->s.fd, EPOLLIN) == 0)
+        c->paused = 0;
+}
+
+static const io_pool_ops_t epoll_ops = { epoll_resume, NULL, NULL };
+
+static void epoll_rebind(session_t *s, int new_fd) {
+    io_conn_t *c = s->io;
+    pthread_mutex_lock(&c->mtx);
+    epoll_ctl(g_conn_epfd[io_conn_index(c)], EPOLL_CTL_DEL, s->fd, NULL);
+    s->fd = new_fd;
+    if (conn_watch(c, EPOLL_CTL_ADD, new_fd, c->paused ? 0 : EPOLLIN) < 0) {
+        LOG_ERRNO(LOG_SYS_IO, "epoll_ctl");
+        c->eof = 1;   /* il worker chiude dopo la riga corrente */
+    }
+    pthread_mutex_unlock(&c->mtx);
+}
+
+static int epoll_start(const io_opts_t *o) {
+    for (int i = 0; i < EP_MAX_IO; i++) {
+        g_epfd[i] = epoll_create1(EPOLL_CLOEXEC);
+        if (g_epfd[i] < 0) return -1;
+    }
+    int workers = io_pool_start(o, &epoll_ops);
+    if (workers < 0) return -1;
+
+    g_nio = (workers + 3) / 4;
+    if (g_nio > EP_MAX_IO) g_nio = EP_MAX_IO;
+    for (int i = 0; i < g_nio; i++)
+        if (io_spawn(io_main, &g_epfd[i], o->stack_size) < 0) return -1;
+    LOG(LOG_INFO, LOG_SYS_IO, "I/O epoll: %ld thread di I/O, %ld worker.", g_nio, workers);
+    return 0;
+}
+
+static int epoll_adopt(int client_fd, int resumed) {
+    io_conn_t *c = io_conn_alloc();
+    if (!c) {
+        LOG(LOG_WARN, LOG_SYS_IO, "epoll: troppe connessioni (fd=%ld)", client_fd);
+        return -1;
+    }
+
+    /* c->mtx tenuto fino a sessione pronta: il primo evento aspetta */
+    unsigned io = __atomic_fetch_add(&g_next_io, 1, __ATOMIC_RELAXED) % (unsigned)g_nio;
+    g_conn_epfd[io_conn_index(c)] = g_epfd[io];
+    if (conn_watch(c, EPOLL_CTL_ADD, client_fd, EPOLLIN) < 0) {
+        LOG_ERRNO(LOG_SYS_IO, "epoll_ctl");
+        io_conn_abort(c);
+        return -1;
+    }
+    session_open(&c->s, client_fd, resumed);
+    c->s.rebind = epoll_rebind;
+    c->s.io     = c;
+    pthread_mutex_unlock(&c->mtx);
+    return 0;
+}
+
+const io_backend_t io_epoll = { "epoll", &io_threaded, epoll_start, epoll_adopt, NULL };
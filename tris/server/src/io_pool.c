@@ -0,0 +1,195 @@
+#include "io_pool.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+typedef struct {
+    pthread_mutex_t mtx;
+    pthread_cond_t  cv;
+    io_conn_t      *q[IO_MAX_CONNS];   /* ogni connessione è in al più una coda */
+    int             head;
+    int             len;
+} io_worker_t;
+
+static io_conn_t            g_conns[IO_MAX_CONNS];
+static pthread_mutex_t      g_conns_mtx = PTHREAD_MUTEX_INITIALIZER;
+static io_worker_t         *g_workers;
+static int                  g_nworkers;
+static const io_pool_ops_t *g_ops;
+
+/* ------------------------------------------------------------------ */
+/*  Pool delle connessioni                                              */
+/* ------------------------------------------------------------------ */
+
+int io_conn_index(const io_conn_t *c) {
+    return (int)(c - g_conns);
+}
+
+uint64_t io_conn_tag(const io_conn_t *c) {
+    return ((uint64_t)c->gen << 32) | (uint64_t)io_conn_index(c);
+}
+
+io_conn_t *io_conn_lock_tag(uint64_t tag) {
+    uint32_t idx = (uint32_t)tag;
+    if (idx >= IO_MAX_CONNS) return NULL;
+    io_conn_t *c = &g_conns[idx];
+    pthread_mutex_lock(&c->mtx);
+    if (c->used && c->gen == (uint32_t)((tag >> 32) & IO_GEN_MASK)) return c;
+    pthread_mutex_unlock(&c->mtx);
+    return NULL;
+}
+
+io_conn_t *io_conn_alloc(void) {
+    pthread_mutex_lock(&g_conns_mtx);
+    for (int i = 0; i < IO_MAX_CONNS; i++) {
+        io_conn_t *c = &g_conns[i];
+        if (c->used) continue;
+        c->used = 1;
+        pthread_mutex_unlock(&g_conns_mtx);
+        pthread_mutex_lock(&c->mtx);
+        return c;
+    }
+    pthread_mutex_unlock(&g_conns_mtx);
+    return NULL;
+}
+
+/* c->mtx tenuto */
+static void conn_release(io_conn_t *c) {
+    if (g_ops->release) g_ops->release(c);
+    c->gen     = (c->gen + 1) & IO_GEN_MASK;
+    c->rxlen   = 0;
+    c->queued  = c->paused = c->eof = c->closing = 0;
+    pthread_mutex_lock(&g_conns_mtx);
+    c->used = 0;
+    pthread_mutex_unlock(&g_conns_mtx);
+}
+
+void io_conn_abort(io_conn_t *c) {
+    conn_release(c);
+    pthread_mutex_unlock(&c->mtx);
+}
+
+static int has_line(const io_conn_t *c) {
+    return memchr(c->rx, '\n', c->rxlen) != NULL;
+}
+
+size_t io_conn_room(io_conn_t *c) {
+    if (c->rxlen == IO_RXBUF - 1 && !has_line(c))
+        c->rxlen = 0;   /* riga troppo lunga: scartata */
+    return IO_RXBUF - 1 - c->rxlen;
+}
+
+/* ------------------------------------------------------------------ */
+/*  Code dei worker                                                     */
+/* ------------------------------------------------------------------ */
+
+/* Worker della prossima riga: per partita se c'è, altrimenti per slot */
+static int shard_of(const io_conn_t *c) {
+    int mid = session_match_of(&c->s, c->rx);
+    if (mid > 0) return mid % g_nworkers;
+    return (c->s.slot >= 0 ? c->s.slot : c->s.fd) % g_nworkers;
+}
+
+/* c->mtx tenuto, c->queued già a 1 */
+static void enqueue(io_conn_t *c) {
+    io_worker_t *w = &g_workers[shard_of(c)];
+    pthread_mutex_lock(&w->mtx);
+    w->q[(w->head + w->len) % IO_MAX_CONNS] = c;
+    w->len++;
+    pthread_cond_signal(&w->cv);
+    pthread_mutex_unlock(&w->mtx);
+}
+
+static io_conn_t *dequeue(io_worker_t *w) {
+    pthread_mutex_lock(&w->mtx);
+    while (w->len == 0)
+        pthread_cond_wait(&w->cv, &w->mtx);
+    io_conn_t *c = w->q[w->head];
+    w->head = (w->head + 1) % IO_MAX_CONNS;
+    w->len--;
+    pthread_mutex_unlock(&w->mtx);
+    return c;
+}
+
+void io_conn_kick(io_conn_t *c) {
+    if (c->queued) return;
+    if (c->eof || (!c->closing && has_line(c))) {
+        c->queued = 1;
+        enqueue(c);
+    }
+}
+
+/* ------------------------------------------------------------------ */
+/*  Worker                                                              */
+/* ------------------------------------------------------------------ */
+
+static void *worker_main(void *arg) {
+    io_worker_t *w = arg;
+    char line[MAX_LINE];
+
+    while (1) {
+        io_conn_t *c = dequeue(w);
+
+        pthread_mutex_lock(&c->mtx);
+        int have = !c->closing && net_pop_line(c->rx, &c->rxlen, line, sizeof(line));
+        if (c->paused && !c->eof) g_ops->resume(c);
+        pthread_mutex_unlock(&c->mtx);
+
+        if (have && session_line(&c->s, line) == SESSION_CLOSE) {
+            pthread_mutex_lock(&c->mtx);
+            c->closing = 1;
+            pthread_mutex_unlock(&c->mtx);
+            /* Il backend vedrà la fine del flusso */
+            if (g_ops->drain) g_ops->drain(c);
+            shutdown(c->s.fd, SHUT_RDWR);
+        }
+
+        pthread_mutex_lock(&c->mtx);
+        if (!c->closing && has_line(c)) {
+            enqueue(c);
+            pthread_mutex_unlock(&c->mtx);
+            continue;
+        }
+        if (!c->eof) {
+            c->queued = 0;
+            pthread_mutex_unlock(&c->mtx);
+            continue;
+        }
+        pthread_mutex_unlock(&c->mtx);
+
+        /* Nessun evento in arrivo e non in coda: la connessione è solo nostra */
+        if (g_ops->drain) g_ops->drain(c);
+        c->s.dropped = !c->closing;
+        session_close(&c->s);
+
+        pthread_mutex_lock(&c->mtx);
+        conn_release(c);
+        pthread_mutex_unlock(&c->mtx);
+    }
+    return NULL;
+}
+
+int io_pool_start(const io_opts_t *o, const io_pool_ops_t *ops) {
+    int workers = o->workers;
+    if (workers <= 0) {
+        long n = sysconf(_SC_NPROCESSORS_ONLN);
+        workers = (n > 0) ? (int)n : 1;
+    }
+    g_ops = ops;
+
+    for (int i = 0; i < IO_MAX_CONNS; i++)
+        pthread_mutex_init(&g_conns[i].mtx, NULL);
+
+    g_workers = calloc((size_t)workers, sizeof(*g_workers));
+    if (!g_workers) return -1;
+    for (int i = 0; i < workers; i++) {
+        pthread_mutex_init(&g_workers[i].mtx, NULL);
+        pthread_cond_init(&g_workers[i].cv, NULL);
+    }
+    g_nworkers = workers;
+    for (int i = 0; i < workers; i++)
+        if (io_spawn(worker_main, &g_workers[i], o->stack_size) < 0) return -1;
+    return workers;
+}
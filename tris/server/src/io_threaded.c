@@ -0,0 +1,123 @@
+#include "io.h"
+#include "net.h"
+#include "session.h"
+#include "log.h"
+#include <stdio.h>
+#include <pthread.h>
+
+/*
+ * I thread dei client sono pre-avviati con uno stack piccolo e, finita
+ * una connessione, tornano ad aspettare la successiva invece di
+ * terminare.  Se al momento dell'accept non c'è un thread libero se ne
+ * avvia un altro, fino a TH_MAX_THREADS; oltre, la connessione aspetta
+ * in coda il primo thread che si libera.
+ */
+
+#define TH_DEFAULT_PRESPAWN 16
+#define TH_MAX_THREADS      (MAX_CLIENTS + 16)
+#define TH_QUEUE            MAX_CLIENTS
+
+typedef struct {
+    int fd;
+    int resumed;   /* 1 = connessione ereditata da un handover */
+} client_job_t;
+
+static struct {
+    client_job_t    q[TH_QUEUE];
+    int             head;
+    int             len;
+    int             threads;     /* avviati */
+    int             idle;        /* in attesa di una connessione */
+    size_t          stack_size;
+} g_th;
+static pthread_mutex_t g_th_mtx = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  g_th_cv  = PTHREAD_COND_INITIALIZER;
+
+/* ------------------------------------------------------------------ */
+/*  Una connessione, dall'inizio alla fine                              */
+/* ------------------------------------------------------------------ */
+static void serve_client(const client_job_t *job) {
+    session_t s;
+    char      line[MAX_LINE];
+
+    session_open(&s, job->fd, job->resumed);
+
+    while (1) {
+        int r = recv_line(s.fd, line, sizeof(line));
+        if (r == 0) { s.dropped = 1; break; }
+        if (r < 0) { LOG_ERRNO(LOG_SYS_IO, "recv_line"); s.dropped = 1; break; }
+        if (session_line(&s, line) == SESSION_CLOSE) break;
+    }
+
+    session_close(&s);
+}
+
+static void *client_thread(void *arg) {
+    (void)arg;
+    pthread_mutex_lock(&g_th_mtx);
+    while (1) {
+        g_th.idle++;
+        while (g_th.len == 0)
+            pthread_cond_wait(&g_th_cv, &g_th_mtx);
+        g_th.idle--;
+
+        client_job_t job = g_th.q[g_th.head];
+        g_th.head = (g_th.head + 1) % TH_QUEUE;
+        g_th.len--;
+        pthread_mutex_unlock(&g_th_mtx);
+
+        serve_client(&job);
+
+        pthread_mutex_lock(&g_th_mtx);
+    }
+    return NULL;
+}
+
+/* g_th_mtx tenuto */
+static int spawn_locked(void) {
+    if (g_th.threads >= TH_MAX_THREADS) return -1;
+    if (io_spawn(client_thread, NULL, g_th.stack_size) < 0) return -1;
+    g_th.threads++;
+    return 0;
+}
+
+static int threaded_start(const io_opts_t *o) {
+    int n = o->workers > 0 ? o->workers : TH_DEFAULT_PRESPAWN;
+    if (n > TH_MAX_THREADS) n = TH_MAX_THREADS;
+
+    pthread_mutex_lock(&g_th_mtx);
+    g_th.stack_size = o->stack_size;
+    for (int i = 0; i < n; i++) {
+        if (spawn_locked() < 0) {
+            pthread_mutex_unlock(&g_th_mtx);
+            return -1;
+        }
+    }
+    pthread_mutex_unlock(&g_th_mtx);
+    LOG(LOG_INFO, LOG_SYS_IO, "I/O threaded: %ld thread pre-avviati (max %ld), stack %ld KB.",
+        n, TH_MAX_THREADS, (long)(o->stack_size / 1024));
+    return 0;
+}
+
+static int threaded_adopt(int client_fd, int resumed) {
+    pthread_mutex_lock(&g_th_mtx);
+    if (g_th.len == TH_QUEUE) {
+        pthread_mutex_unlock(&g_th_mtx);
+        LOG(LOG_WARN, LOG_SYS_IO, "threaded: coda piena (fd=%ld)", client_fd);
+        return -1;
+    }
+    g_th.q[(g_th.head + g_th.len) % TH_QUEUE] = (client_job_t){ client_fd, resumed };
+    g_th.len++;
+    /* Nessun thread libero per questa connessione: se ne avvia un altro */
+    if (g_th.len > g_th.idle && spawn_locked() < 0 && g_th.threads == 0) {
+        g_th.len--;
+        pthread_mutex_unlock(&g_th_mtx);
+        LOG_ERRNO(LOG_SYS_IO, "pthread_create");
+        return -1;
+    }
+    pthread_cond_signal(&g_th_cv);
+    pthread_mutex_unlock(&g_th_mtx);
+    return 0;
+}
+
+const io_backend_t io_threaded = { "threaded", NULL, threaded_start, threaded_adopt, NULL };
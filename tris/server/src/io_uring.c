@@ -0,0 +1,528 @@
+#include "io.h"
+#include "io_pool.h"
+#include "server.h"
+#include "log.h"
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <linux/io_uring.h>
+#include <netinet/in.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+
+/*
+ * Un solo thread (quello di main, in serve) possiede l'anello: accept
+ * multishot sul socket di ascolto, una recv per connessione con buffer
+ * scelto dal kernel in un anello di buffer forniti, send dai buffer di
+ * uscita delle connessioni.  A ogni giro tutte le SQE preparate partono
+ * con una sola io_uring_enter, che attende anche i completamenti.
+ *
+ * Le righe vanno ai worker di io_pool come con epoll.  Le risposte non
+ * toccano il socket: net_send (net.h) le copia nel buffer di uscita e
+ * segnala la connessione al thread dell'anello tramite un eventfd; chi
+ * trova il buffer pieno aspetta come farebbe una send bloccante.
+ *
+ * Niente liburing: bastano le tre syscall e gli mmap dell'ABI.  Il
+ * supporto si verifica registrando l'anello di buffer (kernel 5.19,
+ * come l'accept multishot); se manca start fallisce e main ripiega.
+ */
+
+#define UR_ENTRIES     512
+#define UR_BUFS        256          /* buffer forniti (potenza di 2) */
+#define UR_BUFSZ       1024
+#define UR_BGID        1
+#define UR_TXBUF       (16 * 1024)
+#define UR_MAX_FD      4096
+#define UR_DRAIN_SEC   5
+
+/* Tipo di operazione nei 4 bit alti di user_data, il resto è il tag */
+#define UR_OP_SHIFT    60
+#define UR_ACCEPT      1ULL
+#define UR_RECV        2ULL
+#define UR_SEND        3ULL
+#define UR_WAKE        4ULL
+
+typedef struct {
+    _Alignas(64) pthread_cond_t cv;   /* spazio libero o buffer svuotato */
+    char           buf[UR_TXBUF];
+    size_t         len;
+    size_t         inflight;    /* byte in testa a buf con una send in corso */
+    int            dead;        /* send fallita: i dati successivi si scartano */
+    int            writer;      /* un invio copiato a metà aspetta spazio */
+    int            recv_armed;
+    int            recv_fd;     /* fd con cui sono partite la recv e la send in corso */
+    int            send_fd;
+    int            cancel;      /* RESUME ha cambiato fd: annullare la recv in corso */
+    int            woken;       /* in g_wake */
+} ur_conn_t;
+
+static struct {
+    int                  fd;
+    unsigned             sq_entries;
+    unsigned            *sq_head, *sq_tail, *sq_mask, *sq_array;
+    struct io_uring_sqe *sqes;
+    unsigned             sq_local;     /* coda locale, pubblicata alla submit */
+    unsigned             pending;      /* SQE non ancora passate al kernel */
+    unsigned            *cq_head, *cq_tail, *cq_mask;
+    struct io_uring_cqe *cqes;
+
+    struct io_uring_buf_ring *br;
+    unsigned                  br_tail;
+    char                     *bufs;
+
+    int                  efd;
+    uint64_t             ebuf;
+} g_ring;
+
+static ur_conn_t        g_ur[IO_MAX_CONNS];
+static io_conn_t       *g_fdmap[UR_MAX_FD];
+
+/* Connessioni da servire al prossimo giro (flush, recv da riarmare) */
+static pthread_mutex_t  g_wake_mtx = PTHREAD_MUTEX_INITIALIZER;
+static uint64_t         g_wake[IO_MAX_CONNS];
+static int              g_nwake;
+
+/* ------------------------------------------------------------------ */
+/*  Anello                                                              */
+/* ------------------------------------------------------------------ */
+
+static int ring_enter(unsigned submit, unsigned wait, unsigned flags) {
+    return (int)syscall(__NR_io_uring_enter, g_ring.fd, submit, wait, flags, NULL, 0);
+}
+
+static void ring_publish(void) {
+    __atomic_store_n(g_ring.sq_tail, g_ring.sq_local, __ATOMIC_RELEASE);
+}
+
+static struct io_uring_sqe *sqe_get(void) {
+    while (g_ring.sq_local - __atomic_load_n(g_ring.sq_head, __ATOMIC_ACQUIRE)
+           >= g_ring.sq_entries) {
+        /* SQ piena: si consegna quanto preparato finora */
+        ring_publish();
+        int n = ring_enter(g_ring.pending, 0, 0);
+        if (n > 0) g_ring.pending -= (unsigned)n;
+    }
+    unsigned idx = g_ring.sq_local & *g_ring.sq_mask;
+    struct io_uring_sqe *sqe = &g_ring.sqes[idx];
+    memset(sqe, 0, sizeof(*sqe));
+    g_ring.sq_array[idx] = idx;
+    g_ring.sq_local++;
+    g_ring.pending++;
+    return sqe;
+}
+
+static void buf_recycle(unsigned bid) {
+    struct io_uring_buf *b = &g_ring.br->bufs[g_ring.br_tail & (UR_BUFS - 1)];
+    b->addr = (uint64_t)(uintptr_t)(g_ring.bufs + (size_t)bid * UR_BUFSZ);
+    b->len  = UR_BUFSZ;
+    b->bid  = (uint16_t)bid;
+    g_ring.br_tail++;
+    __atomic_store_n(&g_ring.br->tail, (uint16_t)g_ring.br_tail, __ATOMIC_RELEASE);
+}
+
+static int ring_setup(void) {
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    g_ring.fd = (int)syscall(__NR_io_uring_setup, UR_ENTRIES, &p);
+    if (g_ring.fd < 0) return -1;
+
+    size_t sq_sz = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    size_t cq_sz = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        if (cq_sz > sq_sz) sq_sz = cq_sz;
+        cq_sz = sq_sz;
+    }
+    char *sq = mmap(NULL, sq_sz, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                    g_ring.fd, IORING_OFF_SQ_RING);
+    if (sq == MAP_FAILED) return -1;
+    char *cq = sq;
+    if (!(p.features & IORING_FEAT_SINGLE_MMAP)) {
+        cq = mmap(NULL, cq_sz, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                  g_ring.fd, IORING_OFF_CQ_RING);
+        if (cq == MAP_FAILED) return -1;
+    }
+    g_ring.sqes = mmap(NULL, p.sq_entries * sizeof(struct io_uring_sqe),
+                       PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                       g_ring.fd, IORING_OFF_SQES);
+    if (g_ring.sqes == MAP_FAILED) return -1;
+
+    g_ring.sq_entries = p.sq_entries;
+    g_ring.sq_head    = (unsigned *)(sq + p.sq_off.head);
+    g_ring.sq_tail    = (unsigned *)(sq + p.sq_off.tail);
+    g_ring.sq_mask    = (unsigned *)(sq + p.sq_off.ring_mask);
+    g_ring.sq_array   = (unsigned *)(sq + p.sq_off.array);
+    g_ring.sq_local   = *g_ring.sq_tail;
+    g_ring.cq_head    = (unsigned *)(cq + p.cq_off.head);
+    g_ring.cq_tail    = (unsigned *)(cq + p.cq_off.tail);
+    g_ring.cq_mask    = (unsigned *)(cq + p.cq_off.ring_mask);
+    g_ring.cqes       = (struct io_uring_cqe *)(cq + p.cq_off.cqes);
+
+    /* Anello di buffer forniti per le recv */
+    g_ring.br = mmap(NULL, UR_BUFS * sizeof(struct io_uring_buf), PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    g_ring.bufs = mmap(NULL, (size_t)UR_BUFS * UR_BUFSZ, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (g_ring.br == MAP_FAILED || g_ring.bufs == MAP_FAILED) return -1;
+
+    struct io_uring_buf_reg reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.ring_addr    = (uint64_t)(uintptr_t)g_ring.br;
+    reg.ring_entries = UR_BUFS;
+    reg.bgid         = UR_BGID;
+    if (syscall(__NR_io_uring_register, g_ring.fd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0)
+        return -1;
+    for (unsigned i = 0; i < UR_BUFS; i++) buf_recycle(i);
+
+    g_ring.efd = eventfd(0, EFD_CLOEXEC);
+    return g_ring.efd < 0 ? -1 : 0;
+}
+
+/* ------------------------------------------------------------------ */
+/*  Operazioni                                                          */
+/* ------------------------------------------------------------------ */
+
+static void prep_accept(int listen_fd) {
+    struct io_uring_sqe *sqe = sqe_get();
+    sqe->opcode    = IORING_OP_ACCEPT;
+    sqe->fd        = listen_fd;
+    sqe->ioprio    = IORING_ACCEPT_MULTISHOT;
+    sqe->user_data = UR_ACCEPT << UR_OP_SHIFT;
+}
+
+static void prep_wake(void) {
+    struct io_uring_sqe *sqe = sqe_get();
+    sqe->opcode    = IORING_OP_READ;
+    sqe->fd        = g_ring.efd;
+    sqe->addr      = (uint64_t)(uintptr_t)&g_ring.ebuf;
+    sqe->len       = sizeof(g_ring.ebuf);
+    sqe->off       = (uint64_t)-1;
+    sqe->user_data = UR_WAKE << UR_OP_SHIFT;
+}
+
+/* c->mtx tenuto */
+static void prep_recv(io_conn_t *c) {
+    ur_conn_t *u    = &g_ur[io_conn_index(c)];
+    size_t     room = io_conn_room(c);
+    if (u->recv_armed || c->eof || c->paused) return;
+    if (room == 0) {
+        c->paused = 1;   /* riarmata da uring_resume */
+        return;
+    }
+    struct io_uring_sqe *sqe = sqe_get();
+    sqe->opcode    = IORING_OP_RECV;
+    sqe->fd        = c->s.fd;
+    sqe->len       = (unsigned)(room < UR_BUFSZ ? room : UR_BUFSZ);
+    sqe->flags     = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = UR_BGID;
+    sqe->user_data = (UR_RECV << UR_OP_SHIFT) | io_conn_tag(c);
+    u->recv_armed  = 1;
+    u->recv_fd     = c->s.fd;
+}
+
+/* c->mtx tenuto: la recv in corso usa ancora il fd di prima di RESUME */
+static void prep_cancel(io_conn_t *c) {
+    ur_conn_t *u = &g_ur[io_conn_index(c)];
+    if (!u->cancel) return;
+    u->cancel = 0;
+    if (!u->recv_armed) return;
+    struct io_uring_sqe *sqe = sqe_get();
+    sqe->opcode    = IORING_OP_ASYNC_CANCEL;
+    sqe->addr      = (UR_RECV << UR_OP_SHIFT) | io_conn_tag(c);
+    sqe->user_data = 0;
+}
+
+/* c->mtx tenuto */
+static void prep_send(io_conn_t *c) {
+    ur_conn_t *u = &g_ur[io_conn_index(c)];
+    if (u->inflight || u->len == 0 || u->dead) return;
+    struct io_uring_sqe *sqe = sqe_get();
+    sqe->opcode    = IORING_OP_SEND;
+    sqe->fd        = c->s.fd;
+    sqe->addr      = (uint64_t)(uintptr_t)u->buf;
+    sqe->len       = (unsigned)u->len;
+    sqe->msg_flags = MSG_NOSIGNAL;
+    sqe->user_data = (UR_SEND << UR_OP_SHIFT) | io_conn_tag(c);
+    u->inflight    = u->len;
+    u->send_fd     = c->s.fd;
+}
+
+/* c->mtx tenuto: la connessione va servita dal thread dell'anello */
+static void wake_push(io_conn_t *c) {
+    ur_conn_t *u = &g_ur[io_conn_index(c)];
+    if (u->woken) return;
+    u->woken = 1;
+    pthread_mutex_lock(&g_wake_mtx);
+    int first = (g_nwake == 0);
+    g_wake[g_nwake++] = io_conn_tag(c);
+    pthread_mutex_unlock(&g_wake_mtx);
+    if (first) {
+        uint64_t one = 1;
+        if (write(g_ring.efd, &one, sizeof(one)) < 0) LOG_ERRNO(LOG_SYS_IO, "eventfd");
+    }
+}
+
+static void wake_drain(void) {
+    uint64_t tags[IO_MAX_CONNS];
+    pthread_mutex_lock(&g_wake_mtx);
+    int n = g_nwake;
+    memcpy(tags, g_wake, (size_t)n * sizeof(tags[0]));
+    g_nwake = 0;
+    pthread_mutex_unlock(&g_wake_mtx);
+
+    for (int i = 0; i < n; i++) {
+        io_conn_t *c = io_conn_lock_tag(tags[i]);
+        if (!c) continue;
+        g_ur[io_conn_index(c)].woken = 0;
+        prep_cancel(c);
+        prep_recv(c);
+        prep_send(c);
+        pthread_mutex_unlock(&c->mtx);
+    }
+}
+
+/* ------------------------------------------------------------------ */
+/*  Completamenti                                                       */
+/* ------------------------------------------------------------------ */
+
+static void on_accept(int listen_fd, const struct io_uring_cqe *cqe) {
+    if (!(cqe->flags & IORING_CQE_F_MORE)) prep_accept(listen_fd);
+    if (cqe->res < 0) {
+        errno = -cqe->res;
+        LOG_ERRNO(LOG_SYS_IO, "accept");
+        return;
+    }
+    int client_fd = cqe->res;
+
+    struct sockaddr_in addr;
+    socklen_t alen = sizeof(addr);
+    char ip[INET_ADDRSTRLEN] = "?";
+    if (getpeername(client_fd, (struct sockaddr *)&addr, &alen) == 0)
+        inet_ntop(AF_INET, &addr.sin_addr, ip, sizeof(ip));
+    LOGS(LOG_INFO, LOG_SYS_IO, ip, "Client connesso: %s:%ld (fd=%ld)", ntohs(addr.sin_port), client_fd);
+
+    io_accepted(&io_uring, client_fd);
+}
+
+static void on_recv(uint64_t tag, const struct io_uring_cqe *cqe) {
+    int        has_buf = (cqe->flags & IORING_CQE_F_BUFFER) != 0;
+    unsigned   bid     = cqe->flags >> IORING_CQE_BUFFER_SHIFT;
+    io_conn_t *c       = io_conn_lock_tag(tag);
+
+    if (c) {
+        ur_conn_t *u = &g_ur[io_conn_index(c)];
+        u->recv_armed = 0;
+        if (cqe->res > 0 && has_buf) {
+            /* La recv chiede al massimo lo spazio libero in rx */
+            memcpy(c->rx + c->rxlen, g_ring.bufs + (size_t)bid * UR_BUFSZ, (size_t)cqe->res);
+            c->rxlen += (size_t)cqe->res;
+            c->rx[c->rxlen] = '\0';
+        } else if (cqe->res != -ENOBUFS && u->recv_fd == c->s.fd) {
+            if (cqe->res < 0) {
+                errno = -cqe->res;
+                LOG_ERRNO(LOG_SYS_IO, "recv");
+            }
+            c->eof = 1;
+        }
+        io_conn_kick(c);
+        prep_recv(c);
+        pthread_mutex_unlock(&c->mtx);
+    }
+    if (has_buf) buf_recycle(bid);
+}
+
+static void on_send(uint64_t tag, const struct io_uring_cqe *cqe) {
+    io_conn_t *c = io_conn_lock_tag(tag);
+    if (!c) return;
+    ur_conn_t *u = &g_ur[io_conn_index(c)];
+    if (cqe->res > 0) {
+        size_t n = (size_t)cqe->res;
+        memmove(u->buf, u->buf + n, u->len - n);
+        u->len -= n;
+    } else if (u->send_fd != c->s.fd) {
+        /* Partita con il fd chiuso da RESUME: si ritenta sul nuovo */
+    } else {
+        u->dead = 1;
+        u->len  = 0;
+    }
+    u->inflight = 0;
+    pthread_cond_broadcast(&u->cv);
+    prep_send(c);
+    pthread_mutex_unlock(&c->mtx);
+}
+
+/* ------------------------------------------------------------------ */
+/*  Invio per conto di net_send                                         */
+/* ------------------------------------------------------------------ */
+
+static ssize_t uring_send(int fd, const void *buf, size_t len, int dontwait) {
+    if (fd < 0 || fd >= UR_MAX_FD) return NET_NOT_MINE;
+    io_conn_t *c = __atomic_load_n(&g_fdmap[fd], __ATOMIC_ACQUIRE);
+    if (!c) return NET_NOT_MINE;
+
+    pthread_mutex_lock(&c->mtx);
+    if (!c->used || c->s.fd != fd) {
+        pthread_mutex_unlock(&c->mtx);
+        return NET_NOT_MINE;
+    }
+    ur_conn_t *u    = &g_ur[io_conn_index(c)];
+    size_t     done = 0;
+    int        held = 0;
+    /*
+     * Un buffer entra intero prima del successivo: dontwait non copia a
+     * metà (EAGAIN se non c'è spazio), e chi aspetta spazio a metà di
+     * un buffer tiene la coda finché non lo ha copiato tutto.
+     */
+    while (u->writer && !u->dead) {
+        if (dontwait) break;
+        pthread_cond_wait(&u->cv, &c->mtx);
+    }
+    int full = dontwait && (u->writer || (len <= UR_TXBUF && UR_TXBUF - u->len < len));
+    while (!full && done < len && !u->dead) {
+        size_t room = UR_TXBUF - u->len;
+        if (room == 0) {
+            u->writer = held = 1;
+            pthread_cond_wait(&u->cv, &c->mtx);
+            continue;
+        }
+        size_t n = len - done < room ? len - done : room;
+        memcpy(u->buf + u->len, (const char *)buf + done, n);
+        u->len += n;
+        done   += n;
+        if (!u->inflight) wake_push(c);
+    }
+    if (held) {
+        u->writer = 0;
+        pthread_cond_broadcast(&u->cv);
+    }
+    int dead = u->dead;
+    pthread_mutex_unlock(&c->mtx);
+
+    if (done > 0) return (ssize_t)done;
+    errno = dead ? EPIPE : EAGAIN;
+    return len ? -1 : 0;
+}
+
+/* ------------------------------------------------------------------ */
+/*  Backend                                                             */
+/* ------------------------------------------------------------------ */
+
+static void uring_resume(io_conn_t *c) {
+    c->paused = 0;
+    wake_push(c);
+}
+
+/* Attende che i dati accodati partano (al più UR_DRAIN_SEC) */
+static void uring_drain(io_conn_t *c) {
+    ur_conn_t *u = &g_ur[io_conn_index(c)];
+    struct timespec until;
+    clock_gettime(CLOCK_REALTIME, &until);
+    until.tv_sec += UR_DRAIN_SEC;
+
+    pthread_mutex_lock(&c->mtx);
+    while ((u->len > 0 || u->inflight) && !u->dead)
+        if (pthread_cond_timedwait(&u->cv, &c->mtx, &until) == ETIMEDOUT) break;
+    pthread_mutex_unlock(&c->mtx);
+}
+
+static void uring_release(io_conn_t *c) {
+    ur_conn_t *u  = &g_ur[io_conn_index(c)];
+    int        fd = c->s.fd;
+    if (fd >= 0 && fd < UR_MAX_FD && g_fdmap[fd] == c)
+        __atomic_store_n(&g_fdmap[fd], NULL, __ATOMIC_RELEASE);
+    u->len = u->inflight = 0;
+    u->dead = u->recv_armed = u->cancel = u->woken = u->writer = 0;
+}
+
+static const io_pool_ops_t uring_ops = { uring_resume, uring_drain, uring_release };
+
+static void uring_rebind(session_t *s, int new_fd) {
+    io_conn_t *c = s->io;
+    pthread_mutex_lock(&c->mtx);
+    /*
+     * Dopo dup2 new_fd è lo stesso socket del fd che sta per essere
+     * chiuso, ma le operazioni in volo lo hanno risolto per numero: la
+     * recv si annulla e si riarma, una send fallita si ritenta.
+     */
+    if (g_fdmap[s->fd] == c) __atomic_store_n(&g_fdmap[s->fd], NULL, __ATOMIC_RELEASE);
+    s->fd = new_fd;
+    if (new_fd < UR_MAX_FD) __atomic_store_n(&g_fdmap[new_fd], c, __ATOMIC_RELEASE);
+    else                    g_ur[io_conn_index(c)].dead = 1;
+    g_ur[io_conn_index(c)].cancel = 1;
+    wake_push(c);
+    pthread_mutex_unlock(&c->mtx);
+}
+
+static int uring_start(const io_opts_t *o) {
+    if (ring_setup() < 0) {
+        int err = errno;
+        if (g_ring.fd >= 0) close(g_ring.fd);
+        errno = err;
+        return -1;
+    }
+    for (int i = 0; i < IO_MAX_CONNS; i++)
+        pthread_cond_init(&g_ur[i].cv, NULL);
+
+    int workers = io_pool_start(o, &uring_ops);
+    if (workers < 0) return -1;
+    net_set_sender(uring_send);
+    LOG(LOG_INFO, LOG_SYS_IO, "I/O io_uring: 1 thread per l'anello, %ld worker.", workers);
+    return 0;
+}
+
+static int uring_adopt(int client_fd, int resumed) {
+    if (client_fd >= UR_MAX_FD) {
+        LOG(LOG_WARN, LOG_SYS_IO, "io_uring: fd %ld oltre il limite", client_fd);
+        return -1;
+    }
+    io_conn_t *c = io_conn_alloc();
+    if (!c) {
+        LOG(LOG_WARN, LOG_SYS_IO, "io_uring: troppe connessioni (fd=%ld)", client_fd);
+        return -1;
+    }
+    /* Il benvenuto parte con send(2): il fd non è ancora nella mappa */
+    session_open(&c->s, client_fd, resumed);
+    c->s.rebind = uring_rebind;
+    c->s.io     = c;
+    __atomic_store_n(&g_fdmap[client_fd], c, __ATOMIC_RELEASE);
+    wake_push(c);
+    pthread_mutex_unlock(&c->mtx);
+    return 0;
+}
+
+static void uring_serve(int listen_fd) {
+    prep_accept(listen_fd);
+    prep_wake();
+
+    while (1) {
+        wake_drain();
+        ring_publish();
+        int n = ring_enter(g_ring.pending, 1, IORING_ENTER_GETEVENTS);
+        if (n < 0) {
+            if (errno != EINTR && errno != EBUSY) LOG_ERRNO(LOG_SYS_IO, "io_uring_enter");
+            continue;
+        }
+        g_ring.pending -= (unsigned)n;
+
+        unsigned head = *g_ring.cq_head;
+        unsigned tail = __atomic_load_n(g_ring.cq_tail, __ATOMIC_ACQUIRE);
+        for (; head != tail; head++) {
+            const struct io_uring_cqe *cqe = &g_ring.cqes[head & *g_ring.cq_mask];
+            uint64_t op  = cqe->user_data >> UR_OP_SHIFT;
+            uint64_t tag = cqe->user_data & ((1ULL << UR_OP_SHIFT) - 1);
+            switch (op) {
+                case UR_ACCEPT: on_accept(listen_fd, cqe); break;
+                case UR_RECV:   on_recv(tag, cqe);         break;
+                case UR_SEND:   on_send(tag, cqe);         break;
+                case UR_WAKE:   prep_wake();               break;
+            }
+        }
+        __atomic_store_n(g_ring.cq_head, head, __ATOMIC_RELEASE);
+    }
+}
+
+const io_backend_t io_uring = { "uring", &io_epoll, uring_start, uring_adopt, uring_serve };
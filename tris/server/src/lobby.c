@@ -0,0 +1,637 @@
+#include "lobby.h"
+#include "server.h"
+#include "session.h"
+#include "net.h"
+#include "protocol.h"
+#include "log.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#define LOBBY_MAGIC    0x4c495254u   /* "TRIL" */
+#define LOBBY_VERSION  1
+#define LB_PAYLOAD     4096          /* byte per datagramma: l'output più lungo si spezza */
+#define LB_SEND_MS     500           /* attesa massima su un canale pieno */
+#define LB_WAIT_MS     1000          /* attesa del segmento creato da un altro processo */
+#define LB_VFD_BASE    NET_VFD_BASE  /* primo fd virtuale delle sessioni inoltrate */
+
+/* ------------------------------------------------------------------ */
+/*  Segmento condiviso                                                  */
+/* ------------------------------------------------------------------ */
+
+/*
+ * Nomi e partite in array piatti con una parte calda (proprietario,
+ * hash del nome / id) scorsa dalle ricerche e la parte fredda allo
+ * stesso indice.  Niente tabelle hash: una scrittura interrotta da un
+ * crash non può spezzare una catena di probing.  Una voce nuova si
+ * riempie prima e si pubblica per ultima (pproc / mid); una voce si
+ * libera per prima cosa.
+ */
+typedef struct {
+    int           proc;
+    int           status;   /* match_status_t */
+    unsigned char rows, cols, k;
+    char          owner[MAX_NAME];
+} lb_match_t;
+
+typedef struct {
+    uint32_t        magic;      /* scritto per ultimo da chi crea il segmento */
+    uint32_t        version;
+    pthread_mutex_t mtx;        /* robusto, condiviso fra processi */
+    int             next_id;
+
+    pid_t           pid[LOBBY_MAX_PROCS];           /* 0 = libero */
+
+    int             pproc[LOBBY_MAX_PLAYERS];       /* -1 = libero */
+    unsigned        phash[LOBBY_MAX_PLAYERS];
+    char            pname[LOBBY_MAX_PLAYERS][MAX_NAME];
+
+    int             mid[LOBBY_MAX_MATCHES];         /* 0 = libero */
+    lb_match_t      match[LOBBY_MAX_MATCHES];
+} lobby_shm_t;
+
+/* ------------------------------------------------------------------ */
+/*  Canale                                                              */
+/* ------------------------------------------------------------------ */
+
+enum {
+    LB_OPEN,    /* A -> B: nuova sessione inoltrata, "nome\0riga" */
+    LB_LINE,    /* A -> B: una riga del client */
+    LB_GONE,    /* A -> B: il client si è disconnesso */
+    LB_OUT,     /* B -> A: output per il client */
+    LB_CLOSE,   /* B -> A: chiudere la connessione (QUIT, flood, errore) */
+    LB_BCAST    /* broadcast della lobby */
+};
+
+typedef struct {
+    uint8_t  type;
+    uint8_t  from;       /* indice del mittente in pid[] */
+    uint16_t relay;
+    int32_t  pid;        /* pid del mittente */
+} lb_hdr_t;
+
+typedef struct {
+    lb_hdr_t h;
+    char     data[LB_PAYLOAD];
+} lb_msg_t;
+
+/* ------------------------------------------------------------------ */
+/*  Stato del processo                                                  */
+/* ------------------------------------------------------------------ */
+
+static lobby_shm_t *g_shm;
+static int          g_self = -1;
+static int          g_sock = -1;
+static char         g_name[64];
+
+/* Lato A: connessioni di questo processo inoltrate altrove (fd -1 = libero) */
+typedef struct {
+    int   fd;
+    int   proc;
+    pid_t pid;
+} relay_t;
+
+static pthread_mutex_t g_relay_mtx = PTHREAD_MUTEX_INITIALIZER;
+static relay_t         g_relay[LOBBY_RELAYS];
+
+/*
+ * Lato B: sessioni virtuali per conto degli altri processi, indicizzate
+ * da (processo, inoltro); fd = LB_VFD_BASE + proc * LOBBY_RELAYS + relay.
+ * Le tocca solo il thread del canale, tranne g_virt_pid letto dagli invii.
+ */
+static session_t g_virt[LOBBY_MAX_PROCS][LOBBY_RELAYS];
+static pid_t     g_virt_pid[LOBBY_MAX_PROCS][LOBBY_RELAYS];   /* 0 = libera */
+
+static unsigned hash_name(const char *s) {
+    unsigned h = 2166136261u;                 /* FNV-1a */
+    while (*s) { h ^= (unsigned char)*s++; h *= 16777619u; }
+    return h;
+}
+
+static int proc_alive(pid_t pid) {
+    return pid > 0 && (kill(pid, 0) == 0 || errno == EPERM);
+}
+
+static const char *status_name(int status) {
+    switch (status) {
+        case MATCH_WAITING: return "WAITING";
+        case MATCH_PENDING: return "PENDING";
+        case MATCH_PLAYING: return "PLAYING";
+        default:            return "FINISHED";   /* anche MATCH_REMATCH */
+    }
+}
+
+static void shm_lock(void) {
+    if (pthread_mutex_lock(&g_shm->mtx) == EOWNERDEAD) {
+        /* Il proprietario è morto col lock: le voci restano coerenti */
+        pthread_mutex_consistent(&g_shm->mtx);
+        LOG(LOG_WARN, LOG_SYS_LOBBY, "Lock della lobby recuperato (pid %ld)", (long)getpid());
+    }
+}
+
+static void shm_unlock(void) {
+    pthread_mutex_unlock(&g_shm->mtx);
+}
+
+/* Con il lock preso */
+static int player_find(const char *name, unsigned h) {
+    for (int i = 0; i < LOBBY_MAX_PLAYERS; i++)
+        if (g_shm->pproc[i] >= 0 && g_shm->phash[i] == h &&
+            strcmp(g_shm->pname[i], name) == 0)
+            return i;
+    return -1;
+}
+
+static int match_find(int id) {
+    for (int i = 0; i < LOBBY_MAX_MATCHES; i++)
+        if (g_shm->mid[i] == id) return i;
+    return -1;
+}
+
+/* Nome a proc; force scavalca un proprietario precedente (handover) */
+static int name_put(const char *name, int proc, int force) {
+    unsigned h = hash_name(name);
+    shm_lock();
+    int i = player_find(name, h);
+    if (i >= 0 && !force) { shm_unlock(); return -1; }
+    if (i < 0) {
+        for (i = 0; i < LOBBY_MAX_PLAYERS && g_shm->pproc[i] >= 0; i++) {}
+        if (i == LOBBY_MAX_PLAYERS) { shm_unlock(); return -1; }
+        snprintf(g_shm->pname[i], MAX_NAME, "%s", name);
+        g_shm->phash[i] = h;
+    }
+    __atomic_store_n(&g_shm->pproc[i], proc, __ATOMIC_RELEASE);
+    shm_unlock();
+    return 0;
+}
+
+/* ------------------------------------------------------------------ */
+/*  Invio sul canale                                                    */
+/* ------------------------------------------------------------------ */
+
+static socklen_t chan_addr(pid_t pid, struct sockaddr_un *a) {
+    memset(a, 0, sizeof(*a));
+    a->sun_family = AF_UNIX;
+    int n = snprintf(a->sun_path + 1, sizeof(a->sun_path) - 1,
+                     "tris-lobby/%s/%d", g_name, (int)pid);
+    return (socklen_t)(offsetof(struct sockaddr_un, sun_path) + 1 + (size_t)n);
+}
+
+/*
+ * Mai bloccante all'infinito: due thread del canale che si scrivono a
+ * vicenda con le code piene si fermerebbero per sempre.  Dopo LB_SEND_MS
+ * il messaggio si perde (come un client lento per gli spettatori).
+ * 0 inviato, -1 destinatario morto o canale pieno.
+ */
+static int chan_send(pid_t pid, int type, int relay, const void *data, size_t len) {
+    lb_msg_t m;
+    if (len > LB_PAYLOAD) len = LB_PAYLOAD;
+    m.h.type  = (uint8_t)type;
+    m.h.from  = (uint8_t)g_self;
+    m.h.relay = (uint16_t)relay;
+    m.h.pid   = (int32_t)getpid();
+    if (len) memcpy(m.data, data, len);
+
+    struct sockaddr_un a;
+    socklen_t alen = chan_addr(pid, &a);
+    for (int waited = 0; ; waited++) {
+        if (sendto(g_sock, &m, sizeof(m.h) + len, MSG_DONTWAIT,
+                   (struct sockaddr *)&a, alen) >= 0)
+            return 0;
+        if (errno != EAGAIN || waited >= LB_SEND_MS) break;
+        usleep(1000);
+    }
+    if (errno == EAGAIN)
+        LOG(LOG_WARN, LOG_SYS_LOBBY, "Canale verso pid %ld pieno, messaggio perso", (long)pid);
+    return -1;
+}
+
+/* Pid degli altri processi vivi, fuori dal lock per inviare */
+static int peers(pid_t *out) {
+    int n = 0;
+    shm_lock();
+    for (int i = 0; i < LOBBY_MAX_PROCS; i++)
+        if (i != g_self && g_shm->pid[i]) out[n++] = g_shm->pid[i];
+    shm_unlock();
+    return n;
+}
+
+/* Output di una sessione virtuale: torna al processo che tiene il socket */
+static ssize_t virt_send(int fd, const void *buf, size_t len, int dontwait) {
+    (void)dontwait;
+    int k = fd - LB_VFD_BASE;
+    pid_t pid = __atomic_load_n(&g_virt_pid[k / LOBBY_RELAYS][k % LOBBY_RELAYS],
+                                __ATOMIC_ACQUIRE);
+    size_t n = len < LB_PAYLOAD ? len : LB_PAYLOAD;
+    if (!pid || chan_send(pid, LB_OUT, k % LOBBY_RELAYS, buf, n) < 0) {
+        errno = EPIPE;
+        return -1;
+    }
+    return (ssize_t)n;
+}
+
+/* ------------------------------------------------------------------ */
+/*  Directory delle partite (match_dir_t, sotto ms->mtx)                */
+/* ------------------------------------------------------------------ */
+
+static int dir_next_id(void) {
+    shm_lock();
+    int id = g_shm->next_id++;
+    shm_unlock();
+    return id;
+}
+
+static void dir_publish(int id, const match_hot_t *h, const match_t *m) {
+    char owner[MAX_NAME] = "??";
+    if (h) state_get_name_copy(&g_state, h->owner_fd, owner, sizeof(owner));
+
+    shm_lock();
+    int i = match_find(id);
+    if (!h) {
+        if (i >= 0) __atomic_store_n(&g_shm->mid[i], 0, __ATOMIC_RELEASE);
+        shm_unlock();
+        return;
+    }
+    if (i < 0)
+        for (i = 0; i < LOBBY_MAX_MATCHES && g_shm->mid[i] != 0; i++) {}
+    if (i < LOBBY_MAX_MATCHES) {
+        lb_match_t *e = &g_shm->match[i];
+        e->proc   = g_self;
+        e->status = (int)h->status;
+        e->rows   = m->rows;
+        e->cols   = m->cols;
+        e->k      = m->k;
+        memcpy(e->owner, owner, MAX_NAME);
+        __atomic_store_n(&g_shm->mid[i], id, __ATOMIC_RELEASE);
+    }
+    shm_unlock();
+}
+
+static const match_dir_t k_dir = { dir_next_id, dir_publish };
+
+/* ------------------------------------------------------------------ */
+/*  Sessioni virtuali (lato B, thread del canale)                       */
+/* ------------------------------------------------------------------ */
+
+static void virt_close(int proc, int relay) {
+    session_t *s = &g_virt[proc][relay];
+    s->dropped = 0;      /* niente grazia: il socket è dall'altra parte */
+    session_close(s);
+    __atomic_store_n(&g_virt_pid[proc][relay], 0, __ATOMIC_RELEASE);
+}
+
+static void virt_line(int proc, int relay, const char *data, size_t len) {
+    char line[MAX_LINE];
+    if (len >= sizeof(line)) len = sizeof(line) - 1;
+    memcpy(line, data, len);
+    line[len] = '\0';
+    if (session_line(&g_virt[proc][relay], line) == SESSION_CLOSE) {
+        chan_send(g_virt_pid[proc][relay], LB_CLOSE, relay, NULL, 0);
+        virt_close(proc, relay);
+    }
+}
+
+static void virt_open(const lb_hdr_t *h, const char *data, size_t len) {
+    int proc = h->from, relay = h->relay;
+    if (g_virt_pid[proc][relay]) virt_close(proc, relay);
+
+    const char *name = data;
+    size_t      nl   = strnlen(data, len);
+    if (nl == len) return;
+    const char *line = data + nl + 1;
+
+    int vfd = LB_VFD_BASE + proc * LOBBY_RELAYS + relay;
+    __atomic_store_n(&g_virt_pid[proc][relay], (pid_t)h->pid, __ATOMIC_RELEASE);
+    if (state_add_client(&g_state, vfd) < 0 || state_login(&g_state, vfd, name) != 0) {
+        state_remove_client(&g_state, vfd);
+        lobby_release_name(name);
+        chan_send(h->pid, LB_OUT, relay, PROTO_ERR_JOIN_FAILED, strlen(PROTO_ERR_JOIN_FAILED));
+        chan_send(h->pid, LB_CLOSE, relay, NULL, 0);
+        __atomic_store_n(&g_virt_pid[proc][relay], 0, __ATOMIC_RELEASE);
+        return;
+    }
+    session_open(&g_virt[proc][relay], vfd, 1);
+    LOGS(LOG_INFO, LOG_SYS_LOBBY, name, "Sessione inoltrata: %s da pid %ld (fd=%ld)",
+         (long)h->pid, vfd);
+    virt_line(proc, relay, line, len - nl - 1);
+}
+
+/* ------------------------------------------------------------------ */
+/*  Connessioni inoltrate (lato A)                                      */
+/* ------------------------------------------------------------------ */
+
+static int relay_fd(int relay, pid_t pid) {
+    if (relay >= LOBBY_RELAYS) return -1;
+    pthread_mutex_lock(&g_relay_mtx);
+    int fd = g_relay[relay].pid == pid ? g_relay[relay].fd : -1;
+    pthread_mutex_unlock(&g_relay_mtx);
+    return fd;
+}
+
+int lobby_relay_open(int proc, int fd, const char *name, const char *line) {
+    pid_t pid = __atomic_load_n(&g_shm->pid[proc], __ATOMIC_ACQUIRE);
+    if (!pid) return -1;
+
+    pthread_mutex_lock(&g_relay_mtx);
+    int r = 0;
+    while (r < LOBBY_RELAYS && g_relay[r].fd != -1) r++;
+    if (r < LOBBY_RELAYS) {
+        g_relay[r].fd   = fd;
+        g_relay[r].proc = proc;
+        g_relay[r].pid  = pid;
+    }
+    pthread_mutex_unlock(&g_relay_mtx);
+    if (r == LOBBY_RELAYS) return -1;
+
+    char   buf[MAX_NAME + MAX_LINE];
+    size_t nl = strlen(name) + 1;
+    size_t ll = strnlen(line, MAX_LINE - 1);
+    memcpy(buf, name, nl);
+    memcpy(buf + nl, line, ll);
+
+    name_put(name, proc, 1);
+    if (chan_send(pid, LB_OPEN, r, buf, nl + ll) < 0) {
+        name_put(name, g_self, 1);
+        pthread_mutex_lock(&g_relay_mtx);
+        g_relay[r].fd = -1;
+        pthread_mutex_unlock(&g_relay_mtx);
+        return -1;
+    }
+    LOGS(LOG_INFO, LOG_SYS_LOBBY, name, "Connessione inoltrata: %s verso pid %ld (fd=%ld)",
+         (long)pid, fd);
+    return r;
+}
+
+void lobby_relay_line(int relay, const char *line) {
+    pthread_mutex_lock(&g_relay_mtx);
+    pid_t pid = g_relay[relay].fd != -1 ? g_relay[relay].pid : 0;
+    pthread_mutex_unlock(&g_relay_mtx);
+    if (pid) chan_send(pid, LB_LINE, relay, line, strlen(line));
+}
+
+void lobby_relay_close(int relay) {
+    pthread_mutex_lock(&g_relay_mtx);
+    pid_t pid = g_relay[relay].fd != -1 ? g_relay[relay].pid : 0;
+    g_relay[relay].fd = -1;
+    pthread_mutex_unlock(&g_relay_mtx);
+    if (pid) chan_send(pid, LB_GONE, relay, NULL, 0);
+}
+
+/* ------------------------------------------------------------------ */
+/*  Processi morti                                                      */
+/* ------------------------------------------------------------------ */
+
+static void reap(void) {
+    /* Directory: processi spariti con i loro nomi e partite */
+    shm_lock();
+    for (int p = 0; p < LOBBY_MAX_PROCS; p++) {
+        if (p == g_self || !g_shm->pid[p] || proc_alive(g_shm->pid[p])) continue;
+        LOG(LOG_WARN, LOG_SYS_LOBBY, "Processo %ld della lobby morto, voci rimosse",
+            (long)g_shm->pid[p]);
+        for (int i = 0; i < LOBBY_MAX_PLAYERS; i++)
+            if (g_shm->pproc[i] == p) g_shm->pproc[i] = -1;
+        for (int i = 0; i < LOBBY_MAX_MATCHES; i++)
+            if (g_shm->mid[i] && g_shm->match[i].proc == p) g_shm->mid[i] = 0;
+        g_shm->pid[p] = 0;
+    }
+    shm_unlock();
+
+    /* Sessioni virtuali di processi morti: come una disconnessione */
+    for (int p = 0; p < LOBBY_MAX_PROCS; p++)
+        for (int r = 0; r < LOBBY_RELAYS; r++)
+            if (g_virt_pid[p][r] && !proc_alive(g_virt_pid[p][r])) virt_close(p, r);
+
+    /* Connessioni inoltrate a processi morti: il client si riconnetterà */
+    pthread_mutex_lock(&g_relay_mtx);
+    for (int r = 0; r < LOBBY_RELAYS; r++)
+        if (g_relay[r].fd != -1 && !proc_alive(g_relay[r].pid))
+            shutdown(g_relay[r].fd, SHUT_RDWR);
+    pthread_mutex_unlock(&g_relay_mtx);
+}
+
+/* ------------------------------------------------------------------ */
+/*  Thread del canale                                                   */
+/* ------------------------------------------------------------------ */
+
+static void deliver(int fd, const char *data, size_t len) {
+    size_t off = 0;
+    while (off < len) {
+        ssize_t n = net_send(fd, data + off, len - off, 0);
+        if (n <= 0) return;
+        off += (size_t)n;
+    }
+}
+
+static void *chan_main(void *arg) {
+    (void)arg;
+    static lb_msg_t m;
+    static char     text[LB_PAYLOAD + 1];
+    time_t last = 0;
+
+    while (1) {
+        ssize_t n = recv(g_sock, &m, sizeof(m), 0);   /* SO_RCVTIMEO: 1 s */
+        time_t  now = time(NULL);
+        if (now != last) { last = now; reap(); }
+        if (n < (ssize_t)sizeof(m.h) || m.h.from >= LOBBY_MAX_PROCS) continue;
+
+        size_t len = (size_t)n - sizeof(m.h);
+        int    fd;
+        switch (m.h.type) {
+            case LB_OPEN:
+                if (m.h.relay < LOBBY_RELAYS) virt_open(&m.h, m.data, len);
+                break;
+            case LB_LINE:
+                if (m.h.relay < LOBBY_RELAYS && g_virt_pid[m.h.from][m.h.relay] == m.h.pid)
+                    virt_line(m.h.from, m.h.relay, m.data, len);
+                break;
+            case LB_GONE:
+                if (m.h.relay < LOBBY_RELAYS && g_virt_pid[m.h.from][m.h.relay] == m.h.pid)
+                    virt_close(m.h.from, m.h.relay);
+                break;
+            case LB_OUT:
+                if ((fd = relay_fd(m.h.relay, m.h.pid)) >= 0) deliver(fd, m.data, len);
+                break;
+            case LB_CLOSE:
+                if ((fd = relay_fd(m.h.relay, m.h.pid)) >= 0) shutdown(fd, SHUT_RDWR);
+                break;
+            case LB_BCAST:
+                memcpy(text, m.data, len);
+                text[len] = '\0';
+                state_broadcast(&g_state, text, -1);
+                break;
+        }
+    }
+    return NULL;
+}
+
+/* ------------------------------------------------------------------ */
+/*  API                                                                 */
+/* ------------------------------------------------------------------ */
+
+static int shm_open_or_create(const char *path) {
+    int created = 1;
+    int fd = shm_open(path, O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd < 0 && errno == EEXIST) {
+        created = 0;
+        fd = shm_open(path, O_RDWR, 0600);
+    }
+    if (fd < 0) return -1;
+
+    if (created && ftruncate(fd, sizeof(lobby_shm_t)) < 0) { close(fd); return -1; }
+    struct stat sb;
+    for (int i = 0; !created && i < LB_WAIT_MS; i++) {
+        if (fstat(fd, &sb) == 0 && (size_t)sb.st_size >= sizeof(lobby_shm_t)) break;
+        usleep(1000);
+    }
+    g_shm = mmap(NULL, sizeof(lobby_shm_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (g_shm == MAP_FAILED) { g_shm = NULL; return -1; }
+
+    if (created) {
+        pthread_mutexattr_t a;
+        pthread_mutexattr_init(&a);
+        pthread_mutexattr_setpshared(&a, PTHREAD_PROCESS_SHARED);
+        pthread_mutexattr_setrobust(&a, PTHREAD_MUTEX_ROBUST);
+        pthread_mutex_init(&g_shm->mtx, &a);
+        pthread_mutexattr_destroy(&a);
+        g_shm->version = LOBBY_VERSION;
+        g_shm->next_id = 1;
+        for (int i = 0; i < LOBBY_MAX_PLAYERS; i++) g_shm->pproc[i] = -1;
+        __atomic_store_n(&g_shm->magic, LOBBY_MAGIC, __ATOMIC_RELEASE);
+    }
+    for (int i = 0; i < LB_WAIT_MS; i++) {
+        if (__atomic_load_n(&g_shm->magic, __ATOMIC_ACQUIRE) == LOBBY_MAGIC) break;
+        usleep(1000);
+    }
+    if (g_shm->magic != LOBBY_MAGIC || g_shm->version != LOBBY_VERSION) {
+        fprintf(stderr, "Segmento %s non inizializzato o di un'altra versione: "
+                        "rimuoverlo da /dev/shm.\n", path);
+        munmap(g_shm, sizeof(lobby_shm_t));
+        g_shm = NULL;
+        errno = EPROTO;
+        return -1;
+    }
+    return 0;
+}
+
+int lobby_attach(const char *name) {
+    if (!name[0] || strchr(name, '/') || strlen(name) >= 32) { errno = EINVAL; return -1; }
+    snprintf(g_name, sizeof(g_name), "%s", name);
+    char path[64];
+    snprintf(path, sizeof(path), "/tris-lobby-%s", name);
+    if (shm_open_or_create(path) < 0) return -1;
+
+    for (int r = 0; r < LOBBY_RELAYS; r++) g_relay[r].fd = -1;
+
+    g_sock = socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (g_sock < 0) return -1;
+    struct sockaddr_un a;
+    socklen_t alen = chan_addr(getpid(), &a);
+    struct timeval tv = { 1, 0 };
+    int rcvbuf = 1 << 20;
+    setsockopt(g_sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    setsockopt(g_sock, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+    if (bind(g_sock, (struct sockaddr *)&a, alen) < 0) return -1;
+
+    /* Uno slot libero, dopo aver tolto i processi morti */
+    g_self = LOBBY_MAX_PROCS;
+    reap();
+    shm_lock();
+    for (int p = 0; p < LOBBY_MAX_PROCS; p++)
+        if (!g_shm->pid[p]) { g_self = p; g_shm->pid[p] = getpid(); break; }
+    shm_unlock();
+    if (g_self == LOBBY_MAX_PROCS) { g_self = -1; errno = EUSERS; return -1; }
+
+    /* Nomi e partite ereditati da un handover */
+    for (int i = 0; i < MAX_CLIENTS; i++)
+        if (g_state.clients[i].fd != 0 && g_state.clients[i].logged_in)
+            name_put(g_state.clients[i].name, g_self, 1);
+    /* Nessuna chiusura: l'inattività la misura chi tiene il socket */
+    net_add_virtual(LB_VFD_BASE, LOBBY_MAX_PROCS * LOBBY_RELAYS, virt_send, NULL);
+    matches_set_dir(&g_matches, &k_dir);
+
+    pthread_t tid;
+    if (pthread_create(&tid, NULL, chan_main, NULL) != 0) return -1;
+    pthread_detach(tid);
+    LOG(LOG_INFO, LOG_SYS_LOBBY, "Lobby condivisa: processo %ld di %ld", g_self, LOBBY_MAX_PROCS);
+    return 0;
+}
+
+int lobby_active(void) {
+    return g_self >= 0;
+}
+
+int lobby_claim_name(const char *name) {
+    return g_self < 0 ? 0 : name_put(name, g_self, 0);
+}
+
+void lobby_release_name(const char *name) {
+    if (g_self < 0) return;
+    shm_lock();
+    int i = player_find(name, hash_name(name));
+    if (i >= 0 && g_shm->pproc[i] == g_self) g_shm->pproc[i] = -1;
+    shm_unlock();
+}
+
+void lobby_users(char *out, int outsz) {
+    char *p    = out;
+    int   left = outsz;
+    int   found = 0;
+    shm_lock();
+    for (int i = 0; i < LOBBY_MAX_PLAYERS; i++) {
+        if (g_shm->pproc[i] < 0) continue;
+        int n = snprintf(p, left, "USER %s\n", g_shm->pname[i]);
+        if (n > 0 && n < left) { p += n; left -= n; }
+        found = 1;
+    }
+    shm_unlock();
+    if (!found) snprintf(out, outsz, PROTO_NO_USERS);
+}
+
+void lobby_list(char *out, int outsz) {
+    char *p    = out;
+    int   left = outsz;
+    int   found = 0;
+    shm_lock();
+    for (int i = 0; i < LOBBY_MAX_MATCHES; i++) {
+        if (g_shm->mid[i] == 0) continue;
+        const lb_match_t *e = &g_shm->match[i];
+        int classic = e->rows == 3 && e->cols == 3 && e->k == 3;
+        int n = classic
+            ? snprintf(p, left, "MATCH %d owner=%s status=%s\n",
+                       g_shm->mid[i], e->owner, status_name(e->status))
+            : snprintf(p, left, "MATCH %d owner=%s status=%s board=%dx%d k=%d\n",
+                       g_shm->mid[i], e->owner, status_name(e->status),
+                       e->rows, e->cols, e->k);
+        if (n > 0 && n < left) { p += n; left -= n; }
+        found = 1;
+    }
+    shm_unlock();
+    if (!found) snprintf(out, outsz, PROTO_NO_MATCHES);
+}
+
+int lobby_match_proc(int id) {
+    if (g_self < 0 || id <= 0) return -1;
+    shm_lock();
+    int i    = match_find(id);
+    int proc = i >= 0 ? g_shm->match[i].proc : -1;
+    shm_unlock();
+    return proc == g_self ? -1 : proc;
+}
+
+void lobby_broadcast(const char *msg) {
+    if (g_self < 0) return;
+    pid_t pids[LOBBY_MAX_PROCS];
+    int   n = peers(pids);
+    for (int i = 0; i < n; i++) chan_send(pids[i], LB_BCAST, 0, msg, strlen(msg));
+}
@@ -0,0 +1,305 @@
+#include "log.h"
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#define LOG_MASK   (LOG_RING - 1)
+#define LOG_BATCH  65536    /* byte formattati prima di una write */
+
+typedef struct {
+    uint64_t    ns;                 /* CLOCK_REALTIME */
+    const char *fmt;
+    long        a[LOG_ARGS];
+    uint8_t     level;
+    uint8_t     sys;
+    uint8_t     has_str;
+    char        str[LOG_STR];
+} log_rec_t;
+
+_Static_assert(sizeof(log_rec_t) == 128, "log_rec_t: due righe di cache");
+
+/*
+ * Un produttore (il thread proprietario) e un consumatore (chi tiene
+ * g_wmtx).  head e tail su righe di cache diverse: il produttore scrive
+ * head e incrementa dropped, il consumatore scrive tail e azzera dropped.
+ */
+typedef struct {
+    _Alignas(64) unsigned head;
+    unsigned              dropped;
+    int                   dead;     /* thread uscito: svuotare e liberare */
+    _Alignas(64) unsigned tail;
+    _Alignas(64) log_rec_t rec[LOG_RING];
+} log_ring_t;
+
+int      g_log_level = LOG_INFO;
+unsigned g_log_mask  = LOG_MASK_DEFAULT;
+
+/*
+ * Un ring per thread vivo.  Il thread lo pubblica con un CAS su uno slot
+ * libero (NULL) fino a g_nrings, che cresce solo quando sono tutti
+ * presi.  Alla sua uscita la chiave segna il ring come dead; chi tiene
+ * g_wmtx lo svuota un'ultima volta, lo libera e rende lo slot.
+ */
+static log_ring_t           *g_rings[LOG_MAX_THREADS];
+static int                   g_nrings;
+static unsigned              g_lost;     /* record di thread senza ring */
+static pthread_key_t         g_key;
+static pthread_once_t        g_key_once = PTHREAD_ONCE_INIT;
+static _Thread_local log_ring_t *t_ring;
+static _Thread_local int         t_no_ring;
+
+/* Lato scrittura */
+static pthread_mutex_t g_wmtx = PTHREAD_MUTEX_INITIALIZER;
+static int             g_fd   = 2;
+static const char     *g_path;           /* NULL = stderr, nessuna rotazione */
+static uint64_t        g_size;
+static char            g_buf[LOG_BATCH];
+static size_t          g_len;
+
+static const char *const k_level[] = { "DEBUG", "INFO", "WARN", "ERROR" };
+static const char *const k_sys[LOG_SYS_COUNT] = {
+    "main", "io", "session", "cmd", "match", "handover", "rating", "lobby"
+};
+
+/* ------------------------------------------------------------------ */
+/*  Lato di chi logga                                                   */
+/* ------------------------------------------------------------------ */
+
+static void ring_release(void *p) {
+    log_ring_t *r = p;
+    t_ring    = NULL;   /* un LOG da un'altra chiave di uscita va perso */
+    t_no_ring = 1;
+    __atomic_store_n(&r->dead, 1, __ATOMIC_RELEASE);
+}
+
+static void key_init(void) {
+    pthread_key_create(&g_key, ring_release);
+}
+
+/* Slot libero per r, o -1 se ci sono già LOG_MAX_THREADS ring */
+static int ring_publish(log_ring_t *r) {
+    int n = __atomic_load_n(&g_nrings, __ATOMIC_ACQUIRE);
+    while (1) {
+        for (int i = 0; i < n; i++) {
+            log_ring_t *none = NULL;
+            if (__atomic_compare_exchange_n(&g_rings[i], &none, r, 0,
+                                            __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+                return i;
+        }
+        if (n == LOG_MAX_THREADS) return -1;
+        __atomic_compare_exchange_n(&g_nrings, &n, n + 1, 0,
+                                    __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+        n = __atomic_load_n(&g_nrings, __ATOMIC_ACQUIRE);
+    }
+}
+
+static log_ring_t *ring_get(void) {
+    if (t_ring || t_no_ring) return t_ring;
+
+    pthread_once(&g_key_once, key_init);
+    log_ring_t *r = aligned_alloc(64, sizeof(log_ring_t));
+    if (r) {
+        r->head    = 0;
+        r->dropped = 0;
+        r->dead    = 0;
+        r->tail    = 0;
+    }
+    if (!r || ring_publish(r) < 0) {
+        free(r);
+        t_no_ring = 1;
+        return NULL;
+    }
+    pthread_setspecific(g_key, r);
+    t_ring = r;
+    return r;
+}
+
+void log_record(log_level_t lvl, log_sys_t sys, const char *str,
+                const char *fmt, const long *args, int nargs) {
+    log_ring_t *r = ring_get();
+    if (!r) { __atomic_fetch_add(&g_lost, 1, __ATOMIC_RELAXED); return; }
+
+    unsigned h = r->head;
+    if (h - __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE) == LOG_RING) {
+        __atomic_fetch_add(&r->dropped, 1, __ATOMIC_RELAXED);
+        return;
+    }
+
+    log_rec_t *e = &r->rec[h & LOG_MASK];
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    e->ns    = (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+    e->fmt   = fmt;
+    e->level = (uint8_t)lvl;
+    e->sys   = (uint8_t)sys;
+    for (int i = 0; i < LOG_ARGS; i++) e->a[i] = i < nargs ? args[i] : 0;
+    e->has_str = str != NULL;
+    if (str) {
+        size_t n = strnlen(str, LOG_STR - 1);
+        memcpy(e->str, str, n);
+        e->str[n] = '\0';
+    }
+    __atomic_store_n(&r->head, h + 1, __ATOMIC_RELEASE);
+}
+
+/* ------------------------------------------------------------------ */
+/*  Configurazione                                                      */
+/* ------------------------------------------------------------------ */
+
+int log_parse_level(const char *s) {
+    static const char *const names[] = { "debug", "info", "warn", "error" };
+    for (int i = 0; i < 4; i++)
+        if (strcmp(s, names[i]) == 0) return i;
+    return -1;
+}
+
+int log_parse_mask(const char *s, unsigned *mask_out) {
+    unsigned mask = LOG_MASK_DEFAULT;
+    char     name[32];
+    while (*s) {
+        size_t n = strcspn(s, ",");
+        int    off = *s == '-';
+        if (n - off == 0 || n - off >= sizeof(name)) return -1;
+        memcpy(name, s + off, n - off);
+        name[n - off] = '\0';
+
+        unsigned bits = 0;
+        if (strcmp(name, "all") == 0) bits = (1u << LOG_SYS_COUNT) - 1;
+        for (int i = 0; i < LOG_SYS_COUNT && !bits; i++)
+            if (strcmp(name, k_sys[i]) == 0) bits = 1u << i;
+        if (!bits) return -1;
+
+        mask = off ? (mask & ~bits) : (mask | bits);
+        s += n;
+        if (*s == ',') s++;
+    }
+    *mask_out = mask;
+    return 0;
+}
+
+/* ------------------------------------------------------------------ */
+/*  Lato di scrittura (g_wmtx tenuto)                                   */
+/* ------------------------------------------------------------------ */
+
+static void out_open(void) {
+    int fd = open(g_path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (fd < 0) { perror(g_path); g_fd = 2; g_path = NULL; return; }
+    struct stat sb;
+    g_size = fstat(fd, &sb) == 0 ? (uint64_t)sb.st_size : 0;
+    g_fd   = fd;
+}
+
+static void rotate(void) {
+    char from[PATH_MAX], to[PATH_MAX];
+    close(g_fd);
+    for (int i = LOG_KEEP - 1; i >= 1; i--) {
+        snprintf(from, sizeof(from), "%s.%d", g_path, i);
+        snprintf(to,   sizeof(to),   "%s.%d", g_path, i + 1);
+        rename(from, to);
+    }
+    snprintf(to, sizeof(to), "%s.1", g_path);
+    rename(g_path, to);
+    out_open();
+}
+
+static void out_write(void) {
+    size_t off = 0;
+    while (off < g_len) {
+        ssize_t n = write(g_fd, g_buf + off, g_len - off);
+        if (n <= 0) break;   /* disco pieno o simili: il blocco si perde */
+        off += (size_t)n;
+    }
+    g_size += off;
+    g_len   = 0;
+    if (g_path && g_size >= LOG_ROTATE_BYTES) rotate();
+}
+
+static void out_line(const log_rec_t *r) {
+    static time_t    sec = -1;
+    static struct tm tm;
+    char  msg[256];
+
+    time_t s = (time_t)(r->ns / 1000000000ull);
+    if (s != sec) { localtime_r(&s, &tm); sec = s; }
+
+    if (r->has_str)
+        snprintf(msg, sizeof(msg), r->fmt, r->str, r->a[0], r->a[1], r->a[2], r->a[3]);
+    else
+        snprintf(msg, sizeof(msg), r->fmt, r->a[0], r->a[1], r->a[2], r->a[3]);
+
+    /* Prefisso di 42 byte, messaggio e '\n' stanno sempre nello spazio rimasto */
+    if (LOG_BATCH - g_len < sizeof(msg) + 64) out_write();
+    int n = snprintf(g_buf + g_len, LOG_BATCH - g_len,
+                     "%04d-%02d-%02d %02d:%02d:%02d.%06u %-5s %-8s %s\n",
+                     tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday,
+                     tm.tm_hour, tm.tm_min, tm.tm_sec,
+                     (unsigned)(r->ns % 1000000000ull / 1000),
+                     k_level[r->level & 3], k_sys[r->sys % LOG_SYS_COUNT], msg);
+    if (n > 0) g_len += (size_t)n;
+}
+
+static void out_dropped(unsigned n, const char *what) {
+    if (LOG_BATCH - g_len < 128) out_write();
+    int k = snprintf(g_buf + g_len, LOG_BATCH - g_len,
+                     "--- %u record persi (%s)\n", n, what);
+    if (k > 0) g_len += (size_t)k;
+}
+
+static void drain(void) {
+    int n = __atomic_load_n(&g_nrings, __ATOMIC_ACQUIRE);
+
+    for (int i = 0; i < n; i++) {
+        log_ring_t *r = __atomic_load_n(&g_rings[i], __ATOMIC_ACQUIRE);
+        if (!r) continue;   /* slot libero */
+
+        /* dead prima di head: dopo dead il proprietario non scrive più */
+        int      dead = __atomic_load_n(&r->dead, __ATOMIC_ACQUIRE);
+        unsigned t = r->tail;
+        unsigned h = __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);
+        for (; t != h; t++) out_line(&r->rec[t & LOG_MASK]);
+        __atomic_store_n(&r->tail, t, __ATOMIC_RELEASE);
+
+        unsigned d = __atomic_exchange_n(&r->dropped, 0, __ATOMIC_RELAXED);
+        if (d) out_dropped(d, "ring pieno");
+        if (dead) {
+            __atomic_store_n(&g_rings[i], NULL, __ATOMIC_RELEASE);
+            free(r);
+        }
+    }
+    unsigned lost = __atomic_exchange_n(&g_lost, 0, __ATOMIC_RELAXED);
+    if (lost) out_dropped(lost, "troppi thread");
+    if (g_len) out_write();
+}
+
+void log_flush(void) {
+    pthread_mutex_lock(&g_wmtx);
+    drain();
+    pthread_mutex_unlock(&g_wmtx);
+}
+
+static void *log_main(void *arg) {
+    (void)arg;
+    struct timespec ts = { 0, LOG_FLUSH_MS * 1000000L };
+    while (1) {
+        nanosleep(&ts, NULL);
+        log_flush();
+    }
+    return NULL;
+}
+
+int log_start(const char *path) {
+    pthread_mutex_lock(&g_wmtx);
+    g_path = path;
+    if (path) out_open();
+    pthread_mutex_unlock(&g_wmtx);
+
+    pthread_t tid;
+    if (pthread_create(&tid, NULL, log_main, NULL) != 0) return -1;
+    pthread_detach(tid);
+    return 0;
+}
@@ -1,452 +1,275 @@
+#include <errno.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 #include <arpa/inet.h>
 #include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
 #include <netinet/in.h>
-#include <pthread.h>
-
-#include "net.h"
-#include "state.h"
-#include "match.h"
-#include "protocol.h"
-
-#define BACKLOG 16
-
-server_state_t g_state;
-match_store_t  g_matches;
+#include <getopt.h>
+
+#include "server.h"
+#include "core.h"
+#include "io.h"
+#include "session.h"
+#include "handover.h"
+#include "ratelimit.h"
+#include "log.h"
+#include "lobby.h"
+#include "capture.h"
+
+/*
+ * Adattatore di rete del motore (core.h): porta TCP e socket locale,
+ * backend di I/O, handover.  Lo stato globale vive in libtriscore.a.
+ */
+
+#define BACKLOG           16
+#define DEFAULT_RATINGS   "ratings.dat"
+
+/* reuseport: più processi della stessa lobby sulla stessa porta */
+static int open_listener(int port, int reuseport) {
+    int listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (listen_fd < 0) { perror("socket"); return -1; }
 
-/* ------------------------------------------------------------------ */
-/*  Helper: notifica inizio partita a entrambi i giocatori + board     */
-/* ------------------------------------------------------------------ */
-static void notify_match_start(int match_id,
-                                int owner_fd,  const char *owner_name,
-                                int joiner_fd, const char *joiner_name,
-                                const char *fmt_x, const char *fmt_o) {
-    char msg[256];
-    snprintf(msg, sizeof(msg), fmt_x, match_id, joiner_name);
-    send_all(owner_fd, msg);
+    int opt = 1;
+    setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+    if (reuseport)
+        setsockopt(listen_fd, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt));
 
-    snprintf(msg, sizeof(msg), fmt_o, match_id, owner_name);
-    send_all(joiner_fd, msg);
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family      = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port        = htons((uint16_t)port);
 
-    char bbuf[512];
-    if (matches_board(&g_matches, match_id, bbuf, sizeof(bbuf)) == 0) {
-        send_all(owner_fd,  bbuf);
-        send_all(joiner_fd, bbuf);
+    if (bind(listen_fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        perror("bind"); close(listen_fd); return -1;
     }
+    if (listen(listen_fd, BACKLOG) < 0) {
+        perror("listen"); close(listen_fd); return -1;
+    }
+    return listen_fd;
 }
 
-/* ------------------------------------------------------------------ */
-/*  Thread per ogni client                                              */
-/* ------------------------------------------------------------------ */
-static void *client_handler(void *arg) {
-    int client_fd = *(int *)arg;
-    free(arg);
-
-    send_all(client_fd, PROTO_WELCOME);
-    send_all(client_fd, PROTO_HINT_LOGIN);
-    send_all(client_fd, PROTO_HINT_CMDS);
-
-    char line[MAX_LINE];
-    char me[MAX_NAME] = {0};
-
-    while (1) {
-        int r = recv_line(client_fd, line, sizeof(line));
-        if (r == 0) break;
-        if (r < 0) { perror("recv_line"); break; }
-
-        line[strcspn(line, "\r\n")] = '\0';
-
-        char *p = line;
-        while (*p == ' ' || *p == '\t') p++;
-        if (*p == '\0') continue;
-
-        if (strcmp(p, "QUIT") == 0 || strcmp(p, "quit") == 0) {
-            send_all(client_fd, PROTO_BYE);
-            break;
-        }
-
-        me[0] = '\0';
-        int logged_in = state_get_name_copy(&g_state, client_fd, me, sizeof(me));
-
-        /* ---------------------------------------------------------- */
-        /*  Non loggato: solo LOGIN                                    */
-        /* ---------------------------------------------------------- */
-        if (!logged_in) {
-            if (strncmp(p, "LOGIN ", 6) == 0) {
-                const char *name = p + 6;
-                int ok = state_login(&g_state, client_fd, name);
-                if (ok == 0) {
-                    proto_sendf(client_fd, PROTO_OK_LOGIN, name);
-                } else if (ok == -1) {
-                    send_all(client_fd, PROTO_ERR_NAME_TAKEN);
-                } else {
-                    send_all(client_fd, PROTO_ERR_BAD_NAME);
-                }
-            } else {
-                send_all(client_fd, PROTO_ERR_PLEASE_LOGIN);
-            }
-            continue;
+/*
+ * Socket UNIX stream per gateway e bot sullo stesso host: stesso
+ * protocollo della porta TCP, senza lo stack di rete.  Si sostituisce
+ * solo un socket lasciato da un server morto; un file di altro tipo o
+ * un socket su cui un server accetta ancora fanno fallire l'avvio.
+ */
+static int open_local(const char *path) {
+    struct sockaddr_un addr;
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "Percorso del socket troppo lungo: %s\n", path);
+        return -1;
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+
+    /*
+     * Si sostituisce solo un socket rimasto da un server morto (nessuno
+     * accetta più): un file qualsiasi o un server vivo allo stesso
+     * percorso non si toccano.
+     */
+    struct stat sb;
+    if (lstat(path, &sb) == 0) {
+        int probe = S_ISSOCK(sb.st_mode) ? socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0) : -1;
+        int stale = probe >= 0 &&
+                    connect(probe, (struct sockaddr *)&addr, sizeof(addr)) < 0 &&
+                    errno == ECONNREFUSED;
+        if (probe >= 0) close(probe);
+        if (!stale) {
+            fprintf(stderr, "%s: %s\n", path, strerror(EADDRINUSE));
+            return -1;
         }
+        unlink(path);
+    }
 
-        /* ---------------------------------------------------------- */
-        /*  Comandi disponibili dopo il login                          */
-        /* ---------------------------------------------------------- */
-
-        if (strcmp(p, "WHOAMI") == 0) {
-            proto_sendf(client_fd, PROTO_OK_WHOAMI, me);
-
-        } else if (strcmp(p, "USERS") == 0) {
-            char buf[512];
-            state_users(&g_state, buf, sizeof(buf));
-            send_all(client_fd, buf);
-
-        } else if (strcmp(p, "CREATE") == 0) {
-            int id = matches_create(&g_matches, client_fd);
-            if (id < 0) {
-                send_all(client_fd, PROTO_ERR_MATCHES_FULL);
-            } else {
-                proto_sendf(client_fd, PROTO_OK_MATCH_CREATED, id);
-                char bcast[128];
-                snprintf(bcast, sizeof(bcast), PROTO_EVENT_MATCH_AVAILABLE, id, me);
-                state_broadcast(&g_state, bcast, client_fd);
-            }
-
-        } else if (strcmp(p, "LIST") == 0) {
-            char buf[1024];
-            matches_list(&g_matches, &g_state, buf, sizeof(buf));
-            send_all(client_fd, buf);
-
-        } else if (strncmp(p, "JOIN", 4) == 0 && (p[4] == ' ' || p[4] == '\0')) {
-            int id;
-            if (sscanf(p, "JOIN %d", &id) != 1) {
-                send_all(client_fd, PROTO_ERR_BAD_USAGE);
-                continue;
-            }
-            if (state_get_playing_match(&g_state, client_fd) != -1) {
-                send_all(client_fd, PROTO_ERR_ALREADY_PLAYING);
-                continue;
-            }
-            int owner_fd = -1;
-            int rc = matches_request_join(&g_matches, id, client_fd, &owner_fd);
-            if (rc == 0) {
-                proto_sendf(owner_fd, PROTO_EVENT_JOIN_REQUEST, id, me);
-                send_all(client_fd, PROTO_OK_JOIN_REQUESTED);
-            } else if (rc == -1) {
-                send_all(client_fd, PROTO_ERR_MATCH_NOT_FOUND);
-            } else if (rc == -2) {
-                send_all(client_fd, PROTO_ERR_MATCH_NOT_JOINABLE);
-            } else if (rc == -3) {
-                send_all(client_fd, PROTO_ERR_CANNOT_JOIN_OWN);
-            } else {
-                send_all(client_fd, PROTO_ERR_JOIN_FAILED);
-            }
-
-        } else if (strncmp(p, "ACCEPT", 6) == 0 && (p[6] == ' ' || p[6] == '\0')) {
-            int id;
-            if (sscanf(p, "ACCEPT %d", &id) != 1) {
-                send_all(client_fd, PROTO_ERR_BAD_USAGE);
-                continue;
-            }
-            int joiner_fd = -1;
-            int rc = matches_accept(&g_matches, id, client_fd, &joiner_fd);
-            if (rc == 0) {
-                state_set_playing_match(&g_state, client_fd, id);
-                state_set_playing_match(&g_state, joiner_fd, id);
-
-                char joiner_name[MAX_NAME] = "??";
-                state_get_name_copy(&g_state, joiner_fd, joiner_name, sizeof(joiner_name));
-
-                notify_match_start(id,
-                    client_fd, me,
-                    joiner_fd, joiner_name,
-                    PROTO_OK_MATCH_STARTED_X,
-                    PROTO_OK_MATCH_STARTED_O);
-
-                char bcast[128];
-                snprintf(bcast, sizeof(bcast), PROTO_EVENT_MATCH_STARTED_ALL, id);
-                state_broadcast(&g_state, bcast, -1);
-
-            } else if (rc == -1) {
-                send_all(client_fd, PROTO_ERR_MATCH_NOT_FOUND);
-            } else if (rc == -2) {
-                send_all(client_fd, PROTO_ERR_NOT_OWNER);
-            } else if (rc == -3) {
-                send_all(client_fd, PROTO_ERR_NO_PENDING);
-            } else {
-                send_all(client_fd, PROTO_ERR_ACCEPT_FAILED);
-            }
-
-        } else if (strncmp(p, "REJECT", 6) == 0 && (p[6] == ' ' || p[6] == '\0')) {
-            int id;
-            if (sscanf(p, "REJECT %d", &id) != 1) {
-                send_all(client_fd, PROTO_ERR_BAD_USAGE);
-                continue;
-            }
-            int rejected_fd = -1;
-            int rc = matches_reject(&g_matches, id, client_fd, &rejected_fd);
-            if (rc == 0) {
-                send_all(client_fd, PROTO_OK_REJECTED);
-                if (rejected_fd != -1) send_all(rejected_fd, PROTO_ERR_JOIN_REJECTED);
-            } else if (rc == -1) {
-                send_all(client_fd, PROTO_ERR_MATCH_NOT_FOUND);
-            } else if (rc == -2) {
-                send_all(client_fd, PROTO_ERR_NOT_OWNER);
-            } else if (rc == -3) {
-                send_all(client_fd, PROTO_ERR_NO_PENDING);
-            } else {
-                send_all(client_fd, PROTO_ERR_REJECT_FAILED);
-            }
-
-        } else if (strncmp(p, "MOVE", 4) == 0 && (p[4] == ' ' || p[4] == '\0')) {
-            int rr, cc;
-            if (sscanf(p, "MOVE %d %d", &rr, &cc) != 2) {
-                send_all(client_fd, PROTO_ERR_BAD_USAGE);
-                continue;
-            }
-            int mid = state_get_playing_match(&g_state, client_fd);
-            if (mid == -1) {
-                send_all(client_fd, PROTO_ERR_NOT_IN_MATCH);
-                continue;
-            }
-            int  opp_fd = -1;
-            char boardbuf[512];
-            char winner[MAX_NAME] = {0};
-            int mrc = matches_move(&g_matches, &g_state, mid, client_fd, rr, cc,
-                                   &opp_fd, boardbuf, sizeof(boardbuf),
-                                   winner, sizeof(winner));
-            if (mrc == 0) {
-                send_all(client_fd, PROTO_OK_MOVED);
-                send_all(client_fd, boardbuf);
-                if (opp_fd != -1) {
-                    proto_sendf(opp_fd, PROTO_EVENT_OPPONENT_MOVED, rr, cc);
-                    send_all(opp_fd, boardbuf);
-                }
-
-            } else if (mrc == 1) {
-                /* Vittoria */
-                state_clear_playing_match(&g_state, client_fd);
-                if (opp_fd != -1) state_clear_playing_match(&g_state, opp_fd);
-
-                send_all(client_fd, PROTO_EVENT_YOU_WIN);
-                proto_sendf(client_fd, PROTO_EVENT_WINNER, winner);
-                send_all(client_fd, boardbuf);
-                send_all(client_fd, PROTO_EVENT_GAME_OVER_WIN);
-
-                if (opp_fd != -1) {
-                    send_all(opp_fd, PROTO_EVENT_YOU_LOSE);
-                    proto_sendf(opp_fd, PROTO_EVENT_WINNER, winner);
-                    send_all(opp_fd, boardbuf);
-                    send_all(opp_fd, PROTO_EVENT_GAME_OVER_LOSE);
-                }
-
-                char bcast[64];
-                snprintf(bcast, sizeof(bcast), PROTO_EVENT_MATCH_FINISHED, mid);
-                state_broadcast(&g_state, bcast, -1);
-
-            } else if (mrc == 2) {
-                /* Pareggio */
-                state_clear_playing_match(&g_state, client_fd);
-                if (opp_fd != -1) state_clear_playing_match(&g_state, opp_fd);
-
-                send_all(client_fd, PROTO_EVENT_DRAW);
-                send_all(client_fd, boardbuf);
-                send_all(client_fd, PROTO_EVENT_GAME_OVER_DRAW);
-
-                if (opp_fd != -1) {
-                    send_all(opp_fd, PROTO_EVENT_DRAW);
-                    send_all(opp_fd, boardbuf);
-                    send_all(opp_fd, PROTO_EVENT_GAME_OVER_DRAW);
-                }
-
-                char bcast[64];
-                snprintf(bcast, sizeof(bcast), PROTO_EVENT_MATCH_FINISHED, mid);
-                state_broadcast(&g_state, bcast, -1);
-
-            } else if (mrc == -4) {
-                send_all(client_fd, PROTO_ERR_NOT_YOUR_TURN);
-            } else if (mrc == -5) {
-                send_all(client_fd, PROTO_ERR_BAD_MOVE);
-            } else if (mrc == -2) {
-                send_all(client_fd, PROTO_ERR_MATCH_NOT_PLAYING);
-            } else {
-                send_all(client_fd, PROTO_ERR_MOVE_FAILED);
-            }
-
-        } else if (strcmp(p, "BOARD") == 0) {
-            int mid = state_get_playing_match(&g_state, client_fd);
-            if (mid == -1) {
-                send_all(client_fd, PROTO_ERR_NOT_IN_MATCH);
-                continue;
-            }
-            char bbuf[512];
-            if (matches_board(&g_matches, mid, bbuf, sizeof(bbuf)) == 0)
-                send_all(client_fd, bbuf);
-            else
-                send_all(client_fd, PROTO_ERR_BOARD_NOT_FOUND);
-
-        } else if (strcmp(p, "RESIGN") == 0) {
-            int mid = state_get_playing_match(&g_state, client_fd);
-            if (mid == -1) {
-                send_all(client_fd, PROTO_ERR_NOT_IN_MATCH);
-                continue;
-            }
-            int  opp_fd = -1;
-            char boardbuf[512];
-            char winner[MAX_NAME] = {0};
-            int rrc = matches_resign(&g_matches, &g_state, mid, client_fd,
-                                     &opp_fd, boardbuf, sizeof(boardbuf),
-                                     winner, sizeof(winner));
-            if (rrc == 0) {
-                state_clear_playing_match(&g_state, client_fd);
-                if (opp_fd != -1) state_clear_playing_match(&g_state, opp_fd);
-
-                send_all(client_fd, PROTO_EVENT_YOU_LOSE);
-                proto_sendf(client_fd, PROTO_EVENT_WINNER, winner);
-                send_all(client_fd, boardbuf);
-                send_all(client_fd, PROTO_EVENT_GAME_OVER_LOSE);
-
-                if (opp_fd != -1) {
-                    send_all(opp_fd, PROTO_EVENT_YOU_WIN);
-                    proto_sendf(opp_fd, PROTO_EVENT_WINNER, winner);
-                    send_all(opp_fd, boardbuf);
-                    send_all(opp_fd, PROTO_EVENT_GAME_OVER_WIN);
-                }
-
-                char bcast[64];
-                snprintf(bcast, sizeof(bcast), PROTO_EVENT_MATCH_FINISHED, mid);
-                state_broadcast(&g_state, bcast, -1);
-
-            } else if (rrc == -2) {
-                send_all(client_fd, PROTO_ERR_MATCH_NOT_PLAYING);
-            } else if (rrc == -4) {
-                send_all(client_fd, PROTO_ERR_NO_OPPONENT);
-            } else {
-                send_all(client_fd, PROTO_ERR_RESIGN_FAILED);
-            }
-
-        } else if (strcmp(p, "REMATCH") == 0) {
-            /*
-             * REMATCH: cerca la partita terminata (MATCH_REMATCH) in cui
-             * questo client era coinvolto, e crea una nuova partita WAITING
-             * con lui come owner (X).
-             * Solo il vincitore (o entrambi in caso di pareggio) può farlo.
-             */
-            int old_mid = matches_find_rematch(&g_matches, client_fd);
-            if (old_mid == -1) {
-                send_all(client_fd, PROTO_ERR_REMATCH_NOT_AVAIL);
-                continue;
-            }
-
-            int new_mid = matches_rematch(&g_matches, old_mid, client_fd);
-
-            if (new_mid >= 1) {
-                /* Nuova partita creata: il richiedente è owner (X) */
-                proto_sendf(client_fd, PROTO_OK_REMATCH_CREATED, new_mid);
-
-                /* Broadcast a tutti: nuova partita disponibile */
-                char bcast[128];
-                snprintf(bcast, sizeof(bcast), PROTO_EVENT_MATCH_AVAILABLE, new_mid, me);
-                state_broadcast(&g_state, bcast, client_fd);
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) { perror("socket"); return -1; }
 
-            } else if (new_mid == -3) {
-                /* Perdente tenta il rematch */
-                send_all(client_fd, PROTO_ERR_REMATCH_DENIED);
-            } else if (new_mid == -4) {
-                send_all(client_fd, PROTO_ERR_MATCHES_FULL);
-            } else {
-                send_all(client_fd, PROTO_ERR_REMATCH_FAILED);
-            }
-
-        } else {
-            send_all(client_fd, PROTO_ERR_UNKNOWN_CMD);
-        }
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        perror("bind"); close(fd); return -1;
     }
+    if (listen(fd, BACKLOG) < 0) {
+        perror("listen"); close(fd); return -1;
+    }
+    return fd;
+}
 
-    /* ---------------------------------------------------------------- */
-    /*  Cleanup disconnessione                                           */
-    /* ---------------------------------------------------------------- */
-    printf("Client disconnesso: %s (fd=%d)\n",
-           me[0] ? me : "<not logged in>", client_fd);
-
-    matches_on_disconnect(&g_matches, &g_state, client_fd);
-    state_remove_client(&g_state, client_fd);
-    close(client_fd);
-    return NULL;
+static void usage(const char *prog) {
+    fprintf(stderr, "Uso: %s [-H <sock_handover>] [-g <grazia_sec>] "
+                    "[-r <file_rating>] [-b <fascia_rating>] [-i <inattivita_sec>] "
+                    "[-p <ping_sec>] [-T <turno_sec>] [-l <righe_sec>] "
+                    "[-I threaded|epoll|uring] [-w <worker>] [-S <stack_kb>] "
+                    "[-L <file_log>] [-v debug|info|warn|error] [-D <sottosistemi>] "
+                    "[-M <lobby>] [-U <socket_unix>] [-C <file_cattura>] <porta>\n", prog);
 }
 
 /* ------------------------------------------------------------------ */
 /*  main                                                                */
 /* ------------------------------------------------------------------ */
 int main(int argc, char *argv[]) {
-    if (argc != 2) {
-        fprintf(stderr, "Uso: %s <porta>\n", argv[0]);
+    const char *handover_path = NULL;
+    const char *ratings_path  = NULL;
+    int         band          = 0;
+    int         workers       = 0;
+    int         stack_kb      = IO_DEFAULT_STACK_KB;
+    const io_backend_t *io    = &io_threaded;
+    const char *log_path      = NULL;
+    const char *lobby_name    = NULL;
+    const char *local_path    = NULL;
+    const char *capture_path  = NULL;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "H:g:r:b:i:p:T:l:I:w:S:L:v:D:M:U:C:")) != -1) {
+        switch (opt) {
+            case 'H': handover_path = optarg; break;
+            case 'g': g_grace_sec = atoi(optarg); break;
+            case 'r': ratings_path = optarg; break;
+            case 'b': band = atoi(optarg); break;
+            case 'i': g_idle_sec = atoi(optarg); break;
+            case 'p': g_ping_sec = atoi(optarg); break;
+            case 'T': g_turn_sec = atoi(optarg); break;
+            case 'l': {
+                /* Righe al secondo per connessione; 0 = nessun limite */
+                int rate = atoi(optarg);
+                rl_configure(RL_ANY, rate, 2 * rate);
+                if (rate <= 0) {
+                    rl_configure(RL_QUERY, 0, 0);
+                    rl_configure(RL_LOBBY, 0, 0);
+                }
+                break;
+            }
+            case 'I':
+                io = io_find(optarg);
+                if (!io) { usage(argv[0]); return 1; }
+                break;
+            case 'w': workers = atoi(optarg); break;
+            case 'S': stack_kb = atoi(optarg); break;
+            case 'L': log_path = optarg; break;
+            case 'M': lobby_name = optarg; break;
+            case 'U': local_path = optarg; break;
+            case 'C': capture_path = optarg; break;
+            case 'v':
+                g_log_level = log_parse_level(optarg);
+                if (g_log_level < 0) { usage(argv[0]); return 1; }
+                break;
+            case 'D':
+                if (log_parse_mask(optarg, &g_log_mask) < 0) { usage(argv[0]); return 1; }
+                break;
+            default:  usage(argv[0]); return 1;
+        }
+    }
+    if (optind != argc - 1 || stack_kb < 0) {
+        usage(argv[0]);
         return 1;
     }
-    int port = atoi(argv[1]);
+    int port = atoi(argv[optind]);
     if (port <= 0 || port > 65535) {
         fprintf(stderr, "Porta non valida.\n");
         return 1;
     }
-
-    state_init(&g_state);
-    matches_init(&g_matches);
-
-    int listen_fd = socket(AF_INET, SOCK_STREAM, 0);
-    if (listen_fd < 0) { perror("socket"); return 1; }
-
-    int opt = 1;
-    setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
-
-    struct sockaddr_in addr;
-    memset(&addr, 0, sizeof(addr));
-    addr.sin_family      = AF_INET;
-    addr.sin_addr.s_addr = htonl(INADDR_ANY);
-    addr.sin_port        = htons((uint16_t)port);
-
-    if (bind(listen_fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
-        perror("bind"); close(listen_fd); return 1;
+    /*
+     * I rating restano per processo anche nella lobby condivisa: con lo
+     * stesso file di default ogni salvataggio cancellerebbe quelli degli
+     * altri processi.
+     */
+    if (!ratings_path && lobby_name) {
+        fprintf(stderr, "Con -M ogni processo deve avere il suo file di rating (-r).\n");
+        return 1;
     }
-    if (listen(listen_fd, BACKLOG) < 0) {
-        perror("listen"); close(listen_fd); return 1;
+    if (!ratings_path) ratings_path = DEFAULT_RATINGS;
+    if (log_start(log_path) < 0) {
+        perror("log_start");
+        return 1;
+    }
+    if (capture_path && capture_start(capture_path) < 0) {
+        perror("capture_start");
+        return 1;
     }
-    printf("Server in ascolto sulla porta %d...\n", port);
-
-    while (1) {
-        struct sockaddr_in client_addr;
-        socklen_t clen = sizeof(client_addr);
-        int client_fd = accept(listen_fd, (struct sockaddr *)&client_addr, &clen);
-        if (client_fd < 0) { perror("accept"); continue; }
 
-        char ip[INET_ADDRSTRLEN];
-        inet_ntop(AF_INET, &client_addr.sin_addr, ip, sizeof(ip));
-        printf("Client connesso: %s:%d (fd=%d)\n",
-               ip, ntohs(client_addr.sin_port), client_fd);
+    if (core_init(ratings_path, band) < 0) {
+        perror("core_init");
+        return 1;
+    }
 
-        state_add_client(&g_state, client_fd);
+    /*
+     * Con -H il server prova prima a subentrare a un processo già in
+     * esecuzione sullo stesso socket di handover; se non c'è nessuno
+     * parte da zero.  In entrambi i casi resta poi in attesa del
+     * successore sullo stesso percorso.
+     */
+    handover_ctx_t hctx = { &g_state, &g_matches, &g_queue, &g_ratings, &g_spect, -1, -1 };
+    int ho = 1;
+    if (handover_path) {
+        ho = handover_takeover(handover_path, &hctx);
+        if (ho < 0) {
+            fprintf(stderr, "Handover fallito.\n");
+            return 1;
+        }
+    }
+    int listen_fd = hctx.listen_fd;
+    int local_fd  = hctx.local_fd;
+    if (lobby_name && lobby_attach(lobby_name) < 0) {
+        perror("lobby_attach");
+        return 1;
+    }
+    if (core_start() < 0) {
+        perror("core_start");
+        return 1;
+    }
 
-        int *pfd = malloc(sizeof(int));
-        if (!pfd) {
-            perror("malloc");
-            close(client_fd);
-            state_remove_client(&g_state, client_fd);
-            continue;
+    io_opts_t opts = { workers, (size_t)stack_kb * 1024 };
+    while (io->start(&opts) < 0) {
+        if (!io->fallback) {
+            perror(io->name);
+            return 1;
         }
-        *pfd = client_fd;
+        fprintf(stderr, "Backend %s non disponibile (%s), uso %s.\n",
+                io->name, strerror(errno), io->fallback->name);
+        io = io->fallback;
+    }
 
-        pthread_t tid;
-        if (pthread_create(&tid, NULL, client_handler, pfd) != 0) {
-            perror("pthread_create");
-            close(client_fd);
-            state_remove_client(&g_state, client_fd);
-            free(pfd);
-            continue;
+    if (ho == 0) {
+        int resumed = 0;
+        for (int i = 0; i < MAX_CLIENTS; i++) {
+            int fd = g_state.clients[i].fd;
+            if (fd == 0 || g_state.clients[i].detached_until) continue;
+            if (io->adopt(fd, 1) < 0) {
+                session_drop(fd);
+                continue;
+            }
+            resumed++;
         }
-        pthread_detach(tid);
+        LOG(LOG_INFO, LOG_SYS_HANDOVER, "Handover ricevuto: %ld client ripresi.", resumed);
+    } else {
+        listen_fd = open_listener(port, lobby_name != NULL);
+        if (listen_fd < 0) return 1;
+    }
+    /* Il socket locale ereditato resta quello del predecessore */
+    if (local_path && local_fd < 0) {
+        local_fd = open_local(local_path);
+        if (local_fd < 0) return 1;
+    }
+
+    hctx.listen_fd = listen_fd;
+    hctx.local_fd  = local_fd;
+    if (handover_path && handover_listen(handover_path, &hctx) < 0) {
+        perror("handover_listen");
+        close(listen_fd);
+        return 1;
     }
 
+    LOG(LOG_INFO, LOG_SYS_MAIN, "Server in ascolto sulla porta %ld...", port);
+    if (local_path)
+        LOGS(LOG_INFO, LOG_SYS_MAIN, local_path, "In ascolto anche su %s");
+
+    io_serve(io, listen_fd, local_fd);
+
     close(listen_fd);
     return 0;
 }
\ No newline at end of file
@@ -2,6 +2,8 @@
 #include "state.h"
 #include "net.h"
 #include "protocol.h"
+#include "solver.h"
+#include "rules.h"
 #include <string.h>
 #include <stdio.h>
 
@@ -9,30 +11,53 @@
 /*  Helpers interni                                                     */
 /* ------------------------------------------------------------------ */
 
-static void board_clear(char b[3][3]) {
-    for (int r = 0; r < 3; r++)
-        for (int c = 0; c < 3; c++)
-            b[r][c] = ' ';
+static int is_classic(const match_t *m) {
+    return m->rows == 3 && m->cols == 3 && m->k == 3;
 }
 
-static int check_winner(char b[3][3], char ch) {
-    for (int i = 0; i < 3; i++) {
-        if (b[i][0]==ch && b[i][1]==ch && b[i][2]==ch) return 1;
-        if (b[0][i]==ch && b[1][i]==ch && b[2][i]==ch) return 1;
-    }
-    if (b[0][0]==ch && b[1][1]==ch && b[2][2]==ch) return 1;
-    if (b[0][2]==ch && b[1][1]==ch && b[2][0]==ch) return 1;
-    return 0;
+static const char *turn_label(const match_hot_t *h, const match_t *m) {
+    if (h->status != MATCH_PLAYING) return "-";
+    return m->turn == 0 ? "X (owner)" : "O (joiner)";
 }
 
-static int board_full(char b[3][3]) {
-    for (int r = 0; r < 3; r++)
-        for (int c = 0; c < 3; c++)
-            if (b[r][c] == ' ') return 0;
-    return 1;
+/*
+ * Varianti più grandi: una riga per riga della board, un carattere per
+ * cella ('.' = vuota) e le colonne numerate su due righe (decine/unità).
+ * Una 15x15 sta in circa 400 byte.
+ */
+static void render_compact(const match_hot_t *h, const match_t *m, char *out, int outsz) {
+    char *p    = out;
+    int   left = outsz;
+    int   n;
+
+#define EMIT(...) do { n = snprintf(p, left, __VA_ARGS__); \
+                       if (n < 0 || n >= left) return;     \
+                       p += n; left -= n; } while (0)
+
+    EMIT("Board (match %d, %dx%d, k=%d):\n", h->id, m->rows, m->cols, m->k);
+    if (m->cols > 10) {
+        EMIT("   ");
+        for (int c = 0; c < m->cols; c++) EMIT("%c", c >= 10 ? '0' + c / 10 : ' ');
+        EMIT("\n");
+    }
+    EMIT("   ");
+    for (int c = 0; c < m->cols; c++) EMIT("%d", c % 10);
+    EMIT("\n");
+    for (int r = 0; r < m->rows; r++) {
+        EMIT("%2d ", r);
+        for (int c = 0; c < m->cols; c++) {
+            char ch = m->board[r * m->cols + c];
+            EMIT("%c", ch == ' ' ? '.' : ch);
+        }
+        EMIT("\n");
+    }
+    EMIT("Turno: %s\n", turn_label(h, m));
+#undef EMIT
 }
 
-static void render_board(const match_t *m, char *out, int outsz) {
+static void render_board(const match_hot_t *h, const match_t *m, char *out, int outsz) {
+    if (!is_classic(m)) { render_compact(h, m, out, outsz); return; }
+    const char *b = m->board;
     snprintf(out, outsz,
         "Board (match %d):\n"
         " %c | %c | %c \n"
@@ -41,67 +66,408 @@ static void render_board(const match_t *m, char *out, int outsz) {
         "-----------\n"
         " %c | %c | %c \n"
         "Turno: %s\n",
-        m->id,
-        m->board[0][0], m->board[0][1], m->board[0][2],
-        m->board[1][0], m->board[1][1], m->board[1][2],
-        m->board[2][0], m->board[2][1], m->board[2][2],
-        (m->status == MATCH_PLAYING)
-            ? (m->turn == 0 ? "X (owner)" : "O (joiner)")
-            : "-"
+        h->id,
+        b[0], b[1], b[2],
+        b[3], b[4], b[5],
+        b[6], b[7], b[8],
+        turn_label(h, m)
     );
 }
 
-static match_t *find_free_slot(match_store_t *ms) {
-    for (int i = 0; i < MAX_MATCHES; i++)
-        if (ms->matches[i].id == 0) return &ms->matches[i];
+static void push_event(match_t *m, char kind, char mark, int r, int c) {
+    match_event_t *e = &m->events[m->seq % MATCH_EVENT_RING];
+    e->seq  = ++m->seq;
+    e->kind = kind;
+    e->mark = mark;
+    e->r    = (signed char)r;
+    e->c    = (signed char)c;
+}
+
+/*
+ * Aggiorna i rating a partita decisa.  Chiamata dopo aver rilasciato
+ * ms->mtx: i nomi si leggono da st, prima che i client vengano rimossi.
+ */
+static void record_result(match_store_t *ms, server_state_t *st,
+                          int winner_fd, int loser_fd, int draw) {
+    if (!ms->ratings) return;
+    char a[MAX_NAME], b[MAX_NAME];
+    if (!state_get_name_copy(st, winner_fd, a, sizeof(a)) ||
+        !state_get_name_copy(st, loser_fd,  b, sizeof(b)))
+        return;
+    rating_record(ms->ratings, a, b, draw);
+}
+
+/* Timer di turno: chiamati con ms->mtx preso (ordine ms -> ruota) */
+static void turn_arm(match_store_t *ms, const match_hot_t *h) {
+    if (ms->wheel && ms->turn_sec > 0)
+        tw_arm(ms->wheel, &ms->turn_timer[h - ms->hot],
+               (unsigned)ms->turn_sec * TW_TICKS_PER_SEC, h->id);
+}
+
+static void turn_stop(match_store_t *ms, const match_hot_t *h) {
+    if (ms->wheel)
+        tw_cancel(ms->wheel, &ms->turn_timer[h - ms->hot]);
+}
+
+/*
+ * Le scansioni leggono solo la parte calda.  Con prenotazioni in corso
+ * uno slot libero va a chi non ha prenotato solo se ne restano almeno
+ * ms->reserved per i tornei.
+ */
+static match_hot_t *find_free_slot(match_store_t *ms) {
+    match_hot_t *first = NULL;
+    int          nfree = 0;
+    for (int i = 0; i < MAX_MATCHES; i++) {
+        if (ms->hot[i].id != 0) continue;
+        if (!first) first = &ms->hot[i];
+        if (++nfree > ms->reserved) return first;
+    }
     return NULL;
 }
 
-static match_t *find_match(match_store_t *ms, int match_id) {
+static int count_free(const match_store_t *ms) {
+    int n = 0;
     for (int i = 0; i < MAX_MATCHES; i++)
-        if (ms->matches[i].id == match_id) return &ms->matches[i];
+        if (ms->hot[i].id == 0) n++;
+    return n;
+}
+
+static match_hot_t *find_match(match_store_t *ms, int match_id) {
+    for (int i = 0; i < MAX_MATCHES; i++)
+        if (ms->hot[i].id == match_id) return &ms->hot[i];
+    return NULL;
+}
+
+static match_t *cold_of(match_store_t *ms, const match_hot_t *h) {
+    return &ms->matches[h - ms->hot];
+}
+
+/* ------------------------------------------------------------------ */
+/*  Indice inverso giocatore -> partite                                 */
+/* ------------------------------------------------------------------ */
+
+#define PLAYERS_MASK (MATCH_PLAYERS_SIZE - 1)
+
+enum { ROLE_OWNER = 0, ROLE_JOINER = 1, ROLE_PENDING = 2 };
+
+static unsigned hash_fd(int fd) {
+    unsigned h = (unsigned)fd * 2654435761u;  /* Knuth */
+    return h ^ (h >> 16);
+}
+
+static int *role_fd(match_hot_t *h, int role) {
+    switch (role) {
+        case ROLE_OWNER:  return &h->owner_fd;
+        case ROLE_JOINER: return &h->joiner_fd;
+        default:          return &h->pending_fd;
+    }
+}
+
+static void players_clear(match_store_t *ms) {
+    for (int i = 0; i < MATCH_PLAYERS_SIZE; i++) ms->players[i].fd = -1;
+}
+
+static match_player_t *player_find(match_store_t *ms, int fd) {
+    for (unsigned i = hash_fd(fd) & PLAYERS_MASK; ms->players[i].fd != -1;
+         i = (i + 1) & PLAYERS_MASK)
+        if (ms->players[i].fd == fd) return &ms->players[i];
     return NULL;
 }
 
-static void match_reset(match_t *m) {
-    m->id        = 0;
-    m->status    = MATCH_FINISHED;
-    m->owner_fd  = -1;
-    m->joiner_fd = -1;
-    m->pending_fd= -1;
+static match_player_t *player_get(match_store_t *ms, int fd) {
+    unsigned i = hash_fd(fd) & PLAYERS_MASK;
+    for (; ms->players[i].fd != -1; i = (i + 1) & PLAYERS_MASK)
+        if (ms->players[i].fd == fd) return &ms->players[i];
+    match_player_t *p = &ms->players[i];
+    p->fd = fd;
+    for (int r = 0; r < MATCH_ROLES; r++) p->head[r] = -1;
+    return p;
+}
+
+/* Backward shift come in state.c: i puntatori a voci successive cambiano */
+static void player_remove(match_store_t *ms, match_player_t *p) {
+    unsigned i = (unsigned)(p - ms->players);
+    unsigned j = i;
+    while (1) {
+        j = (j + 1) & PLAYERS_MASK;
+        if (ms->players[j].fd == -1) break;
+        unsigned home = hash_fd(ms->players[j].fd) & PLAYERS_MASK;
+        if (((j - home) & PLAYERS_MASK) >= ((j - i) & PLAYERS_MASK)) {
+            ms->players[i] = ms->players[j];
+            i = j;
+        }
+    }
+    ms->players[i].fd = -1;
+}
+
+static void link_add(match_store_t *ms, int slot, int role, int fd) {
+    if (fd < 0) return;
+    match_player_t *p = player_get(ms, fd);
+    match_link_t   *l = &ms->link[slot];
+    l->prev[role] = -1;
+    l->next[role] = (short)p->head[role];
+    if (p->head[role] != -1) ms->link[p->head[role]].prev[role] = (short)slot;
+    p->head[role] = slot;
+}
+
+static void link_del(match_store_t *ms, int slot, int role, int fd) {
+    if (fd < 0) return;
+    match_player_t *p = player_find(ms, fd);
+    if (!p) return;
+    const match_link_t *l = &ms->link[slot];
+    if (l->prev[role] != -1) ms->link[l->prev[role]].next[role] = l->next[role];
+    else                     p->head[role] = l->next[role];
+    if (l->next[role] != -1) ms->link[l->next[role]].prev[role] = l->prev[role];
+    if (p->head[ROLE_OWNER] == -1 && p->head[ROLE_JOINER] == -1 &&
+        p->head[ROLE_PENDING] == -1)
+        player_remove(ms, p);
+}
+
+/* Unico punto in cui cambiano owner/joiner/pending: l'indice resta allineato */
+static void set_fd(match_store_t *ms, match_hot_t *h, int role, int fd) {
+    int *f = role_fd(h, role);
+    if (*f == fd) return;
+    int slot = (int)(h - ms->hot);
+    link_del(ms, slot, role, *f);
+    *f = fd;
+    link_add(ms, slot, role, fd);
+}
+
+/* Id di una partita nuova: dalla directory se c'è */
+static int next_id(match_store_t *ms) {
+    return ms->dir ? ms->dir->next_id() : ms->next_id++;
+}
+
+/* Ogni cambio di stato passa da qui: la directory resta allineata */
+static void set_status(match_store_t *ms, match_hot_t *h, match_status_t status) {
+    h->status = status;
+    if (ms->dir) ms->dir->publish(h->id, h, cold_of(ms, h));
+}
+
+static void match_reset(match_store_t *ms, match_hot_t *h) {
+    match_t *m = cold_of(ms, h);
+    if (h->id != 0 && ms->dir) ms->dir->publish(h->id, NULL, NULL);
+    h->id        = 0;
+    h->status    = MATCH_FINISHED;
+    set_fd(ms, h, ROLE_OWNER,   -1);
+    set_fd(ms, h, ROLE_JOINER,  -1);
+    set_fd(ms, h, ROLE_PENDING, -1);
     m->winner_fd = -1;
     m->loser_fd  = -1;
     m->draw      = 0;
     m->turn      = 0;
-    board_clear(m->board);
+    m->seq       = 0;
+    m->ai        = MATCH_AI_NONE;
+    m->tour      = 0;
+    m->rows      = 3;
+    m->cols      = 3;
+    m->k         = 3;
+    m->stones    = 0;
+    rules_board_clear(m->board, MATCH_MAX_CELLS);
 }
 
 /* ------------------------------------------------------------------ */
 /*  Inizializzazione                                                    */
 /* ------------------------------------------------------------------ */
 
-void matches_init(match_store_t *ms) {
+void matches_init(match_store_t *ms, rating_store_t *rs) {
     pthread_mutex_init(&ms->mtx, NULL);
-    ms->next_id = 1;
+    ms->next_id  = 1;
+    ms->reserved = 0;
+    ms->dir     = NULL;
+    ms->ratings = rs;
+    ms->wheel    = NULL;
+    ms->turn_sec = 0;
+    players_clear(ms);
+    for (int i = 0; i < MAX_MATCHES; i++) {
+        match_hot_t *h = &ms->hot[i];
+        h->owner_fd = h->joiner_fd = h->pending_fd = -1;
+        match_reset(ms, h);
+        tw_node_init(&ms->turn_timer[i], TW_TURN);
+    }
+}
+
+void matches_set_turn_timer(match_store_t *ms, timewheel_t *tw, int turn_sec) {
+    pthread_mutex_lock(&ms->mtx);
+    ms->wheel    = tw;
+    ms->turn_sec = turn_sec;
+    for (int i = 0; i < MAX_MATCHES; i++)
+        if (ms->hot[i].id != 0 && ms->hot[i].status == MATCH_PLAYING)
+            turn_arm(ms, &ms->hot[i]);
+    pthread_mutex_unlock(&ms->mtx);
+}
+
+void matches_set_dir(match_store_t *ms, const match_dir_t *dir) {
+    pthread_mutex_lock(&ms->mtx);
+    ms->dir = dir;
     for (int i = 0; i < MAX_MATCHES; i++)
-        match_reset(&ms->matches[i]);
+        if (ms->hot[i].id != 0) set_status(ms, &ms->hot[i], ms->hot[i].status);
+    pthread_mutex_unlock(&ms->mtx);
+}
+
+void matches_rebuild_index(match_store_t *ms) {
+    pthread_mutex_lock(&ms->mtx);
+    players_clear(ms);
+    for (int i = 0; i < MAX_MATCHES; i++) {
+        match_hot_t *h = &ms->hot[i];
+        /* Un risultato di torneo che nessuno raccoglierà più: slot libero */
+        if (ms->matches[i].tour && h->status == MATCH_REMATCH) h->id = 0;
+        ms->matches[i].tour = 0;
+        for (int r = 0; r < MATCH_ROLES; r++) {
+            if (h->id == 0) *role_fd(h, r) = -1;
+            link_add(ms, i, r, *role_fd(h, r));
+        }
+    }
+    pthread_mutex_unlock(&ms->mtx);
 }
 
 /* ------------------------------------------------------------------ */
 /*  CREATE                                                              */
 /* ------------------------------------------------------------------ */
 
-int matches_create(match_store_t *ms, int owner_fd) {
+int matches_create(match_store_t *ms, int owner_fd, int rows, int cols, int k) {
+    if (!rules_mnk_valid(rows, cols, k)) return -2;
+
     pthread_mutex_lock(&ms->mtx);
-    match_t *m = find_free_slot(ms);
-    if (!m) { pthread_mutex_unlock(&ms->mtx); return -1; }
+    match_hot_t *h = find_free_slot(ms);
+    if (!h) { pthread_mutex_unlock(&ms->mtx); return -1; }
+
+    match_reset(ms, h);
+    match_t *m = cold_of(ms, h);
+    h->id       = next_id(ms);
+    set_fd(ms, h, ROLE_OWNER, owner_fd);
+    m->rows     = (unsigned char)rows;
+    m->cols     = (unsigned char)cols;
+    m->k        = (unsigned char)k;
+    set_status(ms, h, MATCH_WAITING);
+
+    int id = h->id;
+    pthread_mutex_unlock(&ms->mtx);
+    return id;
+}
+
+/* Con ms->mtx preso: fd ha una partita in attesa, in richiesta o in corso */
+static int player_busy(match_store_t *ms, int fd) {
+    const match_player_t *p = player_find(ms, fd);
+    for (int r = 0; p && r < MATCH_ROLES; r++)
+        for (int i = p->head[r]; i != -1; i = ms->link[i].next[r])
+            if (ms->hot[i].status == MATCH_WAITING || ms->hot[i].status == MATCH_PENDING ||
+                ms->hot[i].status == MATCH_PLAYING)
+                return 1;
+    return 0;
+}
+
+int matches_player_busy(match_store_t *ms, int fd) {
+    pthread_mutex_lock(&ms->mtx);
+    int busy = player_busy(ms, fd);
+    pthread_mutex_unlock(&ms->mtx);
+    return busy;
+}
+
+int matches_create_playing(match_store_t *ms, int owner_fd, int joiner_fd,
+                           int (*claim)(int owner_fd, int joiner_fd)) {
+    pthread_mutex_lock(&ms->mtx);
+    if (player_busy(ms, owner_fd) || player_busy(ms, joiner_fd)) {
+        pthread_mutex_unlock(&ms->mtx);
+        return -2;
+    }
+    match_hot_t *h = find_free_slot(ms);
+    if (!h) { pthread_mutex_unlock(&ms->mtx); return -1; }
+    if (claim && claim(owner_fd, joiner_fd) < 0) {
+        pthread_mutex_unlock(&ms->mtx);
+        return -2;
+    }
+
+    match_reset(ms, h);
+    match_t *m = cold_of(ms, h);
+    h->id        = next_id(ms);
+    set_fd(ms, h, ROLE_OWNER,  owner_fd);
+    set_fd(ms, h, ROLE_JOINER, joiner_fd);
+    m->turn      = 0;
+    set_status(ms, h, MATCH_PLAYING);
+    turn_arm(ms, h);
+
+    int id = h->id;
+    pthread_mutex_unlock(&ms->mtx);
+    return id;
+}
+
+/* ------------------------------------------------------------------ */
+/*  Tornei: prenotazione degli slot e raccolta dei risultati            */
+/* ------------------------------------------------------------------ */
+
+int matches_reserve(match_store_t *ms, int n) {
+    pthread_mutex_lock(&ms->mtx);
+    int avail = count_free(ms) - ms->reserved;
+    int got   = n < avail ? n : avail;
+    if (got < 0) got = 0;
+    ms->reserved += got;
+    pthread_mutex_unlock(&ms->mtx);
+    return got;
+}
+
+void matches_unreserve(match_store_t *ms, int n) {
+    pthread_mutex_lock(&ms->mtx);
+    ms->reserved -= n;
+    if (ms->reserved < 0) ms->reserved = 0;
+    pthread_mutex_unlock(&ms->mtx);
+}
 
-    match_reset(m);
-    m->id       = ms->next_id++;
-    m->status   = MATCH_WAITING;
-    m->owner_fd = owner_fd;
+int matches_create_tour(match_store_t *ms, int owner_fd, int joiner_fd, int tour) {
+    pthread_mutex_lock(&ms->mtx);
+    match_hot_t *h = NULL;
+    for (int i = 0; i < MAX_MATCHES && ms->reserved > 0; i++)
+        if (ms->hot[i].id == 0) { h = &ms->hot[i]; break; }
+    if (!h) { pthread_mutex_unlock(&ms->mtx); return -1; }
+    ms->reserved--;
+
+    match_reset(ms, h);
+    match_t *m = cold_of(ms, h);
+    h->id        = next_id(ms);
+    set_fd(ms, h, ROLE_OWNER,  owner_fd);
+    set_fd(ms, h, ROLE_JOINER, joiner_fd);
+    m->turn      = 0;
+    m->tour      = tour;
+    set_status(ms, h, MATCH_PLAYING);
+    turn_arm(ms, h);
 
-    int id = m->id;
+    int id = h->id;
+    pthread_mutex_unlock(&ms->mtx);
+    return id;
+}
+
+int matches_collect_tour(match_store_t *ms, match_result_t *out, int max) {
+    int n = 0;
+    pthread_mutex_lock(&ms->mtx);
+    for (int i = 0; i < MAX_MATCHES && n < max; i++) {
+        match_hot_t *h = &ms->hot[i];
+        if (h->id == 0 || h->status != MATCH_REMATCH) continue;
+        match_t *m = &ms->matches[i];
+        if (!m->tour) continue;
+        out[n++] = (match_result_t){ m->tour, h->id, m->winner_fd, m->loser_fd, m->draw };
+        match_reset(ms, h);
+        ms->reserved++;
+    }
+    pthread_mutex_unlock(&ms->mtx);
+    return n;
+}
+
+int matches_create_ai(match_store_t *ms, int owner_fd, match_ai_t level) {
+    pthread_mutex_lock(&ms->mtx);
+    match_hot_t *h = find_free_slot(ms);
+    if (!h) { pthread_mutex_unlock(&ms->mtx); return -1; }
+
+    match_reset(ms, h);
+    match_t *m = cold_of(ms, h);
+    h->id       = next_id(ms);
+    set_fd(ms, h, ROLE_OWNER, owner_fd);
+    m->turn     = 0;
+    m->ai       = level;      /* sempre 3,3,3: il solver copre solo il tris classico */
+    m->ai_seed  = (unsigned)h->id * 2654435761u ^ (unsigned)owner_fd;
+    set_status(ms, h, MATCH_PLAYING);
+    turn_arm(ms, h);
+
+    int id = h->id;
     pthread_mutex_unlock(&ms->mtx);
     return id;
 }
@@ -118,14 +484,15 @@ void matches_list(match_store_t *ms, server_state_t *st, char *out, int outsz) {
     int   found = 0;
 
     for (int i = 0; i < MAX_MATCHES; i++) {
-        match_t *m = &ms->matches[i];
-        if (m->id == 0) continue;
+        const match_hot_t *h = &ms->hot[i];
+        if (h->id == 0) continue;
+        const match_t *m = &ms->matches[i];
 
         char owner_name[MAX_NAME] = "??";
-        state_get_name_copy(st, m->owner_fd, owner_name, sizeof(owner_name));
+        state_get_name_copy(st, h->owner_fd, owner_name, sizeof(owner_name));
 
         const char *ss;
-        switch (m->status) {
+        switch (h->status) {
             case MATCH_WAITING:  ss = "WAITING";  break;
             case MATCH_PENDING:  ss = "PENDING";  break;
             case MATCH_PLAYING:  ss = "PLAYING";  break;
@@ -134,8 +501,11 @@ void matches_list(match_store_t *ms, server_state_t *st, char *out, int outsz) {
             default:             ss = "UNKNOWN";  break;
         }
 
-        int n = snprintf(p, left, "MATCH %d owner=%s status=%s\n",
-                         m->id, owner_name, ss);
+        int n = is_classic(m)
+            ? snprintf(p, left, "MATCH %d owner=%s status=%s\n",
+                       h->id, owner_name, ss)
+            : snprintf(p, left, "MATCH %d owner=%s status=%s board=%dx%d k=%d\n",
+                       h->id, owner_name, ss, m->rows, m->cols, m->k);
         if (n > 0 && n < left) { p += n; left -= n; }
         found = 1;
     }
@@ -151,14 +521,15 @@ void matches_list(match_store_t *ms, server_state_t *st, char *out, int outsz) {
 int matches_request_join(match_store_t *ms, int match_id,
                          int joiner_fd, int *owner_fd_out) {
     pthread_mutex_lock(&ms->mtx);
-    match_t *m = find_match(ms, match_id);
+    match_hot_t *h = find_match(ms, match_id);
+    match_t     *m = h ? cold_of(ms, h) : NULL;
     if (!m) { pthread_mutex_unlock(&ms->mtx); return -1; }
-    if (m->owner_fd == joiner_fd) { pthread_mutex_unlock(&ms->mtx); return -3; }
-    if (m->status != MATCH_WAITING) { pthread_mutex_unlock(&ms->mtx); return -2; }
+    if (h->owner_fd == joiner_fd) { pthread_mutex_unlock(&ms->mtx); return -3; }
+    if (h->status != MATCH_WAITING) { pthread_mutex_unlock(&ms->mtx); return -2; }
 
-    m->status     = MATCH_PENDING;
-    m->pending_fd = joiner_fd;
-    *owner_fd_out = m->owner_fd;
+    set_fd(ms, h, ROLE_PENDING, joiner_fd);
+    set_status(ms, h, MATCH_PENDING);
+    *owner_fd_out = h->owner_fd;
     pthread_mutex_unlock(&ms->mtx);
     return 0;
 }
@@ -166,19 +537,22 @@ int matches_request_join(match_store_t *ms, int match_id,
 int matches_accept(match_store_t *ms, int match_id,
                    int owner_fd, int *joiner_fd_out) {
     pthread_mutex_lock(&ms->mtx);
-    match_t *m = find_match(ms, match_id);
+    match_hot_t *h = find_match(ms, match_id);
+    match_t     *m = h ? cold_of(ms, h) : NULL;
     if (!m) { pthread_mutex_unlock(&ms->mtx); return -1; }
-    if (m->owner_fd != owner_fd) { pthread_mutex_unlock(&ms->mtx); return -2; }
-    if (m->status != MATCH_PENDING || m->pending_fd == -1) {
+    if (h->owner_fd != owner_fd) { pthread_mutex_unlock(&ms->mtx); return -2; }
+    if (h->status != MATCH_PENDING || h->pending_fd == -1) {
         pthread_mutex_unlock(&ms->mtx); return -3;
     }
 
-    *joiner_fd_out = m->pending_fd;
-    m->joiner_fd   = m->pending_fd;
-    m->pending_fd  = -1;
-    m->status      = MATCH_PLAYING;
+    *joiner_fd_out = h->pending_fd;
+    set_fd(ms, h, ROLE_JOINER, h->pending_fd);
+    set_fd(ms, h, ROLE_PENDING, -1);
+    set_status(ms, h, MATCH_PLAYING);
     m->turn        = 0;
-    board_clear(m->board);
+    m->stones      = 0;
+    rules_board_clear(m->board, MATCH_MAX_CELLS);
+    turn_arm(ms, h);
     pthread_mutex_unlock(&ms->mtx);
     return 0;
 }
@@ -186,16 +560,17 @@ int matches_accept(match_store_t *ms, int match_id,
 int matches_reject(match_store_t *ms, int match_id,
                    int owner_fd, int *rejected_fd_out) {
     pthread_mutex_lock(&ms->mtx);
-    match_t *m = find_match(ms, match_id);
+    match_hot_t *h = find_match(ms, match_id);
+    match_t     *m = h ? cold_of(ms, h) : NULL;
     if (!m) { pthread_mutex_unlock(&ms->mtx); return -1; }
-    if (m->owner_fd != owner_fd) { pthread_mutex_unlock(&ms->mtx); return -2; }
-    if (m->status != MATCH_PENDING || m->pending_fd == -1) {
+    if (h->owner_fd != owner_fd) { pthread_mutex_unlock(&ms->mtx); return -2; }
+    if (h->status != MATCH_PENDING || h->pending_fd == -1) {
         pthread_mutex_unlock(&ms->mtx); return -3;
     }
 
-    *rejected_fd_out = m->pending_fd;
-    m->pending_fd    = -1;
-    m->status        = MATCH_WAITING;
+    *rejected_fd_out = h->pending_fd;
+    set_fd(ms, h, ROLE_PENDING, -1);
+    set_status(ms, h, MATCH_WAITING);
     pthread_mutex_unlock(&ms->mtx);
     return 0;
 }
@@ -210,58 +585,193 @@ int matches_move(match_store_t *ms, server_state_t *st,
                  char *board_out, int board_outsz,
                  char *winner_name_out, int winner_name_sz) {
     pthread_mutex_lock(&ms->mtx);
-    match_t *m = find_match(ms, match_id);
+    match_hot_t *h = find_match(ms, match_id);
+    match_t     *m = h ? cold_of(ms, h) : NULL;
     if (!m) { pthread_mutex_unlock(&ms->mtx); return -1; }
-    if (m->status != MATCH_PLAYING) { pthread_mutex_unlock(&ms->mtx); return -2; }
+    if (h->status != MATCH_PLAYING) { pthread_mutex_unlock(&ms->mtx); return -2; }
 
-    int is_owner  = (m->owner_fd  == player_fd);
-    int is_joiner = (m->joiner_fd == player_fd);
+    int is_owner  = (h->owner_fd  == player_fd);
+    int is_joiner = (h->joiner_fd == player_fd);
     if (!is_owner && !is_joiner) { pthread_mutex_unlock(&ms->mtx); return -3; }
     if (m->turn != (is_owner ? 0 : 1)) { pthread_mutex_unlock(&ms->mtx); return -4; }
-    if (r < 0 || r > 2 || c < 0 || c > 2) { pthread_mutex_unlock(&ms->mtx); return -5; }
-    if (m->board[r][c] != ' ') { pthread_mutex_unlock(&ms->mtx); return -5; }
+    if (r < 0 || r >= m->rows || c < 0 || c >= m->cols) {
+        pthread_mutex_unlock(&ms->mtx); return -5;
+    }
+    if (m->board[r * m->cols + c] != ' ') { pthread_mutex_unlock(&ms->mtx); return -5; }
 
     char mark        = is_owner ? 'X' : 'O';
-    m->board[r][c]   = mark;
-    *opponent_fd_out = is_owner ? m->joiner_fd : m->owner_fd;
+    m->board[r * m->cols + c] = mark;
+    m->stones++;
+    *opponent_fd_out = is_owner ? h->joiner_fd : h->owner_fd;
+    push_event(m, 'M', mark, r, c);
 
     int result = 0;
-    if (check_winner(m->board, mark)) {
+    if (rules_mnk_wins(m->board, m->rows, m->cols, m->k, r, c)) {
+        push_event(m, 'W', mark, -1, -1);
         m->winner_fd = player_fd;
         m->loser_fd  = *opponent_fd_out;
         m->draw      = 0;
-        m->status    = MATCH_REMATCH;
+        set_status(ms, h, MATCH_REMATCH);
         if (winner_name_out)
             state_get_name_copy(st, player_fd, winner_name_out, winner_name_sz);
         result = 1;
-    } else if (board_full(m->board)) {
+    } else if (m->stones == m->rows * m->cols) {
+        push_event(m, 'D', ' ', -1, -1);
         m->winner_fd = -1;
         m->loser_fd  = -1;
         m->draw      = 1;
-        m->status    = MATCH_REMATCH;
+        set_status(ms, h, MATCH_REMATCH);
         result = 2;
     } else {
         m->turn = 1 - m->turn;
     }
+    if (result == 0) turn_arm(ms, h);
+    else             turn_stop(ms, h);
+
+    render_board(h, m, board_out, board_outsz);
+    pthread_mutex_unlock(&ms->mtx);
+
+    if (result != 0)
+        record_result(ms, st, player_fd, *opponent_fd_out, result == 2);
+    return result;
+}
+
+/* ------------------------------------------------------------------ */
+/*  AI (tabella del solver, O(1) per mossa)                             */
+/* ------------------------------------------------------------------ */
+
+int matches_ai_move(match_store_t *ms, int match_id, int *r_out, int *c_out,
+                    char *board_out, int board_outsz) {
+    pthread_mutex_lock(&ms->mtx);
+    match_hot_t *h = find_match(ms, match_id);
+    match_t     *m = h ? cold_of(ms, h) : NULL;
+    if (!m || m->ai == MATCH_AI_NONE || h->status != MATCH_PLAYING ||
+        m->turn != 1) {
+        pthread_mutex_unlock(&ms->mtx);
+        return -1;
+    }
+
+    int code = solver_encode(m->board);
+    int cell = (m->ai == MATCH_AI_PERFECT) ? solver_best_move(code)
+                                           : solver_random_move(code, &m->ai_seed);
+    if (cell < 0) { pthread_mutex_unlock(&ms->mtx); return -1; }
+
+    int r = cell / 3, c = cell % 3;
+    m->board[cell] = 'O';
+    m->stones++;
+    push_event(m, 'M', 'O', r, c);
+    *r_out = r;
+    *c_out = c;
 
-    render_board(m, board_out, board_outsz);
+    int result = 0;
+    switch (solver_status(solver_encode(m->board))) {
+        case SOLVER_O_WINS:
+            push_event(m, 'W', 'O', -1, -1);
+            m->winner_fd = -1;
+            m->loser_fd  = h->owner_fd;
+            m->draw      = 0;
+            set_status(ms, h, MATCH_REMATCH);
+            result = 1;
+            break;
+        case SOLVER_DRAW:
+            push_event(m, 'D', ' ', -1, -1);
+            m->winner_fd = -1;
+            m->loser_fd  = -1;
+            m->draw      = 1;
+            set_status(ms, h, MATCH_REMATCH);
+            result = 2;
+            break;
+        default:
+            m->turn = 0;
+            break;
+    }
+    if (result == 0) turn_arm(ms, h);
+    else             turn_stop(ms, h);
+
+    render_board(h, m, board_out, board_outsz);
     pthread_mutex_unlock(&ms->mtx);
     return result;
 }
 
+int matches_hint(match_store_t *ms, int match_id, int player_fd,
+                 int *r_out, int *c_out) {
+    pthread_mutex_lock(&ms->mtx);
+    match_hot_t *h = find_match(ms, match_id);
+    match_t     *m = h ? cold_of(ms, h) : NULL;
+    if (!m) { pthread_mutex_unlock(&ms->mtx); return -1; }
+    if (h->status != MATCH_PLAYING) { pthread_mutex_unlock(&ms->mtx); return -2; }
+    if (m->ai == MATCH_AI_NONE || h->owner_fd != player_fd) {
+        pthread_mutex_unlock(&ms->mtx); return -3;
+    }
+    if (m->turn != 0) { pthread_mutex_unlock(&ms->mtx); return -4; }
+
+    int cell = solver_best_move(solver_encode(m->board));
+    pthread_mutex_unlock(&ms->mtx);
+    if (cell < 0) return -2;
+    *r_out = cell / 3;
+    *c_out = cell % 3;
+    return 0;
+}
+
 /* ------------------------------------------------------------------ */
 /*  BOARD                                                               */
 /* ------------------------------------------------------------------ */
 
 int matches_board(match_store_t *ms, int match_id, char *out, int outsz) {
     pthread_mutex_lock(&ms->mtx);
-    match_t *m = find_match(ms, match_id);
+    match_hot_t *h = find_match(ms, match_id);
+    match_t     *m = h ? cold_of(ms, h) : NULL;
     if (!m) { pthread_mutex_unlock(&ms->mtx); return -1; }
-    render_board(m, out, outsz);
+    render_board(h, m, out, outsz);
     pthread_mutex_unlock(&ms->mtx);
     return 0;
 }
 
+/* ------------------------------------------------------------------ */
+/*  REPLAY (RESUME)                                                     */
+/* ------------------------------------------------------------------ */
+
+int matches_replay(match_store_t *ms, int match_id, int last_seq,
+                   char *out, int outsz) {
+    pthread_mutex_lock(&ms->mtx);
+    match_hot_t *h = find_match(ms, match_id);
+    match_t     *m = h ? cold_of(ms, h) : NULL;
+    if (!m) { pthread_mutex_unlock(&ms->mtx); return -1; }
+
+    char *p    = out;
+    int   left = outsz;
+    int   first = m->seq - MATCH_EVENT_RING + 1;
+    if (first < 1) first = 1;
+    if (last_seq < 0) last_seq = 0;
+    if (last_seq + 1 < first) {
+        int n = snprintf(p, left, PROTO_EVENT_REPLAY_GAP, first);
+        if (n > 0 && n < left) { p += n; left -= n; }
+        last_seq = first - 1;
+    }
+
+    for (int s = last_seq + 1; s <= m->seq; s++) {
+        const match_event_t *e = &m->events[(s - 1) % MATCH_EVENT_RING];
+        int n = 0;
+        switch (e->kind) {
+            case 'M': n = snprintf(p, left, PROTO_EVENT_REPLAY_MOVE,
+                                   e->seq, e->mark, e->r, e->c); break;
+            case 'W': n = snprintf(p, left, PROTO_EVENT_REPLAY_WIN,
+                                   e->seq, e->mark); break;
+            case 'D': n = snprintf(p, left, PROTO_EVENT_REPLAY_DRAW, e->seq); break;
+            case 'R': n = snprintf(p, left, PROTO_EVENT_REPLAY_RESIGN,
+                                   e->seq, e->mark); break;
+            case 'T': n = snprintf(p, left, PROTO_EVENT_REPLAY_TIMEOUT,
+                                   e->seq, e->mark); break;
+        }
+        if (n > 0 && n < left) { p += n; left -= n; }
+    }
+
+    render_board(h, m, p, left);
+    int seq = m->seq;
+    pthread_mutex_unlock(&ms->mtx);
+    return seq;
+}
+
 /* ------------------------------------------------------------------ */
 /*  RESIGN                                                              */
 /* ------------------------------------------------------------------ */
@@ -272,29 +782,83 @@ int matches_resign(match_store_t *ms, server_state_t *st,
                    char *board_out, int board_outsz,
                    char *winner_name_out, int winner_name_sz) {
     pthread_mutex_lock(&ms->mtx);
-    match_t *m = find_match(ms, match_id);
+    match_hot_t *h = find_match(ms, match_id);
+    match_t     *m = h ? cold_of(ms, h) : NULL;
     if (!m) { pthread_mutex_unlock(&ms->mtx); return -1; }
-    if (m->status != MATCH_PLAYING) { pthread_mutex_unlock(&ms->mtx); return -2; }
+    if (h->status != MATCH_PLAYING) { pthread_mutex_unlock(&ms->mtx); return -2; }
 
-    int is_owner  = (m->owner_fd  == player_fd);
-    int is_joiner = (m->joiner_fd == player_fd);
+    int is_owner  = (h->owner_fd  == player_fd);
+    int is_joiner = (h->joiner_fd == player_fd);
     if (!is_owner && !is_joiner) { pthread_mutex_unlock(&ms->mtx); return -3; }
 
-    int opp_fd = is_owner ? m->joiner_fd : m->owner_fd;
-    if (opp_fd == -1) { pthread_mutex_unlock(&ms->mtx); return -4; }
+    int opp_fd = is_owner ? h->joiner_fd : h->owner_fd;
+    if (opp_fd == -1 && m->ai == MATCH_AI_NONE) {
+        pthread_mutex_unlock(&ms->mtx); return -4;
+    }
 
     /* Chi fa resign perde */
+    push_event(m, 'R', is_owner ? 'X' : 'O', -1, -1);
     m->winner_fd     = opp_fd;
     m->loser_fd      = player_fd;
     m->draw          = 0;
     *opponent_fd_out = opp_fd;
-    m->status        = MATCH_REMATCH;
+    set_status(ms, h, MATCH_REMATCH);
+    turn_stop(ms, h);
+
+    if (winner_name_out) {
+        if (m->ai != MATCH_AI_NONE)
+            snprintf(winner_name_out, winner_name_sz, "%s", PROTO_AI_NAME);
+        else
+            state_get_name_copy(st, opp_fd, winner_name_out, winner_name_sz);
+    }
 
-    if (winner_name_out)
-        state_get_name_copy(st, opp_fd, winner_name_out, winner_name_sz);
+    render_board(h, m, board_out, board_outsz);
+    pthread_mutex_unlock(&ms->mtx);
+
+    record_result(ms, st, opp_fd, player_fd, 0);
+    return 0;
+}
+
+/* ------------------------------------------------------------------ */
+/*  TEMPO DI TURNO SCADUTO                                              */
+/* ------------------------------------------------------------------ */
+
+int matches_turn_expired(match_store_t *ms, server_state_t *st,
+                         const tw_fired_t *f, int *loser_fd_out,
+                         int *winner_fd_out,
+                         char *board_out, int board_outsz,
+                         char *winner_name_out, int winner_name_sz) {
+    pthread_mutex_lock(&ms->mtx);
+    /* Con ms->mtx preso nessuna mossa può riarmare il timer nel frattempo */
+    if (!ms->wheel || !tw_is_current(ms->wheel, f)) {
+        pthread_mutex_unlock(&ms->mtx); return -1;
+    }
+    match_hot_t *h = find_match(ms, f->arg);
+    match_t     *m = h ? cold_of(ms, h) : NULL;
+    if (!m || h->status != MATCH_PLAYING) { pthread_mutex_unlock(&ms->mtx); return -1; }
+
+    int loser  = (m->turn == 0) ? h->owner_fd  : h->joiner_fd;
+    int winner = (m->turn == 0) ? h->joiner_fd : h->owner_fd;
+    if (loser == -1) { pthread_mutex_unlock(&ms->mtx); return -1; }   /* AI */
+
+    push_event(m, 'T', m->turn == 0 ? 'X' : 'O', -1, -1);
+    m->winner_fd = winner;
+    m->loser_fd  = loser;
+    m->draw      = 0;
+    set_status(ms, h, MATCH_REMATCH);
 
-    render_board(m, board_out, board_outsz);
+    if (winner_name_out) {
+        if (winner == -1)
+            snprintf(winner_name_out, winner_name_sz, "%s", PROTO_AI_NAME);
+        else
+            state_get_name_copy(st, winner, winner_name_out, winner_name_sz);
+    }
+    render_board(h, m, board_out, board_outsz);
     pthread_mutex_unlock(&ms->mtx);
+
+    *loser_fd_out  = loser;
+    *winner_fd_out = winner;
+    record_result(ms, st, winner, loser, 0);
     return 0;
 }
 
@@ -312,12 +876,13 @@ int matches_resign(match_store_t *ms, server_state_t *st,
 int matches_find_rematch(match_store_t *ms, int player_fd) {
     pthread_mutex_lock(&ms->mtx);
     int found_id = -1;
-    for (int i = 0; i < MAX_MATCHES; i++) {
-        match_t *m = &ms->matches[i];
-        if (m->id == 0 || m->status != MATCH_REMATCH) continue;
-        if (m->owner_fd == player_fd || m->joiner_fd == player_fd) {
-            found_id = m->id;
-            break;
+    const match_player_t *p = player_find(ms, player_fd);
+    for (int r = ROLE_OWNER; p && r <= ROLE_JOINER && found_id == -1; r++) {
+        for (int i = p->head[r]; i != -1; i = ms->link[i].next[r]) {
+            if (ms->hot[i].status == MATCH_REMATCH && !ms->matches[i].tour) {
+                found_id = ms->hot[i].id;
+                break;
+            }
         }
     }
     pthread_mutex_unlock(&ms->mtx);
@@ -330,46 +895,53 @@ int matches_find_rematch(match_store_t *ms, int player_fd) {
  *  Ritorna -1 match non trovato / non in REMATCH
  *  Ritorna -2 non sei un giocatore
  *  Ritorna -3 sei il perdente
- *  Ritorna -4 nessuno slot libero
+ *  Ritorna -4 nessuno slot libero (prenotati dai tornei)
  */
 int matches_rematch(match_store_t *ms, int match_id, int player_fd) {
     pthread_mutex_lock(&ms->mtx);
 
-    match_t *m = find_match(ms, match_id);
-    if (!m || m->status != MATCH_REMATCH) {
+    match_hot_t *h = find_match(ms, match_id);
+    match_t     *m = h ? cold_of(ms, h) : NULL;
+    if (!m || h->status != MATCH_REMATCH || m->tour) {
         pthread_mutex_unlock(&ms->mtx);
         return -1;
     }
 
-    int is_owner  = (m->owner_fd  == player_fd);
-    int is_joiner = (m->joiner_fd == player_fd);
+    int is_owner  = (h->owner_fd  == player_fd);
+    int is_joiner = (h->joiner_fd == player_fd);
     if (!is_owner && !is_joiner) {
         pthread_mutex_unlock(&ms->mtx);
         return -2;
     }
 
-    
     if (!m->draw && m->loser_fd == player_fd) {
         pthread_mutex_unlock(&ms->mtx);
         return -3;
     }
 
-   
-    match_t *nm = find_free_slot(ms);
-    if (!nm) {
+    /*
+     * Il vecchio slot si libera prima di cercarne uno: con la lobby piena
+     * la nuova partita prende il suo posto invece di fallire.  Non se gli
+     * slot liberi, contato il vecchio, servono tutti alle prenotazioni dei
+     * tornei: allora la partita in REMATCH resta com'è.
+     */
+    if (count_free(ms) + 1 <= ms->reserved) {
         pthread_mutex_unlock(&ms->mtx);
         return -4;
     }
-
-    
-    int new_id  = ms->next_id++;
-    match_reset(nm);
-    nm->id       = new_id;
-    nm->status   = MATCH_WAITING;
-    nm->owner_fd = player_fd;   
-
-    
-    match_reset(m);
+    unsigned char rows = m->rows, cols = m->cols, k = m->k;
+    match_reset(ms, h);
+
+    match_hot_t *nh = find_free_slot(ms);
+    match_t     *nm = cold_of(ms, nh);
+    int new_id  = next_id(ms);
+    match_reset(ms, nh);
+    nh->id       = new_id;
+    set_fd(ms, nh, ROLE_OWNER, player_fd);
+    nm->rows     = rows;     /* stessa variante m,n,k */
+    nm->cols     = cols;
+    nm->k        = k;
+    set_status(ms, nh, MATCH_WAITING);
 
     pthread_mutex_unlock(&ms->mtx);
     return new_id;
@@ -379,50 +951,68 @@ int matches_rematch(match_store_t *ms, int match_id, int player_fd) {
 /*  DISCONNECT                                                          */
 /* ------------------------------------------------------------------ */
 
-void matches_on_disconnect(match_store_t *ms, server_state_t *st, int fd) {
+int matches_on_disconnect(match_store_t *ms, server_state_t *st, int fd) {
     int notify_opp_fd  = -1;
     int notify_pend_fd = -1;
+    int forfeit_id     = -1;
 
     pthread_mutex_lock(&ms->mtx);
 
-    for (int i = 0; i < MAX_MATCHES; i++) {
-        match_t *m = &ms->matches[i];
-        if (m->id == 0) continue;
-
-        
-        if (m->status == MATCH_PLAYING &&
-            (m->owner_fd == fd || m->joiner_fd == fd)) {
-            notify_opp_fd = (m->owner_fd == fd) ? m->joiner_fd : m->owner_fd;
-            match_reset(m);
+    /*
+     * Solo le partite di fd, dall'indice inverso.  Ogni giro toglie fd da
+     * uno slot; la voce si cerca di nuovo perché player_remove la sposta.
+     */
+    match_player_t *p;
+    while ((p = player_find(ms, fd)) != NULL) {
+        int role = p->head[ROLE_OWNER]  != -1 ? ROLE_OWNER
+                 : p->head[ROLE_JOINER] != -1 ? ROLE_JOINER : ROLE_PENDING;
+        match_hot_t *h = &ms->hot[p->head[role]];
+
+        /* Richiesta di JOIN in sospeso: la partita torna in attesa */
+        if (role == ROLE_PENDING) {
+            set_fd(ms, h, ROLE_PENDING, -1);
+            set_status(ms, h, MATCH_WAITING);
             continue;
         }
 
-        
-        if (m->status == MATCH_REMATCH &&
-            (m->owner_fd == fd || m->joiner_fd == fd)) {
-            match_reset(m);
-            continue;
+        /* Partita in corso: persa a tavolino */
+        if (h->status == MATCH_PLAYING) {
+            notify_opp_fd = (h->owner_fd == fd) ? h->joiner_fd : h->owner_fd;
+            forfeit_id    = h->id;
+            turn_stop(ms, h);
         }
 
-        
-        if ((m->status == MATCH_WAITING || m->status == MATCH_PENDING)
-             && m->owner_fd == fd) {
-            if (m->status == MATCH_PENDING && m->pending_fd != -1)
-                notify_pend_fd = m->pending_fd;
-            match_reset(m);
+        /* Partita propria in attesa: chi aveva chiesto JOIN viene avvisato */
+        if (h->status == MATCH_PENDING && h->pending_fd != -1)
+            notify_pend_fd = h->pending_fd;
+
+        /*
+         * Partita di torneo: il risultato resta nello slot finché il
+         * torneo non lo raccoglie, fd esce solo dal suo ruolo.
+         */
+        match_t *m = cold_of(ms, h);
+        if (m->tour) {
+            if (h->status == MATCH_PLAYING) {
+                push_event(m, 'R', role == ROLE_OWNER ? 'X' : 'O', -1, -1);
+                m->winner_fd = notify_opp_fd;
+                m->loser_fd  = fd;
+                m->draw      = 0;
+                set_status(ms, h, MATCH_REMATCH);
+            }
+            set_fd(ms, h, role, -1);
             continue;
         }
 
-       
-        if (m->status == MATCH_PENDING && m->pending_fd == fd) {
-            m->pending_fd = -1;
-            m->status     = MATCH_WAITING;
-        }
+        /* In ogni caso (anche MATCH_REMATCH) lo slot si libera */
+        match_reset(ms, h);
     }
 
     pthread_mutex_unlock(&ms->mtx);
 
     if (notify_opp_fd != -1) {
+        /* Chi abbandona una partita in corso la perde */
+        record_result(ms, st, notify_opp_fd, fd, 0);
+
         char winner_name[MAX_NAME] = "??";
         state_get_name_copy(st, notify_opp_fd, winner_name, sizeof(winner_name));
         char msg[256];
@@ -440,4 +1030,5 @@ void matches_on_disconnect(match_store_t *ms, server_state_t *st, int fd) {
 
     if (notify_pend_fd != -1)
         send_all(notify_pend_fd, PROTO_ERR_MATCH_CLOSED);
+    return forfeit_id;
 }
\ No newline at end of file
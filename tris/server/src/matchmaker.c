@@ -0,0 +1,185 @@
+#include "matchmaker.h"
+#include <stdlib.h>
+#include <string.h>
+
+/* ------------------------------------------------------------------ */
+/*  Helpers interni (chiamati con mm->mtx preso)                        */
+/* ------------------------------------------------------------------ */
+
+static void unlink_entry(matchmaker_t *mm, int slot) {
+    mm_entry_t *e = &mm->entries[slot];
+    if (e->prev != -1) mm->entries[e->prev].next = e->next;
+    else               mm->head = e->next;
+    if (e->next != -1) mm->entries[e->next].prev = e->prev;
+    else               mm->tail = e->prev;
+    e->queued = 0;
+    e->prev   = e->next = -1;
+    mm->count--;
+}
+
+static void append_entry(matchmaker_t *mm, int slot, int fd, int rating) {
+    mm_entry_t *e = &mm->entries[slot];
+    e->fd     = fd;
+    e->queued = 1;
+    e->rating = rating;
+    e->since  = time(NULL);
+    e->prev   = mm->tail;
+    e->next   = -1;
+    if (mm->tail != -1) mm->entries[mm->tail].next = slot;
+    else                mm->head = slot;
+    mm->tail = slot;
+    mm->count++;
+}
+
+/* a (in coda da più tempo) e un giocatore con rating r sono compatibili? */
+static int in_band(const matchmaker_t *mm, const mm_entry_t *a, int r, time_t now) {
+    if (mm->band == 0) return 1;
+    int band = mm->band + mm->band * (int)((now - a->since) / MM_WIDEN_SEC);
+    return abs(a->rating - r) <= band;
+}
+
+/* ------------------------------------------------------------------ */
+/*  API                                                                 */
+/* ------------------------------------------------------------------ */
+
+void matchmaker_init(matchmaker_t *mm, int band) {
+    pthread_mutex_init(&mm->mtx, NULL);
+    mm->band  = band > 0 ? band : 0;
+    mm->head  = mm->tail = -1;
+    mm->count = 0;
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        mm->entries[i].fd     = -1;
+        mm->entries[i].queued = 0;
+        mm->entries[i].paired = 0;
+        mm->entries[i].prev   = mm->entries[i].next = -1;
+    }
+}
+
+/* Con mm->mtx preso: abbina fd al primo compatibile o lo mette in coda */
+static int enqueue_locked(matchmaker_t *mm, server_state_t *st, int slot, int fd,
+                          int rating, int *opponent_fd_out) {
+    /*
+     * Si scartano i giocatori che nel frattempo sono entrati in una
+     * partita con CREATE/JOIN: la coda non li deve più abbinare.
+     * Senza fasce di rating il primo rimasto è sempre compatibile.
+     */
+    time_t now = time(NULL);
+    int    cur = mm->head;
+    while (cur != -1) {
+        mm_entry_t *e    = &mm->entries[cur];
+        int         next = e->next;
+        if (state_get_playing_match(st, e->fd) != -1) {
+            unlink_entry(mm, cur);
+        } else if (in_band(mm, e, rating, now)) {
+            *opponent_fd_out = e->fd;
+            unlink_entry(mm, cur);
+            e->paired = 1;
+            mm->entries[slot].fd     = fd;
+            mm->entries[slot].paired = 1;
+            return 1;
+        }
+        cur = next;
+    }
+
+    append_entry(mm, slot, fd, rating);
+    return 0;
+}
+
+int matchmaker_enqueue(matchmaker_t *mm, server_state_t *st, int fd,
+                       int rating, int *opponent_fd_out) {
+    int slot = state_slot_of(st, fd);
+    if (slot < 0) return -2;
+
+    pthread_mutex_lock(&mm->mtx);
+    const mm_entry_t *e = &mm->entries[slot];
+    int rc = (e->queued || e->paired) && e->fd == fd
+           ? -1 : enqueue_locked(mm, st, slot, fd, rating, opponent_fd_out);
+    pthread_mutex_unlock(&mm->mtx);
+    return rc;
+}
+
+int matchmaker_requeue(matchmaker_t *mm, server_state_t *st, int fd,
+                       int rating, int *opponent_fd_out) {
+    int slot = state_slot_of(st, fd);
+    if (slot < 0) return -2;
+
+    pthread_mutex_lock(&mm->mtx);
+    mm_entry_t *e = &mm->entries[slot];
+    int rc = -2;
+    if (e->paired && e->fd == fd) {
+        e->paired = 0;
+        rc = enqueue_locked(mm, st, slot, fd, rating, opponent_fd_out);
+    }
+    pthread_mutex_unlock(&mm->mtx);
+    return rc;
+}
+
+int matchmaker_claim(matchmaker_t *mm, server_state_t *st, int x_fd, int o_fd) {
+    int xs = state_slot_of(st, x_fd);
+    int os = state_slot_of(st, o_fd);
+    if (xs < 0 || os < 0) return -1;
+
+    pthread_mutex_lock(&mm->mtx);
+    mm_entry_t *x = &mm->entries[xs], *o = &mm->entries[os];
+    int rc = -1;
+    if (x->paired && x->fd == x_fd && o->paired && o->fd == o_fd) {
+        x->paired = o->paired = 0;
+        rc = 0;
+    }
+    pthread_mutex_unlock(&mm->mtx);
+    return rc;
+}
+
+int matchmaker_remove(matchmaker_t *mm, server_state_t *st, int fd) {
+    int slot = state_slot_of(st, fd);
+    if (slot < 0) return -1;
+
+    pthread_mutex_lock(&mm->mtx);
+    mm_entry_t *e = &mm->entries[slot];
+    int rc = -1;
+    if (e->fd == fd && e->queued) {
+        unlink_entry(mm, slot);
+        rc = 0;
+    }
+    if (e->fd == fd && e->paired) {
+        e->paired = 0;
+        rc = 0;
+    }
+    pthread_mutex_unlock(&mm->mtx);
+    return rc;
+}
+
+int matchmaker_tick(matchmaker_t *mm, server_state_t *st,
+                    int *pairs_out, int max_pairs) {
+    if (mm->band == 0) return 0;   /* senza fasce si abbina già in enqueue */
+
+    pthread_mutex_lock(&mm->mtx);
+    time_t now = time(NULL);
+    int    n   = 0;
+    int    a   = mm->head;
+    while (a != -1 && n < max_pairs) {
+        mm_entry_t *ea     = &mm->entries[a];
+        int         next_a = ea->next;
+        if (state_get_playing_match(st, ea->fd) != -1) {
+            unlink_entry(mm, a);
+            a = next_a;
+            continue;
+        }
+        for (int b = ea->next; b != -1; b = mm->entries[b].next) {
+            mm_entry_t *eb = &mm->entries[b];
+            if (!in_band(mm, ea, eb->rating, now)) continue;
+            if (state_get_playing_match(st, eb->fd) != -1) continue;
+            pairs_out[2 * n]     = ea->fd;   /* in coda da più tempo: X */
+            pairs_out[2 * n + 1] = eb->fd;
+            n++;
+            if (b == next_a) next_a = eb->next;
+            unlink_entry(mm, b);
+            unlink_entry(mm, a);
+            ea->paired = eb->paired = 1;
+            break;
+        }
+        a = next_a;
+    }
+    pthread_mutex_unlock(&mm->mtx);
+    return n;
+}
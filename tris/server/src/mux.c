@@ -0,0 +1,254 @@
+#include "mux.h"
+#include "server.h"
+#include "protocol.h"
+#include "log.h"
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+
+#define MUX_OUT 2048   /* output con i prefissi sullo stack, oltre si alloca */
+
+typedef struct mux mux_t;
+
+struct mux {
+    int             idx;                  /* in g_mux[] */
+    int             fd;                   /* connessione reale */
+    pthread_mutex_t mtx;                  /* invii sulla connessione */
+    unsigned char   used[MUX_MAX_SIDS];
+    unsigned char   idle[MUX_MAX_SIDS];   /* inattivi, da chiudere (mux_shut) */
+    int             reap;                 /* qualche idle[] impostato */
+    session_t       sub[MUX_MAX_SIDS];
+};
+
+/*
+ * Registro per gli invii: chi invia trova la connessione sotto g_mtx e
+ * prende il suo lock prima di lasciarlo; mux_close la toglie dal
+ * registro e aspetta gli invii in corso prima di liberarla.
+ */
+static pthread_mutex_t g_mtx = PTHREAD_MUTEX_INITIALIZER;
+static mux_t          *g_mux[MUX_MAX_CONN];
+
+static int vfd_of(const mux_t *m, int sid) {
+    return MUX_VFD_BASE + m->idx * MUX_MAX_SIDS + sid;
+}
+
+static int write_all(int fd, const char *buf, size_t len) {
+    size_t off = 0;
+    while (off < len) {
+        ssize_t n = net_send(fd, buf + off, len - off, 0);
+        if (n <= 0) return -1;
+        off += (size_t)n;
+    }
+    return 0;
+}
+
+/*
+ * Con m->mtx preso: "@<sid> " all'inizio di ogni riga, poi un solo
+ * invio.  Con dontwait l'invio è tutto o niente come su un socket
+ * (net_send): -1/EAGAIN se la connessione è piena, nessuna riga a metà.
+ */
+static int write_tagged(mux_t *m, int sid, const char *buf, size_t len, int dontwait) {
+    char   stack[MUX_OUT];
+    char   tag[16];
+    size_t tl   = (size_t)snprintf(tag, sizeof(tag), "@%d ", sid);
+    size_t need = tl;
+    for (size_t i = 0; i + 1 < len; i++)
+        if (buf[i] == '\n') need += tl;
+    need += len;
+
+    char *out = need <= sizeof(stack) ? stack : malloc(need);
+    if (!out) return -1;
+    size_t n   = 0;
+    int    bol = 1;
+    for (size_t i = 0; i < len; i++) {
+        if (bol) { memcpy(out + n, tag, tl); n += tl; }
+        out[n++] = buf[i];
+        bol = buf[i] == '\n';
+    }
+    int rc = dontwait ? (net_send(m->fd, out, n, 1) < 0 ? -1 : 0)
+                      : write_all(m->fd, out, n);
+    if (out != stack) free(out);
+    return rc;
+}
+
+static ssize_t mux_send(int fd, const void *buf, size_t len, int dontwait) {
+    int k   = fd - MUX_VFD_BASE;
+    int sid = k % MUX_MAX_SIDS;
+
+    pthread_mutex_lock(&g_mtx);
+    mux_t *m = g_mux[k / MUX_MAX_SIDS];
+    if (!m || !__atomic_load_n(&m->used[sid], __ATOMIC_ACQUIRE)) {
+        pthread_mutex_unlock(&g_mtx);
+        errno = EPIPE;
+        return -1;
+    }
+    /* Con dontwait non si aspetta nemmeno chi sta già scrivendo */
+    if (dontwait && pthread_mutex_trylock(&m->mtx) != 0) {
+        pthread_mutex_unlock(&g_mtx);
+        errno = EAGAIN;
+        return -1;
+    }
+    if (!dontwait) pthread_mutex_lock(&m->mtx);
+    pthread_mutex_unlock(&g_mtx);
+
+    int rc = write_tagged(m, sid, buf, len, dontwait);
+    int e  = errno;
+    pthread_mutex_unlock(&m->mtx);
+    if (rc < 0) { errno = dontwait && e == EAGAIN ? EAGAIN : EPIPE; return -1; }
+    return (ssize_t)len;
+}
+
+static void close_sid(mux_t *m, int sid) {
+    session_t *s = &m->sub[sid];
+    s->dropped = 0;      /* niente grazia: non c'è un socket da riprendere */
+    session_close(s);
+    __atomic_store_n(&m->used[sid], 0, __ATOMIC_RELEASE);
+}
+
+/*
+ * Timer di inattività di un sid (net_shutdown): la sessione del sid la
+ * esegue solo chi serve la connessione, quindi qui si segna e basta.
+ * La chiude la prossima riga della connessione; se non ne arrivano è la
+ * connessione stessa a scadere per inattività, con tutti i suoi sid.
+ */
+static void mux_shut(int fd) {
+    int k   = fd - MUX_VFD_BASE;
+    int sid = k % MUX_MAX_SIDS;
+
+    pthread_mutex_lock(&g_mtx);
+    mux_t *m = g_mux[k / MUX_MAX_SIDS];
+    if (m && __atomic_load_n(&m->used[sid], __ATOMIC_ACQUIRE)) {
+        __atomic_store_n(&m->idle[sid], 1, __ATOMIC_RELAXED);
+        __atomic_store_n(&m->reap, 1, __ATOMIC_RELEASE);
+    }
+    pthread_mutex_unlock(&g_mtx);
+}
+
+/* Sid segnati da mux_shut, dal thread della connessione */
+static void reap_idle(mux_t *m) {
+    if (!__atomic_exchange_n(&m->reap, 0, __ATOMIC_ACQUIRE)) return;
+    for (int sid = 0; sid < MUX_MAX_SIDS; sid++)
+        if (m->used[sid] && __atomic_exchange_n(&m->idle[sid], 0, __ATOMIC_RELAXED)) {
+            LOG(LOG_INFO, LOG_SYS_SESSION, "Sid inattivo chiuso (@%ld, fd=%ld)", sid, m->sub[sid].fd);
+            close_sid(m, sid);
+        }
+}
+
+/* "@<sid>" seguito da spazio o fine riga: sid, oppure -1 */
+static int parse_sid(const char *line, const char **rest) {
+    char *end;
+    long  sid = strtol(line + 1, &end, 10);
+    if (end == line + 1 || sid < 0 || sid >= MUX_MAX_SIDS ||
+        (*end != ' ' && *end != '\0'))
+        return -1;
+    *rest = end;
+    return (int)sid;
+}
+
+/* ------------------------------------------------------------------ */
+/*  API                                                                 */
+/* ------------------------------------------------------------------ */
+
+void mux_init(void) {
+    net_add_virtual(MUX_VFD_BASE, MUX_MAX_CONN * MUX_MAX_SIDS, mux_send, mux_shut);
+}
+
+int mux_open(session_t *s) {
+    mux_t *m = calloc(1, sizeof(*m));
+    if (!m) return -1;
+
+    pthread_mutex_lock(&g_mtx);
+    int i = 0;
+    while (i < MUX_MAX_CONN && g_mux[i]) i++;
+    if (i < MUX_MAX_CONN) {
+        m->idx = i;
+        m->fd  = s->fd;
+        pthread_mutex_init(&m->mtx, NULL);
+        g_mux[i] = m;
+    }
+    pthread_mutex_unlock(&g_mtx);
+    if (i == MUX_MAX_CONN) { free(m); return -1; }
+
+    s->mux = m;
+    LOG(LOG_INFO, LOG_SYS_SESSION, "Connessione multiplexata (fd=%ld)", s->fd);
+    return 0;
+}
+
+int mux_line(session_t *s, char *line) {
+    mux_t      *m = s->mux;
+    const char *rest;
+    int         sid = parse_sid(line, &rest);
+    reap_idle(m);
+    if (sid < 0) {
+        pthread_mutex_lock(&m->mtx);
+        write_all(m->fd, PROTO_ERR_BAD_SID, strlen(PROTO_ERR_BAD_SID));
+        pthread_mutex_unlock(&m->mtx);
+        return -1;
+    }
+
+    if (!m->used[sid]) {
+        int vfd = vfd_of(m, sid);
+        if (state_add_client(&g_state, vfd) < 0) {
+            pthread_mutex_lock(&m->mtx);
+            write_tagged(m, sid, PROTO_ERR_SERVER_FULL, strlen(PROTO_ERR_SERVER_FULL), 0);
+            pthread_mutex_unlock(&m->mtx);
+            return -1;
+        }
+        __atomic_store_n(&m->idle[sid], 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&m->used[sid], 1, __ATOMIC_RELEASE);
+        session_open(&m->sub[sid], vfd, 1);
+    }
+
+    char buf[MAX_LINE];
+    snprintf(buf, sizeof(buf), "%s", rest);
+    if (session_line(&m->sub[sid], buf) == SESSION_CLOSE) close_sid(m, sid);
+    return 0;
+}
+
+int mux_match_of(const session_t *s, const char *line) {
+    const mux_t *m = s->mux;
+    const char  *rest;
+    int          sid = parse_sid(line, &rest);
+    if (sid < 0 || !__atomic_load_n(&m->used[sid], __ATOMIC_ACQUIRE)) return -1;
+    return session_match_of(&m->sub[sid], rest);
+}
+
+void mux_close(session_t *s) {
+    mux_t *m = s->mux;
+    if (!m) return;
+
+    int n = 0;
+    for (int sid = 0; sid < MUX_MAX_SIDS; sid++)
+        if (m->used[sid]) { close_sid(m, sid); n++; }
+
+    pthread_mutex_lock(&g_mtx);
+    g_mux[m->idx] = NULL;
+    pthread_mutex_unlock(&g_mtx);
+    pthread_mutex_lock(&m->mtx);      /* invii in corso finiti */
+    pthread_mutex_unlock(&m->mtx);
+
+    LOG(LOG_INFO, LOG_SYS_SESSION, "Connessione multiplexata chiusa (fd=%ld), %ld giocatori",
+        s->fd, n);
+    pthread_mutex_destroy(&m->mtx);
+    free(m);
+    s->mux = NULL;
+}
+
+void mux_handover(void) {
+    int n = 0;
+    pthread_mutex_lock(&g_mtx);
+    for (int i = 0; i < MUX_MAX_CONN; i++) {
+        mux_t *m = g_mux[i];
+        if (!m) continue;
+        pthread_mutex_lock(&m->mtx);
+        write_all(m->fd, PROTO_BYE, strlen(PROTO_BYE));
+        shutdown(m->fd, SHUT_RDWR);
+        pthread_mutex_unlock(&m->mtx);
+        n++;
+    }
+    pthread_mutex_unlock(&g_mtx);
+    if (n) LOG(LOG_INFO, LOG_SYS_SESSION, "Handover: chiuse %ld connessioni multiplexate", n);
+}
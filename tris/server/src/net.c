@@ -1,14 +1,128 @@
 #include "net.h"
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
 #include <string.h>
 #include <sys/socket.h>
 #include <unistd.h>
 
+typedef struct {
+    int          first, count;
+    net_sender_t fn;
+    net_closer_t close_fn;
+} net_vrange_t;
+
+static net_sender_t g_sender;
+static net_vrange_t g_vranges[NET_MAX_VIRTUAL];
+static int          g_nvranges;
+
+static pthread_mutex_t g_wlock[NET_WLOCKS] = {
+    [0 ... NET_WLOCKS - 1] = PTHREAD_MUTEX_INITIALIZER
+};
+
+void net_set_sender(net_sender_t fn) {
+    g_sender = fn;
+}
+
+int net_add_virtual(int first, int count, net_sender_t fn, net_closer_t close_fn) {
+    int n = g_nvranges;
+    if (n == NET_MAX_VIRTUAL) return -1;
+    g_vranges[n].first    = first;
+    g_vranges[n].count    = count;
+    g_vranges[n].fn       = fn;
+    g_vranges[n].close_fn = close_fn;
+    __atomic_store_n(&g_nvranges, n + 1, __ATOMIC_RELEASE);
+    return 0;
+}
+
+static const net_vrange_t *vrange_of(int fd) {
+    int n = __atomic_load_n(&g_nvranges, __ATOMIC_ACQUIRE);
+    for (int i = 0; i < n; i++)
+        if (fd - g_vranges[i].first >= 0 && fd - g_vranges[i].first < g_vranges[i].count)
+            return &g_vranges[i];
+    return NULL;
+}
+
+/* Resto di un invio non bloccante già iniziato, con il lock preso */
+static int finish_send(int fd, const char *p, size_t len) {
+    while (len > 0) {
+        struct pollfd pfd = { fd, POLLOUT, 0 };
+        int r = poll(&pfd, 1, NET_STALL_MS);
+        if (r < 0 && errno == EINTR) continue;
+        if (r <= 0) {
+            shutdown(fd, SHUT_RDWR);   /* il thread della connessione farà la pulizia */
+            errno = EPIPE;
+            return -1;
+        }
+        ssize_t n = send(fd, p, len, MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) continue;
+        if (n <= 0) return -1;
+        p   += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+static ssize_t sock_send(int fd, const void *buf, size_t len, int dontwait) {
+    pthread_mutex_t *l = &g_wlock[(unsigned)fd % NET_WLOCKS];
+    int              shared = fd >= NET_WLOCKS;
+    const char      *p = buf;
+    size_t           off = 0;
+
+    if (dontwait && pthread_mutex_trylock(l) != 0) { errno = EAGAIN; return -1; }
+    if (!dontwait) pthread_mutex_lock(l);
+
+    /* Lock condiviso: mai un send bloccante, lo stallo resta limitato */
+    if (dontwait || shared) {
+        ssize_t n = send(fd, p, len, MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (n < 0 && !dontwait && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) n = 0;
+        if (n >= 0 && (size_t)n < len && finish_send(fd, p + n, len - (size_t)n) < 0) n = -1;
+        int e = errno;
+        pthread_mutex_unlock(l);
+        errno = e;
+        return n < 0 ? -1 : (ssize_t)len;
+    }
+
+    while (off < len) {
+        ssize_t n = send(fd, p + off, len - off, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        off += (size_t)n;
+    }
+    int e = errno;
+    pthread_mutex_unlock(l);
+    errno = e;
+    return off == len ? (ssize_t)len : -1;
+}
+
+ssize_t net_send(int fd, const void *buf, size_t len, int dontwait) {
+    if (fd >= NET_VFD_BASE) {
+        const net_vrange_t *r = vrange_of(fd);
+        if (r) return r->fn(fd, buf, len, dontwait);
+        errno = EBADF;
+        return -1;
+    }
+    if (g_sender) {
+        ssize_t n = g_sender(fd, buf, len, dontwait);
+        if (n != NET_NOT_MINE) return n;
+    }
+    return sock_send(fd, buf, len, dontwait);
+}
+
+int net_shutdown(int fd) {
+    if (fd < NET_VFD_BASE) return shutdown(fd, SHUT_RDWR);
+    const net_vrange_t *r = vrange_of(fd);
+    if (!r || !r->close_fn) { errno = ENOTSOCK; return -1; }
+    r->close_fn(fd);
+    return 0;
+}
+
 int net_send_str(int sock, const char *s) {
     if (!s) return 0;
     size_t total = strlen(s);
     size_t sent  = 0;
     while (sent < total) {
-        int n = (int)send(sock, s + sent, total - sent, 0);
+        int n = (int)net_send(sock, s + sent, total - sent, 0);
         if (n <= 0) return -1;
         sent += (size_t)n;
     }
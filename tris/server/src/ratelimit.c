@@ -0,0 +1,91 @@
+#include "ratelimit.h"
+#include <string.h>
+#include <time.h>
+
+typedef struct {
+    int rate;
+    int burst;
+} rl_limit_t;
+
+static rl_limit_t g_limits[RL_CLASSES] = {
+    [RL_ANY]   = { RL_ANY_RATE,   RL_ANY_BURST   },
+    [RL_QUERY] = { RL_QUERY_RATE, RL_QUERY_BURST },
+    [RL_LOBBY] = { RL_LOBBY_RATE, RL_LOBBY_BURST },
+    [RL_GAME]  = { 0, 0 },
+};
+
+/* Parola iniziale -> classe (le altre sono RL_GAME) */
+static const struct {
+    const char *cmd;
+    rl_class_t  cls;
+} g_classes[] = {
+    { "LIST",      RL_QUERY }, { "USERS",  RL_QUERY }, { "TOP",    RL_QUERY },
+    { "RANK",      RL_QUERY }, { "WHOAMI", RL_QUERY }, { "HINT",   RL_QUERY },
+    { "CREATE",    RL_LOBBY }, { "JOIN",   RL_LOBBY }, { "QUICKPLAY", RL_LOBBY },
+    { "PLAYAI",    RL_LOBBY }, { "WATCH",  RL_LOBBY }, { "UNWATCH",   RL_LOBBY },
+    { "REMATCH",   RL_LOBBY }, { "LOGIN",  RL_LOBBY }, { "RESUME",    RL_LOBBY },
+    { "TOURNAMENT", RL_LOBBY },
+};
+
+void rl_configure(rl_class_t cls, int rate, int burst) {
+    if (cls < 0 || cls >= RL_CLASSES) return;
+    g_limits[cls].rate  = rate;
+    g_limits[cls].burst = burst > 0 ? burst : rate;
+}
+
+static uint64_t now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
+
+void rl_conn_init(rl_conn_t *c) {
+    uint64_t now = now_ms();
+    for (int i = 0; i < RL_CLASSES; i++) {
+        c->b[i].milli   = (uint32_t)g_limits[i].burst * 1000;
+        c->b[i].last_ms = now;
+    }
+    c->strikes = 0;
+    c->prev    = 0;
+}
+
+rl_class_t rl_class_of(const char *line) {
+    size_t n = strcspn(line, " ");
+    for (size_t i = 0; i < sizeof(g_classes) / sizeof(g_classes[0]); i++)
+        if (strlen(g_classes[i].cmd) == n && strncmp(line, g_classes[i].cmd, n) == 0)
+            return g_classes[i].cls;
+    return RL_GAME;
+}
+
+/* Ricarica e prova a prendere un token (rate token/s = rate millitoken/ms) */
+static int take(rl_bucket_t *b, const rl_limit_t *l, uint64_t now) {
+    if (l->rate <= 0) return 1;
+    uint64_t cap   = (uint64_t)l->burst * 1000;
+    uint64_t fill  = b->milli + (now - b->last_ms) * (uint64_t)l->rate;
+    b->milli   = (uint32_t)(fill < cap ? fill : cap);
+    b->last_ms = now;
+    if (b->milli < 1000) return 0;
+    b->milli -= 1000;
+    return 1;
+}
+
+int rl_check(rl_conn_t *c, const char *line) {
+    uint64_t   now = now_ms();
+    rl_class_t cls = rl_class_of(line);
+
+    int ok = take(&c->b[RL_ANY], &g_limits[RL_ANY], now);
+    if (ok && cls != RL_ANY && !take(&c->b[cls], &g_limits[cls], now)) {
+        /* Rifiutata dalla classe: il token generale torna, MOVE resta libero */
+        if (g_limits[RL_ANY].rate > 0) c->b[RL_ANY].milli += 1000;
+        ok = 0;
+    }
+
+    if (ok) { c->prev = c->strikes; c->strikes = 0; return 0; }
+    return (++c->strikes >= RL_MAX_STRIKES) ? -1 : 1;
+}
+
+int rl_reject(rl_conn_t *c) {
+    c->strikes = c->prev + 1;
+    c->prev    = 0;
+    return c->strikes >= RL_MAX_STRIKES ? -1 : 0;
+}
@@ -0,0 +1,390 @@
+#include "rating.h"
+#include "protocol.h"
+#include "log.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#define RATING_MAGIC   0x54525254u   /* "TRRT" */
+#define RATING_VERSION 1
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t count;
+} rating_file_hdr_t;
+
+/* ------------------------------------------------------------------ */
+/*  Hash per nome                                                       */
+/* ------------------------------------------------------------------ */
+
+static unsigned hash_name(const char *s) {
+    unsigned h = 2166136261u;                 /* FNV-1a */
+    while (*s) { h ^= (unsigned char)*s++; h *= 16777619u; }
+    return h;
+}
+
+static rating_node_t *lookup(rating_store_t *rs, const char *name) {
+    rating_node_t *n = rs->buckets[hash_name(name) & (unsigned)(rs->nbuckets - 1)];
+    while (n && strcmp(n->name, name) != 0) n = n->hnext;
+    return n;
+}
+
+static void grow_buckets(rating_store_t *rs) {
+    int             nb  = rs->nbuckets * 2;
+    rating_node_t **tab = calloc((size_t)nb, sizeof(*tab));
+    if (!tab) return;   /* si continua con catene più lunghe */
+    for (int i = 0; i < rs->nbuckets; i++) {
+        rating_node_t *n = rs->buckets[i];
+        while (n) {
+            rating_node_t *next = n->hnext;
+            unsigned b = hash_name(n->name) & (unsigned)(nb - 1);
+            n->hnext = tab[b];
+            tab[b]   = n;
+            n = next;
+        }
+    }
+    free(rs->buckets);
+    rs->buckets  = tab;
+    rs->nbuckets = nb;
+}
+
+/* ------------------------------------------------------------------ */
+/*  Skiplist indicizzata                                                */
+/* ------------------------------------------------------------------ */
+
+/* a precede b in classifica? */
+static int before(const rating_node_t *a, const rating_node_t *b) {
+    if (a->rating != b->rating) return a->rating > b->rating;
+    return strcmp(a->name, b->name) < 0;
+}
+
+static int random_level(rating_store_t *rs) {
+    int lvl = 1;
+    while (lvl < RATING_MAX_LEVEL && (rand_r(&rs->seed) & 3) == 0) lvl++;
+    return lvl;
+}
+
+static rating_node_t *node_alloc(int level) {
+    rating_node_t *n = calloc(1, sizeof(*n) + (size_t)level * sizeof(n->lv[0]));
+    if (n) n->level = level;
+    return n;
+}
+
+static void sl_insert(rating_store_t *rs, rating_node_t *node) {
+    rating_node_t *update[RATING_MAX_LEVEL];
+    int            rank[RATING_MAX_LEVEL];
+    rating_node_t *x = rs->head;
+
+    for (int i = rs->level - 1; i >= 0; i--) {
+        rank[i] = (i == rs->level - 1) ? 0 : rank[i + 1];
+        while (x->lv[i].next && before(x->lv[i].next, node)) {
+            rank[i] += x->lv[i].span;
+            x = x->lv[i].next;
+        }
+        update[i] = x;
+    }
+    if (node->level > rs->level) {
+        for (int i = rs->level; i < node->level; i++) {
+            rank[i]   = 0;
+            update[i] = rs->head;
+            update[i]->lv[i].span = rs->count;
+        }
+        rs->level = node->level;
+    }
+    for (int i = 0; i < node->level; i++) {
+        node->lv[i].next      = update[i]->lv[i].next;
+        update[i]->lv[i].next = node;
+        node->lv[i].span      = update[i]->lv[i].span - (rank[0] - rank[i]);
+        update[i]->lv[i].span = (rank[0] - rank[i]) + 1;
+    }
+    for (int i = node->level; i < rs->level; i++)
+        update[i]->lv[i].span++;
+    rs->count++;
+}
+
+static void sl_delete(rating_store_t *rs, rating_node_t *node) {
+    rating_node_t *update[RATING_MAX_LEVEL];
+    rating_node_t *x = rs->head;
+
+    for (int i = rs->level - 1; i >= 0; i--) {
+        while (x->lv[i].next && before(x->lv[i].next, node))
+            x = x->lv[i].next;
+        update[i] = x;
+    }
+    for (int i = 0; i < rs->level; i++) {
+        if (update[i]->lv[i].next == node) {
+            update[i]->lv[i].span += node->lv[i].span - 1;
+            update[i]->lv[i].next  = node->lv[i].next;
+        } else {
+            update[i]->lv[i].span--;
+        }
+    }
+    while (rs->level > 1 && rs->head->lv[rs->level - 1].next == NULL)
+        rs->level--;
+    rs->count--;
+}
+
+static int sl_rank(rating_store_t *rs, const rating_node_t *node) {
+    rating_node_t *x = rs->head;
+    int rank = 0;
+    for (int i = rs->level - 1; i >= 0; i--) {
+        while (x->lv[i].next &&
+               (x->lv[i].next == node || before(x->lv[i].next, node))) {
+            rank += x->lv[i].span;
+            x = x->lv[i].next;
+        }
+        if (x == node) return rank;
+    }
+    return -1;
+}
+
+/* Trova o crea (con il rating iniziale, senza partite) */
+static rating_node_t *get_or_create(rating_store_t *rs, const char *name) {
+    rating_node_t *n = lookup(rs, name);
+    if (n) return n;
+    n = node_alloc(random_level(rs));
+    if (!n) return NULL;
+    strncpy(n->name, name, MAX_NAME - 1);
+    n->rating = RATING_INITIAL;
+    if (rs->count >= rs->nbuckets) grow_buckets(rs);
+    unsigned b = hash_name(n->name) & (unsigned)(rs->nbuckets - 1);
+    n->hnext = rs->buckets[b];
+    rs->buckets[b] = n;
+    sl_insert(rs, n);
+    return n;
+}
+
+/* ------------------------------------------------------------------ */
+/*  API                                                                 */
+/* ------------------------------------------------------------------ */
+
+void rating_init(rating_store_t *rs, const char *path) {
+    memset(rs, 0, sizeof(*rs));
+    pthread_mutex_init(&rs->mtx, NULL);
+    pthread_mutex_init(&rs->save_mtx, NULL);
+    rs->nbuckets = 256;
+    rs->buckets  = calloc((size_t)rs->nbuckets, sizeof(*rs->buckets));
+    rs->head     = node_alloc(RATING_MAX_LEVEL);
+    rs->level    = 1;
+    rs->seed     = (unsigned)getpid();
+    if (!rs->buckets || !rs->head) {
+        perror("rating_init");
+        exit(1);
+    }
+    if (path) {
+        strncpy(rs->path, path, sizeof(rs->path) - 1);
+    }
+}
+
+void rating_record(rating_store_t *rs, const char *a, const char *b, int draw) {
+    if (!rs || !a || !b || !a[0] || !b[0] || strcmp(a, b) == 0) return;
+
+    pthread_mutex_lock(&rs->mtx);
+    rating_node_t *na = get_or_create(rs, a);
+    rating_node_t *nb = get_or_create(rs, b);
+    if (!na || !nb) { pthread_mutex_unlock(&rs->mtx); return; }
+
+    double ea = 1.0 / (1.0 + pow(10.0, (nb->rating - na->rating) / 400.0));
+    double sa = draw ? 0.5 : 1.0;
+    int    d  = (int)lround(RATING_K * (sa - ea));
+
+    /* Cambia la chiave di ordinamento: si tolgono e si reinseriscono */
+    sl_delete(rs, na);
+    sl_delete(rs, nb);
+    na->rating += d;
+    nb->rating -= d;
+    if (draw) { na->draws++; nb->draws++; }
+    else      { na->wins++;  nb->losses++; }
+    sl_insert(rs, na);
+    sl_insert(rs, nb);
+    rs->dirty = 1;
+    pthread_mutex_unlock(&rs->mtx);
+}
+
+int rating_get(rating_store_t *rs, const char *name) {
+    pthread_mutex_lock(&rs->mtx);
+    rating_node_t *n = lookup(rs, name);
+    int r = n ? n->rating : RATING_INITIAL;
+    pthread_mutex_unlock(&rs->mtx);
+    return r;
+}
+
+int rating_rank(rating_store_t *rs, const char *name, int *rating_out) {
+    pthread_mutex_lock(&rs->mtx);
+    rating_node_t *n = lookup(rs, name);
+    int rank = -1;
+    if (n) {
+        rank = sl_rank(rs, n);
+        *rating_out = n->rating;
+    }
+    pthread_mutex_unlock(&rs->mtx);
+    return rank;
+}
+
+void rating_top(rating_store_t *rs, int n, char *out, int outsz) {
+    if (n > RATING_MAX_TOP) n = RATING_MAX_TOP;
+
+    pthread_mutex_lock(&rs->mtx);
+    char *p    = out;
+    int   left = outsz;
+    int   pos  = 0;
+    for (rating_node_t *x = rs->head->lv[0].next; x && pos < n; x = x->lv[0].next) {
+        pos++;
+        int k = snprintf(p, left, PROTO_RANK_LINE, pos, x->name, x->rating,
+                         x->wins, x->losses, x->draws);
+        if (k > 0 && k < left) { p += k; left -= k; }
+    }
+    if (pos == 0) snprintf(out, outsz, PROTO_NO_RATINGS);
+    pthread_mutex_unlock(&rs->mtx);
+}
+
+/* ------------------------------------------------------------------ */
+/*  Persistenza                                                         */
+/* ------------------------------------------------------------------ */
+
+int rating_load(rating_store_t *rs) {
+    if (!rs->path[0]) return 0;
+    FILE *f = fopen(rs->path, "rb");
+    if (!f) return 0;
+
+    rating_file_hdr_t hdr;
+    if (fread(&hdr, sizeof(hdr), 1, f) != 1 ||
+        hdr.magic != RATING_MAGIC || hdr.version != RATING_VERSION) {
+        fclose(f);
+        return -1;
+    }
+
+    int loaded = 0;
+    pthread_mutex_lock(&rs->mtx);
+    for (uint32_t i = 0; i < hdr.count; i++) {
+        uint8_t len;
+        char    name[MAX_NAME];
+        int32_t vals[4];
+        if (fread(&len, 1, 1, f) != 1 || len == 0 || len >= MAX_NAME ||
+            fread(name, 1, len, f) != len ||
+            fread(vals, sizeof(vals), 1, f) != 1)
+            break;
+        name[len] = '\0';
+
+        rating_node_t *n = get_or_create(rs, name);
+        if (!n) break;
+        sl_delete(rs, n);
+        n->rating = vals[0];
+        n->wins   = vals[1];
+        n->losses = vals[2];
+        n->draws  = vals[3];
+        sl_insert(rs, n);
+        loaded++;
+    }
+    pthread_mutex_unlock(&rs->mtx);
+    fclose(f);
+    return loaded;
+}
+
+/* Con save_mtx preso */
+static int save_locked(rating_store_t *rs) {
+    /* Serializzazione sotto lock in memoria, scrittura su disco fuori */
+    pthread_mutex_lock(&rs->mtx);
+    size_t rec = 1 + MAX_NAME + 4 * sizeof(int32_t);
+    size_t cap = sizeof(rating_file_hdr_t) + (size_t)rs->count * rec;
+    char  *buf = malloc(cap);
+    if (!buf) { pthread_mutex_unlock(&rs->mtx); return -1; }
+
+    rating_file_hdr_t hdr = { RATING_MAGIC, RATING_VERSION, (uint32_t)rs->count };
+    size_t off = 0;
+    memcpy(buf, &hdr, sizeof(hdr));
+    off += sizeof(hdr);
+    for (rating_node_t *x = rs->head->lv[0].next; x; x = x->lv[0].next) {
+        uint8_t len  = (uint8_t)strlen(x->name);
+        int32_t vals[4] = { x->rating, x->wins, x->losses, x->draws };
+        buf[off++] = (char)len;
+        memcpy(buf + off, x->name, len);
+        off += len;
+        memcpy(buf + off, vals, sizeof(vals));
+        off += sizeof(vals);
+    }
+    rs->dirty = 0;
+    pthread_mutex_unlock(&rs->mtx);
+
+    /* Scrittura atomica: file temporaneo + rename */
+    char tmp[sizeof(rs->path) + 8];
+    snprintf(tmp, sizeof(tmp), "%s.XXXXXX", rs->path);
+    int   tfd = mkstemp(tmp);
+    FILE *f   = NULL;
+    int   rc  = -1;
+    if (tfd >= 0) {
+        fchmod(tfd, 0644);
+        f = fdopen(tfd, "wb");
+        if (!f) close(tfd);
+    }
+    if (f) {
+        if (fwrite(buf, 1, off, f) == off && fflush(f) == 0 && fsync(fileno(f)) == 0)
+            rc = 0;
+        if (fclose(f) != 0) rc = -1;
+        if (rc == 0 && rename(tmp, rs->path) != 0) rc = -1;
+    }
+    if (tfd >= 0 && rc < 0) unlink(tmp);
+    if (rc < 0) {
+        LOG_ERRNO(LOG_SYS_RATING, "rating_save");
+        pthread_mutex_lock(&rs->mtx);
+        rs->dirty = 1;
+        pthread_mutex_unlock(&rs->mtx);
+    }
+    free(buf);
+    return rc;
+}
+
+int rating_save(rating_store_t *rs) {
+    if (!rs->path[0]) return 0;
+    pthread_mutex_lock(&rs->save_mtx);
+    int rc = save_locked(rs);
+    pthread_mutex_unlock(&rs->save_mtx);
+    return rc;
+}
+
+void rating_pause_autosave(rating_store_t *rs, int paused) {
+    pthread_mutex_lock(&rs->save_mtx);
+    rs->paused = paused;
+    pthread_mutex_unlock(&rs->save_mtx);
+}
+
+typedef struct {
+    rating_store_t *rs;
+    int             interval;
+} autosave_arg_t;
+
+static void *autosave_thread(void *arg) {
+    autosave_arg_t a = *(autosave_arg_t *)arg;
+    free(arg);
+    while (1) {
+        sleep((unsigned)a.interval);
+        pthread_mutex_lock(&a.rs->mtx);
+        int dirty = a.rs->dirty;
+        pthread_mutex_unlock(&a.rs->mtx);
+        if (!dirty || !a.rs->path[0]) continue;
+        pthread_mutex_lock(&a.rs->save_mtx);
+        if (!a.rs->paused) save_locked(a.rs);
+        pthread_mutex_unlock(&a.rs->save_mtx);
+    }
+    return NULL;
+}
+
+int rating_start_autosave(rating_store_t *rs, int interval_sec) {
+    autosave_arg_t *a = malloc(sizeof(*a));
+    if (!a) return -1;
+    a->rs       = rs;
+    a->interval = interval_sec > 0 ? interval_sec : 1;
+
+    pthread_t tid;
+    if (pthread_create(&tid, NULL, autosave_thread, a) != 0) {
+        free(a);
+        return -1;
+    }
+    pthread_detach(tid);
+    return 0;
+}
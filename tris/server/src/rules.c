@@ -0,0 +1,59 @@
+#include "rules.h"
+#include <string.h>
+
+/* ------------------------------------------------------------------ */
+/*  Varianti m,n,k                                                      */
+/* ------------------------------------------------------------------ */
+
+int rules_mnk_valid(int rows, int cols, int k) {
+    if (rows < RULES_MIN_DIM || rows > RULES_MAX_DIM) return 0;
+    if (cols < RULES_MIN_DIM || cols > RULES_MAX_DIM) return 0;
+    return k >= 3 && k <= (rows > cols ? rows : cols);
+}
+
+void rules_board_clear(char *b, int cells) {
+    memset(b, ' ', (size_t)cells);
+}
+
+/* Pietre consecutive di ch da (r, c) escluso, nel verso (dr, dc) */
+static int run(const char *b, int rows, int cols, int r, int c,
+               int dr, int dc, char ch, int max) {
+    int n = 0;
+    for (r += dr, c += dc;
+         n < max && r >= 0 && r < rows && c >= 0 && c < cols &&
+         b[r * cols + c] == ch;
+         r += dr, c += dc)
+        n++;
+    return n;
+}
+
+int rules_mnk_wins(const char *b, int rows, int cols, int k, int r, int c) {
+    static const int dir[4][2] = { { 0, 1 }, { 1, 0 }, { 1, 1 }, { 1, -1 } };
+    char ch = b[r * cols + c];
+    if (ch == ' ') return 0;
+
+    for (int i = 0; i < 4; i++) {
+        int dr = dir[i][0], dc = dir[i][1];
+        int n  = 1 + run(b, rows, cols, r, c,  dr,  dc, ch, k - 1);
+        if (n < k)
+            n += run(b, rows, cols, r, c, -dr, -dc, ch, k - n);
+        if (n >= k) return 1;
+    }
+    return 0;
+}
+
+/* ------------------------------------------------------------------ */
+/*  Tris classico in bitboard                                           */
+/* ------------------------------------------------------------------ */
+
+const unsigned short rules_lines[RULES_LINES] = {
+    0007, 0070, 0700,           /* righe    */
+    0111, 0222, 0444,           /* colonne  */
+    0421, 0124                  /* diagonali */
+};
+
+int rules_bits_win(unsigned mask) {
+    for (int i = 0; i < RULES_LINES; i++)
+        if ((mask & rules_lines[i]) == rules_lines[i]) return 1;
+    return 0;
+}
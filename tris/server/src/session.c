@@ -0,0 +1,1124 @@
+#include "session.h"
+#include "server.h"
+#include "net.h"
+#include "protocol.h"
+#include "solver.h"
+#include "admission.h"
+#include "log.h"
+#include "lobby.h"
+#include "mux.h"
+#include "capture.h"
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+
+#define TW_BATCH 64
+
+#define MATCH_WAIT_QUEUE  MAX_CLIENTS
+#define MATCH_WAIT_GAP_MS 30000   /* stima iniziale: una partita breve */
+
+/* Richieste di partita in attesa di uno slot (adm_entry_t.kind) */
+enum { MW_CREATE, MW_AI, MW_QUICKPLAY };
+
+static adm_queue_t g_match_wait;
+
+/* Timer di inattività e heartbeat, per slot client */
+static tw_node_t g_idle_timer[MAX_CLIENTS];
+static tw_node_t g_ping_timer[MAX_CLIENTS];
+
+/* Tempo monotono in tick della ruota dei timer */
+static uint64_t mono_ticks(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * TW_TICKS_PER_SEC +
+           (uint64_t)ts.tv_nsec / (TW_TICK_MS * 1000000ULL);
+}
+
+/* Attività sulla connessione: riparte il conto alla rovescia (O(1)) */
+static void conn_touch(int slot, int fd) {
+    if (slot < 0) return;
+    if (g_idle_sec > 0)
+        tw_arm(&g_wheel, &g_idle_timer[slot], (unsigned)g_idle_sec * TW_TICKS_PER_SEC, fd);
+    if (g_ping_sec > 0)
+        tw_arm(&g_wheel, &g_ping_timer[slot], (unsigned)g_ping_sec * TW_TICKS_PER_SEC, fd);
+}
+
+static void conn_timers_stop(int slot) {
+    if (slot < 0) return;
+    tw_cancel(&g_wheel, &g_idle_timer[slot]);
+    tw_cancel(&g_wheel, &g_ping_timer[slot]);
+}
+
+/* Broadcast della lobby: con -M arriva anche agli altri processi */
+static void broadcast(const char *msg, int exclude_fd) {
+    state_broadcast(&g_state, msg, exclude_fd);
+    lobby_broadcast(msg);
+}
+
+/* ------------------------------------------------------------------ */
+/*  Helper: notifica inizio partita a entrambi i giocatori + board     */
+/* ------------------------------------------------------------------ */
+static void notify_match_start(int match_id,
+                                int owner_fd,  const char *owner_name,
+                                int joiner_fd, const char *joiner_name,
+                                const char *fmt_x, const char *fmt_o) {
+    char msg[256];
+    char bbuf[MATCH_BOARD_BUFSZ];
+    int  have_board = matches_board(&g_matches, match_id, bbuf, sizeof(bbuf)) == 0;
+
+    /*
+     * Prima O: X può muovere appena legge il suo avviso, e la sua mossa
+     * non deve arrivare a O prima dell'inizio partita.
+     */
+    snprintf(msg, sizeof(msg), fmt_o, match_id, owner_name);
+    send_all(joiner_fd, msg);
+    if (have_board) send_all(joiner_fd, bbuf);
+
+    snprintf(msg, sizeof(msg), fmt_x, match_id, joiner_name);
+    send_all(owner_fd, msg);
+    if (have_board) send_all(owner_fd, bbuf);
+}
+
+/* ------------------------------------------------------------------ */
+/*  Helper: fine partita dopo una mossa (mrc 1 = vince mover_fd,        */
+/*  2 = pareggio).  fd -1 indica l'AI.                                  */
+/* ------------------------------------------------------------------ */
+static void announce_move_end(int mid, int mrc, int mover_fd, int other_fd,
+                              int r, int c, const char *winner,
+                              const char *boardbuf) {
+    if (mover_fd != -1) state_clear_playing_match(&g_state, mover_fd);
+    if (other_fd != -1) state_clear_playing_match(&g_state, other_fd);
+
+    if (mrc == 1) {
+        if (mover_fd != -1) {
+            send_all(mover_fd, PROTO_EVENT_YOU_WIN);
+            proto_sendf(mover_fd, PROTO_EVENT_WINNER, winner);
+            send_all(mover_fd, boardbuf);
+            send_all(mover_fd, PROTO_EVENT_GAME_OVER_WIN);
+        }
+        if (other_fd != -1) {
+            send_all(other_fd, PROTO_EVENT_YOU_LOSE);
+            proto_sendf(other_fd, PROTO_EVENT_WINNER, winner);
+            send_all(other_fd, boardbuf);
+            send_all(other_fd, PROTO_EVENT_GAME_OVER_LOSE);
+        }
+        spectate_publish(&g_spect, mid,
+            evbuf_printf(PROTO_EVENT_WATCH_MOVE "%s" PROTO_EVENT_WATCH_WINNER,
+                         mid, r, c, boardbuf, mid, winner), 1);
+    } else {
+        int fds[2] = { mover_fd, other_fd };
+        for (int i = 0; i < 2; i++) {
+            if (fds[i] == -1) continue;
+            send_all(fds[i], PROTO_EVENT_DRAW);
+            send_all(fds[i], boardbuf);
+            send_all(fds[i], PROTO_EVENT_GAME_OVER_DRAW);
+        }
+        spectate_publish(&g_spect, mid,
+            evbuf_printf(PROTO_EVENT_WATCH_MOVE "%s" PROTO_EVENT_WATCH_DRAW,
+                         mid, r, c, boardbuf, mid), 1);
+    }
+
+    char bcast[64];
+    snprintf(bcast, sizeof(bcast), PROTO_EVENT_MATCH_FINISHED, mid);
+    broadcast(bcast, -1);
+}
+
+/* ------------------------------------------------------------------ */
+/*  Helper: risposta dell'AI dopo la mossa del giocatore                */
+/* ------------------------------------------------------------------ */
+static void ai_reply(int mid, int human_fd) {
+    int  r, c;
+    char boardbuf[MATCH_BOARD_BUFSZ];
+    int  rc = matches_ai_move(&g_matches, mid, &r, &c, boardbuf, sizeof(boardbuf));
+    if (rc < 0) return;   /* non è una partita contro l'AI */
+
+    if (rc == 0) {
+        proto_sendf(human_fd, PROTO_EVENT_OPPONENT_MOVED, r, c);
+        send_all(human_fd, boardbuf);
+        spectate_publish(&g_spect, mid,
+            evbuf_printf(PROTO_EVENT_WATCH_MOVE "%s", mid, r, c, boardbuf), 0);
+    } else {
+        proto_sendf(human_fd, PROTO_EVENT_OPPONENT_MOVED, r, c);
+        announce_move_end(mid, rc, -1, human_fd, r, c, PROTO_AI_NAME, boardbuf);
+    }
+}
+
+/* ------------------------------------------------------------------ */
+/*  Helper: avvio di una partita abbinata da QUICKPLAY                  */
+/* ------------------------------------------------------------------ */
+static void match_wait(int fd, int fd2, int kind, int a, int b, int c);
+static void start_quickplay(int x_fd, int o_fd);
+
+/* Partita già in MATCH_PLAYING (QUICKPLAY, tornei): avvisi a tutti */
+static void announce_playing(int id, int x_fd, int o_fd) {
+    state_set_playing_match(&g_state, x_fd, id);
+    state_set_playing_match(&g_state, o_fd, id);
+
+    char x_name[MAX_NAME] = "??";
+    char o_name[MAX_NAME] = "??";
+    state_get_name_copy(&g_state, x_fd, x_name, sizeof(x_name));
+    state_get_name_copy(&g_state, o_fd, o_name, sizeof(o_name));
+
+    notify_match_start(id,
+        x_fd, x_name,
+        o_fd, o_name,
+        PROTO_OK_MATCH_STARTED_X,
+        PROTO_OK_MATCH_STARTED_O);
+
+    char bcast[128];
+    snprintf(bcast, sizeof(bcast), PROTO_EVENT_MATCH_STARTED_ALL, id);
+    broadcast(bcast, -1);
+}
+
+static int qp_claim(int x_fd, int o_fd) {
+    return matchmaker_claim(&g_queue, &g_state, x_fd, o_fd);
+}
+
+/*
+ * La partita di una coppia QUICKPLAY non è nata: chi è ancora abbinato
+ * e libero torna in coda (e magari trova subito un altro avversario),
+ * chi nel frattempo è entrato in un'altra partita ne esce.
+ */
+static void qp_requeue(int fd) {
+    char name[MAX_NAME];
+    if (matches_player_busy(&g_matches, fd) ||
+        !state_get_name_copy(&g_state, fd, name, sizeof(name))) {
+        matchmaker_remove(&g_queue, &g_state, fd);
+        return;
+    }
+    int opp_fd = -1;
+    int rc = matchmaker_requeue(&g_queue, &g_state, fd, rating_get(&g_ratings, name), &opp_fd);
+    if (rc == 1)      start_quickplay(opp_fd, fd);
+    else if (rc == 0) send_all(fd, PROTO_OK_QUEUED);
+}
+
+static int try_quickplay(int x_fd, int o_fd) {
+    int id = matches_create_playing(&g_matches, x_fd, o_fd, qp_claim);
+    if (id == -1) return -1;
+    if (id == -2) {
+        qp_requeue(x_fd);
+        qp_requeue(o_fd);
+        return 0;
+    }
+    announce_playing(id, x_fd, o_fd);
+    return 0;
+}
+
+static void start_quickplay(int x_fd, int o_fd) {
+    if (adm_len(&g_match_wait) > 0 || try_quickplay(x_fd, o_fd) < 0)
+        match_wait(x_fd, o_fd, MW_QUICKPLAY, 0, 0, 0);
+}
+
+/* ------------------------------------------------------------------ */
+/*  Helper: CREATE e PLAYAI.  -1 se non c'è uno slot libero (nessuna    */
+/*  risposta inviata), 0 se la risposta è partita                       */
+/* ------------------------------------------------------------------ */
+static int try_create(int fd, const char *me, int rows, int cols, int k) {
+    int id = matches_create(&g_matches, fd, rows, cols, k);
+    if (id == -1) return -1;
+
+    char bcast[128];
+    if (id == -2) {
+        send_all(fd, PROTO_ERR_BAD_VARIANT);
+    } else if (rows == 3 && cols == 3 && k == 3) {
+        proto_sendf(fd, PROTO_OK_MATCH_CREATED, id);
+        snprintf(bcast, sizeof(bcast), PROTO_EVENT_MATCH_AVAILABLE, id, me);
+        broadcast(bcast, fd);
+    } else {
+        proto_sendf(fd, PROTO_OK_MATCH_CREATED_MNK, id, rows, cols, k);
+        snprintf(bcast, sizeof(bcast), PROTO_EVENT_MATCH_AVAILABLE_MNK,
+                 id, me, rows, cols, k);
+        broadcast(bcast, fd);
+    }
+    return 0;
+}
+
+static int try_playai(int fd, match_ai_t level) {
+    if (state_get_playing_match(&g_state, fd) != -1) {
+        send_all(fd, PROTO_ERR_ALREADY_PLAYING);
+        return 0;
+    }
+    int id = matches_create_ai(&g_matches, fd, level);
+    if (id < 0) return -1;
+
+    matchmaker_remove(&g_queue, &g_state, fd);
+    state_set_playing_match(&g_state, fd, id);
+    proto_sendf(fd, PROTO_OK_AI_MATCH_STARTED, id,
+                level == MATCH_AI_PERFECT ? "perfect" : "easy");
+    char bbuf[MATCH_BOARD_BUFSZ];
+    if (matches_board(&g_matches, id, bbuf, sizeof(bbuf)) == 0)
+        send_all(fd, bbuf);
+    return 0;
+}
+
+/* ------------------------------------------------------------------ */
+/*  Coda delle partite: a lobby piena la richiesta aspetta il suo turno */
+/*  invece di ERR MATCHES_FULL.  Finché c'è qualcuno in coda anche le   */
+/*  richieste nuove si mettono in fila.                                 */
+/* ------------------------------------------------------------------ */
+static void match_wait(int fd, int fd2, int kind, int a, int b, int c) {
+    adm_entry_t e = { fd, fd2, kind, a, b, c };
+    int pos = adm_push(&g_match_wait, &e);
+    if (pos < 0) {
+        send_all(fd, PROTO_ERR_MATCHES_FULL);
+        if (fd2 >= 0) send_all(fd2, PROTO_ERR_MATCHES_FULL);
+        if (kind == MW_QUICKPLAY) {   /* la coppia si scioglie */
+            matchmaker_remove(&g_queue, &g_state, fd);
+            matchmaker_remove(&g_queue, &g_state, fd2);
+        }
+        return;
+    }
+    int eta = adm_eta(&g_match_wait, pos);
+    proto_sendf(fd, PROTO_OK_MATCH_QUEUED, pos, eta);
+    if (fd2 >= 0) proto_sendf(fd2, PROTO_OK_MATCH_QUEUED, pos, eta);
+}
+
+static int match_wait_run(const adm_entry_t *e) {
+    char me[MAX_NAME] = "??";
+    switch (e->kind) {
+        case MW_CREATE:
+            state_get_name_copy(&g_state, e->fd, me, sizeof(me));
+            return try_create(e->fd, me, e->a, e->b, e->c);
+        case MW_AI:
+            return try_playai(e->fd, (match_ai_t)e->a);
+        case MW_QUICKPLAY:
+            return try_quickplay(e->fd, e->fd2);
+    }
+    return 0;
+}
+
+/* Dal thread dei lavori periodici, a ogni tick */
+static void match_wait_drain(void) {
+    if (adm_len(&g_match_wait) == 0) return;
+
+    int         moved = 0;
+    adm_entry_t e;
+    while (adm_pop(&g_match_wait, &e) == 0) {
+        if (match_wait_run(&e) < 0) {
+            adm_push_front(&g_match_wait, &e);
+            break;
+        }
+        adm_served(&g_match_wait);
+        moved = 1;
+    }
+    if (moved) adm_announce(&g_match_wait, PROTO_EVENT_MATCH_QUEUE);
+}
+
+/* fd se ne va: le sue richieste escono dalla coda */
+static void match_wait_cancel(int fd) {
+    adm_entry_t gone[4];
+    int n = adm_remove_fd(&g_match_wait, fd, gone, 4);
+    for (int i = 0; i < n; i++) {
+        if (gone[i].kind != MW_QUICKPLAY) continue;
+        /* L'avversario abbinato torna in coda QUICKPLAY */
+        qp_requeue(gone[i].fd == fd ? gone[i].fd2 : gone[i].fd);
+    }
+    if (n > 0) adm_announce(&g_match_wait, PROTO_EVENT_MATCH_QUEUE);
+}
+
+/* fd esce da code, spettatori e partite (che perde se in corso) */
+static void leave_lobby(int fd) {
+    matchmaker_remove(&g_queue, &g_state, fd);
+    spectate_unwatch(&g_spect, &g_state, fd);
+    match_wait_cancel(fd);
+    int mid = matches_on_disconnect(&g_matches, &g_state, fd);
+    if (mid > 0)
+        spectate_publish(&g_spect, mid,
+                         evbuf_printf(PROTO_EVENT_WATCH_ABANDONED, mid), 1);
+    tour_leave(&g_tours, fd);
+}
+
+/* ------------------------------------------------------------------ */
+/*  Tornei: comandi TOURNAMENT ... (args dopo la parola TOURNAMENT)     */
+/* ------------------------------------------------------------------ */
+static void tournament_cmd(int fd, const char *me, const char *args) {
+    char fmt[16];
+    int  size, id;
+    while (*args == ' ') args++;
+
+    if (sscanf(args, "CREATE %d %15s", &size, fmt) == 2) {
+        int f  = tour_format_parse(fmt);
+        int rc = f < 0 ? -2 : tour_create(&g_tours, fd, me, size, (tour_format_t)f);
+        if (rc > 0) {
+            proto_sendf(fd, PROTO_OK_TOURNAMENT_CREATED, rc);
+            char bcast[160];
+            snprintf(bcast, sizeof(bcast), PROTO_EVENT_TOURNAMENT_OPEN, rc, me, size, fmt);
+            broadcast(bcast, fd);
+        } else if (rc == -1) {
+            send_all(fd, PROTO_ERR_TOURNAMENTS_FULL);
+        } else if (rc == -2) {
+            proto_sendf(fd, PROTO_ERR_BAD_TOURNAMENT, TOUR_MAX_SIZE);
+        } else {
+            send_all(fd, PROTO_ERR_IN_TOURNAMENT);
+        }
+
+    } else if (sscanf(args, "JOIN %d", &id) == 1) {
+        int count = 0;
+        int rc = tour_join(&g_tours, id, fd, me, &count, &size);
+        if (rc == 0)       proto_sendf(fd, PROTO_OK_TOURNAMENT_JOINED, id, count, size);
+        else if (rc == -1) send_all(fd, PROTO_ERR_TOURNAMENT_NOT_FOUND);
+        else if (rc == -2) send_all(fd, PROTO_ERR_TOURNAMENT_CLOSED);
+        else               send_all(fd, PROTO_ERR_IN_TOURNAMENT);
+
+    } else if (strcmp(args, "LEAVE") == 0) {
+        /* Durante una partita no: prima RESIGN */
+        if (state_get_playing_match(&g_state, fd) != -1) {
+            send_all(fd, PROTO_ERR_ALREADY_PLAYING);
+            return;
+        }
+        id = tour_leave(&g_tours, fd);
+        if (id > 0) proto_sendf(fd, PROTO_OK_TOURNAMENT_LEFT, id);
+        else        send_all(fd, PROTO_ERR_NOT_IN_TOURNAMENT);
+
+    } else if (strcmp(args, "LIST") == 0) {
+        char buf[TOUR_MAX * 96];
+        tour_list(&g_tours, buf, sizeof(buf));
+        send_all(fd, buf);
+
+    } else if (sscanf(args, "STANDINGS %d", &id) == 1) {
+        char buf[TOUR_MAX_SIZE * 80];
+        if (tour_standings(&g_tours, id, buf, sizeof(buf)) < 0) {
+            send_all(fd, PROTO_ERR_TOURNAMENT_NOT_FOUND);
+            return;
+        }
+        proto_sendf(fd, PROTO_OK_STANDINGS, id);
+        send_all(fd, buf);
+
+    } else {
+        send_all(fd, PROTO_ERR_BAD_USAGE);
+    }
+}
+
+/* Dal thread dei lavori periodici, a ogni tick: annunci fuori dai lock */
+static void tournament_run(void) {
+    static tour_event_t ev[TOUR_EVENTS_MAX];   /* un solo thread: niente stack */
+    int n = tour_tick(&g_tours, &g_matches, &g_state, &g_ratings, ev, TOUR_EVENTS_MAX);
+    for (int i = 0; i < n; i++) {
+        const tour_event_t *e = &ev[i];
+        char bcast[128];
+        switch (e->kind) {
+            case TOUR_EV_ROUND:
+                proto_sendf(e->fd, PROTO_EVENT_TOURNAMENT_ROUND, e->tour, e->round, e->arg);
+                break;
+            case TOUR_EV_MATCH:
+                matchmaker_remove(&g_queue, &g_state, e->fd);
+                matchmaker_remove(&g_queue, &g_state, e->fd2);
+                proto_sendf(e->fd,  PROTO_EVENT_TOURNAMENT_MATCH, e->tour, e->round, e->match_id);
+                proto_sendf(e->fd2, PROTO_EVENT_TOURNAMENT_MATCH, e->tour, e->round, e->match_id);
+                announce_playing(e->match_id, e->fd, e->fd2);
+                break;
+            case TOUR_EV_BYE:
+                proto_sendf(e->fd, PROTO_EVENT_TOURNAMENT_BYE, e->tour, e->round);
+                break;
+            case TOUR_EV_OUT:
+                proto_sendf(e->fd, PROTO_EVENT_TOURNAMENT_OUT, e->tour, e->round);
+                break;
+            case TOUR_EV_END:
+                snprintf(bcast, sizeof(bcast), PROTO_EVENT_TOURNAMENT_END, e->tour, e->name);
+                broadcast(bcast, -1);
+                break;
+        }
+    }
+}
+
+/* ------------------------------------------------------------------ */
+/*  Helper: JOIN di una partita di un altro processo (lobby.h).  Il     */
+/*  giocatore lascia questo processo come per una disconnessione, ma    */
+/*  la connessione resta e le sue righe passano all'altro processo,     */
+/*  a partire dal JOIN stesso.                                          */
+/* ------------------------------------------------------------------ */
+static void join_remote(session_t *s, int proc, const char *me, const char *line) {
+    int fd    = s->fd;
+    int relay = fd >= NET_VFD_BASE ? -1   /* già inoltrata: niente catene */
+              : lobby_relay_open(proc, fd, me, line);
+    if (relay < 0) {
+        send_all(fd, PROTO_ERR_JOIN_FAILED);
+        return;
+    }
+    leave_lobby(fd);
+    state_logout(&g_state, fd);
+    s->relay = relay;
+}
+
+/* ------------------------------------------------------------------ */
+/*  Cleanup completo di una connessione chiusa o di una sessione scaduta */
+/* ------------------------------------------------------------------ */
+void session_drop(int fd) {
+    char name[MAX_NAME];
+    int  named = state_get_name_copy(&g_state, fd, name, sizeof(name));
+
+    conn_timers_stop(state_slot_of(&g_state, fd));
+    leave_lobby(fd);
+    state_remove_client(&g_state, fd);
+    if (named) lobby_release_name(name);
+    if (fd < NET_VFD_BASE) close(fd);
+}
+
+/* ------------------------------------------------------------------ */
+/*  Sessione: apertura, una riga, chiusura                              */
+/* ------------------------------------------------------------------ */
+void session_open(session_t *s, int fd, int resumed) {
+    s->fd      = fd;
+    s->slot    = state_slot_of(&g_state, fd);
+    s->dropped = 0;
+    s->me[0]   = '\0';
+    s->rebind  = NULL;
+    s->io      = NULL;
+    s->relay   = -1;
+    s->mux     = NULL;
+    s->cap     = fd < NET_VFD_BASE ? capture_conn() : 0;
+    rl_conn_init(&s->rl);
+
+    if (!resumed) {
+        send_all(fd, PROTO_WELCOME);
+        send_all(fd, PROTO_HINT_LOGIN);
+        send_all(fd, PROTO_HINT_CMDS);
+    }
+    conn_touch(s->slot, fd);
+}
+
+int session_line(session_t *s, char *line) {
+    int   client_fd = s->fd;
+    char *me        = s->me;
+
+    conn_touch(s->slot, client_fd);
+    line[strcspn(line, "\r\n")] = '\0';
+    if (s->cap) capture_line(s->cap, line);
+
+    char *p = line;
+    while (*p == ' ' || *p == '\t') p++;
+
+    /*
+     * Limiti prima di qualsiasi lock: conta anche le righe vuote.  Le
+     * righe "@<sid>" di una connessione multiplexata pesano sul limite
+     * generale della connessione, poi su quelli del sid.
+     */
+    int lim = rl_check(&s->rl, p);
+    if (lim == 0 && s->mux && *p == '@' && mux_line(s, p) < 0)
+        lim = rl_reject(&s->rl);
+    if (lim < 0) {
+        send_all(client_fd, PROTO_ERR_RATE_LIMITED);
+        LOG(LOG_WARN, LOG_SYS_SESSION, "Client chiuso per flood (fd=%ld)", client_fd);
+        return SESSION_CLOSE;
+    }
+    if (s->mux && *p == '@') {
+        if (lim > 0) send_all(client_fd, PROTO_ERR_RATE_LIMITED);
+        return SESSION_CONTINUE;
+    }
+    if (*p == '\0') return SESSION_CONTINUE;
+    /* Il token di RESUME non finisce nel log */
+    LOGS(LOG_INFO, LOG_SYS_CMD, strncmp(p, "RESUME ", 7) == 0 ? "RESUME" : p,
+         "%s (fd=%ld)", client_fd);
+    if (lim > 0) {
+        send_all(client_fd, PROTO_ERR_RATE_LIMITED);
+        return SESSION_CONTINUE;
+    }
+    if (s->relay >= 0) {
+        lobby_relay_line(s->relay, p);
+        return SESSION_CONTINUE;
+    }
+
+    if (strcmp(p, "QUIT") == 0 || strcmp(p, "quit") == 0) {
+        send_all(client_fd, PROTO_BYE);
+        return SESSION_CLOSE;
+    }
+
+    /* Heartbeat: valgono anche prima del login */
+    if (strcmp(p, "PING") == 0) { send_all(client_fd, PROTO_PONG); return SESSION_CONTINUE; }
+    if (strcmp(p, "PONG") == 0) return SESSION_CONTINUE;
+
+    me[0] = '\0';
+    int logged_in = state_get_name_copy(&g_state, client_fd, me, sizeof(s->me));
+
+    /* ---------------------------------------------------------- */
+    /*  Non loggato: solo LOGIN                                    */
+    /* ---------------------------------------------------------- */
+    if (!logged_in) {
+        if (strncmp(p, "LOGIN ", 6) == 0) {
+            const char *name = p + 6;
+            int ok = state_login(&g_state, client_fd, name);
+            if (ok == 0 && lobby_claim_name(name) < 0) {
+                /* Preso su un altro processo della lobby */
+                state_logout(&g_state, client_fd);
+                ok = -1;
+            }
+            if (ok == 0) {
+                proto_sendf(client_fd, PROTO_OK_LOGIN, name);
+                char token[TOKEN_LEN + 1];
+                if (state_get_token_copy(&g_state, client_fd, token, sizeof(token)))
+                    proto_sendf(client_fd, PROTO_OK_TOKEN, token);
+            } else if (ok == -1) {
+                send_all(client_fd, PROTO_ERR_NAME_TAKEN);
+            } else {
+                send_all(client_fd, PROTO_ERR_BAD_NAME);
+            }
+        } else if (strcmp(p, "MUX") == 0) {
+            /* Non dentro un giocatore multiplexato o inoltrato */
+            if (s->mux || client_fd >= NET_VFD_BASE || mux_open(s) < 0)
+                send_all(client_fd, PROTO_ERR_SERVER_FULL);
+            else
+                proto_sendf(client_fd, PROTO_OK_MUX, MUX_MAX_SIDS);
+        } else if (strncmp(p, "RESUME ", 7) == 0) {
+            char token[TOKEN_LEN + 1];
+            int  last_seq = 0;
+            int  old_fd   = -1;
+            if (sscanf(p, "RESUME %32s %d", token, &last_seq) < 1) {
+                send_all(client_fd, PROTO_ERR_BAD_USAGE);
+                return SESSION_CONTINUE;
+            }
+            if (state_resume(&g_state, token, client_fd,
+                             &old_fd, me, sizeof(s->me)) < 0) {
+                send_all(client_fd, PROTO_ERR_RESUME_FAILED);
+                return SESSION_CONTINUE;
+            }
+            /* Da qui la sessione prosegue sul vecchio fd */
+            conn_timers_stop(s->slot);
+            if (s->rebind) s->rebind(s, old_fd);
+            else           s->fd = old_fd;
+            close(client_fd);
+            client_fd = old_fd;
+            s->slot   = state_slot_of(&g_state, client_fd);
+            conn_touch(s->slot, client_fd);
+            LOGS(LOG_INFO, LOG_SYS_SESSION, me, "Sessione ripresa: %s (fd=%ld)", client_fd);
+
+            int mid = state_get_playing_match(&g_state, client_fd);
+            if (mid == -1) mid = matches_find_rematch(&g_matches, client_fd);
+            char rbuf[MATCH_BOARD_BUFSZ + 1024];
+            int  seq = (mid == -1) ? -1
+                     : matches_replay(&g_matches, mid, last_seq, rbuf, sizeof(rbuf));
+            if (seq < 0) {
+                proto_sendf(client_fd, PROTO_OK_RESUMED, me);
+            } else {
+                proto_sendf(client_fd, PROTO_OK_RESUMED_MATCH, me, mid, seq);
+                send_all(client_fd, rbuf);
+            }
+        } else {
+            send_all(client_fd, PROTO_ERR_PLEASE_LOGIN);
+        }
+        return SESSION_CONTINUE;
+    }
+
+    /* ---------------------------------------------------------- */
+    /*  Comandi disponibili dopo il login                          */
+    /* ---------------------------------------------------------- */
+
+    if (strcmp(p, "WHOAMI") == 0) {
+        proto_sendf(client_fd, PROTO_OK_WHOAMI, me);
+
+    } else if (strcmp(p, "USERS") == 0) {
+        char buf[512];
+        if (lobby_active()) lobby_users(buf, sizeof(buf));
+        else                state_users(&g_state, buf, sizeof(buf));
+        send_all(client_fd, buf);
+
+    } else if (strncmp(p, "CREATE", 6) == 0 && (p[6] == ' ' || p[6] == '\0')) {
+        /* CREATE = tris classico, CREATE <m> <n> <k> = variante */
+        int rows = 3, cols = 3, k = 3;
+        if (p[6] == ' ' && sscanf(p, "CREATE %d %d %d", &rows, &cols, &k) != 3) {
+            send_all(client_fd, PROTO_ERR_BAD_USAGE);
+            return SESSION_CONTINUE;
+        }
+        if (!rules_mnk_valid(rows, cols, k)) {
+            send_all(client_fd, PROTO_ERR_BAD_VARIANT);
+        } else if (adm_position(&g_match_wait, client_fd) > 0) {
+            send_all(client_fd, PROTO_ERR_ALREADY_QUEUED);
+        } else if (adm_len(&g_match_wait) > 0 ||
+                   try_create(client_fd, me, rows, cols, k) < 0) {
+            match_wait(client_fd, -1, MW_CREATE, rows, cols, k);
+        }
+
+    } else if (strcmp(p, "QUICKPLAY") == 0) {
+        /* Anche una partita propria in attesa o una JOIN in sospeso */
+        if (state_get_playing_match(&g_state, client_fd) != -1 ||
+            matches_player_busy(&g_matches, client_fd)) {
+            send_all(client_fd, PROTO_ERR_ALREADY_PLAYING);
+            return SESSION_CONTINUE;
+        }
+        if (adm_position(&g_match_wait, client_fd) > 0) {
+            send_all(client_fd, PROTO_ERR_ALREADY_QUEUED);
+            return SESSION_CONTINUE;
+        }
+        int opp_fd = -1;
+        int rc = matchmaker_enqueue(&g_queue, &g_state, client_fd,
+                                    rating_get(&g_ratings, me), &opp_fd);
+        if (rc == 1) {
+            start_quickplay(opp_fd, client_fd);
+        } else if (rc == 0) {
+            send_all(client_fd, PROTO_OK_QUEUED);
+        } else if (rc == -1) {
+            send_all(client_fd, PROTO_ERR_ALREADY_QUEUED);
+        } else {
+            send_all(client_fd, PROTO_ERR_UNKNOWN_CMD);
+        }
+
+    } else if (strcmp(p, "QUICKPLAY CANCEL") == 0) {
+        if (matchmaker_remove(&g_queue, &g_state, client_fd) == 0)
+            send_all(client_fd, PROTO_OK_UNQUEUED);
+        else
+            send_all(client_fd, PROTO_ERR_NOT_QUEUED);
+
+    } else if (strncmp(p, "TOURNAMENT", 10) == 0 && (p[10] == ' ' || p[10] == '\0')) {
+        tournament_cmd(client_fd, me, p + 10);
+
+    } else if (strncmp(p, "TOP", 3) == 0 && (p[3] == ' ' || p[3] == '\0')) {
+        int n = 10;
+        if (p[3] == ' ' && (sscanf(p, "TOP %d", &n) != 1 || n <= 0)) {
+            send_all(client_fd, PROTO_ERR_BAD_USAGE);
+            return SESSION_CONTINUE;
+        }
+        char buf[RATING_MAX_TOP * 80];
+        rating_top(&g_ratings, n, buf, sizeof(buf));
+        send_all(client_fd, buf);
+
+    } else if (strncmp(p, "RANK", 4) == 0 && (p[4] == ' ' || p[4] == '\0')) {
+        const char *who = (p[4] == ' ') ? p + 5 : me;
+        int rating = 0;
+        int pos    = rating_rank(&g_ratings, who, &rating);
+        if (pos < 0)
+            send_all(client_fd, PROTO_ERR_UNRANKED);
+        else
+            proto_sendf(client_fd, PROTO_OK_RANK, pos, who, rating);
+
+    } else if (strncmp(p, "WATCH", 5) == 0 && (p[5] == ' ' || p[5] == '\0')) {
+        int id;
+        if (sscanf(p, "WATCH %d", &id) != 1) {
+            send_all(client_fd, PROTO_ERR_BAD_USAGE);
+            return SESSION_CONTINUE;
+        }
+        char bbuf[MATCH_BOARD_BUFSZ];
+        if (matches_board(&g_matches, id, bbuf, sizeof(bbuf)) < 0) {
+            send_all(client_fd, PROTO_ERR_MATCH_NOT_FOUND);
+            return SESSION_CONTINUE;
+        }
+        if (spectate_watch(&g_spect, &g_state, client_fd, id) < 0) {
+            send_all(client_fd, PROTO_ERR_WATCH_FULL);
+            return SESSION_CONTINUE;
+        }
+        proto_sendf(client_fd, PROTO_OK_WATCHING, id);
+        send_all(client_fd, bbuf);
+
+    } else if (strcmp(p, "UNWATCH") == 0) {
+        if (spectate_unwatch(&g_spect, &g_state, client_fd) > 0)
+            send_all(client_fd, PROTO_OK_UNWATCHED);
+        else
+            send_all(client_fd, PROTO_ERR_NOT_WATCHING);
+
+    } else if (strcmp(p, "LIST") == 0) {
+        char buf[1024];
+        if (lobby_active()) lobby_list(buf, sizeof(buf));
+        else                matches_list(&g_matches, &g_state, buf, sizeof(buf));
+        send_all(client_fd, buf);
+
+    } else if (strncmp(p, "JOIN", 4) == 0 && (p[4] == ' ' || p[4] == '\0')) {
+        int id;
+        if (sscanf(p, "JOIN %d", &id) != 1) {
+            send_all(client_fd, PROTO_ERR_BAD_USAGE);
+            return SESSION_CONTINUE;
+        }
+        if (state_get_playing_match(&g_state, client_fd) != -1) {
+            send_all(client_fd, PROTO_ERR_ALREADY_PLAYING);
+            return SESSION_CONTINUE;
+        }
+        int proc = lobby_match_proc(id);
+        if (proc >= 0) {
+            join_remote(s, proc, me, p);
+            return SESSION_CONTINUE;
+        }
+        int owner_fd = -1;
+        int rc = matches_request_join(&g_matches, id, client_fd, &owner_fd);
+        if (rc == 0) {
+            proto_sendf(owner_fd, PROTO_EVENT_JOIN_REQUEST, id, me);
+            send_all(client_fd, PROTO_OK_JOIN_REQUESTED);
+        } else if (rc == -1) {
+            send_all(client_fd, PROTO_ERR_MATCH_NOT_FOUND);
+        } else if (rc == -2) {
+            send_all(client_fd, PROTO_ERR_MATCH_NOT_JOINABLE);
+        } else if (rc == -3) {
+            send_all(client_fd, PROTO_ERR_CANNOT_JOIN_OWN);
+        } else {
+            send_all(client_fd, PROTO_ERR_JOIN_FAILED);
+        }
+
+    } else if (strncmp(p, "ACCEPT", 6) == 0 && (p[6] == ' ' || p[6] == '\0')) {
+        int id;
+        if (sscanf(p, "ACCEPT %d", &id) != 1) {
+            send_all(client_fd, PROTO_ERR_BAD_USAGE);
+            return SESSION_CONTINUE;
+        }
+        int joiner_fd = -1;
+        int rc = matches_accept(&g_matches, id, client_fd, &joiner_fd);
+        if (rc == 0) {
+            state_set_playing_match(&g_state, client_fd, id);
+            state_set_playing_match(&g_state, joiner_fd, id);
+
+            char joiner_name[MAX_NAME] = "??";
+            state_get_name_copy(&g_state, joiner_fd, joiner_name, sizeof(joiner_name));
+
+            notify_match_start(id,
+                client_fd, me,
+                joiner_fd, joiner_name,
+                PROTO_OK_MATCH_STARTED_X,
+                PROTO_OK_MATCH_STARTED_O);
+
+            char bcast[128];
+            snprintf(bcast, sizeof(bcast), PROTO_EVENT_MATCH_STARTED_ALL, id);
+            broadcast(bcast, -1);
+
+        } else if (rc == -1) {
+            send_all(client_fd, PROTO_ERR_MATCH_NOT_FOUND);
+        } else if (rc == -2) {
+            send_all(client_fd, PROTO_ERR_NOT_OWNER);
+        } else if (rc == -3) {
+            send_all(client_fd, PROTO_ERR_NO_PENDING);
+        } else {
+            send_all(client_fd, PROTO_ERR_ACCEPT_FAILED);
+        }
+
+    } else if (strncmp(p, "REJECT", 6) == 0 && (p[6] == ' ' || p[6] == '\0')) {
+        int id;
+        if (sscanf(p, "REJECT %d", &id) != 1) {
+            send_all(client_fd, PROTO_ERR_BAD_USAGE);
+            return SESSION_CONTINUE;
+        }
+        int rejected_fd = -1;
+        int rc = matches_reject(&g_matches, id, client_fd, &rejected_fd);
+        if (rc == 0) {
+            send_all(client_fd, PROTO_OK_REJECTED);
+            if (rejected_fd != -1) send_all(rejected_fd, PROTO_ERR_JOIN_REJECTED);
+        } else if (rc == -1) {
+            send_all(client_fd, PROTO_ERR_MATCH_NOT_FOUND);
+        } else if (rc == -2) {
+            send_all(client_fd, PROTO_ERR_NOT_OWNER);
+        } else if (rc == -3) {
+            send_all(client_fd, PROTO_ERR_NO_PENDING);
+        } else {
+            send_all(client_fd, PROTO_ERR_REJECT_FAILED);
+        }
+
+    } else if (strncmp(p, "MOVE", 4) == 0 && (p[4] == ' ' || p[4] == '\0')) {
+        int rr, cc;
+        if (sscanf(p, "MOVE %d %d", &rr, &cc) != 2) {
+            send_all(client_fd, PROTO_ERR_BAD_USAGE);
+            return SESSION_CONTINUE;
+        }
+        int mid = state_get_playing_match(&g_state, client_fd);
+        if (mid == -1) {
+            send_all(client_fd, PROTO_ERR_NOT_IN_MATCH);
+            return SESSION_CONTINUE;
+        }
+        int  opp_fd = -1;
+        char boardbuf[MATCH_BOARD_BUFSZ];
+        char winner[MAX_NAME] = {0};
+        int mrc = matches_move(&g_matches, &g_state, mid, client_fd, rr, cc,
+                               &opp_fd, boardbuf, sizeof(boardbuf),
+                               winner, sizeof(winner));
+        if (mrc == 0) {
+            send_all(client_fd, PROTO_OK_MOVED);
+            send_all(client_fd, boardbuf);
+            if (opp_fd != -1) {
+                proto_sendf(opp_fd, PROTO_EVENT_OPPONENT_MOVED, rr, cc);
+                send_all(opp_fd, boardbuf);
+            }
+            spectate_publish(&g_spect, mid,
+                evbuf_printf(PROTO_EVENT_WATCH_MOVE "%s", mid, rr, cc, boardbuf), 0);
+            ai_reply(mid, client_fd);
+
+        } else if (mrc == 1 || mrc == 2) {
+            /* Vittoria o pareggio */
+            announce_move_end(mid, mrc, client_fd, opp_fd, rr, cc,
+                              winner, boardbuf);
+
+        } else if (mrc == -4) {
+            send_all(client_fd, PROTO_ERR_NOT_YOUR_TURN);
+        } else if (mrc == -5) {
+            send_all(client_fd, PROTO_ERR_BAD_MOVE);
+        } else if (mrc == -2) {
+            send_all(client_fd, PROTO_ERR_MATCH_NOT_PLAYING);
+        } else {
+            send_all(client_fd, PROTO_ERR_MOVE_FAILED);
+        }
+
+    } else if (strncmp(p, "PLAYAI", 6) == 0 && (p[6] == ' ' || p[6] == '\0')) {
+        match_ai_t level;
+        if (p[6] == '\0' || strcmp(p + 7, "perfect") == 0) {
+            level = MATCH_AI_PERFECT;
+        } else if (strcmp(p + 7, "easy") == 0) {
+            level = MATCH_AI_EASY;
+        } else {
+            send_all(client_fd, PROTO_ERR_BAD_USAGE);
+            return SESSION_CONTINUE;
+        }
+        if (state_get_playing_match(&g_state, client_fd) != -1) {
+            send_all(client_fd, PROTO_ERR_ALREADY_PLAYING);
+        } else if (adm_position(&g_match_wait, client_fd) > 0) {
+            send_all(client_fd, PROTO_ERR_ALREADY_QUEUED);
+        } else if (adm_len(&g_match_wait) > 0 || try_playai(client_fd, level) < 0) {
+            match_wait(client_fd, -1, MW_AI, level, 0, 0);
+        }
+
+    } else if (strcmp(p, "HINT") == 0) {
+        int mid = state_get_playing_match(&g_state, client_fd);
+        if (mid == -1) {
+            send_all(client_fd, PROTO_ERR_NOT_IN_MATCH);
+            return SESSION_CONTINUE;
+        }
+        int hr, hc;
+        int rc = matches_hint(&g_matches, mid, client_fd, &hr, &hc);
+        if (rc == 0)
+            proto_sendf(client_fd, PROTO_OK_HINT, hr, hc);
+        else if (rc == -4)
+            send_all(client_fd, PROTO_ERR_NOT_YOUR_TURN);
+        else if (rc == -2)
+            send_all(client_fd, PROTO_ERR_MATCH_NOT_PLAYING);
+        else
+            send_all(client_fd, PROTO_ERR_HINT_UNAVAILABLE);
+
+    } else if (strcmp(p, "BOARD") == 0) {
+        int mid = state_get_playing_match(&g_state, client_fd);
+        if (mid == -1) {
+            send_all(client_fd, PROTO_ERR_NOT_IN_MATCH);
+            return SESSION_CONTINUE;
+        }
+        char bbuf[MATCH_BOARD_BUFSZ];
+        if (matches_board(&g_matches, mid, bbuf, sizeof(bbuf)) == 0)
+            send_all(client_fd, bbuf);
+        else
+            send_all(client_fd, PROTO_ERR_BOARD_NOT_FOUND);
+
+    } else if (strcmp(p, "RESIGN") == 0) {
+        int mid = state_get_playing_match(&g_state, client_fd);
+        if (mid == -1) {
+            send_all(client_fd, PROTO_ERR_NOT_IN_MATCH);
+            return SESSION_CONTINUE;
+        }
+        int  opp_fd = -1;
+        char boardbuf[MATCH_BOARD_BUFSZ];
+        char winner[MAX_NAME] = {0};
+        int rrc = matches_resign(&g_matches, &g_state, mid, client_fd,
+                                 &opp_fd, boardbuf, sizeof(boardbuf),
+                                 winner, sizeof(winner));
+        if (rrc == 0) {
+            state_clear_playing_match(&g_state, client_fd);
+            if (opp_fd != -1) state_clear_playing_match(&g_state, opp_fd);
+
+            send_all(client_fd, PROTO_EVENT_YOU_LOSE);
+            proto_sendf(client_fd, PROTO_EVENT_WINNER, winner);
+            send_all(client_fd, boardbuf);
+            send_all(client_fd, PROTO_EVENT_GAME_OVER_LOSE);
+
+            if (opp_fd != -1) {
+                send_all(opp_fd, PROTO_EVENT_YOU_WIN);
+                proto_sendf(opp_fd, PROTO_EVENT_WINNER, winner);
+                send_all(opp_fd, boardbuf);
+                send_all(opp_fd, PROTO_EVENT_GAME_OVER_WIN);
+            }
+            spectate_publish(&g_spect, mid,
+                evbuf_printf(PROTO_EVENT_WATCH_RESIGN "%s" PROTO_EVENT_WATCH_WINNER,
+                             mid, me, boardbuf, mid, winner), 1);
+
+            char bcast[64];
+            snprintf(bcast, sizeof(bcast), PROTO_EVENT_MATCH_FINISHED, mid);
+            broadcast(bcast, -1);
+
+        } else if (rrc == -2) {
+            send_all(client_fd, PROTO_ERR_MATCH_NOT_PLAYING);
+        } else if (rrc == -4) {
+            send_all(client_fd, PROTO_ERR_NO_OPPONENT);
+        } else {
+            send_all(client_fd, PROTO_ERR_RESIGN_FAILED);
+        }
+
+    } else if (strcmp(p, "REMATCH") == 0) {
+        /*
+         * REMATCH: cerca la partita terminata (MATCH_REMATCH) in cui
+         * questo client era coinvolto, e crea una nuova partita WAITING
+         * con lui come owner (X).
+         * Solo il vincitore (o entrambi in caso di pareggio) può farlo.
+         */
+        int old_mid = matches_find_rematch(&g_matches, client_fd);
+        if (old_mid == -1) {
+            send_all(client_fd, PROTO_ERR_REMATCH_NOT_AVAIL);
+            return SESSION_CONTINUE;
+        }
+
+        int new_mid = matches_rematch(&g_matches, old_mid, client_fd);
+
+        if (new_mid >= 1) {
+            /* Nuova partita creata: il richiedente è owner (X) */
+            proto_sendf(client_fd, PROTO_OK_REMATCH_CREATED, new_mid);
+
+            /* Broadcast a tutti: nuova partita disponibile */
+            char bcast[128];
+            snprintf(bcast, sizeof(bcast), PROTO_EVENT_MATCH_AVAILABLE, new_mid, me);
+            broadcast(bcast, client_fd);
+
+        } else if (new_mid == -3) {
+            /* Perdente tenta il rematch */
+            send_all(client_fd, PROTO_ERR_REMATCH_DENIED);
+        } else if (new_mid == -4) {
+            send_all(client_fd, PROTO_ERR_MATCHES_FULL);
+        } else {
+            send_all(client_fd, PROTO_ERR_REMATCH_FAILED);
+        }
+
+    } else {
+        send_all(client_fd, PROTO_ERR_UNKNOWN_CMD);
+    }
+    return SESSION_CONTINUE;
+}
+
+void session_close(session_t *s) {
+    if (s->cap) capture_close(s->cap);
+    mux_close(s);
+    if (s->relay >= 0) {
+        lobby_relay_close(s->relay);
+        s->relay = -1;
+    }
+    /* Un giocatore senza connessione non deve essere abbinato */
+    matchmaker_remove(&g_queue, &g_state, s->fd);
+    conn_timers_stop(s->slot);
+
+    if (s->dropped && state_detach(&g_state, s->fd, g_grace_sec) == 0) {
+        /* Lo slot e le partite restano in attesa di RESUME (vedi housekeeping) */
+        LOGS(LOG_INFO, LOG_SYS_SESSION, s->me, "Client staccato: %s (fd=%ld), grazia %ld s",
+             s->fd, g_grace_sec);
+        return;
+    }
+
+    LOGS(LOG_INFO, LOG_SYS_SESSION, s->me[0] ? s->me : "<not logged in>",
+         "Client disconnesso: %s (fd=%ld)", s->fd);
+
+    session_drop(s->fd);
+}
+
+int session_match_of(const session_t *s, const char *line) {
+    if (s->mux && line[0] == '@') return mux_match_of(s, line);
+    int id;
+    if (sscanf(line, " JOIN %d",   &id) == 1 ||
+        sscanf(line, " ACCEPT %d", &id) == 1 ||
+        sscanf(line, " REJECT %d", &id) == 1 ||
+        sscanf(line, " WATCH %d",  &id) == 1)
+        return id > 0 ? id : -1;
+    return state_get_playing_match(&g_state, s->fd);
+}
+
+/* ------------------------------------------------------------------ */
+/*  Timer scaduti della ruota                                           */
+/* ------------------------------------------------------------------ */
+static void turn_timeout(const tw_fired_t *f) {
+    int  loser_fd = -1, winner_fd = -1;
+    char boardbuf[MATCH_BOARD_BUFSZ];
+    char winner[MAX_NAME] = {0};
+    char loser[MAX_NAME]  = "??";
+    if (matches_turn_expired(&g_matches, &g_state, f, &loser_fd, &winner_fd,
+                             boardbuf, sizeof(boardbuf),
+                             winner, sizeof(winner)) < 0)
+        return;
+
+    int mid = f->arg;
+    state_get_name_copy(&g_state, loser_fd, loser, sizeof(loser));
+    LOGS(LOG_INFO, LOG_SYS_MATCH, loser, "Tempo scaduto: %s (match %ld)", mid);
+
+    state_clear_playing_match(&g_state, loser_fd);
+    proto_sendf(loser_fd, PROTO_EVENT_TURN_TIMEOUT, mid, loser);
+    send_all(loser_fd, PROTO_EVENT_YOU_LOSE);
+    proto_sendf(loser_fd, PROTO_EVENT_WINNER, winner);
+    send_all(loser_fd, boardbuf);
+    send_all(loser_fd, PROTO_EVENT_GAME_OVER_LOSE);
+
+    if (winner_fd != -1) {
+        state_clear_playing_match(&g_state, winner_fd);
+        proto_sendf(winner_fd, PROTO_EVENT_TURN_TIMEOUT, mid, loser);
+        send_all(winner_fd, PROTO_EVENT_YOU_WIN);
+        proto_sendf(winner_fd, PROTO_EVENT_WINNER, winner);
+        send_all(winner_fd, boardbuf);
+        send_all(winner_fd, PROTO_EVENT_GAME_OVER_WIN);
+    }
+    spectate_publish(&g_spect, mid,
+        evbuf_printf(PROTO_EVENT_WATCH_TIMEOUT "%s" PROTO_EVENT_WATCH_WINNER,
+                     mid, loser, boardbuf, mid, winner), 1);
+
+    char bcast[64];
+    snprintf(bcast, sizeof(bcast), PROTO_EVENT_MATCH_FINISHED, mid);
+    broadcast(bcast, -1);
+}
+
+static void run_timers(void) {
+    tw_fired_t fired[TW_BATCH];
+    uint64_t   now = mono_ticks();
+    int        n;
+    do {
+        n = tw_advance(&g_wheel, now, fired, TW_BATCH);
+        for (int i = 0; i < n; i++) {
+            tw_fired_t *f = &fired[i];
+            switch (f->kind) {
+                case TW_IDLE:
+                    /*
+                     * shutdown sveglia il backend di I/O (recv bloccante o
+                     * epoll) e la connessione segue il percorso normale
+                     * (sessione staccata, riprendibile con RESUME).  Per
+                     * un fd virtuale lo fa la chiusura del suo modulo.
+                     */
+                    if (tw_is_current(&g_wheel, f) && net_shutdown(f->arg) == 0)
+                        LOG(LOG_INFO, LOG_SYS_SESSION, "Connessione inattiva chiusa (fd=%ld)", f->arg);
+                    break;
+                case TW_PING:
+                    if (tw_is_current(&g_wheel, f)) {
+                        net_send(f->arg, PROTO_PING, strlen(PROTO_PING), 1);
+                        tw_arm(&g_wheel, f->node,
+                               (unsigned)g_ping_sec * TW_TICKS_PER_SEC, f->arg);
+                    }
+                    break;
+                case TW_TURN:
+                    turn_timeout(f);
+                    break;
+            }
+        }
+    } while (n == TW_BATCH);
+}
+
+/* ------------------------------------------------------------------ */
+/*  Lavori periodici:                                                   */
+/*   - a ogni tick, timer della ruota: inattività, heartbeat, turno     */
+/*   - a ogni tick, richieste di partita in coda se si è liberato posto */
+/*   - a ogni tick, tornei: risultati, prenotazioni, turni e partite    */
+/*   - ogni secondo, sessioni staccate scadute: cleanup come una        */
+/*     disconnessione                                                   */
+/*   - ogni secondo, abbinamenti QUICKPLAY la cui fascia di rating si   */
+/*     è allargata                                                      */
+/*   - ogni secondo, record della cattura (-C) ancora in memoria        */
+/* ------------------------------------------------------------------ */
+void *session_housekeeping(void *arg) {
+    (void)arg;
+    for (unsigned tick = 1; ; tick++) {
+        usleep(TW_TICK_MS * 1000);
+        run_timers();
+        match_wait_drain();
+        tournament_run();
+        if (tick % TW_TICKS_PER_SEC) continue;
+        capture_flush();
+
+        int pairs[MAX_CLIENTS];
+        int np = matchmaker_tick(&g_queue, &g_state, pairs, MAX_CLIENTS / 2);
+        for (int i = 0; i < np; i++)
+            start_quickplay(pairs[2 * i], pairs[2 * i + 1]);
+
+        int fds[MAX_CLIENTS];
+        int n = state_reap_expired(&g_state, time(NULL), fds, MAX_CLIENTS);
+        for (int i = 0; i < n; i++) {
+            LOG(LOG_INFO, LOG_SYS_SESSION, "Sessione scaduta (fd=%ld)", fds[i]);
+            session_drop(fds[i]);
+        }
+    }
+    return NULL;
+}
+
+void session_timers_init(void) {
+    adm_init(&g_match_wait, MATCH_WAIT_QUEUE, MATCH_WAIT_GAP_MS);
+    tw_init(&g_wheel, mono_ticks());
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        tw_node_init(&g_idle_timer[i], TW_IDLE);
+        tw_node_init(&g_ping_timer[i], TW_PING);
+    }
+}
@@ -0,0 +1,102 @@
+#include "solver.h"
+#include "rules.h"
+#include <pthread.h>
+#include <stdlib.h>
+
+/*
+ * score: > 0 vince chi muove, < 0 perde, 0 patta.  Il modulo è
+ * (celle libere + 1) al termine: più è grande, prima arriva l'esito.
+ */
+typedef struct {
+    unsigned char status;
+    signed char   score;
+    signed char   best;
+} solver_entry_t;
+
+static solver_entry_t g_table[SOLVER_POSITIONS];
+static pthread_once_t g_once = PTHREAD_ONCE_INIT;
+
+static const int pow3[9] = { 1, 3, 9, 27, 81, 243, 729, 2187, 6561 };
+
+/* ------------------------------------------------------------------ */
+/*  Costruzione                                                         */
+/* ------------------------------------------------------------------ */
+
+/*
+ * Negamax con memo sul codice; who = 1 (X) o 2 (O) è chi deve muovere,
+ * mine / theirs le maschere (rules.h) di chi muove e dell'avversario.
+ */
+static int solve(int code, unsigned mine, unsigned theirs, int who, int empty) {
+    solver_entry_t *e = &g_table[code];
+    if (e->status != SOLVER_INVALID) return e->score;
+
+    e->best = -1;
+    if (rules_bits_win(theirs)) {
+        /* L'ultimo a muovere ha appena chiuso un tris */
+        e->status = (who == 1) ? SOLVER_O_WINS : SOLVER_X_WINS;
+        e->score  = (signed char)-(empty + 1);
+        return e->score;
+    }
+    if (empty == 0) {
+        e->status = SOLVER_DRAW;
+        e->score  = 0;
+        return 0;
+    }
+
+    int best = -100;
+    for (int i = 0; i < RULES_CELLS; i++) {
+        if ((mine | theirs) & (1u << i)) continue;
+        int s = -solve(code + who * pow3[i], theirs, mine | (1u << i),
+                       3 - who, empty - 1);
+        if (s > best) { best = s; e->best = (signed char)i; }
+    }
+    e->status = SOLVER_ONGOING;
+    e->score  = (signed char)best;
+    return best;
+}
+
+static void build_table(void) {
+    solve(0, 0, 0, 1, RULES_CELLS);
+}
+
+void solver_init(void) {
+    pthread_once(&g_once, build_table);
+}
+
+/* ------------------------------------------------------------------ */
+/*  Interrogazione                                                      */
+/* ------------------------------------------------------------------ */
+
+int solver_encode(const char *cells) {
+    int code = 0;
+    for (int i = 0; i < RULES_CELLS; i++) {
+        char ch = cells[i];
+        if (ch == 'X')      code += pow3[i];
+        else if (ch == 'O') code += 2 * pow3[i];
+    }
+    return code;
+}
+
+solver_status_t solver_status(int code) {
+    if (code < 0 || code >= SOLVER_POSITIONS) return SOLVER_INVALID;
+    return (solver_status_t)g_table[code].status;
+}
+
+int solver_value(int code) {
+    if (solver_status(code) == SOLVER_INVALID) return 0;
+    int s = g_table[code].score;
+    return (s > 0) - (s < 0);
+}
+
+int solver_best_move(int code) {
+    if (solver_status(code) != SOLVER_ONGOING) return -1;
+    return g_table[code].best;
+}
+
+int solver_random_move(int code, unsigned *seed) {
+    if (solver_status(code) != SOLVER_ONGOING) return -1;
+    int free_cells[9], n = 0;
+    for (int i = 0; i < 9; i++)
+        if ((code / pow3[i]) % 3 == 0) free_cells[n++] = i;
+    return free_cells[rand_r(seed) % n];
+}
@@ -0,0 +1,235 @@
+#include "spectate.h"
+#include "net.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/socket.h>
+
+#define SPEC_RETRY_MS 20   /* riprova degli invii rimasti in EAGAIN */
+
+/* ------------------------------------------------------------------ */
+/*  Buffer condivisi                                                    */
+/* ------------------------------------------------------------------ */
+
+evbuf_t *evbuf_printf(const char *fmt, ...) {
+    va_list ap;
+    va_start(ap, fmt);
+    int len = vsnprintf(NULL, 0, fmt, ap);
+    va_end(ap);
+    if (len < 0) return NULL;
+
+    evbuf_t *b = malloc(sizeof(*b) + (size_t)len + 1);
+    if (!b) return NULL;
+    atomic_init(&b->refs, 1);
+    b->len = len;
+    va_start(ap, fmt);
+    vsnprintf(b->data, (size_t)len + 1, fmt, ap);
+    va_end(ap);
+    return b;
+}
+
+static evbuf_t *evbuf_ref(evbuf_t *b) {
+    atomic_fetch_add_explicit(&b->refs, 1, memory_order_relaxed);
+    return b;
+}
+
+void evbuf_unref(evbuf_t *b) {
+    if (b && atomic_fetch_sub_explicit(&b->refs, 1, memory_order_acq_rel) == 1)
+        free(b);
+}
+
+/* ------------------------------------------------------------------ */
+/*  Helpers interni (chiamati con sp->mtx preso)                        */
+/* ------------------------------------------------------------------ */
+
+static int group_find(spectators_t *sp, int match_id) {
+    for (int i = 0; i < MAX_MATCHES; i++)
+        if (sp->groups[i].match_id == match_id) return i;
+    return -1;
+}
+
+static void out_clear(spec_out_t *o) {
+    while (o->count > 0) {
+        evbuf_unref(o->q[o->head]);
+        o->head = (o->head + 1) % SPEC_OUT_QUEUE;
+        o->count--;
+    }
+    o->head = 0;
+}
+
+static void out_push(spec_out_t *o, evbuf_t *b) {
+    if (o->count == SPEC_OUT_QUEUE) {
+        /* Spettatore troppo lento: si scarta l'evento più vecchio */
+        evbuf_unref(o->q[o->head]);
+        o->head = (o->head + 1) % SPEC_OUT_QUEUE;
+        o->count--;
+    }
+    o->q[(o->head + o->count) % SPEC_OUT_QUEUE] = evbuf_ref(b);
+    o->count++;
+}
+
+static void detach_slot(spectators_t *sp, int slot) {
+    int g = group_find(sp, sp->watching[slot]);
+    if (g >= 0) {
+        int *pp = &sp->groups[g].head;
+        while (*pp != -1 && *pp != slot) pp = &sp->next[*pp];
+        if (*pp == slot) *pp = sp->next[slot];
+        if (sp->groups[g].head == -1) sp->groups[g].match_id = 0;
+    }
+    sp->watching[slot] = 0;
+    sp->next[slot]     = -1;
+}
+
+/* Da pubblicazione a code degli spettatori: solo copie di puntatori */
+static void fan_out(spectators_t *sp, spec_pub_t *p) {
+    int g = group_find(sp, p->match_id);
+    if (g >= 0) {
+        for (int s = sp->groups[g].head; s != -1; s = sp->next[s])
+            out_push(&sp->out[s], p->buf);
+        if (p->close) {
+            int s = sp->groups[g].head;
+            while (s != -1) {
+                int n = sp->next[s];
+                sp->watching[s] = 0;
+                sp->next[s]     = -1;
+                s = n;
+            }
+            sp->groups[g].match_id = 0;
+            sp->groups[g].head     = -1;
+        }
+    }
+    evbuf_unref(p->buf);
+}
+
+/* ------------------------------------------------------------------ */
+/*  Thread di consegna                                                  */
+/* ------------------------------------------------------------------ */
+
+static void *delivery_thread(void *arg) {
+    spectators_t *sp = arg;
+
+    pthread_mutex_lock(&sp->mtx);
+    while (1) {
+        while (sp->pub_count > 0) {
+            fan_out(sp, &sp->pub[sp->pub_head]);
+            sp->pub_head = (sp->pub_head + 1) % SPEC_PUB_QUEUE;
+            sp->pub_count--;
+        }
+
+        int progress = 0, pending = 0;
+        for (int s = 0; s < MAX_CLIENTS; s++) {
+            spec_out_t *o = &sp->out[s];
+            if (o->count == 0) continue;
+
+            evbuf_t *b  = o->q[o->head];
+            int      fd = sp->fd[s];
+            o->busy = 1;
+            pthread_mutex_unlock(&sp->mtx);
+            ssize_t n = net_send(fd, b->data, (size_t)b->len, 1);
+            int err = errno;
+            pthread_mutex_lock(&sp->mtx);
+            o->busy = 0;
+            pthread_cond_broadcast(&sp->idle);
+
+            if (n > 0) {
+                progress = 1;
+                evbuf_unref(b);
+                o->head = (o->head + 1) % SPEC_OUT_QUEUE;
+                o->count--;
+                if (o->count > 0) pending = 1;
+            } else if (n < 0 && (err == EAGAIN || err == EWOULDBLOCK || err == EINTR)) {
+                pending = 1;
+            } else {
+                out_clear(o);   /* connessione morta: la pulizia la farà il suo thread */
+            }
+        }
+
+        if (progress || sp->pub_count > 0) continue;
+        if (pending) {
+            struct timespec ts;
+            clock_gettime(CLOCK_REALTIME, &ts);
+            ts.tv_nsec += SPEC_RETRY_MS * 1000000L;
+            if (ts.tv_nsec >= 1000000000L) { ts.tv_sec++; ts.tv_nsec -= 1000000000L; }
+            pthread_cond_timedwait(&sp->cv, &sp->mtx, &ts);
+        } else {
+            pthread_cond_wait(&sp->cv, &sp->mtx);
+        }
+    }
+    return NULL;
+}
+
+/* ------------------------------------------------------------------ */
+/*  API                                                                 */
+/* ------------------------------------------------------------------ */
+
+void spectate_init(spectators_t *sp) {
+    memset(sp, 0, sizeof(*sp));
+    pthread_mutex_init(&sp->mtx, NULL);
+    pthread_cond_init(&sp->cv, NULL);
+    pthread_cond_init(&sp->idle, NULL);
+    for (int i = 0; i < MAX_CLIENTS; i++) sp->next[i] = -1;
+    for (int i = 0; i < MAX_MATCHES; i++) sp->groups[i].head = -1;
+}
+
+int spectate_start(spectators_t *sp) {
+    pthread_t tid;
+    if (pthread_create(&tid, NULL, delivery_thread, sp) != 0) return -1;
+    pthread_detach(tid);
+    return 0;
+}
+
+int spectate_watch(spectators_t *sp, server_state_t *st, int fd, int match_id) {
+    int slot = state_slot_of(st, fd);
+    if (slot < 0) return -1;
+
+    pthread_mutex_lock(&sp->mtx);
+    if (sp->watching[slot]) detach_slot(sp, slot);
+
+    int g = group_find(sp, match_id);
+    if (g < 0) g = group_find(sp, 0);
+    if (g < 0) { pthread_mutex_unlock(&sp->mtx); return -2; }
+
+    sp->groups[g].match_id = match_id;
+    sp->next[slot]         = sp->groups[g].head;
+    sp->groups[g].head     = slot;
+    sp->watching[slot]     = match_id;
+    sp->fd[slot]           = fd;
+    pthread_mutex_unlock(&sp->mtx);
+    return 0;
+}
+
+int spectate_unwatch(spectators_t *sp, server_state_t *st, int fd) {
+    int slot = state_slot_of(st, fd);
+    if (slot < 0) return -1;
+
+    pthread_mutex_lock(&sp->mtx);
+    /* Non si tocca la coda mentre il thread di consegna sta scrivendo su fd */
+    while (sp->out[slot].busy) pthread_cond_wait(&sp->idle, &sp->mtx);
+    int old = sp->watching[slot] ? sp->watching[slot] : -1;
+    if (sp->watching[slot]) detach_slot(sp, slot);
+    out_clear(&sp->out[slot]);
+    pthread_mutex_unlock(&sp->mtx);
+    return old;
+}
+
+void spectate_publish(spectators_t *sp, int match_id, evbuf_t *buf, int close) {
+    if (!buf) return;
+
+    pthread_mutex_lock(&sp->mtx);
+    if (sp->pub_count == SPEC_PUB_QUEUE || group_find(sp, match_id) < 0) {
+        /* Nessuno spettatore (o coda piena): l'evento si scarta subito */
+        pthread_mutex_unlock(&sp->mtx);
+        evbuf_unref(buf);
+        return;
+    }
+    spec_pub_t *p = &sp->pub[(sp->pub_head + sp->pub_count) % SPEC_PUB_QUEUE];
+    p->match_id = match_id;
+    p->close    = close;
+    p->buf      = buf;
+    sp->pub_count++;
+    pthread_cond_signal(&sp->cv);
+    pthread_mutex_unlock(&sp->mtx);
+}
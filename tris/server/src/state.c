@@ -1,15 +1,174 @@
 #include "state.h"
 #include "net.h"
+#include "epoch.h"
+#include <sched.h>
 #include <string.h>
 #include <stdio.h>
+#include <unistd.h>
+#include <sys/random.h>
+
+/* ------------------------------------------------------------------ */
+/*  Indici per nome e per fd                                            */
+/* ------------------------------------------------------------------ */
+
+#define INDEX_MASK (CLIENT_INDEX_SIZE - 1)
+
+static unsigned hash_name(const char *s) {
+    unsigned h = 2166136261u;                 /* FNV-1a */
+    while (*s) { h ^= (unsigned char)*s++; h *= 16777619u; }
+    return h;
+}
+
+static unsigned hash_fd(int fd) {
+    unsigned h = (unsigned)fd * 2654435761u;  /* Knuth */
+    return h ^ (h >> 16);
+}
+
+static void index_clear(client_index_t *ix) {
+    for (int i = 0; i < CLIENT_INDEX_SIZE; i++) ix->slot[i] = -1;
+}
+
+static void index_insert(client_index_t *ix, int slot, unsigned h) {
+    unsigned i = h & INDEX_MASK;
+    while (ix->slot[i] != -1) i = (i + 1) & INDEX_MASK;
+    ix->slot[i] = (short)slot;
+    ix->hash[i] = h;
+}
+
+/* Cancellazione con backward shift: niente tombstone, le catene restano corte */
+static void index_remove(client_index_t *ix, int slot, unsigned h) {
+    unsigned i = h & INDEX_MASK;
+    while (ix->slot[i] != slot) {
+        if (ix->slot[i] == -1) return;
+        i = (i + 1) & INDEX_MASK;
+    }
+    unsigned j = i;
+    while (1) {
+        j = (j + 1) & INDEX_MASK;
+        if (ix->slot[j] == -1) break;
+        unsigned home = ix->hash[j] & INDEX_MASK;
+        /* j può riempire il buco in i solo se la sua home non sta in (i, j] */
+        if (((j - home) & INDEX_MASK) >= ((j - i) & INDEX_MASK)) {
+            ix->slot[i] = ix->slot[j];
+            ix->hash[i] = ix->hash[j];
+            i = j;
+        }
+    }
+    ix->slot[i] = -1;
+}
 
 static client_t *find_client(server_state_t *st, int fd) {
-    for (int i = 0; i < MAX_CLIENTS; i++)
-        if (st->clients[i].fd == fd && st->clients[i].fd != 0)
-            return &st->clients[i];
+    if (fd == 0) return NULL;
+    unsigned h = hash_fd(fd);
+    for (unsigned i = h & INDEX_MASK; st->by_fd.slot[i] != -1; i = (i + 1) & INDEX_MASK) {
+        client_t *c = &st->clients[st->by_fd.slot[i]];
+        if (st->by_fd.hash[i] == h && c->fd == fd) return c;
+    }
+    return NULL;
+}
+
+static client_t *find_by_name(server_state_t *st, const char *name) {
+    unsigned h = hash_name(name);
+    for (unsigned i = h & INDEX_MASK; st->by_name.slot[i] != -1; i = (i + 1) & INDEX_MASK) {
+        client_t *c = &st->clients[st->by_name.slot[i]];
+        if (st->by_name.hash[i] == h && strcmp(c->name, name) == 0) return c;
+    }
     return NULL;
 }
 
+/* ------------------------------------------------------------------ */
+/*  Versioni della lobby per i lettori senza lock                       */
+/* ------------------------------------------------------------------ */
+
+/* mtx tenuto: copia lo stato corrente in una versione libera e la pubblica */
+static void roster_publish(server_state_t *st) {
+    roster_t *r = NULL;
+    while (1) {
+        for (int i = 0; i < STATE_ROSTER_VERSIONS && !r; i++) {
+            roster_t *v = &st->versions[i];
+            if (v != st->roster && (st->retired[i] == 0 || epoch_safe(st->retired[i])))
+                r = v;
+        }
+        if (r) break;
+        sched_yield();   /* lettori ancora sulle versioni vecchie: durano poco */
+    }
+
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        const client_t *c = &st->clients[i];
+        r->fd[i]               = c->fd;
+        r->logged_in[i]        = (unsigned char)c->logged_in;
+        r->playing_match_id[i] = c->playing_match_id;
+        memcpy(r->name[i], c->name, MAX_NAME);
+    }
+    r->by_name = st->by_name;
+    r->by_fd   = st->by_fd;
+
+    roster_t *old = st->roster;
+    __atomic_store_n(&st->roster, r, __ATOMIC_SEQ_CST);
+    if (old) st->retired[old - st->versions] = epoch_retire();
+}
+
+/* Apre una sezione di lettura: la versione resta valida fino a roster_leave */
+static const roster_t *roster_enter(server_state_t *st) {
+    epoch_enter();
+    return __atomic_load_n(&st->roster, __ATOMIC_SEQ_CST);
+}
+
+static void roster_leave(void) {
+    epoch_exit();
+}
+
+/* Slot di fd nella versione r, -1 se non c'è */
+static int roster_find(const roster_t *r, int fd) {
+    if (fd == 0) return -1;
+    unsigned h = hash_fd(fd);
+    for (unsigned i = h & INDEX_MASK; r->by_fd.slot[i] != -1; i = (i + 1) & INDEX_MASK) {
+        int k = r->by_fd.slot[i];
+        if (r->by_fd.hash[i] == h && r->fd[k] == fd) return k;
+    }
+    return -1;
+}
+
+static int roster_find_name(const roster_t *r, const char *name) {
+    unsigned h = hash_name(name);
+    for (unsigned i = h & INDEX_MASK; r->by_name.slot[i] != -1; i = (i + 1) & INDEX_MASK) {
+        int k = r->by_name.slot[i];
+        if (r->by_name.hash[i] == h && strcmp(r->name[k], name) == 0) return k;
+    }
+    return -1;
+}
+
+/* Libera lo slot togliendolo da entrambi gli indici */
+static void release_slot(server_state_t *st, client_t *c) {
+    int slot = (int)(c - st->clients);
+    if (c->logged_in) index_remove(&st->by_name, slot, hash_name(c->name));
+    index_remove(&st->by_fd, slot, hash_fd(c->fd));
+    memset(c, 0, sizeof(*c));
+}
+
+static void make_token(char *out) {
+    static const char hex[] = "0123456789abcdef";
+    unsigned char rnd[TOKEN_LEN / 2];
+    if (getrandom(rnd, sizeof(rnd), 0) != (ssize_t)sizeof(rnd)) {
+        /* Senza entropia niente token: la sessione non è riprendibile */
+        out[0] = '\0';
+        return;
+    }
+    for (int i = 0; i < TOKEN_LEN / 2; i++) {
+        out[2 * i]     = hex[rnd[i] >> 4];
+        out[2 * i + 1] = hex[rnd[i] & 0x0f];
+    }
+    out[TOKEN_LEN] = '\0';
+}
+
+/* Confronto a tempo costante: non rivela quanti caratteri coincidono */
+static int token_equal(const char *a, const char *b) {
+    unsigned char diff = 0;
+    for (int i = 0; i < TOKEN_LEN; i++)
+        diff |= (unsigned char)(a[i] ^ b[i]);
+    return diff == 0;
+}
+
 static client_t *find_free_slot(server_state_t *st) {
     for (int i = 0; i < MAX_CLIENTS; i++)
         if (st->clients[i].fd == 0)
@@ -22,24 +181,51 @@ void state_init(server_state_t *st) {
     memset(st->clients, 0, sizeof(st->clients));
     for (int i = 0; i < MAX_CLIENTS; i++)
         st->clients[i].playing_match_id = -1;
+    index_clear(&st->by_name);
+    index_clear(&st->by_fd);
+    st->roster = NULL;
+    memset(st->retired, 0, sizeof(st->retired));
+    roster_publish(st);
+}
+
+void state_rebuild_index(server_state_t *st) {
+    pthread_mutex_lock(&st->mtx);
+    index_clear(&st->by_name);
+    index_clear(&st->by_fd);
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        client_t *c = &st->clients[i];
+        if (c->fd == 0) continue;
+        index_insert(&st->by_fd, i, hash_fd(c->fd));
+        if (c->logged_in) index_insert(&st->by_name, i, hash_name(c->name));
+    }
+    roster_publish(st);
+    pthread_mutex_unlock(&st->mtx);
 }
 
-void state_add_client(server_state_t *st, int fd) {
+int state_add_client(server_state_t *st, int fd) {
     pthread_mutex_lock(&st->mtx);
     client_t *c = find_free_slot(st);
+    int slot = -1;
     if (c) {
         memset(c, 0, sizeof(*c));
         c->fd               = fd;
         c->logged_in        = 0;
         c->playing_match_id = -1;
+        slot = (int)(c - st->clients);
+        index_insert(&st->by_fd, slot, hash_fd(fd));
+        roster_publish(st);
     }
     pthread_mutex_unlock(&st->mtx);
+    return slot;
 }
 
 void state_remove_client(server_state_t *st, int fd) {
     pthread_mutex_lock(&st->mtx);
     client_t *c = find_client(st, fd);
-    if (c) memset(c, 0, sizeof(*c));
+    if (c) {
+        release_slot(st, c);
+        roster_publish(st);
+    }
     pthread_mutex_unlock(&st->mtx);
 }
 
@@ -48,20 +234,35 @@ int state_login(server_state_t *st, int fd, const char *name) {
         return -2;
 
     pthread_mutex_lock(&st->mtx);
-    for (int i = 0; i < MAX_CLIENTS; i++) {
-        if (st->clients[i].fd != 0 &&
-            st->clients[i].logged_in &&
-            strcmp(st->clients[i].name, name) == 0) {
-            pthread_mutex_unlock(&st->mtx);
-            return -1;
-        }
+    if (find_by_name(st, name)) {
+        pthread_mutex_unlock(&st->mtx);
+        return -1;
     }
     client_t *c = find_client(st, fd);
     if (!c) { pthread_mutex_unlock(&st->mtx); return -3; }
+    if (c->logged_in) { pthread_mutex_unlock(&st->mtx); return -1; }
 
     strncpy(c->name, name, MAX_NAME - 1);
     c->name[MAX_NAME - 1] = '\0';
     c->logged_in = 1;
+    index_insert(&st->by_name, (int)(c - st->clients), hash_name(c->name));
+    make_token(c->token);
+    roster_publish(st);
+    pthread_mutex_unlock(&st->mtx);
+    return 0;
+}
+
+int state_logout(server_state_t *st, int fd) {
+    pthread_mutex_lock(&st->mtx);
+    client_t *c = find_client(st, fd);
+    if (!c || !c->logged_in) { pthread_mutex_unlock(&st->mtx); return -1; }
+
+    index_remove(&st->by_name, (int)(c - st->clients), hash_name(c->name));
+    c->logged_in        = 0;
+    c->playing_match_id = -1;
+    memset(c->name,  0, sizeof(c->name));
+    memset(c->token, 0, sizeof(c->token));
+    roster_publish(st);
     pthread_mutex_unlock(&st->mtx);
     return 0;
 }
@@ -74,40 +275,61 @@ const char *state_get_name(server_state_t *st, int fd) {
     return name;
 }
 
+/* ------------------------------------------------------------------ */
+/*  Letture senza lock (versione pubblicata)                            */
+/* ------------------------------------------------------------------ */
+
+/* Ritorna l'fd del client loggato con quel nome, -1 se non c'è */
+int state_find_by_name(server_state_t *st, const char *name) {
+    if (!name) return -1;
+    const roster_t *r = roster_enter(st);
+    int k  = roster_find_name(r, name);
+    int fd = k >= 0 ? r->fd[k] : -1;
+    roster_leave();
+    return fd;
+}
+
+/* Indice in clients[] dello slot di fd, -1 se non c'è */
+int state_slot_of(server_state_t *st, int fd) {
+    const roster_t *r = roster_enter(st);
+    int slot = roster_find(r, fd);
+    roster_leave();
+    return slot;
+}
+
 int state_get_name_copy(server_state_t *st, int fd, char *buf, int bufsz) {
-    pthread_mutex_lock(&st->mtx);
-    client_t *c = find_client(st, fd);
+    const roster_t *r = roster_enter(st);
+    int k = roster_find(r, fd);
     int found = 0;
-    if (c && c->logged_in) {
-        strncpy(buf, c->name, bufsz - 1);
+    if (k >= 0 && r->logged_in[k]) {
+        strncpy(buf, r->name[k], bufsz - 1);
         buf[bufsz - 1] = '\0';
         found = 1;
     }
-    pthread_mutex_unlock(&st->mtx);
+    roster_leave();
     return found;
 }
 
 void state_users(server_state_t *st, char *out, int outsz) {
-    pthread_mutex_lock(&st->mtx);
+    const roster_t *r = roster_enter(st);
     char *p    = out;
     int   left = outsz;
     int   found = 0;
     for (int i = 0; i < MAX_CLIENTS; i++) {
-        client_t *c = &st->clients[i];
-        if (c->fd == 0 || !c->logged_in) continue;
-        int n = snprintf(p, left, "USER %s\n", c->name);
+        if (r->fd[i] == 0 || !r->logged_in[i]) continue;
+        int n = snprintf(p, left, "USER %s\n", r->name[i]);
         if (n > 0 && n < left) { p += n; left -= n; }
         found = 1;
     }
+    roster_leave();
     if (!found) snprintf(out, outsz, "NO_USERS\n");
-    pthread_mutex_unlock(&st->mtx);
 }
 
 int state_get_playing_match(server_state_t *st, int fd) {
-    pthread_mutex_lock(&st->mtx);
-    client_t *c = find_client(st, fd);
-    int mid = c ? c->playing_match_id : -1;
-    pthread_mutex_unlock(&st->mtx);
+    const roster_t *r = roster_enter(st);
+    int k   = roster_find(r, fd);
+    int mid = k >= 0 ? r->playing_match_id[k] : -1;
+    roster_leave();
     return mid;
 }
 
@@ -115,7 +337,10 @@ int state_set_playing_match(server_state_t *st, int fd, int mid) {
     pthread_mutex_lock(&st->mtx);
     client_t *c = find_client(st, fd);
     if (!c) { pthread_mutex_unlock(&st->mtx); return -1; }
-    c->playing_match_id = mid;
+    if (c->playing_match_id != mid) {
+        c->playing_match_id = mid;
+        roster_publish(st);
+    }
     pthread_mutex_unlock(&st->mtx);
     return 0;
 }
@@ -128,15 +353,87 @@ void state_broadcast(server_state_t *st, const char *msg, int exclude_fd) {
     int fds[MAX_CLIENTS];
     int count = 0;
 
+    const roster_t *r = roster_enter(st);
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        if (r->fd[i] == 0 || !r->logged_in[i]) continue;
+        if (r->fd[i] == exclude_fd) continue;
+        fds[count++] = r->fd[i];
+    }
+    roster_leave();
+
+    for (int i = 0; i < count; i++)
+        send_all(fds[i], msg);
+}
+
+/* ------------------------------------------------------------------ */
+/*  Sessioni: distacco, ripresa, scadenza                               */
+/* ------------------------------------------------------------------ */
+
+int state_get_token_copy(server_state_t *st, int fd, char *buf, int bufsz) {
     pthread_mutex_lock(&st->mtx);
+    client_t *c = find_client(st, fd);
+    int found = 0;
+    if (c && c->logged_in && c->token[0]) {
+        strncpy(buf, c->token, bufsz - 1);
+        buf[bufsz - 1] = '\0';
+        found = 1;
+    }
+    pthread_mutex_unlock(&st->mtx);
+    return found;
+}
+
+int state_detach(server_state_t *st, int fd, int grace_sec) {
+    if (grace_sec <= 0) return -1;
+    pthread_mutex_lock(&st->mtx);
+    client_t *c = find_client(st, fd);
+    int rc = -1;
+    if (c && c->logged_in && c->token[0]) {
+        c->detached_until = time(NULL) + grace_sec;
+        rc = 0;
+    }
+    pthread_mutex_unlock(&st->mtx);
+    return rc;
+}
+
+int state_resume(server_state_t *st, const char *token, int new_fd,
+                 int *fd_out, char *name_out, int name_sz) {
+    if (!token || strlen(token) != TOKEN_LEN) return -1;
+
+    pthread_mutex_lock(&st->mtx);
+    client_t *old = NULL;
     for (int i = 0; i < MAX_CLIENTS; i++) {
         client_t *c = &st->clients[i];
-        if (c->fd == 0 || !c->logged_in) continue;
-        if (c->fd == exclude_fd) continue;
-        fds[count++] = c->fd;
+        if (c->fd == 0 || !c->detached_until || !c->token[0]) continue;
+        if (token_equal(c->token, token)) { old = c; break; }
+    }
+    if (!old || dup2(new_fd, old->fd) < 0) {
+        pthread_mutex_unlock(&st->mtx);
+        return -1;
     }
+
+    /* Il vecchio numero di fd ora punta alla nuova connessione */
+    client_t *fresh = find_client(st, new_fd);
+    if (fresh) release_slot(st, fresh);
+    roster_publish(st);
+    old->detached_until = 0;
+    *fd_out = old->fd;
+    strncpy(name_out, old->name, name_sz - 1);
+    name_out[name_sz - 1] = '\0';
     pthread_mutex_unlock(&st->mtx);
+    return 0;
+}
 
-    for (int i = 0; i < count; i++)
-        send_all(fds[i], msg);
-}
\ No newline at end of file
+int state_reap_expired(server_state_t *st, time_t now, int *fds_out, int max) {
+    int n = 0;
+    pthread_mutex_lock(&st->mtx);
+    for (int i = 0; i < MAX_CLIENTS && n < max; i++) {
+        client_t *c = &st->clients[i];
+        if (c->fd == 0 || !c->detached_until || c->detached_until > now) continue;
+        /* Da qui in poi il token non è più riprendibile */
+        c->detached_until = 0;
+        c->token[0]       = '\0';
+        fds_out[n++]      = c->fd;
+    }
+    pthread_mutex_unlock(&st->mtx);
+    return n;
+}
@@ -0,0 +1,86 @@
+#include "timewheel.h"
+
+static void unlink_node(tw_node_t *n) {
+    n->prev->next = n->next;
+    n->next->prev = n->prev;
+    n->prev = n->next = n;
+    n->armed = 0;
+}
+
+void tw_init(timewheel_t *tw, uint64_t now) {
+    pthread_mutex_init(&tw->mtx, NULL);
+    tw->now   = now;
+    tw->armed = 0;
+    for (int i = 0; i < TW_SLOTS; i++)
+        tw->slot[i].prev = tw->slot[i].next = &tw->slot[i];
+}
+
+void tw_node_init(tw_node_t *n, tw_kind_t kind) {
+    n->prev = n->next = n;
+    n->expires = 0;
+    n->gen     = 0;
+    n->armed   = 0;
+    n->kind    = kind;
+    n->arg     = -1;
+}
+
+void tw_arm(timewheel_t *tw, tw_node_t *n, unsigned delay, int arg) {
+    pthread_mutex_lock(&tw->mtx);
+    if (n->armed) { unlink_node(n); tw->armed--; }
+    if (delay == 0) delay = 1;
+    n->expires = tw->now + delay;
+    n->arg     = arg;
+    n->gen++;
+    n->armed   = 1;
+
+    tw_node_t *head = &tw->slot[n->expires % TW_SLOTS];
+    n->prev = head->prev;
+    n->next = head;
+    head->prev->next = n;
+    head->prev = n;
+    tw->armed++;
+    pthread_mutex_unlock(&tw->mtx);
+}
+
+void tw_cancel(timewheel_t *tw, tw_node_t *n) {
+    pthread_mutex_lock(&tw->mtx);
+    if (n->armed) { unlink_node(n); tw->armed--; }
+    n->gen++;
+    pthread_mutex_unlock(&tw->mtx);
+}
+
+int tw_advance(timewheel_t *tw, uint64_t now, tw_fired_t *out, int max) {
+    int count = 0;
+    pthread_mutex_lock(&tw->mtx);
+    while (tw->now < now) {
+        uint64_t   tick = tw->now + 1;
+        tw_node_t *head = &tw->slot[tick % TW_SLOTS];
+        tw_node_t *n    = head->next;
+        while (n != head) {
+            tw_node_t *next = n->next;
+            if (n->expires <= tick) {
+                /* Lista piena: si riprende da questo tick alla prossima chiamata */
+                if (count == max) goto out;
+                out[count].node = n;
+                out[count].kind = n->kind;
+                out[count].arg  = n->arg;
+                out[count].gen  = n->gen;
+                count++;
+                unlink_node(n);
+                tw->armed--;
+            }
+            n = next;
+        }
+        tw->now = tick;
+    }
+out:
+    pthread_mutex_unlock(&tw->mtx);
+    return count;
+}
+
+int tw_is_current(timewheel_t *tw, const tw_fired_t *f) {
+    pthread_mutex_lock(&tw->mtx);
+    int ok = (f->node->gen == f->gen && !f->node->armed);
+    pthread_mutex_unlock(&tw->mtx);
+    return ok;
+}
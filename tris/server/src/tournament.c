@@ -0,0 +1,593 @@
+#include "tournament.h"
+#include "protocol.h"
+#include <stdio.h>
+#include <string.h>
+
+/* ------------------------------------------------------------------ */
+/*  Helpers interni (chiamati con tr->mtx preso)                        */
+/* ------------------------------------------------------------------ */
+
+static tour_t *find_tour(tour_registry_t *tr, int id) {
+    for (int i = 0; i < TOUR_MAX; i++)
+        if (tr->tours[i].status != TOUR_FREE && tr->tours[i].id == id)
+            return &tr->tours[i];
+    return NULL;
+}
+
+/* Torneo aperto o in corso in cui fd è ancora in gara */
+static tour_t *find_fd(tour_registry_t *tr, int fd, int *idx_out) {
+    for (int i = 0; i < TOUR_MAX; i++) {
+        tour_t *t = &tr->tours[i];
+        if (t->status != TOUR_OPEN && t->status != TOUR_RUNNING) continue;
+        for (int j = 0; j < t->nplayers; j++)
+            if (t->players[j].fd == fd) {
+                if (idx_out) *idx_out = j;
+                return t;
+            }
+    }
+    return NULL;
+}
+
+static void add_player(tour_t *t, int fd, const char *name) {
+    tour_player_t *p = &t->players[t->nplayers++];
+    memset(p, 0, sizeof(*p));
+    p->fd = fd;
+    snprintf(p->name, sizeof(p->name), "%s", name);
+}
+
+static void emit(tour_event_t *out, int *n, tour_ev_kind_t kind, const tour_t *t,
+                 int fd, int fd2, int match_id) {
+    tour_event_t *e = &out[(*n)++];
+    memset(e, 0, sizeof(*e));
+    e->kind     = kind;
+    e->tour     = t->id;
+    e->round    = t->round;
+    e->arg      = t->rounds;
+    e->fd       = fd;
+    e->fd2      = fd2;
+    e->match_id = match_id;
+}
+
+/* Classifica: punti, vittorie, testa di serie */
+static int ahead(const tour_t *t, int a, int b) {
+    const tour_player_t *pa = &t->players[a], *pb = &t->players[b];
+    if (pa->score != pb->score) return pa->score > pb->score;
+    if (pa->wins  != pb->wins)  return pa->wins  > pb->wins;
+    return pa->seed < pb->seed;
+}
+
+/* Insertion sort: n <= TOUR_MAX_SIZE */
+static void sort_standings(const tour_t *t, int *idx, int n) {
+    for (int i = 1; i < n; i++) {
+        int v = idx[i], j = i;
+        for (; j > 0 && ahead(t, v, idx[j - 1]); j--) idx[j] = idx[j - 1];
+        idx[j] = v;
+    }
+}
+
+static int log2_ceil(int n) {
+    int r = 0;
+    while ((1 << r) < n) r++;
+    return r;
+}
+
+/* ------------------------------------------------------------------ */
+/*  Risultati                                                           */
+/* ------------------------------------------------------------------ */
+
+static void score_win(tour_t *t, int w, int l) {
+    if (w >= 0) { t->players[w].score += 2; t->players[w].wins++; }
+    if (l >= 0) t->players[l].losses++;
+}
+
+static void meet(tour_t *t, int a, int b) {
+    tour_player_t *pa = &t->players[a], *pb = &t->players[b];
+    if (pa->nopp < TOUR_MAX_ROUNDS) pa->opp[pa->nopp++] = b;
+    if (pb->nopp < TOUR_MAX_ROUNDS) pb->opp[pb->nopp++] = a;
+}
+
+static int have_met(const tour_t *t, int a, int b) {
+    const tour_player_t *pa = &t->players[a];
+    for (int i = 0; i < pa->nopp; i++)
+        if (pa->opp[i] == b) return 1;
+    return 0;
+}
+
+/* Vittoria decisa: a eliminazione diretta il perdente esce */
+static void pair_decided(tour_t *t, tour_pair_t *pr, int w, tour_event_t *out, int *n) {
+    int l = (w == pr->x) ? pr->o : pr->x;
+    pr->winner = w;
+    pr->state  = PAIR_DONE;
+    score_win(t, w, l);
+    if (t->format == TOUR_SINGLE && l >= 0 && t->players[l].fd >= 0) {
+        emit(out, n, TOUR_EV_OUT, t, t->players[l].fd, -1, 0);
+        t->players[l].fd = -1;
+    }
+}
+
+static void apply_result(tour_t *t, const match_result_t *r, tour_event_t *out, int *n) {
+    tour_pair_t *pr = NULL;
+    for (int i = 0; i < t->npairs; i++)
+        if (t->pairs[i].state == PAIR_PLAYING && t->pairs[i].match_id == r->match_id)
+            pr = &t->pairs[i];
+    if (!pr) return;
+
+    if (t->format == TOUR_SWISS) meet(t, pr->x, pr->o);
+    if (!r->draw) {
+        int w = (r->winner_fd == pr->x_fd) ? pr->x
+              : (r->winner_fd == pr->o_fd) ? pr->o
+              : (r->loser_fd  == pr->x_fd) ? pr->o : pr->x;
+        pair_decided(t, pr, w, out, n);
+        return;
+    }
+
+    if (t->format != TOUR_SINGLE) {
+        t->players[pr->x].score++; t->players[pr->x].draws++;
+        t->players[pr->o].score++; t->players[pr->o].draws++;
+        pr->winner = -1;
+        pr->state  = PAIR_DONE;
+    } else if (pr->replays < TOUR_REPLAYS) {
+        /* Si rigioca a colori invertiti: lo slot raccolto è già prenotato */
+        int x = pr->x;
+        pr->x     = pr->o;
+        pr->o     = x;
+        pr->replays++;
+        pr->state = PAIR_WAITING;
+    } else {
+        int w = t->players[pr->x].seed < t->players[pr->o].seed ? pr->x : pr->o;
+        t->players[pr->x].draws++;
+        t->players[pr->o].draws++;
+        pair_decided(t, pr, w, out, n);
+    }
+}
+
+/* ------------------------------------------------------------------ */
+/*  Abbinamenti di un turno                                             */
+/* ------------------------------------------------------------------ */
+
+static tour_pair_t *new_pair(tour_t *t, int x, int o) {
+    tour_pair_t *pr = &t->pairs[t->npairs++];
+    memset(pr, 0, sizeof(*pr));
+    pr->x      = x;
+    pr->o      = o;
+    pr->winner = -1;
+    pr->state  = PAIR_WAITING;
+    return pr;
+}
+
+/* Bye: chi c'è passa il turno; nello svizzero vale una vittoria */
+static void pair_bye(tour_t *t, tour_pair_t *pr, int who, tour_event_t *out, int *n) {
+    pr->winner = who;
+    pr->state  = PAIR_DONE;
+    if (who < 0) return;
+    t->players[who].byes++;
+    if (t->format == TOUR_SWISS) score_win(t, who, -1);
+    emit(out, n, TOUR_EV_BYE, t, t->players[who].fd, -1, 0);
+}
+
+static void pairs_single(tour_t *t, tour_event_t *out, int *n) {
+    for (int i = 0; i + 1 < t->blen; i += 2) {
+        int a = t->bracket[i], b = t->bracket[i + 1];
+        tour_pair_t *pr = new_pair(t, a, b);
+        if (a < 0 || b < 0) pair_bye(t, pr, a < 0 ? b : a, out, n);
+    }
+}
+
+/* Colori: X a chi l'ha avuta meno volte, a parità al meglio piazzato a */
+static void set_colors(const tour_t *t, tour_pair_t *pr, int a, int b) {
+    int swap = t->players[b].xs < t->players[a].xs;
+    pr->x = swap ? b : a;
+    pr->o = swap ? a : b;
+}
+
+static void pairs_swiss(tour_t *t, tour_event_t *out, int *n) {
+    int act[TOUR_MAX_SIZE], na = 0;
+    for (int i = 0; i < t->nplayers; i++)
+        if (t->players[i].fd >= 0) act[na++] = i;
+    sort_standings(t, act, na);
+
+    if (na % 2) {
+        int b = na - 1;
+        for (int i = na - 1; i >= 0; i--)
+            if (t->players[act[i]].byes == 0) { b = i; break; }
+        pair_bye(t, new_pair(t, act[b], -1), act[b], out, n);
+        memmove(&act[b], &act[b + 1], sizeof(int) * (size_t)(na - 1 - b));
+        na--;
+    }
+
+    /* Greedy dall'alto: il primo non ancora incontrato, altrimenti il primo libero */
+    char used[TOUR_MAX_SIZE] = {0};
+    for (int i = 0; i < na; i++) {
+        if (used[i]) continue;
+        int j = -1;
+        for (int k = i + 1; k < na; k++)
+            if (!used[k] && !have_met(t, act[i], act[k])) { j = k; break; }
+        for (int k = i + 1; k < na && j < 0; k++)
+            if (!used[k]) j = k;
+        if (j < 0) break;
+        used[i] = used[j] = 1;
+        set_colors(t, new_pair(t, act[i], act[j]), act[i], act[j]);
+    }
+}
+
+/* Metodo del cerchio: 0 fermo, gli altri ruotano di un posto a turno */
+static void pairs_rr(tour_t *t, tour_event_t *out, int *n) {
+    int np = t->nplayers + (t->nplayers % 2);   /* np - 1 = bye */
+    int r  = t->round - 1;
+    int arr[TOUR_MAX_SIZE + 1];
+    arr[0] = 0;
+    for (int k = 1; k < np; k++) arr[k] = 1 + (k - 1 + r) % (np - 1);
+    for (int i = 0; i < np / 2; i++) {
+        int a = arr[i], b = arr[np - 1 - i];
+        if (a >= t->nplayers || b >= t->nplayers) {
+            int who = a >= t->nplayers ? b : a;
+            pair_bye(t, new_pair(t, who, -1), who, out, n);
+            continue;
+        }
+        if ((i + r) % 2) { int s = a; a = b; b = s; }
+        new_pair(t, a, b);
+    }
+}
+
+/* ------------------------------------------------------------------ */
+/*  Avvio, turni, fine                                                  */
+/* ------------------------------------------------------------------ */
+
+static void tour_start(tour_t *t, rating_store_t *rs) {
+    int idx[TOUR_MAX_SIZE], rating[TOUR_MAX_SIZE];
+    for (int i = 0; i < t->nplayers; i++) {
+        idx[i]    = i;
+        rating[i] = rating_get(rs, t->players[i].name);
+    }
+    /* Teste di serie per rating (insertion sort: n <= TOUR_MAX_SIZE) */
+    for (int i = 1; i < t->nplayers; i++) {
+        int v = idx[i], j = i;
+        for (; j > 0 && rating[idx[j - 1]] < rating[v]; j--) idx[j] = idx[j - 1];
+        idx[j] = v;
+    }
+    for (int s = 0; s < t->nplayers; s++) t->players[idx[s]].seed = s;
+
+    switch (t->format) {
+        case TOUR_SINGLE: {
+            /*
+             * Tabellone classico: a ogni raddoppio la testa di serie s
+             * trova 2 * len - 1 - s, così 0 e 1 si incontrano in finale
+             */
+            int p = 1 << log2_ceil(t->nplayers);
+            int order[TOUR_MAX_SIZE * 2];
+            int len = 1;
+            order[0] = 0;
+            while (len < p) {
+                for (int i = len - 1; i >= 0; i--) {
+                    order[2 * i + 1] = 2 * len - 1 - order[i];
+                    order[2 * i]     = order[i];
+                }
+                len *= 2;
+            }
+            for (int i = 0; i < p; i++)
+                t->bracket[i] = order[i] < t->nplayers ? idx[order[i]] : -1;
+            t->blen   = p;
+            t->rounds = log2_ceil(p);
+            break;
+        }
+        case TOUR_SWISS:
+            t->rounds = log2_ceil(t->nplayers);
+            if (t->rounds > TOUR_MAX_ROUNDS) t->rounds = TOUR_MAX_ROUNDS;
+            break;
+        case TOUR_RR:
+            t->rounds = t->nplayers - 1 + (t->nplayers % 2);
+            break;
+    }
+    if (t->rounds < 1) t->rounds = 1;
+    t->status = TOUR_RUNNING;
+    t->round  = 0;
+}
+
+static int active_count(const tour_t *t) {
+    int n = 0;
+    for (int i = 0; i < t->nplayers; i++)
+        if (t->players[i].fd >= 0) n++;
+    return n;
+}
+
+static void tour_finish(tour_registry_t *tr, match_store_t *ms, tour_t *t,
+                        tour_event_t *out, int *n) {
+    int w = -1;
+    if (t->format == TOUR_SINGLE) {
+        w = t->blen == 1 ? t->bracket[0] : -1;
+    } else if (t->nplayers > 0) {
+        int idx[TOUR_MAX_SIZE];
+        for (int i = 0; i < t->nplayers; i++) idx[i] = i;
+        sort_standings(t, idx, t->nplayers);
+        w = idx[0];
+    }
+    emit(out, n, TOUR_EV_END, t, -1, -1, 0);
+    snprintf(out[*n - 1].name, MAX_NAME, "%s", w >= 0 ? t->players[w].name : "-");
+
+    if (t->reserved) matches_unreserve(ms, t->reserved);
+    t->reserved = 0;
+    t->status   = TOUR_DONE;
+    tr->running--;
+}
+
+/* Turno finito: il prossimo oppure la fine */
+static void next_round(tour_registry_t *tr, match_store_t *ms, tour_t *t,
+                       tour_event_t *out, int *n) {
+    if (t->format == TOUR_SINGLE && t->round > 0) {
+        for (int i = 0; i < t->npairs; i++) t->bracket[i] = t->pairs[i].winner;
+        t->blen = t->npairs;
+    }
+    int over = t->round >= t->rounds ||
+               (t->format == TOUR_SINGLE ? t->blen < 2 : active_count(t) < 2);
+    if (over) {
+        tour_finish(tr, ms, t, out, n);
+        return;
+    }
+
+    t->round++;
+    t->npairs  = 0;
+    t->started = 0;
+    for (int i = 0; i < t->nplayers; i++)
+        if (t->players[i].fd >= 0)
+            emit(out, n, TOUR_EV_ROUND, t, t->players[i].fd, -1, 0);
+    switch (t->format) {
+        case TOUR_SINGLE: pairs_single(t, out, n); break;
+        case TOUR_SWISS:  pairs_swiss(t, out, n);  break;
+        case TOUR_RR:     pairs_rr(t, out, n);     break;
+    }
+}
+
+/*
+ * Partite in attesa: chi è uscito perde a tavolino, le altre partono
+ * quando il turno ha tutti i suoi slot e i due giocatori sono liberi.
+ * may_reserve = 0: un torneo creato prima sta ancora prenotando.
+ */
+static void run_pairs(tour_t *t, match_store_t *ms, server_state_t *st,
+                      int *may_reserve, tour_event_t *out, int *n) {
+    int waiting = 0;
+    for (int i = 0; i < t->npairs; i++) {
+        tour_pair_t *pr = &t->pairs[i];
+        if (pr->state != PAIR_WAITING) continue;
+        int xin = t->players[pr->x].fd >= 0, oin = t->players[pr->o].fd >= 0;
+        if (!xin || !oin) {
+            if (t->format == TOUR_SWISS) meet(t, pr->x, pr->o);
+            if (xin || oin) {
+                int w = xin ? pr->x : pr->o;
+                emit(out, n, TOUR_EV_BYE, t, t->players[w].fd, -1, 0);
+                pair_decided(t, pr, w, out, n);
+            } else {
+                pr->winner = -1;
+                pr->state  = PAIR_DONE;
+            }
+            continue;
+        }
+        waiting++;
+    }
+
+    /*
+     * Prima dell'avvio del turno: gli slot tenuti dal turno prima bastano
+     * o avanzano (quelli in più tornano liberi), altrimenti si prenota.
+     * Dopo l'avvio ogni ripetizione usa lo slot della partita raccolta.
+     */
+    if (!t->started) {
+        if (t->reserved > waiting) {
+            matches_unreserve(ms, t->reserved - waiting);
+            t->reserved = waiting;
+        } else if (t->reserved < waiting) {
+            if (*may_reserve) t->reserved += matches_reserve(ms, waiting - t->reserved);
+            if (t->reserved < waiting) { *may_reserve = 0; return; }
+        }
+        t->started = 1;
+    }
+
+    for (int i = 0; i < t->npairs && t->reserved > 0; i++) {
+        tour_pair_t *pr = &t->pairs[i];
+        if (pr->state != PAIR_WAITING) continue;
+        int x_fd = t->players[pr->x].fd, o_fd = t->players[pr->o].fd;
+        if (state_get_playing_match(st, x_fd) != -1 ||
+            state_get_playing_match(st, o_fd) != -1)
+            continue;
+        int id = matches_create_tour(ms, x_fd, o_fd, t->id);
+        if (id < 0) break;
+        t->reserved--;
+        pr->x_fd     = x_fd;
+        pr->o_fd     = o_fd;
+        pr->match_id = id;
+        pr->state    = PAIR_PLAYING;
+        t->players[pr->x].xs++;
+        emit(out, n, TOUR_EV_MATCH, t, x_fd, o_fd, id);
+    }
+}
+
+/* ------------------------------------------------------------------ */
+/*  API                                                                 */
+/* ------------------------------------------------------------------ */
+
+void tour_init(tour_registry_t *tr) {
+    pthread_mutex_init(&tr->mtx, NULL);
+    tr->next_id = 1;
+    tr->running = 0;
+    for (int i = 0; i < TOUR_MAX; i++) tr->tours[i].status = TOUR_FREE;
+}
+
+int tour_format_parse(const char *s) {
+    if (strcmp(s, "single") == 0) return TOUR_SINGLE;
+    if (strcmp(s, "swiss")  == 0) return TOUR_SWISS;
+    if (strcmp(s, "rr")     == 0) return TOUR_RR;
+    return -1;
+}
+
+const char *tour_format_name(tour_format_t f) {
+    switch (f) {
+        case TOUR_SINGLE: return "single";
+        case TOUR_SWISS:  return "swiss";
+        case TOUR_RR:     return "rr";
+    }
+    return "?";
+}
+
+int tour_create(tour_registry_t *tr, int fd, const char *name,
+                int size, tour_format_t format) {
+    if (size < 2 || size > TOUR_MAX_SIZE) return -2;
+
+    pthread_mutex_lock(&tr->mtx);
+    if (find_fd(tr, fd, NULL)) { pthread_mutex_unlock(&tr->mtx); return -3; }
+
+    /* Uno slot libero, altrimenti il torneo concluso più vecchio */
+    tour_t *t = NULL;
+    for (int i = 0; i < TOUR_MAX; i++) {
+        tour_t *c = &tr->tours[i];
+        if (c->status == TOUR_FREE) { t = c; break; }
+        if (c->status == TOUR_DONE && (!t || c->id < t->id)) t = c;
+    }
+    if (!t) { pthread_mutex_unlock(&tr->mtx); return -1; }
+
+    t->id       = tr->next_id++;
+    t->status   = TOUR_OPEN;
+    t->format   = format;
+    t->size     = size;
+    t->round    = t->rounds = 0;
+    t->started  = 0;
+    t->reserved = 0;
+    t->nplayers = 0;
+    t->npairs   = 0;
+    t->blen     = 0;
+    add_player(t, fd, name);
+    tr->running++;
+
+    int id = t->id;
+    pthread_mutex_unlock(&tr->mtx);
+    return id;
+}
+
+int tour_join(tour_registry_t *tr, int id, int fd, const char *name,
+              int *count_out, int *size_out) {
+    pthread_mutex_lock(&tr->mtx);
+    tour_t *t = find_tour(tr, id);
+    int rc = 0;
+    if (!t)                             rc = -1;
+    else if (t->status != TOUR_OPEN ||
+             t->nplayers >= t->size)    rc = -2;
+    else if (find_fd(tr, fd, NULL))     rc = -3;
+    else {
+        add_player(t, fd, name);
+        *count_out = t->nplayers;
+        *size_out  = t->size;
+    }
+    pthread_mutex_unlock(&tr->mtx);
+    return rc;
+}
+
+int tour_leave(tour_registry_t *tr, int fd) {
+    pthread_mutex_lock(&tr->mtx);
+    int     j;
+    tour_t *t  = find_fd(tr, fd, &j);
+    int     id = t ? t->id : -1;
+    if (t && t->status == TOUR_OPEN) {
+        /* Prima dell'avvio si esce dall'elenco; l'ultimo chiude il torneo */
+        t->players[j] = t->players[--t->nplayers];
+        if (t->nplayers == 0) {
+            t->status = TOUR_FREE;
+            tr->running--;
+        }
+    } else if (t) {
+        /* Le partite non giocate le vince l'avversario (run_pairs) */
+        t->players[j].fd = -1;
+    }
+    pthread_mutex_unlock(&tr->mtx);
+    return id;
+}
+
+void tour_list(tour_registry_t *tr, char *out, int outsz) {
+    pthread_mutex_lock(&tr->mtx);
+    char *p     = out;
+    int   left  = outsz;
+    int   found = 0;
+    for (int i = 0; i < TOUR_MAX; i++) {
+        const tour_t *t = &tr->tours[i];
+        if (t->status == TOUR_FREE) continue;
+        const char *ss = t->status == TOUR_OPEN ? "OPEN"
+                       : t->status == TOUR_RUNNING ? "RUNNING" : "DONE";
+        int n = snprintf(p, left, PROTO_TOURNAMENT_LINE, t->id,
+                         tour_format_name(t->format), t->nplayers, t->size,
+                         ss, t->round, t->rounds);
+        if (n > 0 && n < left) { p += n; left -= n; }
+        found = 1;
+    }
+    if (!found) snprintf(out, outsz, PROTO_NO_TOURNAMENTS);
+    pthread_mutex_unlock(&tr->mtx);
+}
+
+int tour_standings(tour_registry_t *tr, int id, char *out, int outsz) {
+    pthread_mutex_lock(&tr->mtx);
+    tour_t *t = find_tour(tr, id);
+    if (!t) { pthread_mutex_unlock(&tr->mtx); return -1; }
+
+    int idx[TOUR_MAX_SIZE];
+    for (int i = 0; i < t->nplayers; i++) idx[i] = i;
+    sort_standings(t, idx, t->nplayers);
+
+    char *p    = out;
+    int   left = outsz;
+    out[0] = '\0';
+    for (int i = 0; i < t->nplayers; i++) {
+        const tour_player_t *pl = &t->players[idx[i]];
+        int n = snprintf(p, left, PROTO_STANDING_LINE, i + 1, pl->name,
+                         pl->score / 2, pl->score % 2 ? 5 : 0,
+                         pl->wins, pl->draws, pl->losses,
+                         t->status == TOUR_RUNNING && pl->fd < 0 ? " OUT" : "");
+        if (n > 0 && n < left) { p += n; left -= n; }
+    }
+    pthread_mutex_unlock(&tr->mtx);
+    return 0;
+}
+
+int tour_tick(tour_registry_t *tr, match_store_t *ms, server_state_t *st,
+              rating_store_t *rs, tour_event_t *out, int max) {
+    int n = 0;
+    pthread_mutex_lock(&tr->mtx);
+    if (tr->running == 0) { pthread_mutex_unlock(&tr->mtx); return 0; }
+
+    /* Risultati: ogni slot raccolto torna prenotato al suo torneo */
+    match_result_t res[MAX_MATCHES];
+    int nres = matches_collect_tour(ms, res, MAX_MATCHES);
+    for (int i = 0; i < nres; i++) {
+        tour_t *t = find_tour(tr, res[i].tour);
+        if (!t || t->status != TOUR_RUNNING) {
+            matches_unreserve(ms, 1);
+            continue;
+        }
+        t->reserved++;
+        apply_result(t, &res[i], out, &n);
+    }
+
+    /* Tornei in ordine di creazione (id crescenti) */
+    int order[TOUR_MAX], no = 0;
+    for (int i = 0; i < TOUR_MAX; i++) {
+        tour_t *t = &tr->tours[i];
+        if (t->status != TOUR_OPEN && t->status != TOUR_RUNNING) continue;
+        int j = no++;
+        for (; j > 0 && tr->tours[order[j - 1]].id > t->id; j--) order[j] = order[j - 1];
+        order[j] = i;
+    }
+
+    int may_reserve = 1;
+    for (int k = 0; k < no && max - n >= 3 * TOUR_MAX_SIZE + 1; k++) {
+        tour_t *t = &tr->tours[order[k]];
+        if (t->status == TOUR_OPEN) {
+            if (t->nplayers < t->size) continue;
+            tour_start(t, rs);
+        }
+
+        int done = 1;
+        for (int i = 0; i < t->npairs; i++)
+            if (t->pairs[i].state != PAIR_DONE) done = 0;
+        if (done) {
+            next_round(tr, ms, t, out, &n);
+            if (t->status != TOUR_RUNNING) continue;
+        }
+        run_pairs(t, ms, st, &may_reserve, out, &n);
+    }
+    pthread_mutex_unlock(&tr->mtx);
+    return n;
+}
@@ -0,0 +1,65 @@
+#ifndef SIM_H
+#define SIM_H
+
+#include <stdint.h>
+
+/* ================================================================== */
+/*  SIM.H  –  Simulazione offline di partite in batch                  */
+/* ================================================================== */
+
+/*
+ * Le partite si giocano a gruppi di SIM_LANES, una per lane di un
+ * registro vettoriale: le board sono bitboard a 16 bit (rules.h) e il
+ * controllo di vittoria / board piena avviene su tutte le lane insieme.
+ * La scelta della mossa resta scalare (una lettura di tabella o un
+ * numero casuale per lane).  Quando una partita finisce la sua lane
+ * riparte subito con una nuova, così il registro resta pieno.
+ *
+ * Regole e solver sono gli stessi sorgenti del server.
+ */
+
+#define SIM_LANES    16
+#define SIM_MAX_PLY  9
+
+typedef enum {
+    SIM_RANDOM  = 0,   /* cella libera a caso (come PLAYAI easy)        */
+    SIM_GREEDY  = 1,   /* vince se può, altrimenti blocca, altrimenti caso */
+    SIM_PERFECT = 2,   /* tabella del solver (come PLAYAI perfect)      */
+    SIM_EPSILON = 3    /* perfetto, ma con probabilità eps muove a caso */
+} sim_kind_t;
+
+typedef struct {
+    sim_kind_t kind;
+    double     eps;     /* solo SIM_EPSILON */
+} sim_policy_t;
+
+typedef struct {
+    uint64_t games;
+    uint64_t x_wins;
+    uint64_t o_wins;
+    uint64_t draws;
+    uint64_t length[SIM_MAX_PLY + 1];   /* partite per numero di mosse */
+} sim_stats_t;
+
+/*
+ * "random", "greedy", "perfect" oppure "eps:<p>" con 0 <= p <= 1.
+ * Ritorna 0 oppure -1 se la stringa non è valida.
+ */
+int  sim_policy_parse(const char *s, sim_policy_t *out);
+void sim_policy_format(const sim_policy_t *p, char *out, int outsz);
+
+/* Costruisce la tabella del solver (una volta, prima di simulare) */
+void sim_init(void);
+
+/* Gioca games partite X contro O nel thread corrente (somma in out) */
+void sim_run_batch(const sim_policy_t *x, const sim_policy_t *o,
+                   uint64_t games, uint64_t seed, sim_stats_t *out);
+
+/*
+ * Divide games tra threads thread (<= 0: uno per core online).
+ * Ritorna il numero di thread usati oppure -1 in caso di errore.
+ */
+int  sim_run(const sim_policy_t *x, const sim_policy_t *o,
+             uint64_t games, int threads, uint64_t seed, sim_stats_t *out);
+
+#endif /* SIM_H */
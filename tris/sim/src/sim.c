@@ -0,0 +1,230 @@
+#include "sim.h"
+#include "rules.h"
+#include "solver.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/*
+ * Vettori di SIM_LANES lane a 16 bit (estensioni vettoriali di gcc):
+ * il compilatore li mappa su SSE2 / AVX2 / NEON a seconda del target.
+ */
+typedef uint16_t vmask_t __attribute__((vector_size(SIM_LANES * 2)));
+typedef int16_t  vcmp_t  __attribute__((vector_size(SIM_LANES * 2)));
+
+static const int pow3[RULES_CELLS] = { 1, 3, 9, 27, 81, 243, 729, 2187, 6561 };
+
+/* ------------------------------------------------------------------ */
+/*  Policy                                                              */
+/* ------------------------------------------------------------------ */
+
+int sim_policy_parse(const char *s, sim_policy_t *out) {
+    out->eps = 0.0;
+    if (strcmp(s, "random") == 0)  { out->kind = SIM_RANDOM;  return 0; }
+    if (strcmp(s, "greedy") == 0)  { out->kind = SIM_GREEDY;  return 0; }
+    if (strcmp(s, "perfect") == 0) { out->kind = SIM_PERFECT; return 0; }
+    if (strncmp(s, "eps:", 4) == 0) {
+        char *end;
+        double e = strtod(s + 4, &end);
+        if (end == s + 4 || *end != '\0' || e < 0.0 || e > 1.0) return -1;
+        out->kind = SIM_EPSILON;
+        out->eps  = e;
+        return 0;
+    }
+    return -1;
+}
+
+void sim_policy_format(const sim_policy_t *p, char *out, int outsz) {
+    switch (p->kind) {
+        case SIM_RANDOM:  snprintf(out, outsz, "random");  break;
+        case SIM_GREEDY:  snprintf(out, outsz, "greedy");  break;
+        case SIM_PERFECT: snprintf(out, outsz, "perfect"); break;
+        case SIM_EPSILON: snprintf(out, outsz, "eps:%.3g", p->eps); break;
+    }
+}
+
+void sim_init(void) {
+    solver_init();
+}
+
+/* xorshift64*: veloce e senza stato condiviso tra thread */
+static uint64_t rng_next(uint64_t *s) {
+    uint64_t x = *s;
+    x ^= x >> 12; x ^= x << 25; x ^= x >> 27;
+    *s = x;
+    return x * 0x2545F4914F6CDD1DULL;
+}
+
+/* k-esimo bit acceso di mask (k < popcount) */
+static int nth_bit(unsigned mask, int k) {
+    while (k--) mask &= mask - 1;
+    return __builtin_ctz(mask);
+}
+
+static int random_cell(unsigned free_mask, uint64_t *rng) {
+    int n = __builtin_popcount(free_mask);
+    return nth_bit(free_mask, (int)((rng_next(rng) >> 32) % (unsigned)n));
+}
+
+/* Cella che completa una linea di who (2 pezzi + 1 libera), -1 se nessuna */
+static int closing_cell(unsigned who, unsigned free_mask) {
+    for (int i = 0; i < RULES_LINES; i++) {
+        unsigned l = rules_lines[i];
+        if (__builtin_popcount(who & l) == 2 && (free_mask & l))
+            return __builtin_ctz(free_mask & l);
+    }
+    return -1;
+}
+
+static int choose(const sim_policy_t *p, unsigned mine, unsigned theirs,
+                  int code, uint64_t *rng) {
+    unsigned free_mask = RULES_FULL & ~(mine | theirs);
+    int cell;
+
+    switch (p->kind) {
+        case SIM_GREEDY:
+            if ((cell = closing_cell(mine,   free_mask)) >= 0) return cell;
+            if ((cell = closing_cell(theirs, free_mask)) >= 0) return cell;
+            return random_cell(free_mask, rng);
+        case SIM_PERFECT:
+            return solver_best_move(code);
+        case SIM_EPSILON:
+            /* 53 bit di mantissa: confronto esatto con eps */
+            if ((double)(rng_next(rng) >> 11) * 0x1.0p-53 < p->eps)
+                return random_cell(free_mask, rng);
+            return solver_best_move(code);
+        case SIM_RANDOM:
+        default:
+            return random_cell(free_mask, rng);
+    }
+}
+
+/* ------------------------------------------------------------------ */
+/*  Batch (un thread)                                                   */
+/* ------------------------------------------------------------------ */
+
+void sim_run_batch(const sim_policy_t *x, const sim_policy_t *o,
+                   uint64_t games, uint64_t seed, sim_stats_t *out) {
+    const sim_policy_t *pol[2] = { x, o };
+    uint64_t rng = seed ? seed : 0x9E3779B97F4A7C15ULL;
+
+    vmask_t xm = { 0 }, om = { 0 };
+    vmask_t turn = { 0 };        /* 0xFFFF dove muove O */
+    int     code[SIM_LANES] = { 0 };
+    int     ply[SIM_LANES]  = { 0 };
+    int     live[SIM_LANES];
+
+    uint64_t started = 0;
+    int      active  = 0;
+    for (int l = 0; l < SIM_LANES; l++) {
+        live[l] = started < games;
+        if (live[l]) { started++; active++; }
+    }
+
+    while (active > 0) {
+        /* 1. mossa per ogni lane viva (scalare) */
+        vmask_t mv = { 0 };
+        for (int l = 0; l < SIM_LANES; l++) {
+            if (!live[l]) continue;
+            int is_o = turn[l] != 0;
+            unsigned mine   = is_o ? om[l] : xm[l];
+            unsigned theirs = is_o ? xm[l] : om[l];
+            int cell = choose(pol[is_o], mine, theirs, code[l], &rng);
+            mv[l]    = (uint16_t)(1u << cell);
+            code[l] += (is_o ? 2 : 1) * pow3[cell];
+            ply[l]++;
+        }
+
+        /* 2. applicazione e valutazione su tutte le lane insieme */
+        xm |= mv & ~turn;
+        om |= mv &  turn;
+        vmask_t mover = (xm & ~turn) | (om & turn);
+
+        vcmp_t won = { 0 };
+        for (int i = 0; i < RULES_LINES; i++) {
+            uint16_t ln = rules_lines[i];
+            won |= (vcmp_t)((mover & ln) == ln);
+        }
+        vcmp_t full = (vcmp_t)((xm | om) == RULES_FULL);
+        vcmp_t done = won | full;
+
+        /* 3. esiti e ricarica delle lane finite */
+        for (int l = 0; l < SIM_LANES; l++) {
+            if (!live[l]) continue;
+            if (!done[l]) { turn[l] = (uint16_t)~turn[l]; continue; }
+
+            out->games++;
+            out->length[ply[l]]++;
+            if (!won[l])       out->draws++;
+            else if (turn[l])  out->o_wins++;
+            else               out->x_wins++;
+
+            xm[l] = om[l] = turn[l] = 0;
+            code[l] = ply[l] = 0;
+            if (started < games) started++;
+            else { live[l] = 0; active--; }
+        }
+    }
+}
+
+/* ------------------------------------------------------------------ */
+/*  Parallelo                                                           */
+/* ------------------------------------------------------------------ */
+
+typedef struct {
+    const sim_policy_t *x, *o;
+    uint64_t            games;
+    uint64_t            seed;
+    int                 spawned;
+    sim_stats_t         stats;
+} sim_job_t;
+
+static void *sim_worker(void *arg) {
+    sim_job_t *j = arg;
+    sim_run_batch(j->x, j->o, j->games, j->seed, &j->stats);
+    return NULL;
+}
+
+static void stats_add(sim_stats_t *dst, const sim_stats_t *src) {
+    dst->games  += src->games;
+    dst->x_wins += src->x_wins;
+    dst->o_wins += src->o_wins;
+    dst->draws  += src->draws;
+    for (int i = 0; i <= SIM_MAX_PLY; i++)
+        dst->length[i] += src->length[i];
+}
+
+int sim_run(const sim_policy_t *x, const sim_policy_t *o,
+            uint64_t games, int threads, uint64_t seed, sim_stats_t *out) {
+    if (threads <= 0) {
+        long n = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = (n > 0) ? (int)n : 1;
+    }
+    if ((uint64_t)threads > games) threads = games ? (int)games : 1;
+
+    sim_job_t *jobs = calloc((size_t)threads, sizeof(*jobs));
+    pthread_t *tids = calloc((size_t)threads, sizeof(*tids));
+    if (!jobs || !tids) { free(jobs); free(tids); return -1; }
+
+    for (int i = 0; i < threads; i++) {
+        jobs[i].x     = x;
+        jobs[i].o     = o;
+        jobs[i].games = games / (uint64_t)threads +
+                        ((uint64_t)i < games % (uint64_t)threads);
+        /* seed distinti e mai nulli per ogni thread */
+        jobs[i].seed  = (seed + (uint64_t)i + 1) * 0x9E3779B97F4A7C15ULL;
+        jobs[i].spawned = pthread_create(&tids[i], NULL, sim_worker, &jobs[i]) == 0;
+        if (!jobs[i].spawned)
+            sim_worker(&jobs[i]);   /* si gioca nel thread corrente */
+    }
+    for (int i = 0; i < threads; i++) {
+        if (jobs[i].spawned) pthread_join(tids[i], NULL);
+        stats_add(out, &jobs[i].stats);
+    }
+
+    free(jobs);
+    free(tids);
+    return threads;
+}